@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/matrix.hpp"
+
+/*
+ * Throughput of the batched activation kernels against the per-element path the layers used
+ * before (one scalar call per Matrix::at), forward and backward, in million elements per second.
+ *
+ * Usage: activation_benchmark [isa]   with isa one of scalar, avx2, avx512 (default: best available)
+ */
+
+namespace {
+
+// Best-of-N Melem/s, repeating each measurement for at least ~50ms
+template<typename F>
+double throughput(size_t elements, F&& f) {
+    using clock = std::chrono::steady_clock;
+    double best = 0.0;
+
+    for (int trial = 0; trial < 3; trial++) {
+        size_t iterations = 0;
+        auto start = clock::now();
+        double elapsed = 0.0;
+        do {
+            f();
+            iterations++;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < 0.05);
+        best = std::max(best, static_cast<double>(elements) * iterations / elapsed * 1e-6);
+    }
+    return best;
+}
+
+template<template<typename> class Activation>
+void run(const std::string& name, size_t rows, size_t columns) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-6.0f, 6.0f);
+    Matrix<float> z(rows, columns);
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < columns; j++) {
+            z.at(i, j) = dist(gen);
+        }
+    }
+    Matrix<float> out(rows, columns);
+    const size_t n = rows * columns;
+
+    const double element_forward = throughput(n, [&] {
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < columns; j++) {
+                out.at(i, j) = Activation<float>::forward(z.at(i, j));
+            }
+        }
+        asm volatile("" : : "r"(out.data()) : "memory");
+    });
+    const double batched_forward = throughput(n, [&] {
+        Activation<float>::forward(z.data(), out.data(), n);
+        asm volatile("" : : "r"(out.data()) : "memory");
+    });
+    const double element_backward = throughput(n, [&] {
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < columns; j++) {
+                out.at(i, j) = Activation<float>::backward(z.at(i, j));
+            }
+        }
+        asm volatile("" : : "r"(out.data()) : "memory");
+    });
+    const double batched_backward = throughput(n, [&] {
+        Activation<float>::backward(z.data(), out.data(), n);
+        asm volatile("" : : "r"(out.data()) : "memory");
+    });
+
+    std::cout << std::setw(10) << name << std::setw(10) << n << std::fixed << std::setprecision(1)
+        << std::setw(12) << element_forward << std::setw(12) << batched_forward
+        << std::setw(8) << batched_forward / element_forward << "x"
+        << std::setw(12) << element_backward << std::setw(12) << batched_backward
+        << std::setw(8) << batched_backward / element_backward << "x" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        std::string isa = argv[1];
+        if (isa == "scalar") nn::simd::set_isa(nn::simd::Isa::SCALAR);
+        else if (isa == "avx2") nn::simd::set_isa(nn::simd::Isa::AVX2);
+        else if (isa == "avx512") nn::simd::set_isa(nn::simd::Isa::AVX512);
+        else {
+            std::cerr << "unknown isa: " << isa << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << "float (" << nn::simd::isa_name(nn::simd::active_isa()) << "), Melem/s" << std::endl;
+    std::cout << std::setw(10) << "" << std::setw(10) << "n"
+        << std::setw(12) << "fwd elem" << std::setw(12) << "fwd batch" << std::setw(9) << "speedup"
+        << std::setw(12) << "bwd elem" << std::setw(12) << "bwd batch" << std::setw(9) << "speedup" << std::endl;
+
+    // a hidden layer over a batch of 32, and a buffer well beyond L2
+    for (size_t columns : {32, 8192}) {
+        run<nn::activations::ReLU>("relu", 128, columns);
+        run<nn::activations::LeakyReLU>("leakyrelu", 128, columns);
+        run<nn::activations::Sigmoid>("sigmoid", 128, columns);
+        run<nn::activations::Tanh>("tanh", 128, columns);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/dataset.hpp"
+#include "nn/layer.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/thread_pool.hpp"
+
+/*
+ * Training throughput of the mnist topology (784-128-64-10) and of a small one (128-64-10) for
+ * 1..N threads of the library pool: serial steps, whose products and elementwise loops are split
+ * over the threads when large enough, against data-parallel steps with one replica per thread
+ * (Network::set_replicas). Synthetic data, so no dataset download is needed.
+ *
+ * Usage: data_parallel_benchmark [max_threads] [batch_size]
+ */
+
+namespace {
+
+nn::Dataset<float> synthetic(size_t samples, size_t features) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    nn::Dataset<float> data(samples, features, 10);
+    for (size_t i = 0; i < samples; i++) {
+        for (size_t k = 0; k < features; k++) {
+            data.sample(i)[k] = pixel(gen);
+        }
+        data.set_label(i, static_cast<uint32_t>(gen() % 10));
+    }
+    return data;
+}
+
+double samples_per_second(const std::vector<size_t>& sizes, size_t threads, bool replicas, size_t batch_size,
+        const nn::Dataset<float>& data) {
+    nn::set_num_threads(threads);
+
+    std::vector<nn::Layer<float, nn::activations::ReLU>> hidden;
+    hidden.reserve(sizes.size());
+    for (size_t i = 0; i + 2 < sizes.size(); i++) {
+        hidden.emplace_back(sizes[i], sizes[i + 1]);
+    }
+    nn::Layer<float, nn::activations::Sigmoid> output(sizes[sizes.size() - 2], sizes.back());
+    nn::Network<float> network;
+    for (auto& layer : hidden) network.add(&layer);
+    network.add(&output);
+    nn::SGD<float> optimizer(0.1f, 0.9f);
+    network.set_optimizer(&optimizer);
+    network.set_replicas(replicas ? threads : 1);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    // warm-up epoch (thread start-up, packing buffers, replica workspaces)
+    network.train(data, 1, batch_size);
+
+    const size_t epochs = 3;
+    auto start = std::chrono::steady_clock::now();
+    network.train(data, epochs, batch_size);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return epochs * data.size() / elapsed;
+}
+
+void scaling(const std::vector<size_t>& sizes, size_t max_threads, size_t batch_size) {
+    const nn::Dataset<float> data = synthetic(4096, sizes[0]);
+    for (size_t k = 0; k < sizes.size(); k++) {
+        std::cout << (k ? "-" : "") << sizes[k];
+    }
+    std::cout << ", batch size " << batch_size << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "serial/s" << std::setw(10) << "speedup"
+        << std::setw(16) << "replicas/s" << std::setw(10) << "speedup" << std::endl;
+
+    double baseline = 0.0;
+    for (size_t threads = 1; threads <= max_threads; threads = threads < 4 ? threads + 1 : threads * 2) {
+        const double serial = samples_per_second(sizes, threads, false, batch_size, data);
+        const double parallel = samples_per_second(sizes, threads, true, batch_size, data);
+        if (threads == 1) baseline = serial;
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(0)
+            << std::setw(16) << serial << std::setprecision(2) << std::setw(9) << serial / baseline << "x"
+            << std::setprecision(0) << std::setw(16) << parallel << std::setprecision(2)
+            << std::setw(9) << parallel / baseline << "x" << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t batch_size = 64;
+    if (argc > 1) max_threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2) batch_size = std::strtoul(argv[2], nullptr, 10);
+
+    std::cout << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    scaling({784, 128, 64, 10}, max_threads, batch_size);
+    scaling({128, 64, 10}, max_threads, batch_size);
+    return 0;
+}
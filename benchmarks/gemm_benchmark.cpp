@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/matrix.hpp"
+
+/*
+ * GFLOP/s of Matrix::mul (packed, cache-blocked GEMM) against the original naive i-j-k loop.
+ *
+ * Usage: gemm_benchmark [isa]   with isa one of scalar, avx2, avx512 (default: best available)
+ */
+
+namespace {
+
+template<typename T>
+Matrix<T> naive_mul(const Matrix<T>& A, const Matrix<T>& B) {
+    // The implementation Matrix::mul used to have
+    Matrix<T> result(A.rows(), B.columns());
+    for (size_t i = 0; i < A.rows(); i++) {
+        for (size_t j = 0; j < B.columns(); j++) {
+            T sum = 0;
+            for (size_t k = 0; k < A.columns(); k++) {
+                sum += A.at(i, k) * B.at(k, j);
+            }
+            result.at(i, j) = sum;
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> random_matrix(size_t rows, size_t columns, std::mt19937& gen) {
+    std::uniform_real_distribution<T> dist(-1, 1);
+    std::vector<T> values(rows * columns);
+    for (auto& v : values) {
+        v = dist(gen);
+    }
+    return Matrix<T>(rows, columns, values);
+}
+
+// Best-of-N GFLOP/s, repeating each measurement for at least ~50ms
+template<typename F>
+double gflops(size_t M, size_t N, size_t K, F&& f) {
+    using clock = std::chrono::steady_clock;
+    const double flops = 2.0 * M * N * K;
+    double best = 0.0;
+
+    for (int trial = 0; trial < 3; trial++) {
+        size_t iterations = 0;
+        auto start = clock::now();
+        double elapsed = 0.0;
+        do {
+            f();
+            iterations++;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        } while (elapsed < 0.05);
+        best = std::max(best, flops * iterations / elapsed * 1e-9);
+    }
+    return best;
+}
+
+template<typename T>
+void run(const std::string& type_name) {
+    struct Shape { size_t M, N, K; const char* label; };
+    const std::vector<Shape> shapes = {
+        {128, 1, 784, "layer1 forward, 1 sample"},
+        {128, 32, 784, "layer1 forward, batch 32"},
+        {784, 32, 128, "layer1 input grad, batch 32"},
+        {64, 32, 128, "layer2 forward, batch 32"},
+        {128, 128, 128, "square"},
+        {256, 256, 256, "square"},
+        {512, 512, 512, "square"},
+    };
+
+    std::mt19937 gen(42);
+    std::cout << type_name << " (" << nn::simd::isa_name(nn::simd::active_isa()) << ")" << std::endl;
+    std::cout << std::setw(6) << "M" << std::setw(6) << "N" << std::setw(6) << "K"
+        << std::setw(14) << "naive GF/s" << std::setw(14) << "gemm GF/s"
+        << std::setw(10) << "speedup" << "  " << "shape" << std::endl;
+
+    for (const auto& s : shapes) {
+        Matrix<T> A = random_matrix<T>(s.M, s.K, gen);
+        Matrix<T> B = random_matrix<T>(s.K, s.N, gen);
+
+        double naive = gflops(s.M, s.N, s.K, [&] {
+            Matrix<T> C = naive_mul(A, B);
+            asm volatile("" : : "r"(C.data()) : "memory");
+        });
+        double blocked = gflops(s.M, s.N, s.K, [&] {
+            Matrix<T> C = A * B;
+            asm volatile("" : : "r"(C.data()) : "memory");
+        });
+
+        std::cout << std::setw(6) << s.M << std::setw(6) << s.N << std::setw(6) << s.K
+            << std::fixed << std::setprecision(2)
+            << std::setw(14) << naive << std::setw(14) << blocked
+            << std::setw(9) << blocked / naive << "x" << "  " << s.label << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        std::string isa = argv[1];
+        if (isa == "scalar") nn::simd::set_isa(nn::simd::Isa::SCALAR);
+        else if (isa == "avx2") nn::simd::set_isa(nn::simd::Isa::AVX2);
+        else if (isa == "avx512") nn::simd::set_isa(nn::simd::Isa::AVX512);
+        else {
+            std::cerr << "unknown isa: " << isa << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    run<float>("float");
+    run<double>("double");
+    return 0;
+}
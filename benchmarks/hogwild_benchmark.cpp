@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/dataset.hpp"
+#include "nn/layer.hpp"
+#include "nn/loss.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/thread_pool.hpp"
+
+/*
+ * Hogwild! against synchronous training on a sparse-ish problem: 784 binary features of which
+ * about 6% are set (a quarter of the 40 features of the class, and 40 at random), 10 classes,
+ * trained per sample (batch 1) and in small batches on the mnist topology with an Identity output
+ * and softmax cross-entropy, SGD with momentum. For 1..N threads: training throughput and test
+ * accuracy after a fixed number of epochs of
+ * - serial steps (threads inside each product),
+ * - synchronous data-parallel steps (one replica per thread, gradients summed per batch),
+ * - Hogwild! (one replica per thread, lock-free SGD steps on the shared weights).
+ * With one thread all three are the same serial training.
+ *
+ * Usage: hogwild_benchmark [max_threads] [epochs]
+ */
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Each class sets a few of its own 40 features, among as many random ones
+nn::Dataset<float> sparse_problem(size_t samples, unsigned seed) {
+    std::mt19937 prototype_gen(1);
+    std::vector<std::vector<size_t>> prototypes(10);
+    for (auto& prototype : prototypes) {
+        for (int k = 0; k < 40; k++) prototype.push_back(prototype_gen() % 784);
+    }
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+    nn::Dataset<float> data(samples, 784, 10);
+    for (size_t i = 0; i < samples; i++) {
+        const size_t label = gen() % 10;
+        float* x = data.sample(i);
+        std::fill(x, x + 784, 0.0f);
+        for (size_t feature : prototypes[label]) {
+            if (coin(gen) < 0.25f) x[feature] = 1.0f;
+        }
+        for (int k = 0; k < 40; k++) x[gen() % 784] = 1.0f;
+        data.set_label(i, static_cast<uint32_t>(label));
+    }
+    return data;
+}
+
+struct Result {
+    double samples_per_second;
+    double accuracy;
+};
+
+Result run(size_t threads, size_t replicas, nn::Synchronization synchronization, size_t batch_size, size_t epochs,
+        const nn::Dataset<float>& train, const nn::Dataset<float>& test) {
+    nn::set_num_threads(threads);
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::Identity> layer3(64, 10);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    nn::SGD<float> optimizer(0.01f, 0.9f);
+    nn::SoftmaxCrossEntropy<float> loss;
+    network.set_optimizer(&optimizer);
+    network.set_loss(&loss);
+    network.set_replicas(replicas, synchronization);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    auto start = clock_type::now();
+    network.train(train, epochs, batch_size);
+    const double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    Matrix<float> inputs(0, 0);
+    std::vector<uint32_t> labels;
+    test.gather(size_t{0}, test.size(), inputs, labels);
+    const size_t correct = network.count_correct_predictions(network.predict(inputs), labels);
+    return {epochs * train.size() / elapsed, 100.0 * correct / test.size()};
+}
+
+void compare(size_t max_threads, size_t batch_size, size_t epochs, const nn::Dataset<float>& train,
+        const nn::Dataset<float>& test) {
+    std::cout << "batch size " << batch_size << ", " << epochs << " epochs" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(24) << "serial" << std::setw(24) << "all-reduce"
+        << std::setw(24) << "hogwild" << std::endl;
+    std::cout << std::setw(8) << "";
+    for (int k = 0; k < 3; k++) std::cout << std::setw(14) << "samples/s" << std::setw(10) << "accuracy";
+    std::cout << std::endl;
+
+    for (size_t threads = 1; threads <= max_threads; threads = threads < 4 ? threads + 1 : threads * 2) {
+        const Result serial = run(threads, 1, nn::Synchronization::ALL_REDUCE, batch_size, epochs, train, test);
+        const Result all_reduce = run(threads, threads, nn::Synchronization::ALL_REDUCE, batch_size, epochs, train, test);
+        const Result hogwild = run(threads, threads, nn::Synchronization::HOGWILD, batch_size, epochs, train, test);
+        std::cout << std::setw(8) << threads;
+        for (const Result& result : {serial, all_reduce, hogwild}) {
+            std::cout << std::fixed << std::setprecision(0) << std::setw(14) << result.samples_per_second
+                << std::setprecision(2) << std::setw(9) << result.accuracy << "%";
+        }
+        std::cout << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t epochs = 2;
+    if (argc > 1) max_threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2) epochs = std::strtoul(argv[2], nullptr, 10);
+
+    const nn::Dataset<float> train = sparse_problem(8192, 2);
+    const nn::Dataset<float> test = sparse_problem(2048, 3);
+    std::cout << std::thread::hardware_concurrency() << " hardware threads, 784-128-64-10, "
+        << train.size() << " training and " << test.size() << " test samples" << std::endl;
+    compare(max_threads, 1, epochs, train, test);
+    compare(max_threads, 8, epochs, train, test);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+#include "nn/checkpoint.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/activation.hpp"
+#include "nn/static_network.hpp"
+
+/*
+ * Single-sample inference on the mnist topology (784-128-64-10):
+ * latency and heap allocations per call of Network::forward against Network::predict, and
+ * against the same weights in a StaticNetwork (sizes known at compile time, no virtual calls).
+ * Then the cold start from a checkpoint until the first prediction: building the layers and
+ * loading the checkpoint into them against mapping it with nn::MappedModel.
+ */
+
+namespace {
+std::atomic<size_t> allocation_count{0};
+
+void* counted_malloc(std::size_t size) {
+    allocation_count++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* counted_aligned_alloc(std::size_t size, std::align_val_t alignment) {
+    allocation_count++;
+    const std::size_t a = static_cast<std::size_t>(alignment);
+    if (void* p = std::aligned_alloc(a, size ? (size + a - 1) / a * a : a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+}
+
+// Every form is replaced, each new with its delete, so that GCC sees malloc paired with free
+void* operator new(std::size_t size) { return counted_malloc(size); }
+void* operator new[](std::size_t size) { return counted_malloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// Matrix storage comes from the aligned forms (see aligned_allocator.hpp)
+void* operator new(std::size_t size, std::align_val_t alignment) { return counted_aligned_alloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return counted_aligned_alloc(size, alignment); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Result {
+    double ns_per_call;
+    double allocations_per_call;
+};
+
+template<typename F>
+Result measure(F&& f) {
+    using clock = std::chrono::steady_clock;
+    const size_t iterations = 20000;
+
+    for (size_t i = 0; i < 100; i++) {
+        f();
+    }
+
+    size_t allocations = allocation_count.load();
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        f();
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    allocations = allocation_count.load() - allocations;
+
+    return {elapsed / iterations, static_cast<double>(allocations) / iterations};
+}
+
+}
+
+int main() {
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    std::vector<float> image(784);
+    for (auto& p : image) p = pixel(gen);
+    Matrix<float> input(784, 1, image);
+
+    auto fixed = std::make_unique<nn::StaticNetwork<float,
+        nn::StaticLayer<784, 128, nn::activations::ReLU>,
+        nn::StaticLayer<128, 64, nn::activations::ReLU>,
+        nn::StaticLayer<64, 10, nn::activations::Sigmoid>>>(network);
+
+    float sink = 0.0f;
+    Result forward = measure([&] { sink += network.forward(input).at(0, 0); });
+    Result predict = measure([&] { sink += network.predict(input).at(0, 0); });
+    Result fixed_predict = measure([&] { sink += fixed->predict(image.data())[0]; });
+
+    std::cout << "784-128-64-10, single sample" << std::endl;
+    std::cout << std::setw(10) << "path" << std::setw(14) << "ns/call" << std::setw(16) << "allocs/call" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(10) << "forward" << std::setw(14) << forward.ns_per_call
+        << std::setw(16) << forward.allocations_per_call << std::endl;
+    std::cout << std::setw(10) << "predict" << std::setw(14) << predict.ns_per_call
+        << std::setw(16) << predict.allocations_per_call << std::endl;
+    std::cout << std::setw(10) << "static" << std::setw(14) << fixed_predict.ns_per_call
+        << std::setw(16) << fixed_predict.allocations_per_call << std::endl;
+    std::cout << "speedup: predict " << std::setprecision(2) << forward.ns_per_call / predict.ns_per_call << "x"
+        << ", static " << forward.ns_per_call / fixed_predict.ns_per_call << "x"
+        << " (checksum " << sink << ")" << std::endl;
+
+    // Cold start, best of 20
+    const std::string path = (std::filesystem::temp_directory_path() / "nn_inference_benchmark.nnckpt").string();
+    nn::save_checkpoint(network, path);
+    auto cold_start = [&](auto&& f) {
+        using clock = std::chrono::steady_clock;
+        double best = 1e30;
+        for (int trial = 0; trial < 20; trial++) {
+            auto start = clock::now();
+            f();
+            best = std::min(best, std::chrono::duration<double, std::micro>(clock::now() - start).count());
+        }
+        return best;
+    };
+    const double load = cold_start([&] {
+        nn::Network<float> restored;
+        nn::Layer<float, nn::activations::ReLU> restored1(784, 128);
+        nn::Layer<float, nn::activations::ReLU> restored2(128, 64);
+        nn::Layer<float, nn::activations::Sigmoid> restored3(64, 10);
+        restored.add(&restored1);
+        restored.add(&restored2);
+        restored.add(&restored3);
+        nn::load_checkpoint(restored, path);
+        sink += restored.predict(input).at(0, 0);
+    });
+    const double mapped = cold_start([&] {
+        nn::MappedModel<float> model(path);
+        sink += model.predict(input).at(0, 0);
+    });
+    std::filesystem::remove(path);
+
+    std::cout << std::endl << "cold start to first prediction" << std::endl << std::setprecision(1)
+        << std::setw(22) << std::left << "layers + load" << std::right << std::setw(10) << load << " us" << std::endl
+        << std::setw(22) << std::left << "mapped model" << std::right << std::setw(10) << mapped << " us"
+        << "  (" << std::setprecision(2) << load / mapped << "x)" << std::endl;
+    return 0;
+}
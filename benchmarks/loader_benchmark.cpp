@@ -0,0 +1,156 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/batch_loader.hpp"
+#include "nn/idx.hpp"
+#include "nn/layer.hpp"
+#include "nn/matrix.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "mnist_utils.cpp"
+
+/*
+ * Load time of the MNIST training images: the original byte-by-byte reader against the mapped
+ * IdxFile, both into one Matrix per image (mnist::load_images) and in bulk into one buffer.
+ * Then the time of a shuffled training epoch of the mnist topology (batch 32) with the batches
+ * gathered on the training thread (BatchLoader of depth 1, no overlap) against a prefetching
+ * BatchLoader of depth 2. The overlap needs a second hardware thread.
+ *
+ * Usage: loader_benchmark [images.idx3-ubyte]
+ * Without an argument ./data/train-images.idx3-ubyte is used, or a synthetic file of the same
+ * size (60000 x 28 x 28) when it does not exist.
+ */
+
+namespace {
+
+// The implementation mnist::load_images used to have
+std::vector<Matrix<float> > legacy_load_images(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    auto read_big_endian_int = [&file] {
+        uint8_t buf[4];
+        file.read(reinterpret_cast<char*>(buf), 4);
+        return (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 | (uint32_t)buf[2] << 8 | (uint32_t)buf[3];
+    };
+    read_big_endian_int();
+    const uint32_t num_images = read_big_endian_int();
+    const uint32_t rows = read_big_endian_int();
+    const uint32_t cols = read_big_endian_int();
+
+    std::vector<Matrix<float> > images;
+    images.reserve(num_images);
+    for (uint32_t i = 0; i < num_images; ++i) {
+        std::vector<float> pixels(rows * cols);
+        for (uint32_t j = 0; j < rows * cols; ++j) {
+            uint8_t pixel;
+            file.read(reinterpret_cast<char*>(&pixel), 1);
+            pixels[j] = static_cast<float>(pixel) / 255.0f;
+        }
+        Matrix<float> image(rows * cols, 1, pixels);
+        images.push_back(image);
+    }
+    return images;
+}
+
+std::string write_synthetic_images(size_t count) {
+    const std::string path = (std::filesystem::temp_directory_path() / "nn_loader_benchmark.idx3-ubyte").string();
+    std::ofstream file(path, std::ios::binary);
+    const uint8_t header[16] = {
+        0, 0, 8, 3,
+        static_cast<uint8_t>(count >> 24), static_cast<uint8_t>(count >> 16),
+        static_cast<uint8_t>(count >> 8), static_cast<uint8_t>(count),
+        0, 0, 0, 28, 0, 0, 0, 28
+    };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    std::mt19937 gen(42);
+    std::vector<char> pixels(count * 28 * 28);
+    for (auto& p : pixels) {
+        p = static_cast<char>(gen() & 0xff);
+    }
+    file.write(pixels.data(), static_cast<std::streamsize>(pixels.size()));
+    return path;
+}
+
+// Best-of-3 wall time in milliseconds
+template<typename F>
+double best_ms(F&& f) {
+    using clock = std::chrono::steady_clock;
+    double best = 1e30;
+    for (int trial = 0; trial < 3; trial++) {
+        auto start = clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(clock::now() - start).count());
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "./data/train-images.idx3-ubyte";
+    if (argc <= 1 && !std::filesystem::exists(path)) {
+        path = write_synthetic_images(60000);
+        std::cout << "MNIST not found, using a synthetic file: " << path << std::endl;
+    }
+
+    size_t images = 0;
+    const double legacy = best_ms([&] { images = legacy_load_images(path).size(); });
+    const double per_image = best_ms([&] { images = mnist::load_images(path).size(); });
+
+    std::vector<float> contiguous;
+    const double bulk = best_ms([&] {
+        nn::IdxFile file(path);
+        contiguous.resize(file.count() * file.sample_size());
+        file.to_float(0, file.count(), contiguous.data());
+        images = file.count();
+    });
+
+    std::cout << images << " images (" << nn::simd::isa_name(nn::simd::active_isa()) << ")" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+        << std::setw(34) << std::left << "byte-by-byte reader" << std::right << std::setw(10) << legacy << " ms" << std::endl
+        << std::setw(34) << std::left << "mapped, one Matrix per image" << std::right << std::setw(10) << per_image << " ms"
+        << "  (" << legacy / per_image << "x)" << std::endl
+        << std::setw(34) << std::left << "mapped, bulk into one buffer" << std::right << std::setw(10) << bulk << " ms"
+        << "  (" << legacy / bulk << "x)" << std::endl;
+
+    // Training epochs over the first 10000 images, labels are arbitrary
+    nn::IdxFile file(path);
+    const size_t samples = std::min<size_t>(10000, file.count());
+    nn::Dataset<float> data(samples, file.sample_size(), 10);
+    file.to_float(0, samples, data.features());
+    for (size_t i = 0; i < samples; i++) {
+        data.set_label(i, static_cast<uint32_t>(i % 10));
+    }
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(file.sample_size(), 128);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    nn::SGD<float> optimizer1(0.01f), optimizer2(0.01f), optimizer3(0.01f);
+    layer1.set_optimizer(&optimizer1);
+    layer2.set_optimizer(&optimizer2);
+    layer3.set_optimizer(&optimizer3);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::BatchLoader<float> synchronous(data, 32, true, 1, 1);
+    nn::BatchLoader<float> prefetching(data, 32, true, 1, 2);
+    const double sync_epoch = best_ms([&] { network.train(synchronous, 1); });
+    const double async_epoch = best_ms([&] { network.train(prefetching, 1); });
+
+    std::cout << std::endl << samples << " samples per epoch, batch 32, "
+        << std::thread::hardware_concurrency() << " hardware threads" << std::endl
+        << std::setw(34) << std::left << "gather on the training thread" << std::right << std::setw(10) << sync_epoch << " ms" << std::endl
+        << std::setw(34) << std::left << "prefetching loader" << std::right << std::setw(10) << async_epoch << " ms"
+        << "  (" << sync_epoch / async_epoch << "x)" << std::endl;
+    return 0;
+}
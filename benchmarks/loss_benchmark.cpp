@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/batch_loader.hpp"
+#include "nn/layer.hpp"
+#include "nn/loss.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "mnist_utils.cpp"
+
+/*
+ * Convergence of the mnist topology (784-128-64-10, batch 32, shuffled) with a Sigmoid output
+ * trained on mean squared error against an Identity output trained on softmax cross-entropy from
+ * the labels, with SGD and with Adam: epochs and training time until the test accuracy reaches
+ * the target, checked after every epoch (at most 10 epochs). Then the cost of the loss and its
+ * gradient for a batch of 32 and of 256.
+ *
+ * Usage: loss_benchmark [data_dir] [target_accuracy_percent]
+ * Uses 10000 training samples of data_dir (default ./data/) and t10k, with a default target of
+ * 95%. Without the MNIST files, a noisy synthetic 10-class problem of the same shape is used
+ * (default target 90%), so only the relative numbers are meaningful.
+ */
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// 10 class prototypes in [0, 1]^784 under heavy noise
+nn::Dataset<float> synthetic(size_t samples, unsigned seed) {
+    std::mt19937 prototype_gen(1);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    std::vector<float> prototypes(10 * 784);
+    for (auto& p : prototypes) p = pixel(prototype_gen) < 0.2f ? 1.0f : 0.0f;
+
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.0f, 1.5f);
+    nn::Dataset<float> data(samples, 784, 10);
+    for (size_t i = 0; i < samples; i++) {
+        const size_t label = gen() % 10;
+        for (size_t k = 0; k < 784; k++) {
+            data.sample(i)[k] = std::min(1.0f, std::max(0.0f, prototypes[label * 784 + k] + noise(gen)));
+        }
+        data.set_label(i, static_cast<uint32_t>(label));
+    }
+    return data;
+}
+
+double accuracy(nn::Network<float>& network, const nn::Dataset<float>& test) {
+    Matrix<float> inputs(0, 0);
+    std::vector<uint32_t> labels;
+    size_t correct = 0;
+    for (size_t first = 0; first < test.size(); first += 256) {
+        const size_t count = std::min<size_t>(256, test.size() - first);
+        test.gather(first, count, inputs, labels);
+        correct += network.count_correct_predictions(network.predict(inputs), labels);
+    }
+    return 100.0 * correct / test.size();
+}
+
+template<template<typename> class Output>
+void converge(const std::string& name, nn::Optimizer<float>& optimizer, nn::Loss<float>* loss,
+    const nn::Dataset<float>& train, const nn::Dataset<float>& test, double target) {
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, Output> layer3(64, 10);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    network.set_optimizer(&optimizer);
+    network.set_loss(loss);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::BatchLoader<float> loader(train, 32, true, 7);
+    double seconds = 0.0;
+    double reached = 0.0;
+    size_t epoch = 0;
+    while (epoch < 10 && reached < target) {
+        auto start = clock_type::now();
+        network.train(loader, 1);
+        seconds += std::chrono::duration<double>(clock_type::now() - start).count();
+        reached = accuracy(network, test);
+        epoch++;
+    }
+
+    std::cout << std::setw(26) << name << std::setw(10) << epoch << std::setw(12) << seconds
+        << std::setw(11) << reached << "%" << (reached < target ? "  (target not reached)" : "") << std::endl;
+}
+
+// Best-of-5 microseconds per loss and gradient of a 10 x batch output
+double loss_us(nn::Loss<float>& loss, size_t batch) {
+    Matrix<float> output(10, batch), gradient(0, 0);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dist(-5.0f, 5.0f);
+    for (size_t k = 0; k < 10 * batch; k++) output.data()[k] = dist(gen);
+    std::vector<uint32_t> labels(batch);
+    for (auto& label : labels) label = gen() % 10;
+
+    loss.evaluate(output, labels.data(), gradient);
+    double best = 1e30;
+    for (int trial = 0; trial < 5; trial++) {
+        auto start = clock_type::now();
+        for (int i = 0; i < 1000; i++) {
+            loss.evaluate(output, labels.data(), gradient);
+            asm volatile("" : : "r"(gradient.data()) : "memory");
+        }
+        best = std::min(best, std::chrono::duration<double, std::micro>(clock_type::now() - start).count() / 1000);
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : "./data/";
+    const bool have_mnist = std::filesystem::exists(dir + "train-images.idx3-ubyte");
+    const double target = argc > 2 ? std::stod(argv[2]) : (have_mnist ? 95.0 : 90.0);
+
+    nn::Dataset<float> train = have_mnist
+        ? mnist::load_dataset(dir + "train-images.idx3-ubyte", dir + "train-labels.idx1-ubyte", 10000)
+        : synthetic(10000, 2);
+    nn::Dataset<float> test = have_mnist
+        ? mnist::load_dataset(dir + "t10k-images.idx3-ubyte", dir + "t10k-labels.idx1-ubyte")
+        : synthetic(10000, 3);
+    std::cout << (have_mnist ? "MNIST" : "synthetic data (MNIST not found)") << ": "
+        << train.size() << " training, " << test.size() << " test samples, target "
+        << target << "% test accuracy" << std::endl;
+
+    std::cout << std::setw(26) << "output + loss" << std::setw(10) << "epochs" << std::setw(12) << "seconds"
+        << std::setw(12) << "accuracy" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    nn::SoftmaxCrossEntropy<float> cross_entropy;
+    {
+        nn::SGD<float> optimizer(0.01f);
+        converge<nn::activations::Sigmoid>("sigmoid + mse, sgd", optimizer, nullptr, train, test, target);
+    }
+    {
+        nn::SGD<float> optimizer(0.01f);
+        converge<nn::activations::Identity>("softmax + ce, sgd", optimizer, &cross_entropy, train, test, target);
+    }
+    {
+        nn::Adam<float> optimizer(0.001f);
+        converge<nn::activations::Sigmoid>("sigmoid + mse, adam", optimizer, nullptr, train, test, target);
+    }
+    {
+        nn::Adam<float> optimizer(0.001f);
+        converge<nn::activations::Identity>("softmax + ce, adam", optimizer, &cross_entropy, train, test, target);
+    }
+
+    nn::MeanSquaredError<float> mse;
+    std::cout << "loss and gradient of 10 outputs (" << nn::simd::isa_name(nn::simd::active_isa()) << ")" << std::endl;
+    std::cout << std::setw(26) << "loss" << std::setw(12) << "batch 32" << std::setw(12) << "batch 256" << std::endl;
+    std::cout << std::setw(26) << "mse" << std::setw(12) << loss_us(mse, 32) << std::setw(12) << loss_us(mse, 256) << std::endl;
+    std::cout << std::setw(26) << "softmax cross-entropy" << std::setw(12) << loss_us(cross_entropy, 32)
+        << std::setw(12) << loss_us(cross_entropy, 256) << std::endl;
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/dataset.hpp"
+#include "nn/layer.hpp"
+#include "nn/matrix.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "mnist_utils.cpp"
+
+/*
+ * Google Benchmark suite of the hot paths, to compare builds against each other:
+ * - Matrix: mul (allocating and into a reused result) and the elementwise ops across sizes
+ * - Layer: forward and backward of every activation on the mnist layer shapes
+ * - Network::train: one epoch of the mnist topology on synthetic MNIST-shaped data
+ * - mnist::load_images / load_dataset: on a synthetic IDX file of 10000 images
+ *
+ * Usage: nn_benchmark [google benchmark flags], e.g.
+ *   nn_benchmark --benchmark_filter=Layer --benchmark_out=results.json --benchmark_out_format=json
+ * The benchmark_json target writes the whole suite to benchmark.json in the build directory;
+ * tools/compare.py of Google Benchmark diffs two such files.
+ */
+
+namespace {
+
+Matrix<float> random_matrix(size_t rows, size_t columns, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Matrix<float> m(rows, columns);
+    for (size_t k = 0; k < rows * columns; k++) {
+        m.data()[k] = dist(gen);
+    }
+    return m;
+}
+
+// 784 pixels in [0, 1] and a class out of 10 per sample
+nn::Dataset<float> mnist_shaped(size_t samples) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    nn::Dataset<float> data(samples, 784, 10);
+    for (size_t i = 0; i < samples; i++) {
+        for (size_t k = 0; k < 784; k++) {
+            data.sample(i)[k] = pixel(gen);
+        }
+        data.set_label(i, static_cast<uint32_t>(gen() % 10));
+    }
+    return data;
+}
+
+void write_big_endian(std::ofstream& out, uint32_t value) {
+    const char bytes[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+        static_cast<char>(value >> 8), static_cast<char>(value)};
+    out.write(bytes, 4);
+}
+
+// Synthetic MNIST image and label files, written once per run
+struct IdxFiles {
+    std::string images;
+    std::string labels;
+
+    IdxFiles() {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path();
+        images = (dir / "nn_benchmark-images.idx3-ubyte").string();
+        labels = (dir / "nn_benchmark-labels.idx1-ubyte").string();
+        const uint32_t count = 10000;
+        std::mt19937 gen(7);
+
+        std::ofstream image_file(images, std::ios::binary);
+        write_big_endian(image_file, 0x803);
+        write_big_endian(image_file, count);
+        write_big_endian(image_file, 28);
+        write_big_endian(image_file, 28);
+        std::vector<char> pixels(count * 28 * 28);
+        for (auto& p : pixels) p = static_cast<char>(gen());
+        image_file.write(pixels.data(), pixels.size());
+
+        std::ofstream label_file(labels, std::ios::binary);
+        write_big_endian(label_file, 0x801);
+        write_big_endian(label_file, count);
+        std::vector<char> classes(count);
+        for (auto& c : classes) c = static_cast<char>(gen() % 10);
+        label_file.write(classes.data(), classes.size());
+    }
+
+    ~IdxFiles() {
+        std::filesystem::remove(images);
+        std::filesystem::remove(labels);
+    }
+};
+
+const IdxFiles& idx_files() {
+    static const IdxFiles files;
+    return files;
+}
+
+// --- Matrix ---
+
+void BM_MatrixMul(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const Matrix<float> a = random_matrix(n, n, 1), b = random_matrix(n, n, 2);
+    for (auto _ : state) {
+        Matrix<float> c = a.mul(b);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.counters["FLOPS"] = benchmark::Counter(2.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_MatrixMul)->RangeMultiplier(2)->Range(32, 512);
+
+// The layer shapes: (M x K) * (K x N) into a reused result
+void BM_MatrixMulInto(benchmark::State& state) {
+    const size_t m = state.range(0), k = state.range(1), n = state.range(2);
+    const Matrix<float> a = random_matrix(m, k, 1), b = random_matrix(k, n, 2);
+    Matrix<float> c(m, n);
+    for (auto _ : state) {
+        a.mul_into(b, c);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.counters["FLOPS"] = benchmark::Counter(2.0 * m * n * k, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_MatrixMulInto)->Args({128, 784, 1})->Args({128, 784, 32})->Args({64, 128, 32})->Args({10, 64, 32})
+    ->Args({128, 784, 256});
+
+void BM_MatrixAdd(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const Matrix<float> a = random_matrix(n, n, 1), b = random_matrix(n, n, 2);
+    Matrix<float> c(n, n);
+    for (auto _ : state) {
+        a.add_into(b, c);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.SetBytesProcessed(state.iterations() * 3 * n * n * sizeof(float));
+}
+BENCHMARK(BM_MatrixAdd)->RangeMultiplier(4)->Range(64, 1024);
+
+void BM_MatrixHadamard(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const Matrix<float> a = random_matrix(n, n, 1), b = random_matrix(n, n, 2);
+    Matrix<float> c(n, n);
+    for (auto _ : state) {
+        a.hadamard_into(b, c);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.SetBytesProcessed(state.iterations() * 3 * n * n * sizeof(float));
+}
+BENCHMARK(BM_MatrixHadamard)->RangeMultiplier(4)->Range(64, 1024);
+
+void BM_MatrixScalarMul(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const Matrix<float> a = random_matrix(n, n, 1);
+    Matrix<float> c(n, n);
+    for (auto _ : state) {
+        a.scalar_mul_into(0.5f, c);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * n * n * sizeof(float));
+}
+BENCHMARK(BM_MatrixScalarMul)->RangeMultiplier(4)->Range(64, 1024);
+
+void BM_MatrixTranspose(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const Matrix<float> a = random_matrix(n, n, 1);
+    Matrix<float> c(n, n);
+    for (auto _ : state) {
+        a.transpose_into(c);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * n * n * sizeof(float));
+}
+BENCHMARK(BM_MatrixTranspose)->RangeMultiplier(4)->Range(64, 1024);
+
+// --- Layer ---
+
+// Arguments: input size, output size, batch size
+void layer_shapes(benchmark::internal::Benchmark* b) {
+    for (int64_t batch : {1, 32, 256}) {
+        b->Args({784, 128, batch});
+        b->Args({128, 64, batch});
+        b->Args({64, 10, batch});
+    }
+}
+
+template<template<typename> class Activation>
+void BM_LayerForward(benchmark::State& state) {
+    const size_t in = state.range(0), out = state.range(1), batch = state.range(2);
+    nn::Layer<float, Activation> layer(in, out);
+    const Matrix<float> input = random_matrix(in, batch, 3);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(layer.forward(input).data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK_TEMPLATE(BM_LayerForward, nn::activations::ReLU)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerForward, nn::activations::LeakyReLU)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerForward, nn::activations::Sigmoid)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerForward, nn::activations::Tanh)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerForward, nn::activations::Identity)->Apply(layer_shapes);
+
+// Gradients only: the layer has no optimizer
+template<template<typename> class Activation>
+void BM_LayerBackward(benchmark::State& state) {
+    const size_t in = state.range(0), out = state.range(1), batch = state.range(2);
+    nn::Layer<float, Activation> layer(in, out);
+    layer.forward(random_matrix(in, batch, 3));
+    const Matrix<float> gradient = random_matrix(out, batch, 4);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(layer.backward(gradient).data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK_TEMPLATE(BM_LayerBackward, nn::activations::ReLU)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerBackward, nn::activations::LeakyReLU)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerBackward, nn::activations::Sigmoid)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerBackward, nn::activations::Tanh)->Apply(layer_shapes);
+BENCHMARK_TEMPLATE(BM_LayerBackward, nn::activations::Identity)->Apply(layer_shapes);
+
+// --- Network ---
+
+// One epoch of 784-128-64-10 over 10000 samples, batch size as argument
+void BM_NetworkTrainEpoch(benchmark::State& state) {
+    static const nn::Dataset<float> data = mnist_shaped(10000);
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    nn::SGD<float> optimizer(0.1f, 0.9f);
+    network.set_optimizer(&optimizer);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    for (auto _ : state) {
+        network.train(data, 1, state.range(0));
+    }
+    state.SetItemsProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_NetworkTrainEpoch)->Arg(32)->Arg(128)->Unit(benchmark::kMillisecond);
+
+// --- MNIST loading ---
+
+void BM_MnistLoadImages(benchmark::State& state) {
+    const IdxFiles& files = idx_files();
+    for (auto _ : state) {
+        std::vector<Matrix<float>> images = mnist::load_images(files.images);
+        benchmark::DoNotOptimize(images.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 10000);
+    state.SetBytesProcessed(state.iterations() * 10000 * 784);
+}
+BENCHMARK(BM_MnistLoadImages)->Unit(benchmark::kMillisecond);
+
+void BM_MnistLoadDataset(benchmark::State& state) {
+    const IdxFiles& files = idx_files();
+    for (auto _ : state) {
+        nn::Dataset<float> data = mnist::load_dataset(files.images, files.labels);
+        benchmark::DoNotOptimize(data.features());
+    }
+    state.SetItemsProcessed(state.iterations() * 10000);
+    state.SetBytesProcessed(state.iterations() * 10000 * 784);
+}
+BENCHMARK(BM_MnistLoadDataset)->Unit(benchmark::kMillisecond);
+
+}
+
+BENCHMARK_MAIN();
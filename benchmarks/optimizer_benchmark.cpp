@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/batch_loader.hpp"
+#include "nn/layer.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "mnist_utils.cpp"
+
+/*
+ * Convergence of the mnist topology (784-128-64-10, batch 32, shuffled) with SGD, SGD with
+ * momentum, Adam, AdamW and RMSProp: epochs and training time until the test accuracy reaches
+ * the target, checked after every epoch (at most 10 epochs). Then the cost of one update of
+ * the 784 x 128 layer with each optimizer, and the time of a training step with one optimizer
+ * per layer against a single one for the whole network (Network::set_optimizer).
+ *
+ * Usage: optimizer_benchmark [data_dir] [target_accuracy_percent]
+ * Uses 10000 training samples of data_dir (default ./data/) and t10k, with a default target of
+ * 95%. Without the MNIST files, a noisy synthetic 10-class problem of the same shape is used
+ * (default target 90%), so only the relative numbers are meaningful.
+ */
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// 10 class prototypes in [0, 1]^784 under heavy noise
+nn::Dataset<float> synthetic(size_t samples, unsigned seed) {
+    std::mt19937 prototype_gen(1);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    std::vector<float> prototypes(10 * 784);
+    for (auto& p : prototypes) p = pixel(prototype_gen) < 0.2f ? 1.0f : 0.0f;
+
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.0f, 1.5f);
+    nn::Dataset<float> data(samples, 784, 10);
+    for (size_t i = 0; i < samples; i++) {
+        const size_t label = gen() % 10;
+        for (size_t k = 0; k < 784; k++) {
+            data.sample(i)[k] = std::min(1.0f, std::max(0.0f, prototypes[label * 784 + k] + noise(gen)));
+        }
+        data.set_label(i, static_cast<uint32_t>(label));
+    }
+    return data;
+}
+
+double accuracy(nn::Network<float>& network, const nn::Dataset<float>& test) {
+    Matrix<float> inputs(0, 0);
+    Matrix<float> targets(0, 0);
+    size_t correct = 0;
+    for (size_t first = 0; first < test.size(); first += 256) {
+        const size_t count = std::min<size_t>(256, test.size() - first);
+        test.gather(first, count, inputs, targets);
+        correct += network.count_correct_predictions(network.predict(inputs), targets);
+    }
+    return 100.0 * correct / test.size();
+}
+
+using Factory = std::function<std::unique_ptr<nn::Optimizer<float>>()>;
+
+struct Candidate {
+    std::string name;
+    Factory make;
+};
+
+void converge(const Candidate& candidate, const nn::Dataset<float>& train, const nn::Dataset<float>& test,
+    double target) {
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    auto optimizer1 = candidate.make(), optimizer2 = candidate.make(), optimizer3 = candidate.make();
+    layer1.set_optimizer(optimizer1.get());
+    layer2.set_optimizer(optimizer2.get());
+    layer3.set_optimizer(optimizer3.get());
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::BatchLoader<float> loader(train, 32, true, 7);
+    double seconds = 0.0;
+    double reached = 0.0;
+    size_t epoch = 0;
+    while (epoch < 10 && reached < target) {
+        auto start = clock_type::now();
+        network.train(loader, 1);
+        seconds += std::chrono::duration<double>(clock_type::now() - start).count();
+        reached = accuracy(network, test);
+        epoch++;
+    }
+
+    std::cout << std::setw(14) << candidate.name << std::setw(10) << epoch << std::setw(12) << seconds
+        << std::setw(11) << reached << "%" << (reached < target ? "  (target not reached)" : "") << std::endl;
+}
+
+// Best-of-5 microseconds per update of a 784 x 128 layer
+double update_us(nn::Optimizer<float>& optimizer) {
+    Matrix<float> weights(128, 784), bias(128, 1), weight_gradients(128, 784), bias_gradients(128, 1);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dist(-0.01f, 0.01f);
+    for (size_t k = 0; k < 128 * 784; k++) weight_gradients.data()[k] = dist(gen);
+    for (size_t k = 0; k < 128; k++) bias_gradients.data()[k] = dist(gen);
+
+    optimizer.update(weights, bias, weight_gradients, bias_gradients);
+    double best = 1e30;
+    for (int trial = 0; trial < 5; trial++) {
+        auto start = clock_type::now();
+        for (int i = 0; i < 200; i++) {
+            optimizer.update(weights, bias, weight_gradients, bias_gradients);
+        }
+        best = std::min(best, std::chrono::duration<double, std::micro>(clock_type::now() - start).count() / 200);
+    }
+    return best;
+}
+
+
+// Best-of-5 microseconds per training step (batch 32), one optimizer per layer or one for the network
+double step_us(const Candidate& candidate, bool shared, const Matrix<float>& inputs, const Matrix<float>& targets) {
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    auto optimizer1 = candidate.make(), optimizer2 = candidate.make(), optimizer3 = candidate.make();
+    if (shared) {
+        network.set_optimizer(optimizer1.get());
+    } else {
+        layer1.set_optimizer(optimizer1.get());
+        layer2.set_optimizer(optimizer2.get());
+        layer3.set_optimizer(optimizer3.get());
+    }
+
+    network.train_step(inputs, targets);
+    double best = 1e30;
+    for (int trial = 0; trial < 5; trial++) {
+        auto start = clock_type::now();
+        for (int i = 0; i < 100; i++) {
+            network.train_step(inputs, targets);
+        }
+        best = std::min(best, std::chrono::duration<double, std::micro>(clock_type::now() - start).count() / 100);
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : "./data/";
+    const bool have_mnist = std::filesystem::exists(dir + "train-images.idx3-ubyte");
+    const double target = argc > 2 ? std::stod(argv[2]) : (have_mnist ? 95.0 : 90.0);
+
+    nn::Dataset<float> train = have_mnist
+        ? mnist::load_dataset(dir + "train-images.idx3-ubyte", dir + "train-labels.idx1-ubyte", 10000)
+        : synthetic(10000, 2);
+    nn::Dataset<float> test = have_mnist
+        ? mnist::load_dataset(dir + "t10k-images.idx3-ubyte", dir + "t10k-labels.idx1-ubyte")
+        : synthetic(10000, 3);
+    std::cout << (have_mnist ? "MNIST" : "synthetic data (MNIST not found)") << ": "
+        << train.size() << " training, " << test.size() << " test samples, target "
+        << target << "% test accuracy" << std::endl;
+
+    const std::vector<Candidate> candidates = {
+        {"sgd 0.01", [] { return std::make_unique<nn::SGD<float>>(0.01f); }},
+        {"sgd+m 0.01", [] { return std::make_unique<nn::SGD<float>>(0.01f, 0.9f); }},
+        {"adam 1e-3", [] { return std::make_unique<nn::Adam<float>>(0.001f); }},
+        {"adamw 1e-3", [] { return std::make_unique<nn::AdamW<float>>(0.001f, 0.01f); }},
+        {"rmsprop 1e-3", [] { return std::make_unique<nn::RMSProp<float>>(0.001f); }},
+    };
+
+    std::cout << std::setw(14) << "optimizer" << std::setw(10) << "epochs" << std::setw(12) << "seconds"
+        << std::setw(12) << "accuracy" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& candidate : candidates) {
+        converge(candidate, train, test, target);
+    }
+
+    std::cout << "update of a 784 x 128 layer (" << nn::simd::isa_name(nn::simd::active_isa()) << ")" << std::endl;
+    std::cout << std::setw(14) << "optimizer" << std::setw(10) << "us" << std::endl;
+    for (const auto& candidate : candidates) {
+        auto optimizer = candidate.make();
+        std::cout << std::setw(14) << candidate.name << std::setw(10) << update_us(*optimizer) << std::endl;
+    }
+
+    Matrix<float> inputs(0, 0), targets(0, 0);
+    train.gather(size_t{0}, size_t{32}, inputs, targets);
+    std::cout << "training step, batch 32: one optimizer per layer against one for the network (parameter arena)" << std::endl;
+    std::cout << std::setw(14) << "optimizer" << std::setw(12) << "per layer" << std::setw(12) << "network" << std::endl;
+    for (const auto& candidate : candidates) {
+        std::cout << std::setw(14) << candidate.name << std::setw(12) << step_us(candidate, false, inputs, targets)
+            << std::setw(12) << step_us(candidate, true, inputs, targets) << std::endl;
+    }
+    return 0;
+}
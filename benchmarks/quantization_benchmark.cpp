@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "nn/activation.hpp"
+#include "nn/batch_loader.hpp"
+#include "nn/layer.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/quantization.hpp"
+#include "mnist_utils.cpp"
+
+/*
+ * Post-training int8 quantization of the mnist topology (784-128-64-10): test accuracy of the
+ * float network against the quantized one (calibrated on 512 training samples), inference
+ * throughput at batch 1 and 64, and the size of the inference parameters.
+ *
+ * Usage: quantization_benchmark [data_dir]
+ * The network is trained for 3 epochs on 10000 training samples of data_dir (default ./data/)
+ * and evaluated on t10k. Without the MNIST files, a synthetic 10-class problem of the same
+ * shape is used instead, so the accuracies are only meaningful relative to each other.
+ */
+
+namespace {
+
+// 10 noisy class prototypes in [0, 1]^784
+nn::Dataset<float> synthetic(size_t samples, unsigned seed) {
+    std::mt19937 prototype_gen(1);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    std::vector<float> prototypes(10 * 784);
+    for (auto& p : prototypes) p = pixel(prototype_gen) < 0.2f ? 1.0f : 0.0f;
+
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.0f, 0.35f);
+    nn::Dataset<float> data(samples, 784, 10);
+    for (size_t i = 0; i < samples; i++) {
+        const size_t label = gen() % 10;
+        for (size_t k = 0; k < 784; k++) {
+            data.sample(i)[k] = std::min(1.0f, std::max(0.0f, prototypes[label * 784 + k] + noise(gen)));
+        }
+        data.set_label(i, static_cast<uint32_t>(label));
+    }
+    return data;
+}
+
+size_t argmax(const Matrix<float>& m, size_t column) {
+    size_t best = 0;
+    for (size_t i = 1; i < m.rows(); i++) {
+        if (m.at(i, column) > m.at(best, column)) best = i;
+    }
+    return best;
+}
+
+// Best-of-5 samples per second of predict over batches of the given size
+template<typename Model>
+double throughput(Model& model, const nn::Dataset<float>& data, size_t batch_size) {
+    using clock = std::chrono::steady_clock;
+    Matrix<float> inputs(0, 0);
+    Matrix<float> targets(0, 0);
+    const size_t batches = std::max<size_t>(1, 4096 / batch_size);
+    double best = 0.0;
+    float sink = 0.0f;
+    for (int trial = 0; trial < 5; trial++) {
+        auto start = clock::now();
+        for (size_t b = 0; b < batches; b++) {
+            data.gather((b * batch_size) % (data.size() - batch_size), batch_size, inputs, targets);
+            sink += model.predict(inputs).at(0, 0);
+        }
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        best = std::max(best, batches * batch_size / seconds);
+    }
+    return sink == -1.0f ? 0.0 : best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : "./data/";
+    const bool have_mnist = std::filesystem::exists(dir + "train-images.idx3-ubyte");
+
+    nn::Dataset<float> train = have_mnist
+        ? mnist::load_dataset(dir + "train-images.idx3-ubyte", dir + "train-labels.idx1-ubyte", 10000)
+        : synthetic(10000, 2);
+    nn::Dataset<float> test = have_mnist
+        ? mnist::load_dataset(dir + "t10k-images.idx3-ubyte", dir + "t10k-labels.idx1-ubyte")
+        : synthetic(10000, 3);
+    std::cout << (have_mnist ? "MNIST" : "synthetic data (MNIST not found)") << ": "
+        << train.size() << " training, " << test.size() << " test samples" << std::endl;
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    nn::SGD<float> optimizer1(0.05f, 0.9f), optimizer2(0.05f, 0.9f), optimizer3(0.05f, 0.9f);
+    layer1.set_optimizer(&optimizer1);
+    layer2.set_optimizer(&optimizer2);
+    layer3.set_optimizer(&optimizer3);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::BatchLoader<float> loader(train, 32, true, 7);
+    network.train(loader, 3);
+
+    std::vector<size_t> calibration_indices(512);
+    for (size_t i = 0; i < calibration_indices.size(); i++) {
+        calibration_indices[i] = (i * 7919) % train.size();
+    }
+    Matrix<float> calibration(0, 0);
+    Matrix<float> unused(0, 0);
+    train.gather(calibration_indices.data(), calibration_indices.size(), calibration, unused);
+    nn::QuantizedNetwork quantized(network, calibration);
+
+    Matrix<float> inputs(0, 0);
+    Matrix<float> targets(0, 0);
+    size_t float_correct = 0;
+    size_t int8_correct = 0;
+    size_t agree = 0;
+    for (size_t first = 0; first < test.size(); first += 256) {
+        const size_t count = std::min<size_t>(256, test.size() - first);
+        test.gather(first, count, inputs, targets);
+        const Matrix<float>& float_output = network.predict(inputs);
+        const Matrix<float>& int8_output = quantized.predict(inputs);
+        for (size_t j = 0; j < count; j++) {
+            const size_t label = argmax(targets, j);
+            const size_t float_class = argmax(float_output, j);
+            const size_t int8_class = argmax(int8_output, j);
+            float_correct += float_class == label;
+            int8_correct += int8_class == label;
+            agree += float_class == int8_class;
+        }
+    }
+
+    size_t float_bytes = 0;
+    for (const auto* layer : network.layers()) {
+        float_bytes += (layer->weights().rows() * layer->weights().columns() + layer->bias().rows()) * sizeof(float);
+    }
+
+    const double n = static_cast<double>(test.size());
+    std::cout << std::fixed << std::setprecision(2)
+        << "accuracy: float " << 100.0 * float_correct / n << "%, int8 " << 100.0 * int8_correct / n
+        << "% (delta " << 100.0 * (static_cast<double>(int8_correct) - float_correct) / n << " points), "
+        << "same class on " << 100.0 * agree / n << "% of samples" << std::endl
+        << "parameters: float " << float_bytes / 1024.0 << " KiB, int8 " << quantized.memory_bytes() / 1024.0
+        << " KiB (" << static_cast<double>(float_bytes) / quantized.memory_bytes() << "x smaller)" << std::endl
+        << "kernel: " << nn::simd::isa_name(nn::simd::active_isa())
+        << (nn::simd::active_isa() == nn::simd::Isa::AVX512 && !nn::simd::has_avx512bw() ? " (int8 on avx2)" : "") << std::endl;
+
+    std::cout << std::setw(8) << "batch" << std::setw(18) << "float samples/s" << std::setw(18) << "int8 samples/s" << std::endl;
+    for (size_t batch : {1, 64}) {
+        const double f = throughput(network, test, batch);
+        const double q = throughput(quantized, test, batch);
+        std::cout << std::setw(8) << batch << std::setprecision(0) << std::setw(18) << f << std::setw(18) << q
+            << std::setprecision(2) << "  (" << q / f << "x)" << std::endl;
+    }
+    return 0;
+}
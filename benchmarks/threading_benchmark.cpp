@@ -0,0 +1,90 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+#include "nn/thread_pool.hpp"
+
+/*
+ * Training throughput of the mnist topology (784-128-64-10) for 1..N threads of the library pool.
+ * Synthetic data, so no dataset download is needed.
+ *
+ * Usage: threading_benchmark [max_threads] [batch_size]
+ */
+
+namespace {
+
+double samples_per_second(size_t threads, size_t batch_size,
+        const std::vector<Matrix<float>>& inputs, const std::vector<Matrix<float>>& targets) {
+    nn::set_num_threads(threads);
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1(784, 128);
+    nn::Layer<float, nn::activations::ReLU> layer2(128, 64);
+    nn::Layer<float, nn::activations::Sigmoid> layer3(64, 10);
+    nn::SGD<float> optimizer1(0.1f, 0.9f);
+    nn::SGD<float> optimizer2(0.1f, 0.9f);
+    nn::SGD<float> optimizer3(0.1f, 0.9f);
+    layer1.set_optimizer(&optimizer1);
+    layer2.set_optimizer(&optimizer2);
+    layer3.set_optimizer(&optimizer3);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    // warm-up epoch (thread start-up, packing buffers)
+    network.train(inputs, targets, 1, batch_size);
+
+    const size_t epochs = 3;
+    auto start = std::chrono::steady_clock::now();
+    network.train(inputs, targets, epochs, batch_size);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return epochs * inputs.size() / elapsed;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t batch_size = 64;
+    if (argc > 1) max_threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2) batch_size = std::strtoul(argv[2], nullptr, 10);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    std::uniform_int_distribution<int> label(0, 9);
+
+    const size_t num_samples = 4096;
+    std::vector<Matrix<float>> inputs;
+    std::vector<Matrix<float>> targets;
+    for (size_t i = 0; i < num_samples; i++) {
+        std::vector<float> image(784);
+        for (auto& p : image) p = pixel(gen);
+        std::vector<float> one_hot(10, 0.0f);
+        one_hot[label(gen)] = 1.0f;
+        inputs.emplace_back(784, 1, image);
+        targets.emplace_back(10, 1, one_hot);
+    }
+
+    std::cout << "784-128-64-10, batch size " << batch_size << ", "
+        << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "samples/s" << std::setw(10) << "speedup" << std::endl;
+
+    double baseline = 0.0;
+    for (size_t threads = 1; threads <= max_threads; threads = threads < 4 ? threads + 1 : threads * 2) {
+        double throughput = samples_per_second(threads, batch_size, inputs, targets);
+        if (threads == 1) baseline = throughput;
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(0)
+            << std::setw(16) << throughput << std::setprecision(2)
+            << std::setw(9) << throughput / baseline << "x" << std::endl;
+    }
+    return 0;
+}
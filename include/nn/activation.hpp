@@ -24,6 +24,20 @@
   * Derivative: f'(x) = 1 if x > 0, α otherwise
   * Use cases: Alternative to ReLU to prevent "dying ReLU" problem
   * Properties: Never completely "dies" (always has a small gradient)
+  *
+  * Identity
+  * Function: f(x) = x
+  * Derivative: f'(x) = 1
+  * Use cases: Output layer producing logits for a loss that applies its own output function
+  *            (SoftmaxCrossEntropy, see loss.hpp) or for regression
+  *
+  * Every activation has a per-value forward/backward and a batched overload over n contiguous
+  * values, forward(x, y, n) / backward(x, y, n), which runs the vectorized kernels of
+  * activation_kernels.hpp (x and y may be the same buffer). backward(x, gradient, y, n) computes
+  * gradient * f'(x) in the same pass.
+  *
+  * Each class names its kernels::ActivationKind, which is how checkpoints record the activation
+  * of a layer; forward_function(kind) gives the batched forward pass back for a stored kind.
  */
 
 #ifndef ACTIVATIONS_H
@@ -31,12 +45,17 @@
 
 #include <algorithm>
 #include <cmath>
+#include <stdexcept>
+#include <string>
+#include "activation_kernels.hpp"
 
 namespace nn {
  namespace activations {
   template<typename T>
   class ReLU {
    public:
+    static constexpr kernels::ActivationKind kind = kernels::ActivationKind::RELU;
+
     static T forward(const T x) {
      return std::max(static_cast<T>(0), x);
     }
@@ -44,11 +63,29 @@ namespace nn {
     static T backward(const T x) {
      return x > static_cast<T>(0) ? static_cast<T>(1) : static_cast<T>(0);
     }
+
+    static void forward(const T* x, T* y, size_t n) {
+     kernels::apply_activation<kernels::ActivationKind::RELU, false>(x, y, n, static_cast<T>(0),
+       [](T v) { return forward(v); });
+    }
+
+    static void backward(const T* x, T* y, size_t n) {
+     kernels::apply_activation<kernels::ActivationKind::RELU, true>(x, y, n, static_cast<T>(0),
+       [](T v) { return backward(v); });
+    }
+
+    // y = gradient * f'(x), the fused form used by the backward pass of a layer
+    static void backward(const T* x, const T* gradient, T* y, size_t n) {
+     kernels::apply_activation_gradient<kernels::ActivationKind::RELU>(x, gradient, y, n, static_cast<T>(0),
+       [](T v) { return backward(v); });
+    }
   };
 
   template<typename T>
   class Sigmoid {
    public:
+    static constexpr kernels::ActivationKind kind = kernels::ActivationKind::SIGMOID;
+
     static T forward(const T x) {
      // handle extreme values to prevent overflow/underflow
      // 100.0 is arbitrary
@@ -62,11 +99,29 @@ namespace nn {
      T fx = forward(x);
      return fx * (static_cast<T>(1) - fx);
     }
+
+    static void forward(const T* x, T* y, size_t n) {
+     kernels::apply_activation<kernels::ActivationKind::SIGMOID, false>(x, y, n, static_cast<T>(0),
+       [](T v) { return forward(v); });
+    }
+
+    static void backward(const T* x, T* y, size_t n) {
+     kernels::apply_activation<kernels::ActivationKind::SIGMOID, true>(x, y, n, static_cast<T>(0),
+       [](T v) { return backward(v); });
+    }
+
+    // y = gradient * f'(x), the fused form used by the backward pass of a layer
+    static void backward(const T* x, const T* gradient, T* y, size_t n) {
+     kernels::apply_activation_gradient<kernels::ActivationKind::SIGMOID>(x, gradient, y, n, static_cast<T>(0),
+       [](T v) { return backward(v); });
+    }
   };
   
   template<typename T>
   class Tanh {
    public:
+    static constexpr kernels::ActivationKind kind = kernels::ActivationKind::TANH;
+
     static T forward(const T x) {
      // handle extreme values to prevent overflow/underflow
      // 100.0 is arbitrary
@@ -82,13 +137,32 @@ namespace nn {
      if (x >= static_cast<T>(100.0)) return static_cast<T>(0);
      if (x <= static_cast<T>(-100.0)) return static_cast<T>(0);
 
-     return static_cast<T>(1) - std::pow(std::tanh(x), static_cast<T>(2));
+     const T t = std::tanh(x);
+     return static_cast<T>(1) - t * t;
+    }
+
+    static void forward(const T* x, T* y, size_t n) {
+     kernels::apply_activation<kernels::ActivationKind::TANH, false>(x, y, n, static_cast<T>(0),
+       [](T v) { return forward(v); });
+    }
+
+    static void backward(const T* x, T* y, size_t n) {
+     kernels::apply_activation<kernels::ActivationKind::TANH, true>(x, y, n, static_cast<T>(0),
+       [](T v) { return backward(v); });
+    }
+
+    // y = gradient * f'(x), the fused form used by the backward pass of a layer
+    static void backward(const T* x, const T* gradient, T* y, size_t n) {
+     kernels::apply_activation_gradient<kernels::ActivationKind::TANH>(x, gradient, y, n, static_cast<T>(0),
+       [](T v) { return backward(v); });
     }
   };
 
   template<typename T>
   class LeakyReLU {
    public:
+    static constexpr kernels::ActivationKind kind = kernels::ActivationKind::LEAKY_RELU;
+
     static T forward(const T x, const T alpha = static_cast<T>(0.01)) {
      if (x > static_cast<T>(0)) {
       return x;
@@ -99,7 +173,72 @@ namespace nn {
     static T backward(const T x, const T alpha = static_cast<T>(0.01)) {
      return x > static_cast<T>(0) ? static_cast<T>(1) : alpha;
     }
+
+    static void forward(const T* x, T* y, size_t n, const T alpha = static_cast<T>(0.01)) {
+     kernels::apply_activation<kernels::ActivationKind::LEAKY_RELU, false>(x, y, n, alpha,
+       [alpha](T v) { return forward(v, alpha); });
+    }
+
+    static void backward(const T* x, T* y, size_t n, const T alpha = static_cast<T>(0.01)) {
+     kernels::apply_activation<kernels::ActivationKind::LEAKY_RELU, true>(x, y, n, alpha,
+       [alpha](T v) { return backward(v, alpha); });
+    }
+
+    // y = gradient * f'(x), the fused form used by the backward pass of a layer
+    static void backward(const T* x, const T* gradient, T* y, size_t n, const T alpha = static_cast<T>(0.01)) {
+     kernels::apply_activation_gradient<kernels::ActivationKind::LEAKY_RELU>(x, gradient, y, n, alpha,
+       [alpha](T v) { return backward(v, alpha); });
+    }
   };
+
+  template<typename T>
+  class Identity {
+   public:
+    static constexpr kernels::ActivationKind kind = kernels::ActivationKind::IDENTITY;
+
+    static T forward(const T x) {
+     return x;
+    }
+
+    static T backward(const T) {
+     return static_cast<T>(1);
+    }
+
+    static void forward(const T* x, T* y, size_t n) {
+     if (x != y) {
+      std::copy(x, x + n, y);
+     }
+    }
+
+    static void backward(const T*, T* y, size_t n) {
+     std::fill(y, y + n, static_cast<T>(1));
+    }
+
+    // y = gradient * f'(x) = gradient
+    static void backward(const T*, const T* gradient, T* y, size_t n) {
+     if (gradient != y) {
+      std::copy(gradient, gradient + n, y);
+     }
+    }
+  };
+
+  // Batched forward pass of the activation of the given kind (LeakyReLU with its default slope)
+  template<typename T>
+  void (*forward_function(kernels::ActivationKind kind))(const T*, T*, size_t) {
+   switch (kind) {
+    case kernels::ActivationKind::RELU:
+     return [](const T* x, T* y, size_t n) { ReLU<T>::forward(x, y, n); };
+    case kernels::ActivationKind::LEAKY_RELU:
+     return [](const T* x, T* y, size_t n) { LeakyReLU<T>::forward(x, y, n); };
+    case kernels::ActivationKind::SIGMOID:
+     return [](const T* x, T* y, size_t n) { Sigmoid<T>::forward(x, y, n); };
+    case kernels::ActivationKind::TANH:
+     return [](const T* x, T* y, size_t n) { Tanh<T>::forward(x, y, n); };
+    case kernels::ActivationKind::IDENTITY:
+     return [](const T* x, T* y, size_t n) { Identity<T>::forward(x, y, n); };
+   }
+   throw std::invalid_argument(std::string(__func__) + ": unknown activation");
+  }
  }
 }
 
@@ -0,0 +1,57 @@
+ /*
+  * Aligned allocator
+  *
+  * std::allocator only guarantees the alignment of the element type. This one starts every
+  * allocation on an Alignment byte boundary (a cache line and an AVX-512 vector by default), so
+  * that the first element of a std::vector<T, AlignedAllocator<T>> can be read with aligned
+  * vector loads and never shares a cache line with another allocation.
+ */
+
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+namespace nn {
+
+ template<typename T, size_t Alignment = 64>
+ class AlignedAllocator {
+  static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+    "the alignment must be a power of two, at least that of the element type");
+
+  public:
+   using value_type = T;
+   static constexpr size_t alignment = Alignment;
+
+   template<typename U>
+   struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+   };
+
+   AlignedAllocator() noexcept = default;
+
+   template<typename U>
+   AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+   T* allocate(size_t n) {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+     throw std::bad_array_new_length();
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+   }
+
+   void deallocate(T* p, size_t) noexcept {
+    ::operator delete(p, std::align_val_t(Alignment));
+   }
+ };
+
+ template<typename T, typename U, size_t Alignment>
+ bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return true; }
+
+ template<typename T, typename U, size_t Alignment>
+ bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return false; }
+}
+
+#endif
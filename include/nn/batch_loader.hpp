@@ -0,0 +1,219 @@
+ /*
+  * Batch loader
+  *
+  * Prepares the mini-batches of training on a background thread, so gathering (and any shuffling
+  * or decoding done by the source) overlaps with the training step of the previous batch.
+  *
+  * Batches go through a bounded ring of depth() reusable slots: the loader thread fills a free slot
+  * while the training thread works on a filled one, and blocks when all slots are waiting to be
+  * trained on. A slot's matrices keep their storage between uses, so once every slot has seen a
+  * full batch no memory is allocated.
+  *
+  * The loader runs through the epochs in order and never stops at an epoch boundary: the first
+  * batches of the next epoch are prepared while the last ones of the current epoch train. With
+  * shuffling enabled, the sample order of epoch e is a permutation drawn from a std::mt19937_64
+  * seeded with seed + e, so a run is reproducible for a given seed (and standard library), and
+  * epoch e can be replayed without replaying the ones before it.
+  *
+  * The source fills one batch from a list of sample indices. The Dataset constructor uses
+  * Dataset::gather(): a class index data set fills only the labels of the batch, which the losses
+  * take in place of one-hot targets, and a dense one only the targets. Other sources (e.g. decoding straight from a mapped file) can be given as a function, with an
+  * optional label source. Sources run on the loader thread, exceptions they throw are rethrown by
+  * next().
+ */
+
+#ifndef BATCH_LOADER_H
+#define BATCH_LOADER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dataset.hpp"
+#include "matrix.hpp"
+
+namespace nn {
+
+ // One mini-batch: the samples side by side, one per column
+ template<typename T>
+ struct Batch {
+  Matrix<T> inputs = Matrix<T>(0, 0);
+  Matrix<T> targets = Matrix<T>(0, 0);  // left empty by a class index data set
+  std::vector<uint32_t> labels;  // class of each sample when the source has class indices, else empty
+  size_t epoch = 0;
+  size_t first = 0;  // position of the first sample within the epoch
+  size_t count = 0;
+ };
+
+ template<typename T>
+ class BatchLoader {
+  public:
+   // Fill inputs (features x count) and targets (targets x count) with the samples indices[0..count)
+   using Source = std::function<void(const size_t* indices, size_t count, Matrix<T>& inputs, Matrix<T>& targets)>;
+   // Fill labels with the classes of the samples indices[0..count)
+   using LabelSource = std::function<void(const size_t* indices, size_t count, std::vector<uint32_t>& labels)>;
+
+   BatchLoader(size_t num_samples, size_t batch_size, Source source,
+     bool shuffle = false, uint64_t seed = 0, size_t depth = 2)
+    : BatchLoader(num_samples, batch_size, std::move(source), LabelSource(), shuffle, seed, depth) {}
+
+   // Batches of the given data set, with labels or targets as it has them; the data set must outlive the loader
+   BatchLoader(const Dataset<T>& data, size_t batch_size,
+     bool shuffle = false, uint64_t seed = 0, size_t depth = 2)
+    : BatchLoader(data.size(), batch_size,
+      data.kind() == Targets::CLASS_INDICES
+       ? Fill([&data](const size_t* indices, size_t count, Batch<T>& batch) {
+        data.gather(indices, count, batch.inputs, batch.labels);
+       })
+       : Fill([&data](const size_t* indices, size_t count, Batch<T>& batch) {
+        data.gather(indices, count, batch.inputs, batch.targets);
+       }),
+      shuffle, seed, depth) {}
+
+   BatchLoader(size_t num_samples, size_t batch_size, Source source, LabelSource labels,
+     bool shuffle, uint64_t seed, size_t depth)
+    : BatchLoader(num_samples, batch_size, fill(std::move(source), std::move(labels)), shuffle, seed, depth) {}
+
+   ~BatchLoader() {
+    {
+     std::lock_guard<std::mutex> lock(mutex_);
+     stop_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) {
+     thread_.join();
+    }
+   }
+
+   BatchLoader(const BatchLoader&) = delete;
+   BatchLoader& operator=(const BatchLoader&) = delete;
+
+   size_t size() const { return num_samples_; }
+   size_t batch_size() const { return batch_size_; }
+   size_t depth() const { return slots_.size(); }
+   size_t batches_per_epoch() const { return (num_samples_ + batch_size_ - 1) / batch_size_; }
+
+   /*
+    * The next batch in order, waiting for the loader thread if it is not ready yet. The batch stays
+    * valid until the following call to next(), which hands its slot back to the loader.
+    */
+   const Batch<T>& next() {
+    if (num_samples_ == 0) {
+     throw std::logic_error(std::string(__func__) + ": the data set is empty");
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (holding_) {
+     consumed_++;
+     holding_ = false;
+     changed_.notify_all();
+    }
+    changed_.wait(lock, [this] { return produced_ > consumed_ || error_; });
+    if (produced_ == consumed_ && error_) {
+     std::rethrow_exception(error_);
+    }
+    holding_ = true;
+    return slots_[consumed_ % slots_.size()];
+   }
+
+  private:
+   // Fill the batch with the samples indices[0..count)
+   using Fill = std::function<void(const size_t* indices, size_t count, Batch<T>& batch)>;
+
+   size_t num_samples_;
+   size_t batch_size_;
+   Fill fill_;
+   bool shuffle_;
+   uint64_t seed_;
+
+   std::vector<Batch<T>> slots_;
+   std::vector<size_t> order_;  // sample order of the epoch being loaded, loader thread only
+
+   std::thread thread_;
+   std::mutex mutex_;
+   std::condition_variable changed_;
+   size_t produced_ = 0;  // batches filled so far, slot produced_ % depth is filled next
+   size_t consumed_ = 0;  // batches handed back by the training thread
+   bool holding_ = false;  // the training thread is using slot consumed_ % depth
+   bool stop_ = false;
+   std::exception_ptr error_;
+
+   BatchLoader(size_t num_samples, size_t batch_size, Fill fill, bool shuffle, uint64_t seed, size_t depth)
+    : num_samples_(num_samples), batch_size_(batch_size), fill_(std::move(fill)),
+      shuffle_(shuffle), seed_(seed), slots_(depth), order_(num_samples) {
+    if (batch_size == 0) {
+     throw std::invalid_argument(std::string(__func__) + ": batch size must be positive");
+    }
+    if (depth == 0) {
+     throw std::invalid_argument(std::string(__func__) + ": at least one batch buffer is needed");
+    }
+    if (num_samples_ > 0) {
+     thread_ = std::thread([this] { produce(); });
+    }
+   }
+
+   static Fill fill(Source source, LabelSource labels) {
+    if (!source) {
+     throw std::invalid_argument("BatchLoader: no batch source");
+    }
+    return [source = std::move(source), labels = std::move(labels)](const size_t* indices, size_t count, Batch<T>& batch) {
+     source(indices, count, batch.inputs, batch.targets);
+     if (labels) {
+      labels(indices, count, batch.labels);
+     }
+    };
+   }
+
+   void produce() {
+    const size_t per_epoch = batches_per_epoch();
+    try {
+     for (size_t epoch = 0;; epoch++) {
+      std::iota(order_.begin(), order_.end(), size_t(0));
+      if (shuffle_) {
+       std::mt19937_64 engine(seed_ + epoch);
+       std::shuffle(order_.begin(), order_.end(), engine);
+      }
+
+      for (size_t b = 0; b < per_epoch; b++) {
+       size_t slot;
+       {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return stop_ || produced_ - consumed_ < slots_.size(); });
+        if (stop_) {
+         return;
+        }
+        slot = produced_ % slots_.size();
+       }
+
+       // The slot is free: the training thread is done with it and won't look at it until published
+       Batch<T>& batch = slots_[slot];
+       batch.epoch = epoch;
+       batch.first = b * batch_size_;
+       batch.count = std::min(batch_size_, num_samples_ - batch.first);
+       fill_(order_.data() + batch.first, batch.count, batch);
+
+       {
+        std::lock_guard<std::mutex> lock(mutex_);
+        produced_++;
+       }
+       changed_.notify_all();
+      }
+     }
+    } catch (...) {
+     std::lock_guard<std::mutex> lock(mutex_);
+     error_ = std::current_exception();
+     changed_.notify_all();
+    }
+   }
+ };
+}
+
+#endif
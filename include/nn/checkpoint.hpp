@@ -0,0 +1,458 @@
+ /*
+  * Checkpoints
+  *
+  * A versioned binary file holding a Network<T>: the topology and activation of every layer, its
+  * weights and bias, and the settings and state of its optimizer (e.g. the SGD velocities).
+  *
+  * Layout (native byte order, checked on load):
+  *   - Header
+  *   - one LayerRecord per layer
+  *   - one ArrayRecord per stored matrix: for each layer the weights, the bias and, when the layer
+  *     has an optimizer, its settings (1 x n) followed by its state buffers; then, when the
+  *     network has an optimizer of its own (Network::set_optimizer), its settings and state
+  *   - the matrices, row-major, each starting at a multiple of kAlignment bytes
+  *
+  * Version 2 added the network optimizer to the header; version 1 files are still read.
+  *
+  * Since a mapping starts on a page boundary, every matrix of a mapped checkpoint is cache line
+  * (and AVX-512 vector) aligned, so MappedModel runs inference straight on the mapped weights:
+  * opening a model costs a mapping and a header check, the weights are paged in on first use.
+  *
+  * save_checkpoint() writes to a temporary file and renames it over the target, so a process
+  * mapping the previous checkpoint is never handed a half-written file.
+  * load_checkpoint() restores a checkpoint into a network built with the same layers.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "activation.hpp"
+#include "mapped_file.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+
+namespace nn {
+
+ namespace checkpoint {
+  constexpr char kMagic[8] = {'N', 'N', 'C', 'K', 'P', 'T', '\r', '\n'};
+  constexpr uint32_t kVersion = 2;
+  constexpr uint64_t kVersion1HeaderSize = 40;
+  constexpr uint32_t kByteOrder = 0x01020304;
+  constexpr uint64_t kAlignment = 64;
+
+  struct Header {
+   char magic[8];
+   uint32_t version;
+   uint32_t byte_order;   // kByteOrder as written by the saving machine
+   uint32_t scalar_size;  // sizeof(T)
+   uint32_t num_layers;
+   uint64_t num_arrays;
+   uint64_t file_size;
+   // version 2
+   char optimizer[16];              // network optimizer's name(), empty without one
+   uint64_t optimizer_first_array;  // index of its settings in the array table
+   uint32_t optimizer_num_arrays;   // settings + state buffers
+   uint32_t reserved;
+  };
+
+  struct LayerRecord {
+   uint64_t input_size;
+   uint64_t output_size;
+   uint32_t activation;   // kernels::ActivationKind
+   uint32_t num_arrays;   // 2 without optimizer, 3 + state buffers with one
+   uint64_t first_array;  // index of the weights in the array table
+   char optimizer[16];    // Optimizer::name(), empty without optimizer
+  };
+
+  struct ArrayRecord {
+   uint64_t offset;  // from the start of the file
+   uint64_t rows;
+   uint64_t columns;
+  };
+
+  static_assert(sizeof(Header) == 72 && sizeof(LayerRecord) == 48 && sizeof(ArrayRecord) == 24,
+    "checkpoint records must not depend on the compiler's padding");
+
+  inline uint64_t align(uint64_t offset) {
+   return (offset + kAlignment - 1) / kAlignment * kAlignment;
+  }
+ }
+
+ /*
+  * Read-only view of a checkpoint file. The whole file is validated on construction: header,
+  * record bounds, array sizes against the layer sizes, and consecutive layer sizes.
+ */
+ template<typename T>
+ class Checkpoint {
+  public:
+   explicit Checkpoint(const std::string& filename) : file_(filename) {
+    const uint8_t* bytes = file_.data();
+    if (file_.size() < checkpoint::kVersion1HeaderSize) {
+     throw std::runtime_error("invalid checkpoint: " + filename);
+    }
+    header_ = checkpoint::Header{};
+    std::memcpy(&header_, bytes, checkpoint::kVersion1HeaderSize);
+    if (std::memcmp(header_.magic, checkpoint::kMagic, sizeof(checkpoint::kMagic)) != 0) {
+     throw std::runtime_error("invalid checkpoint: " + filename);
+    }
+    if (header_.version != 1 && header_.version != checkpoint::kVersion) {
+     throw std::runtime_error("unsupported checkpoint version in: " + filename);
+    }
+    const uint64_t header_size = header_.version == 1 ? checkpoint::kVersion1HeaderSize : sizeof(checkpoint::Header);
+    if (file_.size() < header_size) {
+     throw std::runtime_error("invalid checkpoint: " + filename);
+    }
+    std::memcpy(&header_, bytes, header_size);
+    if (header_.byte_order != checkpoint::kByteOrder || header_.scalar_size != sizeof(T)) {
+     throw std::runtime_error("checkpoint was saved with another byte order or scalar type: " + filename);
+    }
+    if (header_.file_size != file_.size()) {
+     throw std::runtime_error("truncated checkpoint: " + filename);
+    }
+
+    const uint64_t tables = header_size + header_.num_layers * sizeof(checkpoint::LayerRecord);
+    if (header_.num_arrays > file_.size() || tables + header_.num_arrays * sizeof(checkpoint::ArrayRecord) > file_.size()) {
+     throw std::runtime_error("truncated checkpoint: " + filename);
+    }
+    layers_.resize(header_.num_layers);
+    std::memcpy(layers_.data(), bytes + header_size, layers_.size() * sizeof(checkpoint::LayerRecord));
+    arrays_.resize(header_.num_arrays);
+    std::memcpy(arrays_.data(), bytes + tables, arrays_.size() * sizeof(checkpoint::ArrayRecord));
+
+    for (const checkpoint::ArrayRecord& array : arrays_) {
+     const uint64_t bytes_needed = array.rows * array.columns * sizeof(T);
+     if (array.offset % checkpoint::kAlignment != 0 || array.offset > file_.size()
+       || (array.columns != 0 && array.rows > file_.size() / array.columns)
+       || bytes_needed > file_.size() - array.offset) {
+      throw std::runtime_error("corrupted checkpoint array table: " + filename);
+     }
+    }
+
+    for (size_t i = 0; i < layers_.size(); i++) {
+     const checkpoint::LayerRecord& layer = layers_[i];
+     if (layer.activation > static_cast<uint32_t>(kernels::ActivationKind::IDENTITY)
+       || layer.num_arrays < 2 || layer.first_array > arrays_.size()
+       || layer.num_arrays > arrays_.size() - layer.first_array
+       || layer.optimizer[sizeof(layer.optimizer) - 1] != '\0') {
+      throw std::runtime_error("corrupted checkpoint layer table: " + filename);
+     }
+     const checkpoint::ArrayRecord& w = arrays_[layer.first_array];
+     const checkpoint::ArrayRecord& b = arrays_[layer.first_array + 1];
+     if (w.rows != layer.output_size || w.columns != layer.input_size || b.rows != layer.output_size || b.columns != 1) {
+      throw std::runtime_error("checkpoint parameters do not match the layer sizes: " + filename);
+     }
+     if (i > 0 && layers_[i - 1].output_size != layer.input_size) {
+      throw std::runtime_error("checkpoint layer sizes do not chain: " + filename);
+     }
+    }
+
+    if (header_.optimizer[sizeof(header_.optimizer) - 1] != '\0'
+      || (header_.optimizer[0] != '\0' && (header_.optimizer_num_arrays < 1
+      || header_.optimizer_first_array > arrays_.size()
+      || header_.optimizer_num_arrays > arrays_.size() - header_.optimizer_first_array))) {
+     throw std::runtime_error("corrupted checkpoint optimizer record: " + filename);
+    }
+   }
+
+   size_t num_layers() const { return layers_.size(); }
+   const checkpoint::LayerRecord& layer(size_t i) const { return layers_.at(i); }
+
+   // Matrix j of layer i (0: weights, 1: bias, then optimizer settings and state) and its storage
+   const checkpoint::ArrayRecord& array(size_t i, size_t j) const {
+    const checkpoint::LayerRecord& record = layer(i);
+    if (j >= record.num_arrays) {
+     throw std::out_of_range(std::string(__func__) + ": array index out of range");
+    }
+    return arrays_[record.first_array + j];
+   }
+   // Network optimizer, empty name without one; its matrix j (0: settings, then state)
+   const char* optimizer() const { return header_.optimizer; }
+   size_t optimizer_num_arrays() const { return header_.optimizer[0] != '\0' ? header_.optimizer_num_arrays : 0; }
+   const checkpoint::ArrayRecord& optimizer_array(size_t j) const {
+    if (j >= optimizer_num_arrays()) {
+     throw std::out_of_range(std::string(__func__) + ": array index out of range");
+    }
+    return arrays_[header_.optimizer_first_array + j];
+   }
+
+   const T* data(const checkpoint::ArrayRecord& array) const {
+    return reinterpret_cast<const T*>(file_.data() + array.offset);
+   }
+
+   Matrix<T> to_matrix(const checkpoint::ArrayRecord& array) const {
+    Matrix<T> m(array.rows, array.columns);
+    std::memcpy(m.data(), data(array), array.rows * array.columns * sizeof(T));
+    return m;
+   }
+
+  private:
+   MappedFile file_;
+   checkpoint::Header header_;
+   std::vector<checkpoint::LayerRecord> layers_;
+   std::vector<checkpoint::ArrayRecord> arrays_;
+ };
+
+ template<typename T>
+ void save_checkpoint(const Network<T>& network, const std::string& filename) {
+  static_assert(std::is_trivially_copyable<T>::value, "checkpoints store raw scalars");
+
+  struct Array {
+   const T* data;
+   uint64_t rows;
+   uint64_t columns;
+  };
+  std::vector<checkpoint::LayerRecord> layers;
+  std::vector<Array> arrays;
+  std::vector<std::vector<T>> settings(network.layers().size() + 1);  // the last for the network optimizer
+
+  // name into a record field, then settings and state into the array table
+  auto add_optimizer = [&](Optimizer<T>& optimizer, char (&name_field)[16], std::vector<T>& values) {
+   const std::string name = optimizer.name();
+   if (name.empty() || name.size() >= sizeof(name_field)) {
+    throw std::invalid_argument("save_checkpoint: optimizer name must have 1 to 15 characters");
+   }
+   std::memcpy(name_field, name.c_str(), name.size());
+   values = optimizer.settings();
+   arrays.push_back({values.data(), 1, values.size()});
+   for (const Matrix<T>* buffer : optimizer.state()) {
+    arrays.push_back({buffer->data(), buffer->rows(), buffer->columns()});
+   }
+  };
+
+  for (size_t i = 0; i < network.layers().size(); i++) {
+   const LayerBase<T>& layer = *network.layers()[i];
+   checkpoint::LayerRecord record{};
+   record.input_size = layer.input_size();
+   record.output_size = layer.output_size();
+   record.activation = static_cast<uint32_t>(layer.activation());
+   record.first_array = arrays.size();
+
+   arrays.push_back({layer.weights().data(), layer.weights().rows(), layer.weights().columns()});
+   arrays.push_back({layer.bias().data(), layer.bias().rows(), layer.bias().columns()});
+   if (Optimizer<T>* optimizer = layer.optimizer()) {
+    add_optimizer(*optimizer, record.optimizer, settings[i]);
+   }
+   record.num_arrays = static_cast<uint32_t>(arrays.size() - record.first_array);
+   layers.push_back(record);
+  }
+
+  checkpoint::Header header{};
+  if (Optimizer<T>* optimizer = network.optimizer()) {
+   header.optimizer_first_array = arrays.size();
+   add_optimizer(*optimizer, header.optimizer, settings.back());
+   header.optimizer_num_arrays = static_cast<uint32_t>(arrays.size() - header.optimizer_first_array);
+  }
+
+  std::vector<checkpoint::ArrayRecord> table(arrays.size());
+  uint64_t offset = sizeof(checkpoint::Header) + layers.size() * sizeof(checkpoint::LayerRecord)
+   + table.size() * sizeof(checkpoint::ArrayRecord);
+  for (size_t k = 0; k < arrays.size(); k++) {
+   offset = checkpoint::align(offset);
+   table[k] = {offset, arrays[k].rows, arrays[k].columns};
+   offset += arrays[k].rows * arrays[k].columns * sizeof(T);
+  }
+
+  std::memcpy(header.magic, checkpoint::kMagic, sizeof(header.magic));
+  header.version = checkpoint::kVersion;
+  header.byte_order = checkpoint::kByteOrder;
+  header.scalar_size = sizeof(T);
+  header.num_layers = static_cast<uint32_t>(layers.size());
+  header.num_arrays = table.size();
+  header.file_size = offset;
+
+  const std::string temporary = filename + ".tmp";
+  {
+   std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+   if (!file.is_open()) {
+    throw std::runtime_error("cannot create file: " + temporary);
+   }
+   file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   file.write(reinterpret_cast<const char*>(layers.data()), layers.size() * sizeof(checkpoint::LayerRecord));
+   file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(checkpoint::ArrayRecord));
+
+   const char padding[checkpoint::kAlignment] = {};
+   uint64_t position = sizeof(header) + layers.size() * sizeof(checkpoint::LayerRecord)
+    + table.size() * sizeof(checkpoint::ArrayRecord);
+   for (size_t k = 0; k < arrays.size(); k++) {
+    file.write(padding, table[k].offset - position);
+    const uint64_t bytes = arrays[k].rows * arrays[k].columns * sizeof(T);
+    file.write(reinterpret_cast<const char*>(arrays[k].data), bytes);
+    position = table[k].offset + bytes;
+   }
+   if (!file) {
+    throw std::runtime_error("cannot write file: " + temporary);
+   }
+  }
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+   std::remove(temporary.c_str());
+   throw std::runtime_error("cannot replace file: " + filename);
+  }
+ }
+
+ /*
+  * Restore weights, biases and optimizer state into a network with the same layer sizes and
+  * activations. Layers without an optimizer only get their parameters; a layer whose optimizer
+  * differs from the stored one is an error, as is a stored state buffer count that differs.
+  * The same holds for the network optimizer.
+ */
+ template<typename T>
+ void load_checkpoint(Network<T>& network, const std::string& filename) {
+  const Checkpoint<T> checkpoint(filename);
+  const std::vector<LayerBase<T>*>& layers = network.layers();
+  if (checkpoint.num_layers() != layers.size()) {
+   throw std::runtime_error("checkpoint has " + std::to_string(checkpoint.num_layers())
+    + " layers, the network " + std::to_string(layers.size()) + ": " + filename);
+  }
+
+  /*
+   * Stored state buffers are empty (saved before the first update) or of the shape of their
+   * parameters: those of the weights first, then as many of the bias (see Optimizer::state)
+   */
+  auto state_matches = [&](size_t num_state, size_t weight_rows, size_t weight_columns, size_t bias_rows,
+    size_t bias_columns, auto state_array) {
+   for (size_t k = 0; k < num_state; k++) {
+    const checkpoint::ArrayRecord& array = state_array(k);
+    const bool of_weights = k < num_state / 2;
+    if ((array.rows != 0 || array.columns != 0)
+      && (array.rows != (of_weights ? weight_rows : bias_rows)
+      || array.columns != (of_weights ? weight_columns : bias_columns))) {
+     return false;
+    }
+   }
+   return true;
+  };
+
+  // check everything before the first layer is modified
+  for (size_t i = 0; i < layers.size(); i++) {
+   const checkpoint::LayerRecord& record = checkpoint.layer(i);
+   if (record.input_size != layers[i]->input_size() || record.output_size != layers[i]->output_size()
+     || record.activation != static_cast<uint32_t>(layers[i]->activation())) {
+    throw std::runtime_error("checkpoint layer " + std::to_string(i) + " does not match the network: " + filename);
+   }
+   Optimizer<T>* optimizer = layers[i]->optimizer();
+   if (optimizer && record.optimizer[0] != '\0') {
+    const size_t num_state = optimizer->state().size();
+    if (std::string(record.optimizer) != optimizer->name() || record.num_arrays != 3 + num_state
+      || !state_matches(num_state, record.output_size, record.input_size, record.output_size, 1,
+        [&](size_t k) -> const checkpoint::ArrayRecord& { return checkpoint.array(i, 3 + k); })) {
+     throw std::runtime_error("checkpoint optimizer of layer " + std::to_string(i) + " does not match: " + filename);
+    }
+   }
+  }
+  Optimizer<T>* network_optimizer = network.optimizer();
+  const bool restore_network_optimizer = network_optimizer && checkpoint.optimizer()[0] != '\0';
+  if (restore_network_optimizer) {
+   // the network optimizer sweeps the weight and bias regions of the arena as single rows
+   const ParameterArena<T>* arena = network.parameters();
+   const size_t num_state = network_optimizer->state().size();
+   if (std::string(checkpoint.optimizer()) != network_optimizer->name()
+     || checkpoint.optimizer_num_arrays() != 1 + num_state
+     || !state_matches(num_state, 1, arena->num_weights(), 1, arena->size() - arena->num_weights(),
+       [&](size_t k) -> const checkpoint::ArrayRecord& { return checkpoint.optimizer_array(1 + k); })) {
+    throw std::runtime_error("checkpoint network optimizer does not match: " + filename);
+   }
+  }
+
+  // settings, then state buffers
+  auto restore_optimizer = [&](Optimizer<T>& optimizer, const checkpoint::ArrayRecord& settings, auto state_array) {
+   const T* values = checkpoint.data(settings);
+   optimizer.restore_settings(std::vector<T>(values, values + settings.columns));
+   std::vector<Matrix<T>*> state = optimizer.state();
+   for (size_t k = 0; k < state.size(); k++) {
+    *state[k] = checkpoint.to_matrix(state_array(k));
+   }
+  };
+
+  for (size_t i = 0; i < layers.size(); i++) {
+   const checkpoint::LayerRecord& record = checkpoint.layer(i);
+   layers[i]->set_weights(checkpoint.to_matrix(checkpoint.array(i, 0)));
+   layers[i]->set_bias(checkpoint.to_matrix(checkpoint.array(i, 1)));
+
+   Optimizer<T>* optimizer = layers[i]->optimizer();
+   if (optimizer && record.optimizer[0] != '\0') {
+    restore_optimizer(*optimizer, checkpoint.array(i, 2),
+      [&](size_t k) -> const checkpoint::ArrayRecord& { return checkpoint.array(i, 3 + k); });
+   }
+  }
+  if (restore_network_optimizer) {
+   restore_optimizer(*network_optimizer, checkpoint.optimizer_array(0),
+     [&](size_t k) -> const checkpoint::ArrayRecord& { return checkpoint.optimizer_array(1 + k); });
+  }
+ }
+
+ /*
+  * Inference on a mapped checkpoint, without building layers or copying weights: every product
+  * reads its weights and bias straight from the mapping. Like Network::predict, the layer outputs
+  * live in two reused buffers, and the returned matrix is overwritten by the next call.
+ */
+ template<typename T>
+ class MappedModel {
+  public:
+   explicit MappedModel(const std::string& filename) : checkpoint_(filename) {
+    if (checkpoint_.num_layers() == 0) {
+     throw std::runtime_error("checkpoint has no layers: " + filename);
+    }
+    for (size_t i = 0; i < checkpoint_.num_layers(); i++) {
+     const checkpoint::LayerRecord& record = checkpoint_.layer(i);
+     layers_.push_back({checkpoint_.data(checkpoint_.array(i, 0)), checkpoint_.data(checkpoint_.array(i, 1)),
+      record.input_size, record.output_size,
+      activations::forward_function<T>(static_cast<kernels::ActivationKind>(record.activation))});
+    }
+   }
+
+   size_t input_size() const { return layers_.front().input_size; }
+   size_t output_size() const { return layers_.back().output_size; }
+   const Checkpoint<T>& checkpoint() const { return checkpoint_; }
+
+   // input is (input_size x N), one sample per column
+   const Matrix<T>& predict(const Matrix<T>& input) {
+    if (input.columns() == 0 || input.rows() != input_size()) {
+     throw std::invalid_argument("input dimensions do not match model input size");
+    }
+
+    // the previous result can be passed back in: the first layer then writes the other buffer
+    const size_t first = &input == &buffers_[0] ? 1 : 0;
+    const size_t batch = input.columns();
+    const Matrix<T>* current = &input;
+    for (size_t i = 0; i < layers_.size(); i++) {
+     const MappedLayer& layer = layers_[i];
+     Matrix<T>& output = buffers_[(first + i) % 2];
+     output.resize(layer.output_size, batch);
+
+     kernels::Epilogue<T> epilogue;
+     epilogue.bias = layer.bias;
+     epilogue.activate = layer.activate;
+     epilogue.out = output.data();
+     epilogue.ldo = batch;
+     kernels::gemm(kernels::Transpose::NO, kernels::Transpose::NO, layer.output_size, batch, layer.input_size,
+      static_cast<T>(1), layer.weights, layer.input_size, current->data(), current->stride(),
+      static_cast<T>(0), output.data(), batch, epilogue);
+     current = &output;
+    }
+    return *current;
+   }
+
+  private:
+   struct MappedLayer {
+    const T* weights;
+    const T* bias;
+    size_t input_size;
+    size_t output_size;
+    void (*activate)(const T*, T*, size_t);
+   };
+
+   Checkpoint<T> checkpoint_;
+   std::vector<MappedLayer> layers_;
+   Matrix<T> buffers_[2] = {Matrix<T>(0, 0), Matrix<T>(0, 0)};
+ };
+}
+
+#endif
@@ -0,0 +1,256 @@
+ /*
+  * Data-parallel training
+  *
+  * Every training step splits the mini-batch (features x N) into one contiguous shard of columns
+  * per replica. A replica is a clone of every layer of the network, bound to an arena that reads
+  * the parameters of the network arena in place (ParameterArena::sharing_values) and has its own
+  * gradient buffer, plus its own loss. A replica reads its shard of the batch in place, as a column
+  * range view, and writes its output columns straight into the output of the batch. The replicas run forward, loss and
+  * backward on the library thread pool, one task each; inside a task every kernel stays on its
+  * thread, so the small products of each shard are not split any further.
+  *
+  * The gradients are then combined into the network arena: it is cut into chunks of contiguous
+  * elements, and each thread sums one chunk over all the replicas. That is the reduce-scatter half
+  * of a ring all-reduce; the gather half is not needed since every replica reads the same values.
+  * Each replica averages its gradients over its shard, so shard r is weighted by n_r / N, and the
+  * sum is the gradient of the whole batch. The replicas are always summed in the same order, so
+  * results do not depend on the scheduling of the threads.
+  *
+  * The owner then runs its optimizer once over the network arena.
+  *
+  * Hogwild! mode (Niu et al.) drops the synchronization: the replicas run asynchronously, each
+  * one taking the next batch of the epoch from a shared counter, and each applies its own SGD
+  * step straight to the shared parameters after every batch, without locks. Steps of different
+  * replicas may then interleave on the same parameters and read half-updated weights, which the
+  * algorithm tolerates as long as each step touches the weights lightly (small or sparse-ish
+  * gradients, small batches). Every replica keeps its own activations, gradients and momentum, so
+  * nothing else is shared.
+ */
+
+#ifndef DATA_PARALLEL_H
+#define DATA_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "batch_loader.hpp"
+#include "layer.hpp"
+#include "loss.hpp"
+#include "matrix.hpp"
+#include "optimizer_kernels.hpp"
+#include "parameters.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+namespace nn {
+
+ enum class Synchronization {
+  ALL_REDUCE,  // one optimizer step per batch, on the gradients of all the replicas
+  HOGWILD      // every replica applies its own SGD steps to the shared parameters, without locks
+ };
+
+ template<typename T>
+ class DataParallel {
+  public:
+   // Replicas of layers, which must be bound to parameters (the network arena)
+   DataParallel(const std::vector<LayerBase<T>*>& layers, std::shared_ptr<ParameterArena<T>> parameters,
+     size_t num_replicas)
+    : parameters_(std::move(parameters)), replicas_(num_replicas) {
+    if (num_replicas == 0) {
+     throw std::invalid_argument(std::string(__func__) + ": at least one replica is needed");
+    }
+    if (!parameters_ || layers.empty()) {
+     throw std::invalid_argument(std::string(__func__) + ": layers must be bound to a parameter arena");
+    }
+    for (auto& replica : replicas_) {
+     replica.parameters = ParameterArena<T>::sharing_values(parameters_);
+     for (size_t i = 0; i < layers.size(); i++) {
+      replica.layers.push_back(layers[i]->clone());
+      replica.layers.back()->bind_parameters(replica.parameters, i);
+     }
+    }
+   }
+
+   size_t size() const { return replicas_.size(); }
+
+   /*
+    * Forward and backward pass of input over the replicas, against the target columns or, when
+    * target is null, the labels (one per column). Leaves the gradient of the whole batch in the
+    * gradient buffer of the network arena, writes the network output (outputs x N) and returns
+    * the loss averaged over the batch.
+    */
+   T step(const Matrix<T>& input, const Matrix<T>* target, const uint32_t* labels, const Loss<T>& loss,
+     Matrix<T>& output) {
+    const size_t batch_size = input.columns();
+    if (batch_size == 0) {
+     throw std::invalid_argument(std::string(__func__) + ": empty batch");
+    }
+    if (target && target->columns() != batch_size) {
+     throw std::invalid_argument(std::string(__func__) + ": target and input have different batch sizes");
+    }
+    use_loss(loss);
+
+    // shard r gets count / active columns, the first count % active one more
+    const size_t active = std::min(replicas_.size(), batch_size);
+    const size_t outputs = replicas_[0].layers.back()->output_size();
+    output.resize(outputs, batch_size);
+    for (size_t r = 0, first = 0; r < active; r++) {
+     replicas_[r].first = first;
+     replicas_[r].count = batch_size / active + (r < batch_size % active ? 1 : 0);
+     first += replicas_[r].count;
+    }
+
+    thread_pool().run(active, [&](size_t r) {
+     Replica& replica = replicas_[r];
+     for (auto& layer : replica.layers) {
+      layer->parameters_updated();  // narrow weight copies follow the shared values
+     }
+
+     // the first layer reads the shard in place, backward included
+     const Matrix<T>* current = &replica.layers[0]->forward(input.view().column_range(replica.first, replica.count));
+     for (size_t i = 1; i < replica.layers.size(); i++) {
+      current = &replica.layers[i]->forward(*current);
+     }
+     if (target) {
+      // the losses take contiguous targets, so these columns are still copied
+      copy_columns(*target, replica.first, replica.count, replica.target);
+      replica.loss_value = replica.loss->evaluate(*current, replica.target, replica.output_gradient);
+     } else {
+      replica.loss_value = replica.loss->evaluate(*current, labels + replica.first, replica.output_gradient);
+     }
+     Matrix<T> columns = Matrix<T>::borrow(output.view().column_range(replica.first, replica.count));
+     columns = *current;
+
+     const Matrix<T>* gradient = &replica.output_gradient;
+     for (size_t i = replica.layers.size(); i-- > 0;) {
+      gradient = &replica.layers[i]->backward(*gradient);
+     }
+    });
+
+    reduce_gradients(active, batch_size);
+
+    T total = 0;
+    for (size_t r = 0; r < active; r++) {
+     total += replicas_[r].loss_value * static_cast<T>(replicas_[r].count);
+    }
+    return total / static_cast<T>(batch_size);
+   }
+
+   /*
+    * One Hogwild! epoch of num_batches batches. load_batch(b, batch) fills batch with batch b of
+    * the epoch and is called from the replica threads, several at once; done(r, batch, output,
+    * loss) reports each batch from the thread of replica r, before its SGD step.
+    */
+   template<typename LoadBatch, typename Done>
+   void hogwild(size_t num_batches, const LoadBatch& load_batch, const Done& done, const Loss<T>& loss,
+     T learning_rate, T momentum) {
+    use_loss(loss);
+    std::atomic<size_t> next_batch{0};
+    T* values = parameters_->values();
+    const size_t size = parameters_->size();
+
+    thread_pool().run(replicas_.size(), [&](size_t r) {
+     Replica& replica = replicas_[r];
+     replica.velocity.resize(size);
+     T* gradients = replica.parameters->gradients();
+     for (size_t b = next_batch.fetch_add(1); b < num_batches; b = next_batch.fetch_add(1)) {
+      const Batch<T>& batch = load_batch(b, replica.batch);
+      for (auto& layer : replica.layers) {
+       layer->parameters_updated();
+      }
+
+      const Matrix<T>* current = &batch.inputs;
+      for (auto& layer : replica.layers) {
+       current = &layer->forward(*current);
+      }
+      const T value = batch.labels.size() == batch.inputs.columns()
+       ? replica.loss->evaluate(*current, batch.labels.data(), replica.output_gradient)
+       : replica.loss->evaluate(*current, batch.targets, replica.output_gradient);
+      done(r, batch, *current, value);
+
+      const Matrix<T>* gradient = &replica.output_gradient;
+      for (size_t i = replica.layers.size(); i-- > 0;) {
+       gradient = &replica.layers[i]->backward(*gradient);
+      }
+      NN_PROFILE_SCOPE("Hogwild::update", "optimizer", 4.0 * size, 5.0 * sizeof(T) * size);
+      kernels::sgd_update(values, gradients, replica.velocity.data(), size, learning_rate, momentum);
+     }
+    });
+   }
+
+  private:
+   struct Replica {
+    std::vector<std::unique_ptr<LayerBase<T>>> layers;
+    std::shared_ptr<ParameterArena<T>> parameters;
+    std::unique_ptr<Loss<T>> loss;
+    Matrix<T> target = Matrix<T>(0, 0);
+    Matrix<T> output_gradient = Matrix<T>(0, 0);
+    T loss_value = 0;
+    size_t first = 0;
+    size_t count = 0;
+    Batch<T> batch;              // Hogwild! only: the batch the replica works on
+    std::vector<T> velocity;     // and its own momentum, in the arena layout
+   };
+
+   // Elements of the arena summed by one task
+   static constexpr size_t kReduceGrain = 1 << 14;
+
+   std::shared_ptr<ParameterArena<T>> parameters_;
+   std::vector<Replica> replicas_;
+   const Loss<T>* loss_source_ = nullptr;  // the loss the replicas' copies were cloned from
+
+   // Each replica gets its own copy of the loss, to keep its workspaces apart
+   void use_loss(const Loss<T>& loss) {
+    if (&loss != loss_source_) {
+     for (auto& replica : replicas_) {
+      replica.loss = loss.clone();
+     }
+     loss_source_ = &loss;
+    }
+   }
+
+   // gradient = sum over the active replicas of n_r / N * gradient_r, chunk by chunk
+   void reduce_gradients(size_t active, size_t batch_size) {
+    T* sum = parameters_->gradients();
+    std::vector<const T*> sources(active);
+    std::vector<T> weights(active);
+    for (size_t r = 0; r < active; r++) {
+     sources[r] = replicas_[r].parameters->gradients();
+     weights[r] = static_cast<T>(replicas_[r].count) / static_cast<T>(batch_size);
+    }
+    NN_PROFILE_SCOPE("DataParallel::reduce", "parallel", 2.0 * active * parameters_->size(),
+      (active + 1.0) * sizeof(T) * parameters_->size());
+
+    nn::parallel_for(0, parameters_->size(), kReduceGrain, [&](size_t lo, size_t hi) {
+     const T* g = sources[0];
+     const T w = weights[0];
+     for (size_t k = lo; k < hi; k++) {
+      sum[k] = w * g[k];
+     }
+     for (size_t r = 1; r < active; r++) {
+      g = sources[r];
+      const T wr = weights[r];
+      for (size_t k = lo; k < hi; k++) {
+       sum[k] += wr * g[k];
+      }
+     }
+    });
+   }
+
+   // Columns [first, first + count) of source into shard, row by row (either may be padded)
+   static void copy_columns(const Matrix<T>& source, size_t first, size_t count, Matrix<T>& shard) {
+    const size_t rows = source.rows();
+    shard.resize(rows, count);
+    for (size_t i = 0; i < rows; i++) {
+     const T* src = source.data() + i * source.stride() + first;
+     std::copy(src, src + count, shard.data() + i * shard.stride());
+    }
+   }
+ };
+}
+
+#endif
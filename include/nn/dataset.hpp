@@ -0,0 +1,237 @@
+ /*
+  * Dataset
+  *
+  * All samples of a data set in one contiguous block instead of one Matrix per sample.
+  *
+  * Features are stored sample-major: sample i is the num_features() values starting at
+  * sample(i), and consecutive samples follow each other, so a run of samples is a single block
+  * and a shuffled mini-batch still reads whole cache lines.
+  *
+  * Targets are either class indices (Targets::CLASS_INDICES, one integer per sample, expanded to
+  * one-hot columns only when a batch is gathered) or dense vectors of num_targets() values
+  * (Targets::DENSE), stored like the features.
+  *
+  * gather() builds the (features x batch) and (targets x batch) matrices the network trains on,
+  * reusing their storage between calls, or the features and the class index of each sample.
+ */
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "matrix.hpp"
+
+namespace nn {
+
+ enum class Targets {
+  CLASS_INDICES,  // one class per sample, num_targets is the number of classes
+  DENSE           // a vector of num_targets values per sample
+ };
+
+ template<typename T>
+ class Dataset {
+  private:
+   size_t size_;
+   size_t num_features_;
+   size_t num_targets_;
+   Targets kind_;
+   std::vector<T> features_;
+   std::vector<uint32_t> labels_;  // CLASS_INDICES
+   std::vector<T> targets_;        // DENSE
+
+   // Samples copied per pass of the transposing gather: their rows stay in L1 together
+   static constexpr size_t kGatherBlock = 16;
+
+   template<typename Index>
+   void gather_features(const Index& index, size_t count, Matrix<T>& inputs) const {
+    inputs.resize(num_features_, count);
+    T* in = inputs.data();
+
+    for (size_t j0 = 0; j0 < count; j0 += kGatherBlock) {
+     const size_t block = std::min(kGatherBlock, count - j0);
+     const T* src[kGatherBlock];
+     for (size_t jj = 0; jj < block; jj++) {
+      src[jj] = sample(index(j0 + jj));
+     }
+     for (size_t f = 0; f < num_features_; f++) {
+      T* dst = in + f * count + j0;
+      for (size_t jj = 0; jj < block; jj++) {
+       dst[jj] = src[jj][f];
+      }
+     }
+    }
+   }
+
+   template<typename Index>
+   void gather_columns(const Index& index, size_t count, Matrix<T>& inputs, Matrix<T>& targets) const {
+    gather_features(index, count, inputs);
+    targets.resize(num_targets_, count);
+    T* out = targets.data();
+
+    if (kind_ == Targets::CLASS_INDICES) {
+     std::fill(out, out + num_targets_ * count, static_cast<T>(0));
+     for (size_t j = 0; j < count; j++) {
+      out[labels_[index(j)] * count + j] = static_cast<T>(1);
+     }
+    } else {
+     for (size_t j = 0; j < count; j++) {
+      const T* src = target(index(j));
+      for (size_t t = 0; t < num_targets_; t++) {
+       out[t * count + j] = src[t];
+      }
+     }
+    }
+   }
+
+  public:
+   Dataset(size_t size, size_t num_features, size_t num_targets, Targets kind = Targets::CLASS_INDICES)
+    : size_(size), num_features_(num_features), num_targets_(num_targets), kind_(kind),
+      features_(size * num_features) {
+    if (num_features == 0 || num_targets == 0) {
+     throw std::invalid_argument(std::string(__func__) + ": features and targets must not be empty");
+    }
+    if (kind == Targets::CLASS_INDICES) {
+     labels_.resize(size);
+    } else {
+     targets_.resize(size * num_targets);
+    }
+   }
+
+   /*
+    * Copy of a data set given as one column matrix per sample. Targets are kept dense, one-hot
+    * targets can be converted with the class index constructor instead.
+    */
+   Dataset(const std::vector<Matrix<T>>& inputs, const std::vector<Matrix<T>>& targets)
+    : Dataset(inputs.size(), inputs.empty() ? 1 : inputs[0].rows(),
+      targets.empty() ? 1 : targets[0].rows(), Targets::DENSE) {
+    if (inputs.size() != targets.size()) {
+     throw std::invalid_argument(std::string(__func__) + ": number of inputs must match number of targets");
+    }
+    for (size_t i = 0; i < size_; i++) {
+     if (inputs[i].rows() != num_features_ || inputs[i].columns() != 1
+       || targets[i].rows() != num_targets_ || targets[i].columns() != 1) {
+      throw std::invalid_argument(std::string(__func__) + ": samples must be column vectors of the same size");
+     }
+     // a padded column holds one element per stride
+     for (size_t k = 0; k < num_features_; k++) {
+      sample(i)[k] = inputs[i].data()[k * inputs[i].stride()];
+     }
+     for (size_t k = 0; k < num_targets_; k++) {
+      target(i)[k] = targets[i].data()[k * targets[i].stride()];
+     }
+    }
+   }
+
+   size_t size() const { return size_; }
+   bool empty() const { return size_ == 0; }
+   size_t num_features() const { return num_features_; }
+   size_t num_targets() const { return num_targets_; }
+   Targets kind() const { return kind_; }
+
+   // The whole feature block, size() x num_features() row-major
+   T* features() { return features_.data(); }
+   const T* features() const { return features_.data(); }
+
+   // Features of sample i, num_features() contiguous values
+   T* sample(size_t i) {
+    return const_cast<T*>(static_cast<const Dataset&>(*this).sample(i));
+   }
+   const T* sample(size_t i) const {
+    if (i >= size_) {
+     throw std::out_of_range(std::string(__func__) + ": sample index out of range");
+    }
+    return features_.data() + i * num_features_;
+   }
+
+   uint32_t label(size_t i) const {
+    if (kind_ != Targets::CLASS_INDICES) {
+     throw std::logic_error(std::string(__func__) + ": dataset has dense targets");
+    }
+    if (i >= size_) {
+     throw std::out_of_range(std::string(__func__) + ": sample index out of range");
+    }
+    return labels_[i];
+   }
+
+   void set_label(size_t i, uint32_t label) {
+    if (kind_ != Targets::CLASS_INDICES) {
+     throw std::logic_error(std::string(__func__) + ": dataset has dense targets");
+    }
+    if (i >= size_ || label >= num_targets_) {
+     throw std::out_of_range(std::string(__func__) + ": sample or class index out of range");
+    }
+    labels_[i] = label;
+   }
+
+   // Dense target of sample i, num_targets() contiguous values
+   T* target(size_t i) {
+    return const_cast<T*>(static_cast<const Dataset&>(*this).target(i));
+   }
+   const T* target(size_t i) const {
+    if (kind_ != Targets::DENSE) {
+     throw std::logic_error(std::string(__func__) + ": dataset has class index targets");
+    }
+    if (i >= size_) {
+     throw std::out_of_range(std::string(__func__) + ": sample index out of range");
+    }
+    return targets_.data() + i * num_targets_;
+   }
+
+   // Samples [first, first + count) as the columns of inputs and targets
+   void gather(size_t first, size_t count, Matrix<T>& inputs, Matrix<T>& targets) const {
+    if (first > size_ || count > size_ - first) {
+     throw std::out_of_range(std::string(__func__) + ": sample range out of range");
+    }
+    gather_columns([first](size_t j) { return first + j; }, count, inputs, targets);
+   }
+
+   // Samples indices[0], ..., indices[count - 1] (e.g. a shuffled order) as columns
+   void gather(const size_t* indices, size_t count, Matrix<T>& inputs, Matrix<T>& targets) const {
+    for (size_t j = 0; j < count; j++) {
+     if (indices[j] >= size_) {
+      throw std::out_of_range(std::string(__func__) + ": sample index out of range");
+     }
+    }
+    gather_columns([indices](size_t j) { return indices[j]; }, count, inputs, targets);
+   }
+
+   /*
+    * The same batches with the class index of each sample instead of one-hot target columns, for
+    * losses that take labels (see loss.hpp). Class index data sets only.
+    */
+   void gather(size_t first, size_t count, Matrix<T>& inputs, std::vector<uint32_t>& labels) const {
+    if (first > size_ || count > size_ - first) {
+     throw std::out_of_range(std::string(__func__) + ": sample range out of range");
+    }
+    gather_labels([first](size_t j) { return first + j; }, count, inputs, labels);
+   }
+
+   void gather(const size_t* indices, size_t count, Matrix<T>& inputs, std::vector<uint32_t>& labels) const {
+    for (size_t j = 0; j < count; j++) {
+     if (indices[j] >= size_) {
+      throw std::out_of_range(std::string(__func__) + ": sample index out of range");
+     }
+    }
+    gather_labels([indices](size_t j) { return indices[j]; }, count, inputs, labels);
+   }
+
+  private:
+   template<typename Index>
+   void gather_labels(const Index& index, size_t count, Matrix<T>& inputs, std::vector<uint32_t>& labels) const {
+    if (kind_ != Targets::CLASS_INDICES) {
+     throw std::logic_error("gather: dataset has dense targets");
+    }
+    gather_features(index, count, inputs);
+    labels.resize(count);
+    for (size_t j = 0; j < count; j++) {
+     labels[j] = labels_[index(j)];
+    }
+   }
+ };
+}
+
+#endif
@@ -0,0 +1,879 @@
+ /*
+  * General matrix multiplication
+  *
+  * C = alpha * A * B + beta * C, with row-major A (M x K), B (K x N) and C (M x N) given as
+  * raw pointers plus leading dimensions (the distance between two consecutive rows).
+  * Either operand can also be used transposed (BLAS transA/transB): op(A) = A^T reads A as a
+  * K x M matrix in place, which spares the backward pass an explicit transposed copy.
+  *
+  * The implementation follows the usual GotoBLAS/BLIS structure:
+  * - B is copied ("packed") one KC x NC block at a time into NR-wide column panels
+  * - A is packed one MC x KC block at a time into MR-tall row panels
+  * - a register-tiled micro-kernel computes an MR x NR tile of C from one A panel and one
+  *   B panel, keeping the whole tile in registers for the entire KC loop
+  *
+  * Block sizes are picked so a packed A block stays in L2 and a B panel in L1 while the
+  * micro-kernel streams through them. Matrix-vector products (N == 1) skip the packing,
+  * since every element of A is used only once there. The transposition is absorbed by the
+  * packing routines, so the micro-kernels never see it.
+  *
+  * Large products are split into row or column slabs over the library thread pool.
+  *
+  * An optional epilogue finishes C as it is produced: a bias per row is added and an activation
+  * writes its output, tile by tile right after the last K block, while the tile is still in L1.
+  *
+  * A and B may be stored in a narrower type than C (bfloat16/float16 with a float C, see half.hpp).
+  * They are widened as they are packed, so the micro-kernels and the accumulation stay in the
+  * type of C; matrix-vector products widen A a few rows at a time into an L1-sized buffer.
+ */
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "half.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+
+namespace nn {
+ namespace kernels {
+
+  // How gemm reads an operand: as stored, or as its transpose
+  enum class Transpose {
+   NO,
+   YES
+  };
+
+  /*
+   * Work applied to the finished C: C[i][j] += bias[i], then out[i][j] = activate(C[i][j]).
+   * activate runs over n contiguous values and may work in place (out == C); either step is
+   * skipped when its pointer is null.
+  */
+  template<typename T>
+  struct Epilogue {
+   const T* bias = nullptr;
+   void (*activate)(const T* x, T* y, size_t n) = nullptr;
+   T* out = nullptr;
+   size_t ldo = 0;
+
+   bool empty() const { return bias == nullptr && activate == nullptr; }
+
+   // The same epilogue for the sub-block of C starting at (row, column)
+   Epilogue at(size_t row, size_t column) const {
+    Epilogue block = *this;
+    if (bias) block.bias += row;
+    if (out) block.out += row * ldo + column;
+    return block;
+   }
+  };
+
+  // Register tile (MR x NR) and cache blocks (MC x KC of A, KC x NC of B) per instruction set
+  template<typename T, simd::Isa isa>
+  struct GemmBlocking {
+   static constexpr size_t MR = 4;
+   static constexpr size_t NR = 4;
+   static constexpr size_t MC = 64;
+   static constexpr size_t KC = 256;
+   static constexpr size_t NC = 1024;
+  };
+
+  template<>
+  struct GemmBlocking<float, simd::Isa::SCALAR> {
+   static constexpr size_t MR = 4;
+   static constexpr size_t NR = 8;
+   static constexpr size_t MC = 96;
+   static constexpr size_t KC = 256;
+   static constexpr size_t NC = 2048;
+  };
+
+  template<>
+  struct GemmBlocking<float, simd::Isa::AVX2> {
+   static constexpr size_t MR = 6;
+   static constexpr size_t NR = 16;
+   static constexpr size_t MC = 96;
+   static constexpr size_t KC = 256;
+   static constexpr size_t NC = 2048;
+  };
+
+  template<>
+  struct GemmBlocking<float, simd::Isa::AVX512> {
+   static constexpr size_t MR = 6;
+   static constexpr size_t NR = 32;
+   static constexpr size_t MC = 96;
+   static constexpr size_t KC = 256;
+   static constexpr size_t NC = 2048;
+  };
+
+  template<>
+  struct GemmBlocking<double, simd::Isa::AVX2> {
+   static constexpr size_t MR = 6;
+   static constexpr size_t NR = 8;
+   static constexpr size_t MC = 96;
+   static constexpr size_t KC = 256;
+   static constexpr size_t NC = 1024;
+  };
+
+  template<>
+  struct GemmBlocking<double, simd::Isa::AVX512> {
+   static constexpr size_t MR = 6;
+   static constexpr size_t NR = 16;
+   static constexpr size_t MC = 96;
+   static constexpr size_t KC = 256;
+   static constexpr size_t NC = 1024;
+  };
+
+  namespace detail {
+
+   // Below this many multiply-adds the packing overhead is not worth it
+   constexpr size_t kSmallGemmFlops = 16 * 16 * 16;
+
+   // Packed panels start on a cache line, NR * sizeof(T) is a multiple of the vector width
+   template<typename T>
+   using PackBuffer = std::vector<T, AlignedAllocator<T, 64>>;
+
+   template<typename T>
+   PackBuffer<T>& pack_buffer_a() {
+    thread_local PackBuffer<T> buffer;
+    return buffer;
+   }
+
+   template<typename T>
+   PackBuffer<T>& pack_buffer_b() {
+    thread_local PackBuffer<T> buffer;
+    return buffer;
+   }
+
+   // Tile of C computed from packed panels: acc = sum_p a[p*MR + i] * b[p*NR + j]
+   template<typename T, size_t MR, size_t NR>
+   NN_ALWAYS_INLINE void micro_kernel_body(size_t kc, const T* a, const T* b,
+     T* c, size_t ldc, T alpha, T beta) {
+    T acc[MR][NR] = {};
+
+    for (size_t p = 0; p < kc; p++) {
+     for (size_t i = 0; i < MR; i++) {
+      const T ai = a[i];
+      for (size_t j = 0; j < NR; j++) {
+       acc[i][j] += ai * b[j];
+      }
+     }
+     a += MR;
+     b += NR;
+    }
+
+    if (beta == static_cast<T>(0)) {
+     for (size_t i = 0; i < MR; i++) {
+      for (size_t j = 0; j < NR; j++) {
+       c[i * ldc + j] = alpha * acc[i][j];
+      }
+     }
+    } else {
+     for (size_t i = 0; i < MR; i++) {
+      for (size_t j = 0; j < NR; j++) {
+       c[i * ldc + j] = alpha * acc[i][j] + beta * c[i * ldc + j];
+      }
+     }
+    }
+   }
+
+   // Portable micro-kernel, also used for types without a vector specialization
+   template<typename T, simd::Isa isa>
+   struct MicroKernel {
+    static void run(size_t kc, const T* a, const T* b, T* c, size_t ldc, T alpha, T beta) {
+     using B = GemmBlocking<T, isa>;
+     micro_kernel_body<T, B::MR, B::NR>(kc, a, b, c, ldc, alpha, beta);
+    }
+   };
+
+#if NN_X86_DISPATCH
+   /*
+    * Vector micro-kernel: MR rows x NV vectors of accumulators (12 registers for the 6 x 2 tiles
+    * used here), one broadcast of A and NV aligned loads of the B panel per k step, fused
+    * multiply-add throughout.
+    * V wraps the intrinsics of one register type (see the Vec* structs in simd.hpp).
+    *
+    * GCC refuses to inline target-specific intrinsics into a function without that target, so the
+    * body is stamped out once per target instead of living in a single generic template.
+   */
+#define NN_DEFINE_VECTOR_MICRO_KERNEL(name, target)                                           \
+   template<typename V, size_t MR, size_t NV>                                                 \
+   target NN_ALWAYS_INLINE void name(size_t kc, const typename V::scalar* a,                  \
+     const typename V::scalar* b, typename V::scalar* c, size_t ldc,                          \
+     typename V::scalar alpha, typename V::scalar beta) {                                     \
+    using R = typename V::reg;                                                                \
+    R acc[MR][NV];                                                                            \
+    for (size_t i = 0; i < MR; i++) {                                                         \
+     for (size_t v = 0; v < NV; v++) {                                                        \
+      acc[i][v] = V::zero();                                                                  \
+     }                                                                                        \
+    }                                                                                         \
+                                                                                              \
+    for (size_t p = 0; p < kc; p++) {                                                         \
+     R bv[NV];                                                                                \
+     for (size_t v = 0; v < NV; v++) {                                                        \
+      bv[v] = V::load_aligned(b + v * V::width);                                              \
+     }                                                                                        \
+     for (size_t i = 0; i < MR; i++) {                                                        \
+      const R ai = V::broadcast(a[i]);                                                        \
+      for (size_t v = 0; v < NV; v++) {                                                       \
+       acc[i][v] = V::fmadd(ai, bv[v], acc[i][v]);                                            \
+      }                                                                                       \
+     }                                                                                        \
+     a += MR;                                                                                 \
+     b += NV * V::width;                                                                      \
+    }                                                                                         \
+                                                                                              \
+    const R alpha_v = V::broadcast(alpha);                                                    \
+    if (beta == 0) {                                                                          \
+     for (size_t i = 0; i < MR; i++) {                                                        \
+      for (size_t v = 0; v < NV; v++) {                                                       \
+       V::store(c + i * ldc + v * V::width, V::mul(alpha_v, acc[i][v]));                      \
+      }                                                                                       \
+     }                                                                                        \
+    } else {                                                                                  \
+     const R beta_v = V::broadcast(beta);                                                     \
+     for (size_t i = 0; i < MR; i++) {                                                        \
+      for (size_t v = 0; v < NV; v++) {                                                       \
+       typename V::scalar* dst = c + i * ldc + v * V::width;                                  \
+       V::store(dst, V::fmadd(alpha_v, acc[i][v], V::mul(beta_v, V::load(dst))));             \
+      }                                                                                       \
+     }                                                                                        \
+    }                                                                                         \
+   }
+
+   NN_DEFINE_VECTOR_MICRO_KERNEL(vector_micro_kernel_avx2, NN_TARGET_AVX2)
+   NN_DEFINE_VECTOR_MICRO_KERNEL(vector_micro_kernel_avx512, NN_TARGET_AVX512)
+#undef NN_DEFINE_VECTOR_MICRO_KERNEL
+
+   /*
+    * Vector matrix-vector product with a contiguous x: four rows of A at a time share every
+    * load of x, two vectors of partial sums per row hide the FMA latency.
+    * A may be stored in a 16-bit type (TA), it is then widened in registers as it is loaded.
+   */
+#define NN_DEFINE_VECTOR_GEMV(name, target)                                                   \
+   template<typename V, typename TA>                                                          \
+   target NN_ALWAYS_INLINE void name(size_t M, size_t K, typename V::scalar alpha,            \
+     const TA* A, size_t lda, const typename V::scalar* x,                                    \
+     typename V::scalar beta, typename V::scalar* y, size_t incy) {                           \
+    using R = typename V::reg;                                                                \
+    using S = typename V::scalar;                                                             \
+    constexpr size_t ROWS = 4;                                                                \
+    constexpr size_t STEP = 2 * V::width;                                                     \
+    for (size_t i = 0; i < M; i += ROWS) {                                                    \
+     const size_t rows = M - i < ROWS ? M - i : ROWS;                                         \
+     const TA* a[ROWS];                                                                       \
+     for (size_t r = 0; r < ROWS; r++) {                                                      \
+      a[r] = A + (i + (r < rows ? r : 0)) * lda;                                              \
+     }                                                                                        \
+     R acc[ROWS][2];                                                                          \
+     for (size_t r = 0; r < ROWS; r++) {                                                      \
+      acc[r][0] = V::zero();                                                                  \
+      acc[r][1] = V::zero();                                                                  \
+     }                                                                                        \
+     size_t p = 0;                                                                            \
+     for (; p + STEP <= K; p += STEP) {                                                       \
+      const R x0 = V::load(x + p);                                                            \
+      const R x1 = V::load(x + p + V::width);                                                 \
+      for (size_t r = 0; r < ROWS; r++) {                                                     \
+       if constexpr (std::is_same<TA, S>::value) {                                            \
+        acc[r][0] = V::fmadd(V::load(a[r] + p), x0, acc[r][0]);                               \
+        acc[r][1] = V::fmadd(V::load(a[r] + p + V::width), x1, acc[r][1]);                    \
+       } else {                                                                               \
+        acc[r][0] = V::fmadd(WideLoad<V, TA>::load(a[r] + p), x0, acc[r][0]);                 \
+        acc[r][1] = V::fmadd(WideLoad<V, TA>::load(a[r] + p + V::width), x1, acc[r][1]);      \
+       }                                                                                      \
+      }                                                                                       \
+     }                                                                                        \
+     for (size_t r = 0; r < rows; r++) {                                                      \
+      S sum = V::reduce(V::add(acc[r][0], acc[r][1]));                                        \
+      for (size_t q = p; q < K; q++) {                                                        \
+       sum += static_cast<S>(a[r][q]) * x[q];                                                 \
+      }                                                                                       \
+      S& out = y[(i + r) * incy];                                                             \
+      out = beta == 0 ? alpha * sum : alpha * sum + beta * out;                               \
+     }                                                                                        \
+    }                                                                                         \
+   }
+
+   NN_DEFINE_VECTOR_GEMV(vector_gemv_avx2, NN_TARGET_AVX2)
+   NN_DEFINE_VECTOR_GEMV(vector_gemv_avx512, NN_TARGET_AVX512)
+#undef NN_DEFINE_VECTOR_GEMV
+
+   template<>
+   struct MicroKernel<float, simd::Isa::AVX2> {
+    NN_TARGET_AVX2
+    static void run(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta) {
+     using B = GemmBlocking<float, simd::Isa::AVX2>;
+     vector_micro_kernel_avx2<simd::VecAvx2Float, B::MR, B::NR / simd::VecAvx2Float::width>(kc, a, b, c, ldc, alpha, beta);
+    }
+   };
+
+   template<>
+   struct MicroKernel<double, simd::Isa::AVX2> {
+    NN_TARGET_AVX2
+    static void run(size_t kc, const double* a, const double* b, double* c, size_t ldc, double alpha, double beta) {
+     using B = GemmBlocking<double, simd::Isa::AVX2>;
+     vector_micro_kernel_avx2<simd::VecAvx2Double, B::MR, B::NR / simd::VecAvx2Double::width>(kc, a, b, c, ldc, alpha, beta);
+    }
+   };
+
+   template<>
+   struct MicroKernel<float, simd::Isa::AVX512> {
+    NN_TARGET_AVX512
+    static void run(size_t kc, const float* a, const float* b, float* c, size_t ldc, float alpha, float beta) {
+     using B = GemmBlocking<float, simd::Isa::AVX512>;
+     vector_micro_kernel_avx512<simd::VecAvx512Float, B::MR, B::NR / simd::VecAvx512Float::width>(kc, a, b, c, ldc, alpha, beta);
+    }
+   };
+
+   template<>
+   struct MicroKernel<double, simd::Isa::AVX512> {
+    NN_TARGET_AVX512
+    static void run(size_t kc, const double* a, const double* b, double* c, size_t ldc, double alpha, double beta) {
+     using B = GemmBlocking<double, simd::Isa::AVX512>;
+     vector_micro_kernel_avx512<simd::VecAvx512Double, B::MR, B::NR / simd::VecAvx512Double::width>(kc, a, b, c, ldc, alpha, beta);
+    }
+   };
+#endif
+
+   // Position of element (i, j) of op(X), for X stored row-major with leading dimension ld
+   inline size_t offset(size_t i, size_t j, size_t ld, bool trans) {
+    return trans ? j * ld + i : i * ld + j;
+   }
+
+   /*
+    * Copy an mc x kc block of op(A) into MR-tall panels, each stored k-major; short panels are zero padded.
+    * A narrower S is widened to T on the way.
+   */
+   template<typename T, size_t MR, typename S>
+   void pack_a(size_t mc, size_t kc, const S* A, size_t lda, bool trans, T* packed) {
+    for (size_t i = 0; i < mc; i += MR) {
+     const size_t mr = std::min(MR, mc - i);
+     for (size_t p = 0; p < kc; p++) {
+      if (trans) {
+       const S* col = A + p * lda + i;
+       for (size_t ii = 0; ii < mr; ii++) {
+        packed[ii] = static_cast<T>(col[ii]);
+       }
+      } else {
+       for (size_t ii = 0; ii < mr; ii++) {
+        packed[ii] = static_cast<T>(A[(i + ii) * lda + p]);
+       }
+      }
+      for (size_t ii = mr; ii < MR; ii++) {
+       packed[ii] = static_cast<T>(0);
+      }
+      packed += MR;
+     }
+    }
+   }
+
+   // Copy a kc x nc block of op(B) into NR-wide panels, each stored k-major; short panels are zero padded
+   template<typename T, size_t NR, typename S>
+   void pack_b(size_t kc, size_t nc, const S* B, size_t ldb, bool trans, T* packed) {
+    for (size_t j = 0; j < nc; j += NR) {
+     const size_t nr = std::min(NR, nc - j);
+     for (size_t p = 0; p < kc; p++) {
+      if (trans) {
+       for (size_t jj = 0; jj < nr; jj++) {
+        packed[jj] = static_cast<T>(B[(j + jj) * ldb + p]);
+       }
+      } else {
+       const S* row = B + p * ldb + j;
+       for (size_t jj = 0; jj < nr; jj++) {
+        packed[jj] = static_cast<T>(row[jj]);
+       }
+      }
+      for (size_t jj = nr; jj < NR; jj++) {
+       packed[jj] = static_cast<T>(0);
+      }
+      packed += NR;
+     }
+    }
+   }
+
+   template<typename T>
+   void scale(size_t M, size_t N, T beta, T* C, size_t ldc) {
+    for (size_t i = 0; i < M; i++) {
+     for (size_t j = 0; j < N; j++) {
+      C[i * ldc + j] = beta == static_cast<T>(0) ? static_cast<T>(0) : beta * C[i * ldc + j];
+     }
+    }
+   }
+
+   // Run the epilogue over an m x n block of C whose origin is (0, 0) of ep
+   template<typename T>
+   void apply_epilogue(const Epilogue<T>& ep, size_t m, size_t n, T* C, size_t ldc) {
+    if (ep.empty()) {
+     return;
+    }
+    for (size_t i = 0; i < m; i++) {
+     T* z = C + i * ldc;
+     if (ep.bias) {
+      const T b = ep.bias[i];
+      for (size_t j = 0; j < n; j++) {
+       z[j] += b;
+      }
+     }
+     if (ep.activate) {
+      ep.activate(z, ep.out + i * ep.ldo, n);
+     }
+    }
+   }
+
+   // Unpacked i-k-j loop for tiny products, the inner loop runs along rows of op(B) and C
+   template<typename T, typename TA, typename TB>
+   void gemm_small(bool trans_a, bool trans_b, size_t M, size_t N, size_t K, T alpha, const TA* A, size_t lda,
+     const TB* B, size_t ldb, T beta, T* C, size_t ldc) {
+    scale(M, N, beta, C, ldc);
+    for (size_t i = 0; i < M; i++) {
+     T* c = C + i * ldc;
+     for (size_t p = 0; p < K; p++) {
+      const T a = alpha * static_cast<T>(A[offset(i, p, lda, trans_a)]);
+      if (trans_b) {
+       for (size_t j = 0; j < N; j++) {
+        c[j] += a * static_cast<T>(B[j * ldb + p]);
+       }
+      } else {
+       const TB* b = B + p * ldb;
+       for (size_t j = 0; j < N; j++) {
+        c[j] += a * static_cast<T>(b[j]);
+       }
+      }
+     }
+    }
+   }
+
+   /*
+    * Matrix-vector product, each output is a dot product over a contiguous row of A.
+    * The row is consumed in chunks of LANES independent partial sums, which the compiler can keep
+    * in vector registers without reassociating a single floating point sum.
+   */
+   template<typename T>
+   NN_ALWAYS_INLINE void gemv_body(size_t M, size_t K, T alpha, const T* A, size_t lda,
+     const T* x, size_t incx, T beta, T* y, size_t incy) {
+    constexpr size_t LANES = 128 / sizeof(T);
+
+    for (size_t i = 0; i < M; i++) {
+     const T* a = A + i * lda;
+     T sum = 0;
+     size_t p = 0;
+
+     if (incx == 1) {
+      T partial[LANES] = {};
+      for (; p + LANES <= K; p += LANES) {
+       for (size_t l = 0; l < LANES; l++) {
+        partial[l] += a[p + l] * x[p + l];
+       }
+      }
+      for (size_t l = 0; l < LANES; l++) {
+       sum += partial[l];
+      }
+     }
+
+     for (; p < K; p++) {
+      sum += a[p] * x[p * incx];
+     }
+
+     y[i * incy] = beta == static_cast<T>(0) ? alpha * sum : alpha * sum + beta * y[i * incy];
+    }
+   }
+
+   /*
+    * Transposed matrix-vector product, y = alpha * A^T * x + beta * y with A stored K x M.
+    * Reading columns of A would stride through memory, so y is built up instead as a sum of the
+    * contiguous rows of A scaled by the entries of x (an axpy per row, vectorized by the compiler).
+   */
+   template<typename T>
+   NN_ALWAYS_INLINE void gemv_trans_body(size_t M, size_t K, T alpha, const T* A, size_t lda,
+     const T* x, size_t incx, T beta, T* y, size_t incy) {
+    if (incy != 1) {
+     for (size_t i = 0; i < M; i++) {
+      T sum = 0;
+      for (size_t p = 0; p < K; p++) {
+       sum += A[p * lda + i] * x[p * incx];
+      }
+      y[i * incy] = beta == static_cast<T>(0) ? alpha * sum : alpha * sum + beta * y[i * incy];
+     }
+     return;
+    }
+
+    for (size_t i = 0; i < M; i++) {
+     y[i] = beta == static_cast<T>(0) ? static_cast<T>(0) : beta * y[i];
+    }
+    for (size_t p = 0; p < K; p++) {
+     const T s = alpha * x[p * incx];
+     const T* a = A + p * lda;
+     for (size_t i = 0; i < M; i++) {
+      y[i] += s * a[i];
+     }
+    }
+   }
+
+   template<typename T, simd::Isa isa>
+   struct GemvKernel {
+    static void run(bool trans, size_t M, size_t K, T alpha, const T* A, size_t lda,
+      const T* x, size_t incx, T beta, T* y, size_t incy) {
+     if (trans) {
+      gemv_trans_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     } else {
+      gemv_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     }
+    }
+   };
+
+#if NN_X86_DISPATCH
+   template<>
+   struct GemvKernel<float, simd::Isa::AVX2> {
+    NN_TARGET_AVX2
+    static void run(bool trans, size_t M, size_t K, float alpha, const float* A, size_t lda,
+      const float* x, size_t incx, float beta, float* y, size_t incy) {
+     if (trans) {
+      gemv_trans_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     } else if (incx == 1) {
+      vector_gemv_avx2<simd::VecAvx2Float>(M, K, alpha, A, lda, x, beta, y, incy);
+     } else {
+      gemv_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     }
+    }
+   };
+
+   template<>
+   struct GemvKernel<double, simd::Isa::AVX2> {
+    NN_TARGET_AVX2
+    static void run(bool trans, size_t M, size_t K, double alpha, const double* A, size_t lda,
+      const double* x, size_t incx, double beta, double* y, size_t incy) {
+     if (trans) {
+      gemv_trans_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     } else if (incx == 1) {
+      vector_gemv_avx2<simd::VecAvx2Double>(M, K, alpha, A, lda, x, beta, y, incy);
+     } else {
+      gemv_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     }
+    }
+   };
+
+   template<>
+   struct GemvKernel<float, simd::Isa::AVX512> {
+    NN_TARGET_AVX512
+    static void run(bool trans, size_t M, size_t K, float alpha, const float* A, size_t lda,
+      const float* x, size_t incx, float beta, float* y, size_t incy) {
+     if (trans) {
+      gemv_trans_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     } else if (incx == 1) {
+      vector_gemv_avx512<simd::VecAvx512Float>(M, K, alpha, A, lda, x, beta, y, incy);
+     } else {
+      gemv_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     }
+    }
+   };
+
+   template<>
+   struct GemvKernel<double, simd::Isa::AVX512> {
+    NN_TARGET_AVX512
+    static void run(bool trans, size_t M, size_t K, double alpha, const double* A, size_t lda,
+      const double* x, size_t incx, double beta, double* y, size_t incy) {
+     if (trans) {
+      gemv_trans_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     } else if (incx == 1) {
+      vector_gemv_avx512<simd::VecAvx512Double>(M, K, alpha, A, lda, x, beta, y, incy);
+     } else {
+      gemv_body(M, K, alpha, A, lda, x, incx, beta, y, incy);
+     }
+    }
+   };
+#endif
+
+   // Matrix-vector product reading a 16-bit A directly, where a vector kernel exists (returns false otherwise)
+   template<typename T, simd::Isa isa>
+   struct WideGemvKernel {
+    template<typename TA>
+    static bool run(size_t, size_t, T, const TA*, size_t, const T*, T, T*, size_t) {
+     return false;
+    }
+   };
+
+#if NN_X86_DISPATCH
+   template<>
+   struct WideGemvKernel<float, simd::Isa::AVX2> {
+    template<typename TA>
+    NN_TARGET_AVX2
+    static bool run(size_t M, size_t K, float alpha, const TA* A, size_t lda,
+      const float* x, float beta, float* y, size_t incy) {
+     vector_gemv_avx2<simd::VecAvx2Float>(M, K, alpha, A, lda, x, beta, y, incy);
+     return true;
+    }
+   };
+
+   template<>
+   struct WideGemvKernel<float, simd::Isa::AVX512> {
+    template<typename TA>
+    NN_TARGET_AVX512
+    static bool run(size_t M, size_t K, float alpha, const TA* A, size_t lda,
+      const float* x, float beta, float* y, size_t incy) {
+     vector_gemv_avx512<simd::VecAvx512Float>(M, K, alpha, A, lda, x, beta, y, incy);
+     return true;
+    }
+   };
+#endif
+
+   template<typename T, simd::Isa isa, typename TA, typename TB>
+   void gemm_blocked(bool trans_a, bool trans_b, size_t M, size_t N, size_t K, T alpha, const TA* A, size_t lda,
+     const TB* B, size_t ldb, T beta, T* C, size_t ldc, const Epilogue<T>& ep) {
+    using Blk = GemmBlocking<T, isa>;
+    constexpr size_t MR = Blk::MR;
+    constexpr size_t NR = Blk::NR;
+
+    PackBuffer<T>& buffer_a = pack_buffer_a<T>();
+    PackBuffer<T>& buffer_b = pack_buffer_b<T>();
+    const size_t a_size = Blk::MC * Blk::KC;
+    const size_t b_size = Blk::KC * ((std::min(Blk::NC, N) + NR - 1) / NR) * NR;
+    if (buffer_a.size() < a_size) buffer_a.resize(a_size);
+    if (buffer_b.size() < b_size) buffer_b.resize(b_size);
+    T* packed_a = buffer_a.data();
+    T* packed_b = buffer_b.data();
+
+    alignas(64) T edge[MR * NR];
+
+    for (size_t jc = 0; jc < N; jc += Blk::NC) {
+     const size_t nc = std::min(Blk::NC, N - jc);
+
+     for (size_t pc = 0; pc < K; pc += Blk::KC) {
+      const size_t kc = std::min(Blk::KC, K - pc);
+      // earlier K blocks already wrote into C, the following ones accumulate
+      const T beta_block = pc == 0 ? beta : static_cast<T>(1);
+      const bool last_block = pc + kc == K;
+
+      pack_b<T, NR>(kc, nc, B + offset(pc, jc, ldb, trans_b), ldb, trans_b, packed_b);
+
+      for (size_t ic = 0; ic < M; ic += Blk::MC) {
+       const size_t mc = std::min(Blk::MC, M - ic);
+
+       pack_a<T, MR>(mc, kc, A + offset(ic, pc, lda, trans_a), lda, trans_a, packed_a);
+
+       for (size_t jr = 0; jr < nc; jr += NR) {
+        const size_t nr = std::min(NR, nc - jr);
+        const T* b_panel = packed_b + jr * kc;
+
+        for (size_t ir = 0; ir < mc; ir += MR) {
+         const size_t mr = std::min(MR, mc - ir);
+         const T* a_panel = packed_a + ir * kc;
+         T* c = C + (ic + ir) * ldc + jc + jr;
+
+         if (mr == MR && nr == NR) {
+          MicroKernel<T, isa>::run(kc, a_panel, b_panel, c, ldc, alpha, beta_block);
+         } else {
+          // partial tile: compute the full tile aside and merge the valid part
+          MicroKernel<T, isa>::run(kc, a_panel, b_panel, edge, NR, alpha, static_cast<T>(0));
+          for (size_t i = 0; i < mr; i++) {
+           for (size_t j = 0; j < nr; j++) {
+            T& dst = c[i * ldc + j];
+            dst = beta_block == static_cast<T>(0) ? edge[i * NR + j] : edge[i * NR + j] + beta_block * dst;
+           }
+          }
+         }
+
+         if (last_block && !ep.empty()) {
+          apply_epilogue(ep.at(ic + ir, jc + jr), mr, nr, c, ldc);
+         }
+        }
+       }
+      }
+     }
+    }
+   }
+
+   // y[0..n) = x[0..n) widened to T
+   template<typename T, typename S>
+   void widen(const S* x, T* y, size_t n) {
+    if constexpr (std::is_same<S, T>::value) {
+     std::copy(x, x + n, y);
+    } else if constexpr (std::is_same<T, float>::value) {
+     to_float(x, y, n);
+    } else {
+     for (size_t i = 0; i < n; i++) {
+      y[i] = static_cast<T>(x[i]);
+     }
+    }
+   }
+
+   // Elements of a narrow A widened per pass of the matrix-vector product: 16 KB of float, stays in L1
+   constexpr size_t kGemvWidenChunk = 4096;
+
+   /*
+    * Matrix-vector product with A and/or x stored narrower than T. x is widened once. A is read
+    * as stored by the vector kernels when it is not transposed; otherwise it is widened a few
+    * stored rows at a time and each chunk goes through the regular kernel. The pack buffers are
+    * free during a matrix-vector product, so they hold the widened copies.
+   */
+   template<typename T, simd::Isa isa, typename TA, typename TB>
+   void gemv_widened(bool trans, size_t M, size_t K, T alpha, const TA* A, size_t lda,
+     const TB* x, size_t incx, T beta, T* y, size_t incy) {
+    PackBuffer<T>& x_buffer = pack_buffer_b<T>();
+    if (x_buffer.size() < K) x_buffer.resize(K);
+    T* wide_x = x_buffer.data();
+    if (incx == 1) {
+     widen(x, wide_x, K);
+    } else {
+     for (size_t p = 0; p < K; p++) {
+      wide_x[p] = static_cast<T>(x[p * incx]);
+     }
+    }
+
+    if constexpr (std::is_same<TA, T>::value) {
+     GemvKernel<T, isa>::run(trans, M, K, alpha, A, lda, wide_x, 1, beta, y, incy);
+    } else {
+     if (!trans && WideGemvKernel<T, isa>::run(M, K, alpha, A, lda, wide_x, beta, y, incy)) {
+      return;
+     }
+
+     // A is stored M x K, or K x M when transposed; the chunks are whole stored rows
+     const size_t row = trans ? M : K;
+     const size_t stored_rows = trans ? K : M;
+     const size_t chunk = std::max<size_t>(1, kGemvWidenChunk / row);
+     PackBuffer<T>& a_buffer = pack_buffer_a<T>();
+     if (a_buffer.size() < chunk * row) a_buffer.resize(chunk * row);
+     T* wide_a = a_buffer.data();
+
+     for (size_t r0 = 0; r0 < stored_rows; r0 += chunk) {
+      const size_t rows = std::min(chunk, stored_rows - r0);
+      for (size_t r = 0; r < rows; r++) {
+       widen(A + (r0 + r) * lda, wide_a + r * row, row);
+      }
+      if (trans) {
+       // each chunk adds its share of K to y
+       GemvKernel<T, isa>::run(true, M, rows, alpha, wide_a, row, wide_x + r0, 1,
+         r0 == 0 ? beta : static_cast<T>(1), y, incy);
+      } else {
+       GemvKernel<T, isa>::run(false, rows, K, alpha, wide_a, row, wide_x, 1, beta, y + r0 * incy, incy);
+      }
+     }
+    }
+   }
+
+   template<typename T, simd::Isa isa, typename TA, typename TB>
+   void gemm_dispatch(bool trans_a, bool trans_b, size_t M, size_t N, size_t K, T alpha, const TA* A, size_t lda,
+     const TB* B, size_t ldb, T beta, T* C, size_t ldc, const Epilogue<T>& ep) {
+    if (N == 1) {
+     // x is a column of op(B): a row of B when it is transposed
+     if constexpr (std::is_same<TA, T>::value && std::is_same<TB, T>::value) {
+      GemvKernel<T, isa>::run(trans_a, M, K, alpha, A, lda, B, trans_b ? 1 : ldb, beta, C, ldc);
+     } else {
+      gemv_widened<T, isa>(trans_a, M, K, alpha, A, lda, B, trans_b ? 1 : ldb, beta, C, ldc);
+     }
+     apply_epilogue(ep, M, N, C, ldc);
+    } else {
+     gemm_blocked<T, isa>(trans_a, trans_b, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, ep);
+    }
+   }
+
+   template<typename T, typename TA, typename TB>
+   void gemm_serial(bool trans_a, bool trans_b, size_t M, size_t N, size_t K, T alpha, const TA* A, size_t lda,
+     const TB* B, size_t ldb, T beta, T* C, size_t ldc, const Epilogue<T>& ep) {
+    switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+     case simd::Isa::AVX512:
+      gemm_dispatch<T, simd::Isa::AVX512>(trans_a, trans_b, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, ep);
+      break;
+     case simd::Isa::AVX2:
+      gemm_dispatch<T, simd::Isa::AVX2>(trans_a, trans_b, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, ep);
+      break;
+#endif
+     case simd::Isa::SCALAR:
+     default:
+      gemm_dispatch<T, simd::Isa::SCALAR>(trans_a, trans_b, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, ep);
+      break;
+    }
+   }
+
+   // Below this many multiply-adds a product runs on the calling thread only
+   constexpr size_t kParallelGemmFlops = 64 * 64 * 64;
+
+   /*
+    * Split C into row or column slabs, one per thread, along its larger dimension.
+    * Every thread packs its own blocks into its thread-local buffers, the shared operand is
+    * packed once per thread, which is cheap next to the product itself.
+    * Slab edges are rounded to 48 rows / 32 columns so they fall on register tile boundaries.
+   */
+   template<typename T, typename TA, typename TB>
+   void gemm_parallel(ThreadPool& pool, bool trans_a, bool trans_b, size_t M, size_t N, size_t K,
+     T alpha, const TA* A, size_t lda,
+     const TB* B, size_t ldb, T beta, T* C, size_t ldc, const Epilogue<T>& ep) {
+    const bool split_rows = M >= N;
+    const size_t extent = split_rows ? M : N;
+    const size_t unit = split_rows ? 48 : 32;
+    const size_t units = (extent + unit - 1) / unit;
+    const size_t tasks = std::min(pool.size(), units);
+    const size_t chunk = (units + tasks - 1) / tasks * unit;
+
+    pool.run(tasks, [&](size_t task) {
+     const size_t lo = task * chunk;
+     if (lo >= extent) {
+      return;
+     }
+     const size_t len = std::min(chunk, extent - lo);
+     if (split_rows) {
+      gemm_serial(trans_a, trans_b, len, N, K, alpha, A + offset(lo, 0, lda, trans_a), lda,
+        B, ldb, beta, C + lo * ldc, ldc, ep.at(lo, 0));
+     } else {
+      gemm_serial(trans_a, trans_b, M, len, K, alpha, A, lda,
+        B + offset(0, lo, ldb, trans_b), ldb, beta, C + lo, ldc, ep.at(0, lo));
+     }
+    });
+   }
+  }
+
+  /*
+   * C = alpha * op(A) * op(B) + beta * C, with op(A) M x K, op(B) K x N and C M x N (row-major).
+   * lda and ldb are the leading dimensions of A and B as stored: with Transpose::YES, A is
+   * stored K x M (B: N x K) and read in place. The epilogue, if any, runs on the finished C.
+   * TA and TB are T, or a 16-bit storage type widened to T (float) as it is read.
+  */
+  template<typename T, typename TA, typename TB>
+  void gemm(Transpose trans_a, Transpose trans_b, size_t M, size_t N, size_t K, T alpha,
+    const TA* A, size_t lda, const TB* B, size_t ldb, T beta, T* C, size_t ldc,
+    const Epilogue<T>& epilogue = Epilogue<T>()) {
+   if (M == 0 || N == 0) {
+    return;
+   }
+
+   if (K == 0 || alpha == static_cast<T>(0)) {
+    detail::scale(M, N, beta, C, ldc);
+    detail::apply_epilogue(epilogue, M, N, C, ldc);
+    return;
+   }
+
+   const bool ta = trans_a == Transpose::YES;
+   const bool tb = trans_b == Transpose::YES;
+
+   if (N > 1 && M * N * K <= detail::kSmallGemmFlops) {
+    detail::gemm_small(ta, tb, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+    detail::apply_epilogue(epilogue, M, N, C, ldc);
+    return;
+   }
+
+   if (M * N * K >= detail::kParallelGemmFlops && !ThreadPool::in_parallel_region()) {
+    ThreadPool& pool = thread_pool();
+    if (pool.size() > 1) {
+     detail::gemm_parallel(pool, ta, tb, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+     return;
+    }
+   }
+
+   detail::gemm_serial(ta, tb, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+  }
+
+  // C = alpha * A * B + beta * C (row-major, leading dimensions in elements)
+  template<typename T, typename TA, typename TB>
+  void gemm(size_t M, size_t N, size_t K, T alpha, const TA* A, size_t lda,
+    const TB* B, size_t ldb, T beta, T* C, size_t ldc) {
+   gemm(Transpose::NO, Transpose::NO, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+  }
+ }
+}
+
+#endif
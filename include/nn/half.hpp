@@ -0,0 +1,368 @@
+ /*
+  * 16-bit floating point storage
+  *
+  * bfloat16 (8 exponent bits, 7 mantissa bits: the range of float with less precision) and
+  * float16 (IEEE binary16: 5 exponent bits, 10 mantissa bits, max 65504) are storage formats only.
+  * They convert implicitly to float, and arithmetic on them happens in float: nothing here rounds
+  * an intermediate result to 16 bits. Conversions from float round to nearest even, keep NaNs
+  * (quieted) and infinities; float16 overflows to infinity and keeps subnormals.
+  *
+  * The kernels convert whole arrays at once: to_float() widens 16-bit values, from_float() narrows
+  * floats. bfloat16 is converted with integer shifts, float16 with the F16C/AVX-512F conversion
+  * instructions when available. Every instruction set gives bitwise the same result.
+  *
+  * The GEMM reads these types directly (see gemm.hpp): they are widened to float as the operands
+  * are packed, or in registers by the matrix-vector kernel (WideLoad), so products accumulate in
+  * float and only half the bytes are read from memory.
+ */
+
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "simd.hpp"
+
+namespace nn {
+
+ namespace detail {
+  inline uint32_t float_bits(float x) {
+   uint32_t bits;
+   std::memcpy(&bits, &x, sizeof(bits));
+   return bits;
+  }
+
+  inline float bits_float(uint32_t bits) {
+   float x;
+   std::memcpy(&x, &bits, sizeof(x));
+   return x;
+  }
+
+  inline uint16_t float_to_bf16_bits(float x) {
+   const uint32_t bits = float_bits(x);
+   if ((bits & 0x7fffffffu) > 0x7f800000u) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40u);  // NaN, keep it one
+   }
+   const uint32_t rounding = 0x7fffu + ((bits >> 16) & 1u);
+   return static_cast<uint16_t>((bits + rounding) >> 16);
+  }
+
+  inline float bf16_bits_to_float(uint16_t bits) {
+   return bits_float(static_cast<uint32_t>(bits) << 16);
+  }
+
+  inline uint16_t float_to_fp16_bits(float x) {
+   const uint32_t bits = float_bits(x);
+   const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+   const uint32_t magnitude = bits & 0x7fffffffu;
+
+   if (magnitude >= 0x7f800000u) {
+    // infinity, or NaN with its top mantissa bits kept and the quiet bit set
+    return magnitude == 0x7f800000u ? static_cast<uint16_t>(sign | 0x7c00u)
+      : static_cast<uint16_t>(sign | 0x7e00u | ((magnitude >> 13) & 0x3ffu));
+   }
+   if (magnitude >= 0x477ff000u) {
+    return static_cast<uint16_t>(sign | 0x7c00u);  // rounds above 65504
+   }
+   if (magnitude < 0x38800000u) {
+    // below the smallest normal: adding 0.5 makes the float unit align with the subnormal steps
+    const float shifted = bits_float(magnitude) + 0.5f;
+    return static_cast<uint16_t>(sign | (float_bits(shifted) - 0x3f000000u));
+   }
+   const uint32_t rounding = 0xfffu + ((magnitude >> 13) & 1u);
+   return static_cast<uint16_t>(sign | ((magnitude - 0x38000000u + rounding) >> 13));
+  }
+
+  inline float fp16_bits_to_float(uint16_t h) {
+   const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+   const uint32_t exponent = (h >> 10) & 0x1fu;
+   const uint32_t mantissa = h & 0x3ffu;
+
+   if (exponent == 0x1fu) {
+    return bits_float(sign | 0x7f800000u | (mantissa != 0 ? (mantissa << 13) | 0x400000u : 0u));
+   }
+   if (exponent == 0) {
+    // zero or subnormal: mantissa * 2^-24, exact in float
+    const float value = static_cast<float>(mantissa) * bits_float(0x33800000u);
+    return bits_float(sign | float_bits(value));
+   }
+   return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+  }
+ }
+
+ struct bfloat16 {
+  uint16_t bits = 0;
+
+  bfloat16() = default;
+  bfloat16(float x) : bits(detail::float_to_bf16_bits(x)) {}
+  operator float() const { return detail::bf16_bits_to_float(bits); }
+
+  static bfloat16 from_bits(uint16_t bits) {
+   bfloat16 x;
+   x.bits = bits;
+   return x;
+  }
+ };
+
+ struct float16 {
+  uint16_t bits = 0;
+
+  float16() = default;
+  float16(float x) : bits(detail::float_to_fp16_bits(x)) {}
+  operator float() const { return detail::fp16_bits_to_float(bits); }
+
+  static float16 from_bits(uint16_t bits) {
+   float16 x;
+   x.bits = bits;
+   return x;
+  }
+ };
+
+ static_assert(sizeof(bfloat16) == 2 && sizeof(float16) == 2, "16-bit types must not be padded");
+
+ namespace kernels {
+  namespace detail {
+#if NN_X86_DISPATCH
+   NN_TARGET_AVX512
+   inline void bf16_to_float_avx512(const uint16_t* x, float* y, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+     const __m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)));
+     _mm512_storeu_si512(y + i, _mm512_slli_epi32(h, 16));
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::bf16_bits_to_float(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX512
+   inline void float_to_bf16_avx512(const float* x, uint16_t* y, size_t n) {
+    const __m512i lsb = _mm512_set1_epi32(1);
+    const __m512i bias = _mm512_set1_epi32(0x7fff);
+    const __m512i quiet = _mm512_set1_epi32(0x400000);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+     const __m512 v = _mm512_loadu_ps(x + i);
+     const __m512i bits = _mm512_castps_si512(v);
+     const __m512i rounding = _mm512_add_epi32(bias, _mm512_and_si512(_mm512_srli_epi32(bits, 16), lsb));
+     const __mmask16 nan = _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q);
+     const __m512i r = _mm512_mask_or_epi32(_mm512_add_epi32(bits, rounding), nan, bits, quiet);
+     _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), _mm512_cvtepi32_epi16(_mm512_srli_epi32(r, 16)));
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::float_to_bf16_bits(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX512
+   inline void fp16_to_float_avx512(const uint16_t* x, float* y, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+     _mm512_storeu_ps(y + i, _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i))));
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::fp16_bits_to_float(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX512
+   inline void float_to_fp16_avx512(const float* x, uint16_t* y, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+     const __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(x + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+     _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), h);
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::float_to_fp16_bits(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX2
+   inline void bf16_to_float_avx2(const uint16_t* x, float* y, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+     const __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)));
+     _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), _mm256_slli_epi32(h, 16));
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::bf16_bits_to_float(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX2
+   inline void float_to_bf16_avx2(const float* x, uint16_t* y, size_t n) {
+    const __m256i lsb = _mm256_set1_epi32(1);
+    const __m256i bias = _mm256_set1_epi32(0x7fff);
+    const __m256i quiet = _mm256_set1_epi32(0x400000);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+     const __m256 v = _mm256_loadu_ps(x + i);
+     const __m256i bits = _mm256_castps_si256(v);
+     const __m256i rounding = _mm256_add_epi32(bias, _mm256_and_si256(_mm256_srli_epi32(bits, 16), lsb));
+     const __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+     const __m256i rounded = _mm256_add_epi32(bits, rounding);
+     const __m256i r = _mm256_srli_epi32(_mm256_blendv_epi8(rounded, _mm256_or_si256(bits, quiet), nan), 16);
+     // packus works per 128-bit lane: the two halves end up in the low quadwords of each lane
+     const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(r, r), 0x08);
+     _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), _mm256_castsi256_si128(packed));
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::float_to_bf16_bits(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX2
+   inline void fp16_to_float_avx2(const uint16_t* x, float* y, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+     _mm256_storeu_ps(y + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i))));
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::fp16_bits_to_float(x[i]);
+    }
+   }
+
+   NN_TARGET_AVX2
+   inline void float_to_fp16_avx2(const float* x, uint16_t* y, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+     const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(x + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+     _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), h);
+    }
+    for (; i < n; i++) {
+     y[i] = nn::detail::float_to_fp16_bits(x[i]);
+    }
+   }
+
+   /*
+    * One vector of floats loaded from 16-bit storage, for kernels that widen their operands in
+    * registers: WideLoad<V, S>::load(p) is V::load for an array of S.
+   */
+   template<typename V, typename S>
+   struct WideLoad;
+
+   template<>
+   struct WideLoad<simd::VecAvx2Float, bfloat16> {
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE __m256 load(const bfloat16* p) {
+     const __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+     return _mm256_castsi256_ps(_mm256_slli_epi32(h, 16));
+    }
+   };
+
+   template<>
+   struct WideLoad<simd::VecAvx2Float, float16> {
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE __m256 load(const float16* p) {
+     return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+   };
+
+   template<>
+   struct WideLoad<simd::VecAvx512Float, bfloat16> {
+    NN_TARGET_AVX512 static NN_ALWAYS_INLINE __m512 load(const bfloat16* p) {
+     const __m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+     return _mm512_castsi512_ps(_mm512_slli_epi32(h, 16));
+    }
+   };
+
+   template<>
+   struct WideLoad<simd::VecAvx512Float, float16> {
+    NN_TARGET_AVX512 static NN_ALWAYS_INLINE __m512 load(const float16* p) {
+     return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+   };
+#endif
+  }
+
+  inline void to_float(const bfloat16* x, float* y, size_t n) {
+   const uint16_t* bits = reinterpret_cast<const uint16_t*>(x);
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     detail::bf16_to_float_avx512(bits, y, n);
+     return;
+    case simd::Isa::AVX2:
+     detail::bf16_to_float_avx2(bits, y, n);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     for (size_t i = 0; i < n; i++) {
+      y[i] = nn::detail::bf16_bits_to_float(bits[i]);
+     }
+     return;
+   }
+  }
+
+  inline void from_float(const float* x, bfloat16* y, size_t n) {
+   uint16_t* bits = reinterpret_cast<uint16_t*>(y);
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     detail::float_to_bf16_avx512(x, bits, n);
+     return;
+    case simd::Isa::AVX2:
+     detail::float_to_bf16_avx2(x, bits, n);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     for (size_t i = 0; i < n; i++) {
+      bits[i] = nn::detail::float_to_bf16_bits(x[i]);
+     }
+     return;
+   }
+  }
+
+  inline void to_float(const float16* x, float* y, size_t n) {
+   const uint16_t* bits = reinterpret_cast<const uint16_t*>(x);
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     detail::fp16_to_float_avx512(bits, y, n);
+     return;
+    case simd::Isa::AVX2:
+     detail::fp16_to_float_avx2(bits, y, n);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     for (size_t i = 0; i < n; i++) {
+      y[i] = nn::detail::fp16_bits_to_float(bits[i]);
+     }
+     return;
+   }
+  }
+
+  inline void from_float(const float* x, float16* y, size_t n) {
+   uint16_t* bits = reinterpret_cast<uint16_t*>(y);
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     detail::float_to_fp16_avx512(x, bits, n);
+     return;
+    case simd::Isa::AVX2:
+     detail::float_to_fp16_avx2(x, bits, n);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     for (size_t i = 0; i < n; i++) {
+      bits[i] = nn::detail::float_to_fp16_bits(x[i]);
+     }
+     return;
+   }
+  }
+
+  // Plain copies, so code templated on the storage type can convert unconditionally
+  inline void to_float(const float* x, float* y, size_t n) {
+   std::memcpy(y, x, n * sizeof(float));
+  }
+
+  inline void from_float(const float* x, float* y, size_t n) {
+   std::memcpy(y, x, n * sizeof(float));
+  }
+ }
+}
+
+#endif
@@ -0,0 +1,155 @@
+ /*
+  * IDX files
+  *
+  * The IDX format (used by MNIST) is a big-endian header followed by the raw elements:
+  *   - 2 bytes: zero
+  *   - 1 byte:  element type (0x08 = unsigned byte, the only type supported here)
+  *   - 1 byte:  number of dimensions d
+  *   - d x 4 bytes: size of each dimension
+  *   - the elements, row-major
+  *
+  * IdxFile maps the whole file read-only and validates the header and the file size once.
+  * The first dimension indexes the samples, sample(i) is a pointer into the mapping, so no
+  * element is copied until it is converted. to_float() converts a run of consecutive samples
+  * into a float buffer in one pass (AVX2/AVX-512 when available), scaling the bytes on the way.
+ */
+
+#ifndef IDX_H
+#define IDX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+#include "simd.hpp"
+
+namespace nn {
+
+ namespace kernels {
+  namespace detail {
+#if NN_X86_DISPATCH
+   NN_TARGET_AVX512
+   inline void u8_to_float_avx512(const uint8_t* x, float* y, size_t n, float scale) {
+    const __m512 s = _mm512_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+     const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+     _mm512_storeu_ps(y + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(bytes)), s));
+    }
+    for (; i < n; i++) {
+     y[i] = static_cast<float>(x[i]) * scale;
+    }
+   }
+
+   NN_TARGET_AVX2
+   inline void u8_to_float_avx2(const uint8_t* x, float* y, size_t n, float scale) {
+    const __m256 s = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+     const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i));
+     _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), s));
+    }
+    for (; i < n; i++) {
+     y[i] = static_cast<float>(x[i]) * scale;
+    }
+   }
+#endif
+  }
+
+  // y[i] = x[i] * scale for n bytes, the same value on every instruction set
+  inline void u8_to_float(const uint8_t* x, float* y, size_t n, float scale) {
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     detail::u8_to_float_avx512(x, y, n, scale);
+     return;
+    case simd::Isa::AVX2:
+     detail::u8_to_float_avx2(x, y, n, scale);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     for (size_t i = 0; i < n; i++) {
+      y[i] = static_cast<float>(x[i]) * scale;
+     }
+     return;
+   }
+  }
+ }
+
+ class IdxFile {
+  public:
+   static constexpr uint8_t kUnsignedByte = 0x08;
+
+   explicit IdxFile(const std::string& filename) : file_(filename) {
+    const uint8_t* bytes = file_.data();
+    if (file_.size() < 4 || bytes[0] != 0 || bytes[1] != 0) {
+     throw std::runtime_error("invalid IDX file: " + filename);
+    }
+    if (bytes[2] != kUnsignedByte) {
+     throw std::runtime_error("unsupported IDX element type in: " + filename);
+    }
+
+    const size_t num_dims = bytes[3];
+    const size_t header = 4 + 4 * num_dims;
+    if (num_dims == 0 || file_.size() < header) {
+     throw std::runtime_error("truncated IDX header: " + filename);
+    }
+
+    // Checked before each product: a few 32-bit dimensions can wrap size_t to a small count
+    const size_t available = file_.size() - header;
+    size_t elements = 1;
+    for (size_t d = 0; d < num_dims; d++) {
+     const size_t dim = read_big_endian(bytes + 4 + 4 * d);
+     dims_.push_back(dim);
+     if (dim != 0 && elements > available / dim) {
+      throw std::runtime_error("truncated IDX data: " + filename);
+     }
+     elements *= dim;
+    }
+
+    magic_ = read_big_endian(bytes);
+    data_ = bytes + header;
+    sample_size_ = dims_[0] == 0 ? 0 : elements / dims_[0];
+   }
+
+   // The leading 4 bytes as one big-endian number (0x803 for MNIST images, 0x801 for labels)
+   uint32_t magic() const { return magic_; }
+   const std::vector<size_t>& dims() const { return dims_; }
+
+   // Samples along the first dimension, each the product of the other dimensions long
+   size_t count() const { return dims_[0]; }
+   size_t sample_size() const { return sample_size_; }
+
+   const uint8_t* data() const { return data_; }
+   const uint8_t* sample(size_t i) const {
+    if (i >= count()) {
+     throw std::out_of_range(std::string(__func__) + ": sample index out of range");
+    }
+    return data_ + i * sample_size_;
+   }
+
+   // Convert count consecutive samples starting at first into out (count * sample_size() floats)
+   void to_float(size_t first, size_t count, float* out, float scale = 1.0f / 255.0f) const {
+    if (first > this->count() || count > this->count() - first) {
+     throw std::out_of_range(std::string(__func__) + ": sample range out of range");
+    }
+    kernels::u8_to_float(data_ + first * sample_size_, out, count * sample_size_, scale);
+   }
+
+  private:
+   MappedFile file_;
+   std::vector<size_t> dims_;
+   uint32_t magic_ = 0;
+   const uint8_t* data_ = nullptr;
+   size_t sample_size_ = 0;
+
+   static uint32_t read_big_endian(const uint8_t* buf) {
+    return (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 | (uint32_t)buf[2] << 8 | (uint32_t)buf[3];
+   }
+ };
+}
+
+#endif
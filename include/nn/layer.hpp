@@ -1,11 +1,18 @@
 #ifndef LAYER_H
 #define LAYER_H
 
+#include <algorithm>
 #include <cmath>
+#include <memory>
 #include <random>
+#include <type_traits>
 #include "matrix.hpp"
 #include "activation.hpp"
+#include "half.hpp"
 #include "optimizer.hpp"
+#include "parameters.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
 
 namespace nn {
 
@@ -21,14 +28,58 @@ namespace nn {
  class LayerBase {
   public:
    virtual ~LayerBase() = default;
-   virtual Matrix<T> forward(const Matrix<T>& input) = 0;
-   virtual Matrix<T> backward(const Matrix<T>& gradient) = 0;
+   // The returned matrices are owned by the layer and overwritten by the next call
+   virtual const Matrix<T>& forward(const Matrix<T>& input) = 0;
+   virtual const Matrix<T>& backward(const Matrix<T>& gradient) = 0;
+   // Inference only: no state kept for backward, the result is written into output
+   virtual void infer(const Matrix<T>& input, Matrix<T>& output) const = 0;
+   // The same over views (see matrix_view.hpp); forward does not copy its input, backward reads it in place
+   virtual const Matrix<T>& forward(MatrixView<const T> input) = 0;
+   virtual const Matrix<T>& backward(MatrixView<const T> gradient) = 0;
+   virtual void infer(MatrixView<const T> input, Matrix<T>& output) const = 0;
    virtual void set_optimizer(Optimizer<T>* optimizer) = 0;
+
+   // Topology and parameters, for checkpoints
+   virtual size_t input_size() const = 0;
+   virtual size_t output_size() const = 0;
+   virtual kernels::ActivationKind activation() const = 0;
+   virtual const Matrix<T>& weights() const = 0;
+   virtual const Matrix<T>& bias() const = 0;
+   virtual void set_weights(Matrix<T> weights) = 0;
+   virtual void set_bias(Matrix<T> bias) = 0;
+   virtual Optimizer<T>* optimizer() const = 0;
+
+   /*
+    * Move the parameters and gradients into slot index of a network-wide arena (see
+    * parameters.hpp). From then on the layer no longer updates itself: the owner of the arena runs
+    * the optimizer over all layers at once and calls parameters_updated() afterwards.
+    */
+   virtual void bind_parameters(std::shared_ptr<ParameterArena<T>> arena, size_t index) = 0;
+   virtual void parameters_updated() {}
+
+   // A copy with its own parameters and workspaces and no optimizer, e.g. a data-parallel replica
+   virtual std::unique_ptr<LayerBase<T>> clone() const = 0;
  };
 
- template<typename T, template<typename> class Activation>
+ /*
+  * Storage is the type the products read the weights and the saved input in. With a 16-bit
+  * Storage (bfloat16 or float16, T = float) the layer trains in mixed precision:
+  * - weights_ stays the float master copy the optimizer updates, and a Storage copy of it is
+  *   refreshed after every step; forward, backward and infer multiply with that copy
+  * - the input saved for backward is kept as Storage
+  * - the GEMM widens both to float as it reads them, so sums, gradients, bias and activations
+  *   stay in float
+  * The weight and input traffic of the products is halved, at the precision of the 16-bit type.
+ */
+ template<typename T, template<typename> class Activation, typename Storage = T>
  class Layer : public LayerBase<T> {
+  static_assert(std::is_same<Storage, T>::value
+    || (std::is_same<T, float>::value && (std::is_same<Storage, bfloat16>::value || std::is_same<Storage, float16>::value)),
+    "Storage must be T, or bfloat16/float16 for a float layer");
+
   private:
+   static constexpr bool kNarrow = !std::is_same<Storage, T>::value;
+
    Matrix<T> weights_;
    Matrix<T> bias_;
    size_t input_size_;
@@ -36,11 +87,66 @@ namespace nn {
    T learning_rate_;
    std::mt19937 gen_;
 
-   Matrix<T> last_input_;       // Store input for backward pass
+   Matrix<Storage> stored_weights_ = Matrix<Storage>(0, 0);  // narrow copy of weights_ (kNarrow only)
+
+   Matrix<Storage> last_input_; // Store input for backward pass
+   // The input of a forward call on a view, read in place by backward instead of last_input_
+   MatrixView<const Storage> borrowed_input_;
+   bool input_borrowed_ = false;
    Matrix<T> last_z_;           // Store weighted sum (before activation)
    Matrix<T> last_activation_;  // Store output after activation
-   
+
+   // Backward pass workspaces, sized for one sample at construction and grown with the batch size
+   Matrix<T> delta_;
+   Matrix<T> weight_gradients_;
+   Matrix<T> bias_gradients_;
+   Matrix<T> input_gradients_;
+
    Optimizer<T>* optimizer_ = nullptr;
+   std::shared_ptr<ParameterArena<T>> arena_;  // set once bound, keeps the borrowed storage alive
+
+#ifdef NN_PROFILE
+   // Rows of the layer in the profile (see profiler.hpp), e.g. "Layer 784x128 forward"
+   const char* profile_label(const char* pass) const {
+    return profile::profiler().label("Layer " + std::to_string(input_size_) + "x" + std::to_string(output_size_) + " " + pass);
+   }
+   const char* forward_label_ = profile_label("forward");
+   const char* backward_label_ = profile_label("backward");
+   const char* infer_label_ = profile_label("infer");
+#endif
+
+   // Activation loops below this many elements stay on the calling thread
+   static constexpr size_t kParallelGrain = 1 << 14;
+
+   static size_t rows_per_task(size_t batch_size) {
+    return std::max<size_t>(1, kParallelGrain / std::max<size_t>(1, batch_size));
+   }
+
+   // GEMM epilogue: z += bias (broadcast over the batch columns), out = activation(z), out may be z
+   nn::kernels::Epilogue<T> bias_and_activation(T* out, size_t ldo) const {
+    nn::kernels::Epilogue<T> epilogue;
+    epilogue.bias = bias_.data();
+    epilogue.activate = [](const T* x, T* y, size_t n) { Activation<T>::forward(x, y, n); };
+    epilogue.out = out;
+    epilogue.ldo = ldo;
+    return epilogue;
+   }
+
+   // The weights as the products read them
+   const Storage* stored_weights() const {
+    if constexpr (kNarrow) {
+     return stored_weights_.data();
+    } else {
+     return weights_.data();
+    }
+   }
+
+   void refresh_stored_weights() {
+    if constexpr (kNarrow) {
+     stored_weights_.resize(weights_.rows(), weights_.columns());
+     kernels::from_float(weights_.data(), stored_weights_.data(), weights_.rows() * weights_.columns());
+    }
+   }
 
    void initialize_weights(InitializationType type) {
     switch(type) {
@@ -117,7 +223,11 @@ namespace nn {
       learning_rate_(learning_rate),
       last_input_(input_size, 1),
       last_z_(output_size, 1),
-      last_activation_(output_size, 1)
+      last_activation_(output_size, 1),
+      delta_(output_size, 1),
+      weight_gradients_(output_size, input_size),
+      bias_gradients_(output_size, 1),
+      input_gradients_(input_size, 1)
    {
     /*
      * Default: Glorot or Xavier uniform initialization
@@ -134,58 +244,223 @@ namespace nn {
     gen_ = std::mt19937(rd());
 
     initialize_weights(init_type);
+    refresh_stored_weights();
    }
    
    void set_optimizer(Optimizer<T>* optimizer) override {
+    if (arena_ && optimizer) {
+     throw std::invalid_argument(std::string(__func__) + ": the layer is updated by its network's optimizer");
+    }
     optimizer_ = optimizer;
    }
 
-   // For testing
-   void set_weights(Matrix<T> weights) {
+   void bind_parameters(std::shared_ptr<ParameterArena<T>> arena, size_t index) override {
+    if (optimizer_) {
+     throw std::invalid_argument(std::string(__func__) + ": the layer already has its own optimizer");
+    }
+    // each borrowed matrix takes the current values, then replaces the layer's own one
+    Matrix<T> weights = arena->weights(index);
+    Matrix<T> bias = arena->bias(index);
+    Matrix<T> weight_gradients = arena->weight_gradients(index);
+    Matrix<T> bias_gradients = arena->bias_gradients(index);
+    weights = weights_;
+    bias = bias_;
+    weights_.swap(weights);
+    bias_.swap(bias);
+    weight_gradients_.swap(weight_gradients);
+    bias_gradients_.swap(bias_gradients);
+    arena_ = std::move(arena);
+   }
+
+   void parameters_updated() override {
+    refresh_stored_weights();
+   }
+
+   std::unique_ptr<LayerBase<T>> clone() const override {
+    // copying a borrowed matrix gives an owning one, so the copy is independent of any arena
+    auto copy = std::make_unique<Layer>(*this);
+    copy->optimizer_ = nullptr;
+    copy->arena_.reset();
+    return copy;
+   }
+
+   Optimizer<T>* optimizer() const override { return optimizer_; }
+
+   // For testing and checkpoints
+   void set_weights(Matrix<T> weights) override {
+    if (weights.rows() != output_size_ || weights.columns() != input_size_) {
+     throw std::invalid_argument(std::string(__func__) + ": the weights must be output_size x input_size");
+    }
     weights_ = weights;
+    refresh_stored_weights();
    }
     
-   // For testing
-   void set_bias(Matrix<T> bias) {
+   // For testing and checkpoints
+   void set_bias(Matrix<T> bias) override {
+    if (bias.rows() != output_size_ || bias.columns() != 1) {
+     throw std::invalid_argument(std::string(__func__) + ": the bias must be output_size x 1");
+    }
     bias_ = bias;
    }
 
-   const Matrix<T>& weights() const { return weights_; }
-   const Matrix<T>& bias() const { return bias_; }
+   const Matrix<T>& weights() const override { return weights_; }
+   const Matrix<T>& bias() const override { return bias_; }
+
+   size_t input_size() const override { return input_size_; }
+   size_t output_size() const override { return output_size_; }
+   kernels::ActivationKind activation() const override { return Activation<T>::kind; }
+
+   /*
+    * Forward pass over a batch: input is (input_size x N), one sample per column.
+    * The bias is broadcast across the columns. The result is the layer's last_activation_,
+    * valid until the next forward call.
+    * The input is copied for backward, the caller's matrix may be gone by then.
+    */
+   const Matrix<T>& forward(const Matrix<T>& input) override { return forward_pass(input, false); }
 
-   Matrix<T> forward(const Matrix<T>& input) override {
-    if (input.columns() != 1 || input.rows() != input_size_) {
+   /*
+    * The same over a view, e.g. a batch that is a column range of a (features x samples) buffer.
+    * The input is not copied: backward reads it in place, so the viewed values must stay alive and
+    * unchanged until then (a layer with a 16-bit Storage still keeps a narrow copy).
+    */
+   const Matrix<T>& forward(MatrixView<const T> input) override { return forward_pass(input, true); }
+
+   /*
+    * Same result as forward, without touching last_input_/last_z_/last_activation_:
+    * the pre-activation is computed directly in output and activated in place.
+    * Being const, it can serve several threads at once as long as no one trains the layer.
+    */
+   void infer(const Matrix<T>& input, Matrix<T>& output) const override { infer(input.view(), output); }
+
+   void infer(MatrixView<const T> input, Matrix<T>& output) const override {
+    if (input.columns() == 0 || input.rows() != input_size_) {
      throw std::invalid_argument("input dimensions do not match layer input size");
     }
 
-    last_input_ = input;
-    last_z_ = weights_ * input + bias_;
-
-    Matrix<T> output(output_size_, 1);
-    for (size_t i = 0; i < output_size_; i++) {
-     output.at(i, 0) = Activation<T>::forward(last_z_.at(i, 0));
+    // the product writes output while it reads input, and resizing output may free it
+    if (output.shares_storage(input)) {
+     throw std::invalid_argument(std::string(__func__) + ": output cannot alias the input");
     }
 
-    last_activation_ = output;
+    const size_t batch_size = input.columns();
+    NN_PROFILE_SCOPE(infer_label_, "layer", 2.0 * output_size_ * input_size_ * batch_size,
+      static_cast<double>(sizeof(Storage)) * output_size_ * input_size_
+      + static_cast<double>(sizeof(T)) * (input_size_ + output_size_) * batch_size);
+    output.resize(output_size_, batch_size);
+    nn::kernels::gemm(nn::kernels::Transpose::NO, nn::kernels::Transpose::NO, output_size_, batch_size, input_size_,
+      static_cast<T>(1), stored_weights(), input_size_, input.data(), input.stride(),
+      static_cast<T>(0), output.data(), output.stride(), bias_and_activation(output.data(), output.stride()));
+   }
 
-    return output;
+   /*
+    * Backward pass over the batch of the last forward call.
+    * Weight and bias gradients are averaged over the batch, so the optimizer takes a single step.
+    * Every intermediate lives in a layer workspace, so once they are sized for the batch a
+    * backward pass does not allocate. The result is valid until the next backward call.
+    */
+   const Matrix<T>& backward(const Matrix<T>& gradient_from_next_layer) override {
+    return backward(gradient_from_next_layer.view());
    }
 
-   Matrix<T> backward(const Matrix<T>& gradient_from_next_layer) override {
-    Matrix<T> activation_gradient(output_size_, 1);
-    for (size_t i = 0; i < output_size_; i++) {
-     activation_gradient.at(i, 0) = Activation<T>::backward(last_z_.at(i, 0));
+   const Matrix<T>& backward(MatrixView<const T> gradient_from_next_layer) override {
+    const size_t batch_size = last_z_.columns();
+    if (gradient_from_next_layer.rows() != output_size_ || gradient_from_next_layer.columns() != batch_size) {
+     throw std::invalid_argument("gradient dimensions do not match layer output");
     }
+    // the two products, the weight and input gradients written once
+    NN_PROFILE_SCOPE(backward_label_, "layer", 4.0 * output_size_ * input_size_ * batch_size,
+      static_cast<double>(sizeof(Storage)) * (output_size_ * input_size_ + input_size_ * batch_size)
+      + static_cast<double>(sizeof(T)) * (output_size_ * input_size_ + input_size_ * batch_size + 3 * output_size_ * batch_size));
 
-    Matrix<T> delta = gradient_from_next_layer.hadamard(activation_gradient);
-    Matrix<T> weight_gradients = delta * last_input_.transpose();
-    Matrix<T> input_gradients = weights_.transpose() * delta;
+    // delta = gradient * activation'(z), in one pass
+    delta_.resize(output_size_, batch_size);
+    const T* z = last_z_.data();
+    const T* gradient = gradient_from_next_layer.data();
+    T* d = delta_.data();
+    if (gradient_from_next_layer.is_contiguous()) {
+     nn::parallel_for(0, output_size_ * batch_size, kParallelGrain, [=](size_t lo, size_t hi) {
+      Activation<T>::backward(z + lo, gradient + lo, d + lo, hi - lo);
+     });
+    } else {
+     const size_t stride = gradient_from_next_layer.stride();
+     nn::parallel_for(0, output_size_, rows_per_task(batch_size), [=](size_t lo, size_t hi) {
+      for (size_t i = lo; i < hi; i++) {
+       Activation<T>::backward(z + i * batch_size, gradient + i * stride, d + i * batch_size, batch_size);
+      }
+     });
+    }
+
+    // averaging over the batch is folded into the products
+    const T scale = static_cast<T>(1) / static_cast<T>(batch_size);
+    using nn::kernels::Transpose;
+
+    // dW = delta * input^T / N, dX = W^T * delta, both read the transposed operand in place
+    const MatrixView<const Storage> input = input_borrowed_ ? borrowed_input_ : last_input_.view();
+    weight_gradients_.resize(output_size_, input_size_);
+    input_gradients_.resize(input_size_, batch_size);
+    nn::kernels::gemm(Transpose::NO, Transpose::YES, output_size_, input_size_, batch_size,
+      scale, d, batch_size, input.data(), input.stride(),
+      static_cast<T>(0), weight_gradients_.data(), input_size_);
+    nn::kernels::gemm(Transpose::YES, Transpose::NO, input_size_, batch_size, output_size_,
+      static_cast<T>(1), stored_weights(), input_size_, d, batch_size,
+      static_cast<T>(0), input_gradients_.data(), batch_size);
+
+    T* bias_grad = bias_gradients_.data();
+    nn::parallel_for(0, output_size_, rows_per_task(batch_size), [=](size_t lo, size_t hi) {
+     for (size_t i = lo; i < hi; i++) {
+      T sum = 0;
+      for (size_t j = 0; j < batch_size; j++) {
+       sum += d[i * batch_size + j];
+      }
+      bias_grad[i] = sum * scale;
+     }
+    });
 
     if (optimizer_) {
-     optimizer_->update(weights_, bias_, weight_gradients, delta);
+     optimizer_->update(weights_, bias_, weight_gradients_, bias_gradients_);
+     refresh_stored_weights();
     }
 
-    return input_gradients;
+    return input_gradients_;
+   }
+
+  private:
+   // borrow: keep reading the caller's input in backward instead of a copy
+   const Matrix<T>& forward_pass(MatrixView<const T> input, bool borrow) {
+    if (input.columns() == 0 || input.rows() != input_size_) {
+     throw std::invalid_argument("input dimensions do not match layer input size");
+    }
+
+    const size_t batch_size = input.columns();
+    NN_PROFILE_SCOPE(forward_label_, "layer", 2.0 * output_size_ * input_size_ * batch_size,
+      static_cast<double>(sizeof(Storage)) * (output_size_ * input_size_ + input_size_ * batch_size)
+      + static_cast<double>(sizeof(T)) * (input_size_ * batch_size + 2 * output_size_ * batch_size));
+    if constexpr (kNarrow) {
+     last_input_.resize(input_size_, batch_size);
+     if (input.is_contiguous()) {
+      kernels::from_float(input.data(), last_input_.data(), input_size_ * batch_size);
+     } else {
+      for (size_t i = 0; i < input_size_; i++) {
+       kernels::from_float(input.data() + i * input.stride(), last_input_.data() + i * batch_size, batch_size);
+      }
+     }
+     input_borrowed_ = false;
+    } else if (borrow) {
+     borrowed_input_ = input;
+     input_borrowed_ = true;
+    } else {
+     last_input_.assign(input);
+     input_borrowed_ = false;
+    }
+
+    // bias and activation are applied to each tile of the product as it is finished
+    last_activation_.resize(output_size_, batch_size);
+    last_z_.resize(output_size_, batch_size);
+    nn::kernels::gemm(nn::kernels::Transpose::NO, nn::kernels::Transpose::NO, output_size_, batch_size, input_size_,
+      static_cast<T>(1), stored_weights(), input_size_, input.data(), input.stride(),
+      static_cast<T>(0), last_z_.data(), batch_size, bias_and_activation(last_activation_.data(), batch_size));
+
+    return last_activation_;
    }
  };
 }
@@ -0,0 +1,210 @@
+ /*
+  * Loss functions
+  *
+  * A loss compares the network output (outputs x N, one sample per column) with the targets of
+  * the batch, given either as target columns (outputs x N) or as one class index per sample.
+  * evaluate() returns the loss averaged over the samples and writes, in the same pass, the
+  * gradient of each sample's loss with respect to the output. The gradient is not divided by N:
+  * the layers average their parameter gradients over the batch.
+  *
+  * MeanSquaredError
+  * Loss: mean over all outputs and samples of (y - t)^2
+  * Gradient: y - t (the constant factor 2 / outputs is left to the learning rate)
+  * Use cases: regression, and the default of Network
+  *
+  * SoftmaxCrossEntropy
+  * The output layer gives logits z (use activations::Identity), the loss applies the softmax:
+  * Loss: -sum_c t_c log softmax(z)_c = logsumexp(z) - z_label for a class index
+  * Gradient: softmax(z) - t, computed directly from the softmax without differentiating
+  *           through it, which is both cheaper and numerically stable
+  * Use cases: classification; the gradient does not vanish when the output saturates, unlike a
+  *            Sigmoid output with MSE, so training reaches a given accuracy in fewer epochs.
+  * Target columns are distributions (one-hot or soft labels, each column summing to 1).
+ */
+
+#ifndef LOSS_H
+#define LOSS_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "loss_kernels.hpp"
+#include "matrix.hpp"
+
+namespace nn {
+
+ template<typename T>
+ class Loss {
+  public:
+   virtual ~Loss() = default;
+
+   // Mean loss over the samples, gradient (resized to the output shape) with respect to the output
+   virtual T evaluate(const Matrix<T>& output, const Matrix<T>& target, Matrix<T>& gradient) = 0;
+   // Same with labels[j] the class of sample j (labels has output.columns() entries)
+   virtual T evaluate(const Matrix<T>& output, const uint32_t* labels, Matrix<T>& gradient) = 0;
+
+   // Mean loss alone
+   virtual T loss(const Matrix<T>& output, const Matrix<T>& target) = 0;
+
+   virtual const char* name() const = 0;
+
+   // A fresh instance with its own workspaces, e.g. for a data-parallel replica
+   virtual std::unique_ptr<Loss<T>> clone() const = 0;
+
+  protected:
+   static void check_shapes(const Matrix<T>& output, const Matrix<T>& target) {
+    if (output.rows() != target.rows() || output.columns() != target.columns()) {
+     throw std::invalid_argument("output and target dimensions do not match");
+    }
+    if (!output.is_contiguous() || !target.is_contiguous()) {
+     throw std::invalid_argument("output and target must be contiguous (not Matrix::padded)");
+    }
+   }
+
+   static void check_labels(const Matrix<T>& output, const uint32_t* labels) {
+    if (!output.is_contiguous()) {
+     throw std::invalid_argument("output must be contiguous (not Matrix::padded)");
+    }
+    for (size_t j = 0; j < output.columns(); j++) {
+     if (labels[j] >= output.rows()) {
+      throw std::out_of_range("class index out of range of the output");
+     }
+    }
+   }
+
+   // The gradient is written as one array of the output shape, so it cannot be padded either
+   static void resize_gradient(const Matrix<T>& output, Matrix<T>& gradient) {
+    gradient.resize(output.rows(), output.columns());
+    if (!gradient.is_contiguous()) {
+     throw std::invalid_argument("gradient must be contiguous (not Matrix::padded)");
+    }
+   }
+ };
+
+ template<typename T>
+ class MeanSquaredError : public Loss<T> {
+  public:
+   T evaluate(const Matrix<T>& output, const Matrix<T>& target, Matrix<T>& gradient) override {
+    this->check_shapes(output, target);
+    this->resize_gradient(output, gradient);
+    output.subtract_into(target, gradient);
+    return mean_square(gradient);
+   }
+
+   T evaluate(const Matrix<T>& output, const uint32_t* labels, Matrix<T>& gradient) override {
+    this->check_labels(output, labels);
+    this->resize_gradient(output, gradient);
+    const size_t n = output.columns();
+    gradient = output;
+    for (size_t j = 0; j < n; j++) {
+     gradient.data()[labels[j] * n + j] -= static_cast<T>(1);
+    }
+    return mean_square(gradient);
+   }
+
+   T loss(const Matrix<T>& output, const Matrix<T>& target) override {
+    this->check_shapes(output, target);
+    T sum_squared_error = 0;
+    const T* y = output.data();
+    const T* t = target.data();
+    for (size_t k = 0; k < output.rows() * output.columns(); k++) {
+     const T error = y[k] - t[k];
+     sum_squared_error += error * error;
+    }
+    return sum_squared_error / (output.rows() * output.columns());
+   }
+
+   const char* name() const override { return "mse"; }
+
+   std::unique_ptr<Loss<T>> clone() const override { return std::make_unique<MeanSquaredError<T>>(); }
+
+  private:
+   static T mean_square(const Matrix<T>& error) {
+    T sum = 0;
+    const T* e = error.data();
+    for (size_t k = 0; k < error.rows() * error.columns(); k++) {
+     sum += e[k] * e[k];
+    }
+    return sum / (error.rows() * error.columns());
+   }
+ };
+
+ template<typename T>
+ class SoftmaxCrossEntropy : public Loss<T> {
+  public:
+   T evaluate(const Matrix<T>& output, const Matrix<T>& target, Matrix<T>& gradient) override {
+    this->check_shapes(output, target);
+    softmax(output, gradient);
+
+    // loss_j = sum_c t_cj (lse_j - z_cj), gradient = softmax - t
+    const size_t rows = output.rows(), n = output.columns();
+    const T* z = output.data();
+    const T* t = target.data();
+    T* g = gradient.data();
+    T total = 0;
+    for (size_t c = 0; c < rows; c++) {
+     for (size_t j = 0; j < n; j++) {
+      const size_t k = c * n + j;
+      if (t[k] != static_cast<T>(0)) {
+       total += t[k] * (log_sum_exp_[j] - z[k]);
+      }
+      g[k] -= t[k];
+     }
+    }
+    return total / static_cast<T>(n);
+   }
+
+   T evaluate(const Matrix<T>& output, const uint32_t* labels, Matrix<T>& gradient) override {
+    this->check_labels(output, labels);
+    softmax(output, gradient);
+
+    // only the label entry of each column differs from the softmax
+    const size_t n = output.columns();
+    const T* z = output.data();
+    T* g = gradient.data();
+    T total = 0;
+    for (size_t j = 0; j < n; j++) {
+     const size_t k = labels[j] * n + j;
+     total += log_sum_exp_[j] - z[k];
+     g[k] -= static_cast<T>(1);
+    }
+    return total / static_cast<T>(n);
+   }
+
+   T loss(const Matrix<T>& output, const Matrix<T>& target) override {
+    return evaluate(output, target, probabilities_);
+   }
+
+   const char* name() const override { return "softmax_cross_entropy"; }
+
+   std::unique_ptr<Loss<T>> clone() const override { return std::make_unique<SoftmaxCrossEntropy<T>>(); }
+
+   // The class probabilities of logits (outputs x N), e.g. of Network::predict
+   static void probabilities(const Matrix<T>& logits, Matrix<T>& result) {
+    std::vector<T> log_sum_exp(logits.columns());
+    result.resize(logits.rows(), logits.columns());
+    if (!logits.is_contiguous() || !result.is_contiguous()) {
+     throw std::invalid_argument("logits and result must be contiguous (not Matrix::padded)");
+    }
+    kernels::softmax_columns(logits.data(), result.data(), log_sum_exp.data(), logits.rows(), logits.columns());
+   }
+
+  private:
+   // Workspaces reused between calls, so a training step does not allocate once they are sized
+   std::vector<T> log_sum_exp_;
+   Matrix<T> probabilities_ = Matrix<T>(0, 0);
+
+   void softmax(const Matrix<T>& output, Matrix<T>& result) {
+    if (&result == &output) {
+     throw std::invalid_argument(std::string(__func__) + ": gradient cannot alias the output");
+    }
+    log_sum_exp_.resize(output.columns());
+    this->resize_gradient(output, result);
+    kernels::softmax_columns(output.data(), result.data(), log_sum_exp_.data(), output.rows(), output.columns());
+   }
+ };
+}
+
+#endif
@@ -0,0 +1,129 @@
+ /*
+  * Vectorized softmax kernels
+  *
+  * Softmax over the rows of each column of a (rows x columns) row-major matrix, i.e. over the
+  * classes of each sample of a batch, together with the log-sum-exp of every column:
+  *
+  *   m[j]   = max_c x[c][j]
+  *   s[j]   = sum_c exp(x[c][j] - m[j])
+  *   y[c][j] = exp(x[c][j] - m[j]) / s[j]
+  *   lse[j] = m[j] + log(s[j])
+  *
+  * Subtracting the column maximum keeps every exponent <= 0, so nothing overflows for any finite
+  * logit, and s[j] >= 1 so the logarithm is always defined.
+  *
+  * A row of the matrix holds one class for consecutive samples, so the float kernels run across
+  * the columns: a register covers V::width samples, the max, the sum and the exponentials (the
+  * exp_approx polynomial of activation_kernels.hpp) are computed for all of them in one pass per
+  * row, with no horizontal reductions. The logarithm is taken once per column. Leftover columns
+  * and other types use the same steps in scalar code with std::exp.
+ */
+
+#ifndef LOSS_KERNELS_H
+#define LOSS_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include "activation_kernels.hpp"
+#include "simd.hpp"
+
+namespace nn {
+ namespace kernels {
+  namespace detail {
+   // Columns [first, columns); y may alias x
+   template<typename T>
+   void softmax_columns_scalar(const T* x, T* y, T* lse, size_t rows, size_t columns, size_t first) {
+    for (size_t j = first; j < columns; j++) {
+     T m = x[j];
+     for (size_t c = 1; c < rows; c++) {
+      m = std::max(m, x[c * columns + j]);
+     }
+     T s = 0;
+     for (size_t c = 0; c < rows; c++) {
+      const T e = std::exp(x[c * columns + j] - m);
+      y[c * columns + j] = e;
+      s += e;
+     }
+     const T inverse = static_cast<T>(1) / s;
+     for (size_t c = 0; c < rows; c++) {
+      y[c * columns + j] *= inverse;
+     }
+     lse[j] = m + std::log(s);
+    }
+   }
+
+#if NN_X86_DISPATCH
+   // Returns the first column left to the scalar code; lse temporarily holds the sums
+#define NN_DEFINE_VECTOR_SOFTMAX(ns, target)                                                  \
+   namespace ns {                                                                             \
+    template<typename V>                                                                      \
+    target size_t softmax_columns(const float* x, float* y, float* lse, size_t rows,          \
+      size_t columns) {                                                                       \
+     using R = typename V::reg;                                                               \
+     size_t j = 0;                                                                            \
+     for (; j + V::width <= columns; j += V::width) {                                         \
+      R m = V::load(x + j);                                                                   \
+      for (size_t c = 1; c < rows; c++) {                                                     \
+       m = V::max(m, V::load(x + c * columns + j));                                           \
+      }                                                                                       \
+      R s = V::zero();                                                                        \
+      for (size_t c = 0; c < rows; c++) {                                                     \
+       const R e = exp_approx<V>(V::sub(V::load(x + c * columns + j), m));                    \
+       V::store(y + c * columns + j, e);                                                      \
+       s = V::add(s, e);                                                                      \
+      }                                                                                       \
+      const R inverse = V::div(V::broadcast(1.0f), s);                                        \
+      for (size_t c = 0; c < rows; c++) {                                                     \
+       V::store(y + c * columns + j, V::mul(V::load(y + c * columns + j), inverse));          \
+      }                                                                                       \
+      /* lse = m + log(s), the log per column below */                                        \
+      V::store(lse + j, s);                                                                   \
+      float maxima[V::width];                                                                 \
+      V::store(maxima, m);                                                                    \
+      for (size_t k = 0; k < V::width; k++) {                                                 \
+       lse[j + k] = maxima[k] + std::log(lse[j + k]);                                         \
+      }                                                                                       \
+     }                                                                                        \
+     return j;                                                                                \
+    }                                                                                         \
+   }
+
+   NN_DEFINE_VECTOR_SOFTMAX(avx2, NN_TARGET_AVX2)
+   NN_DEFINE_VECTOR_SOFTMAX(avx512, NN_TARGET_AVX512)
+#undef NN_DEFINE_VECTOR_SOFTMAX
+#endif
+  }
+
+  /*
+   * y = softmax of each column of x (rows x columns, row-major), lse[j] = log-sum-exp of column j.
+   * y may be x; lse has one value per column.
+  */
+  template<typename T>
+  void softmax_columns(const T* x, T* y, T* lse, size_t rows, size_t columns) {
+   if (rows == 0) {
+    return;
+   }
+   size_t first = 0;
+#if NN_X86_DISPATCH
+   if constexpr (std::is_same<T, float>::value) {
+    switch (simd::active_isa()) {
+     case simd::Isa::AVX512:
+      first = detail::avx512::softmax_columns<simd::VecAvx512Float>(x, y, lse, rows, columns);
+      break;
+     case simd::Isa::AVX2:
+      first = detail::avx2::softmax_columns<simd::VecAvx2Float>(x, y, lse, rows, columns);
+      break;
+     case simd::Isa::SCALAR:
+     default:
+      break;
+    }
+   }
+#endif
+   detail::softmax_columns_scalar(x, y, lse, rows, columns, first);
+  }
+ }
+}
+
+#endif
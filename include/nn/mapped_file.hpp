@@ -0,0 +1,109 @@
+ /*
+  * Mapped file
+  *
+  * Read-only view of a whole file, shared by the IDX reader and the checkpoint loader.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define NN_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define NN_HAS_MMAP 0
+#endif
+
+namespace nn {
+
+ /*
+  * Read-only view of a whole file: a private mapping where mmap is available, a single
+  * bulk read into memory otherwise.
+ */
+ class MappedFile {
+  public:
+   MappedFile() = default;
+
+   explicit MappedFile(const std::string& filename) {
+#if NN_HAS_MMAP
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+     throw std::runtime_error("cannot open file: " + filename);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+     ::close(fd);
+     throw std::runtime_error("cannot stat file: " + filename);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+     void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+     if (mapping == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("cannot map file: " + filename);
+     }
+     data_ = static_cast<const uint8_t*>(mapping);
+    }
+    ::close(fd);
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+     throw std::runtime_error("cannot open file: " + filename);
+    }
+    buffer_.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+   }
+
+   ~MappedFile() { release(); }
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+   MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+     release();
+     data_ = std::exchange(other.data_, nullptr);
+     size_ = std::exchange(other.size_, 0);
+     buffer_ = std::move(other.buffer_);
+    }
+    return *this;
+   }
+
+   const uint8_t* data() const { return data_; }
+   size_t size() const { return size_; }
+
+  private:
+   const uint8_t* data_ = nullptr;
+   size_t size_ = 0;
+   std::vector<uint8_t> buffer_;  // fallback storage without mmap
+
+   void release() {
+#if NN_HAS_MMAP
+    if (data_ && buffer_.empty()) {
+     ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+   }
+ };
+}
+
+#endif
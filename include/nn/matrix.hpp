@@ -1,201 +1,605 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <algorithm>
+#include <functional>
 #include <iostream> 
 #include <iterator>
 #include <iomanip> 
 #include <vector> 
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "aligned_allocator.hpp"
+#include "gemm.hpp"
+#include "matrix_expression.hpp"
+#include "matrix_view.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
 
 template<typename T>
 class Matrix {
+ public:
+  // Alignment of the owned storage, and of every row of a padded() matrix
+  static constexpr size_t kAlignment = 64;
+
  private:
   size_t rows_;
   size_t columns_;
-  std::vector<T> data_;
+  size_t stride_;         // leading dimension: row i starts at data() + i * stride_
+  bool padded_ = false;   // stride_ rounded up to kAlignment bytes (see padded())
+  std::vector<T, nn::AlignedAllocator<T, kAlignment>> data_;
+  T* borrowed_ = nullptr;  // storage owned by someone else (see borrow()), data_ is then empty
 
   // Unsafe and unbound methods for internal usage
   inline T& unsafe_at(size_t i, size_t j) {
-   return data_[i * columns_ + j];
+   return data()[i * stride_ + j];
   }
 
   inline const T& unsafe_at(size_t i, size_t j) const {
-   return data_[i * columns_ + j];
+   return data()[i * stride_ + j];
+  }
+
+  static size_t padded_stride(size_t columns) {
+   constexpr size_t step = kAlignment / sizeof(T) > 0 ? kAlignment / sizeof(T) : 1;
+   return (columns + step - 1) / step * step;
+  }
+
+  // Copies the values of from into to, which already has the same shape
+  static void copy_values(nn::MatrixView<const T> from, Matrix& to) {
+   if (from.is_contiguous() && to.is_contiguous()) {
+    std::copy(from.data(), from.data() + from.rows() * from.columns(), to.data());
+    return;
+   }
+   for (size_t i = 0; i < from.rows(); i++) {
+    const T* row = from.data() + i * from.stride();
+    std::copy(row, row + from.columns(), to.data() + i * to.stride_);
+   }
+  }
+
+  // Assignment into borrowed storage copies the values, the shape cannot change
+  void assign_borrowed(const Matrix& other) {
+   if (other.rows_ != rows_ || other.columns_ != columns_) {
+    throw std::invalid_argument(std::string(__func__) + ": borrowed storage cannot change shape");
+   }
+   copy_values(other, *this);
+  }
+
+  template<typename A>
+  void check_same_shape(const A& other, const char* function) const {
+   if (other.rows() != rows_ || other.columns() != columns_) {
+    throw std::invalid_argument(std::string(function) + ": matrices are not the same size");
+   }
+  }
+
+  // Elementwise loops below this many elements stay on the calling thread
+  static constexpr size_t kParallelGrain = 1 << 15;
+
+  /*
+   * f(i, lo, hi) for the elements [lo, hi) of every row i, split over the thread pool when large
+   * enough. When every matrix of the loop is contiguous the storage is walked as one row
+   * (i == 0, hi up to rows * columns), so short rows still make long loops.
+  */
+  template<typename F>
+  void for_each_span(bool contiguous, const F& f) const {
+   if (contiguous) {
+    nn::parallel_for(0, rows_ * columns_, kParallelGrain, [&f](size_t lo, size_t hi) { f(0, lo, hi); });
+    return;
+   }
+   const size_t columns = columns_;
+   nn::parallel_for(0, rows_, std::max<size_t>(1, kParallelGrain / std::max<size_t>(1, columns)),
+     [&f, columns](size_t lo, size_t hi) {
+    for (size_t i = lo; i < hi; i++) {
+     f(i, 0, columns);
+    }
+   });
+  }
+
+  // r = op(a, b) elementwise; the three have the same shape, r may be a or b
+  template<typename Op>
+  static void elementwise(nn::MatrixView<const T> a, nn::MatrixView<const T> b, Matrix& r, Op op) {
+   const T* pa = a.data();
+   const T* pb = b.data();
+   T* pr = r.data();
+   const size_t la = a.stride(), lb = b.stride(), lr = r.stride_;
+   r.for_each_span(a.is_contiguous() && b.is_contiguous() && r.is_contiguous(), [=](size_t i, size_t lo, size_t hi) {
+    const T* ai = pa + i * la;
+    const T* bi = pb + i * lb;
+    T* ri = pr + i * lr;
+    for (size_t k = lo; k < hi; k++) {
+     ri[k] = op(ai[k], bi[k]);
+    }
+   });
+  }
+
+  // r = op(a) elementwise; r has the shape of a and may be a
+  template<typename Op>
+  static void elementwise(nn::MatrixView<const T> a, Matrix& r, Op op) {
+   const T* pa = a.data();
+   T* pr = r.data();
+   const size_t la = a.stride(), lr = r.stride_;
+   r.for_each_span(a.is_contiguous() && r.is_contiguous(), [=](size_t i, size_t lo, size_t hi) {
+    const T* ai = pa + i * la;
+    T* ri = pr + i * lr;
+    for (size_t k = lo; k < hi; k++) {
+     ri[k] = op(ai[k]);
+    }
+   });
+  }
+
+  // Storage = expression, in one pass (see matrix_expression.hpp); the shape already matches
+  template<typename E>
+  void evaluate(const E& expression) {
+   NN_PROFILE_SCOPE("Matrix::evaluate", "matrix", static_cast<double>(E::kOperations) * rows_ * columns_,
+     (E::kReads + 1.0) * sizeof(T) * rows_ * columns_);
+   T* r = data();
+   const size_t lr = stride_;
+   for_each_span(is_contiguous() && expression.contiguous(), [r, lr, &expression](size_t i, size_t lo, size_t hi) {
+    T* ri = r + i * lr;
+    for (size_t k = lo; k < hi; k++) {
+     ri[k] = expression(i, k);
+    }
+   });
+  }
+
+  // Storage op= expression, in one pass
+  template<typename E, typename Op>
+  void update(const E& expression, Op op) {
+   T* r = data();
+   const size_t lr = stride_;
+   for_each_span(is_contiguous() && expression.contiguous(), [r, lr, &expression, op](size_t i, size_t lo, size_t hi) {
+    T* ri = r + i * lr;
+    for (size_t k = lo; k < hi; k++) {
+     ri[k] = op(ri[k], expression(i, k));
+    }
+   });
   }
 
  public:
+  using value_type = T;
+
   Matrix(size_t rows, size_t columns) 
-   : rows_(rows), columns_(columns), data_(rows * columns) {};
+   : rows_(rows), columns_(columns), stride_(columns), data_(rows * columns) {
+   if (!data_.empty()) {
+    NN_PROFILE_ALLOCATION(data_.size() * sizeof(T));
+   }
+  }
 
   Matrix(size_t rows, size_t columns, const std::vector<T>& values)
-   : rows_(rows), columns_(columns), data_(values) {
+   : rows_(rows), columns_(columns), stride_(columns), data_(values.begin(), values.end()) {
    if (values.size() != rows * columns) {
     throw std::invalid_argument("initial values size doesn't match matrix dimensions");
    }
+   if (!data_.empty()) {
+    NN_PROFILE_ALLOCATION(data_.size() * sizeof(T));
    }
+   }
+
+  // A contiguous copy of the viewed values
+  explicit Matrix(nn::MatrixView<const T> view) : Matrix(view.rows(), view.columns()) {
+   copy_values(view, *this);
+  }
+
+  /*
+   * A zeroed rows x columns matrix whose rows are padded to a multiple of kAlignment bytes, so
+   * that every row starts on a cache line and its vectors can be loaded aligned (a 784 float row
+   * takes 13 whole lines instead of straddling 14). It stays padded when it is resized or
+   * assigned to; copies keep the layout. The padding is zero.
+   * Matrix operations and the GEMM read the stride; code walking data() as one array of
+   * rows() * columns() elements needs is_contiguous().
+  */
+  static Matrix padded(size_t rows, size_t columns) {
+   Matrix m(0, 0);
+   m.padded_ = true;
+   m.resize(rows, columns);
+   return m;
+  }
 
-  Matrix(const Matrix&) = default;
-  Matrix& operator=(const Matrix&) = default;
-  Matrix(Matrix&&) noexcept = default;
-  Matrix& operator=(Matrix&&) noexcept = default;
+  /*
+   * A rows x columns matrix over storage it does not own, e.g. a layer's slot of a parameter
+   * arena (see parameters.hpp). The storage must outlive the matrix.
+   * Copies of a borrowed matrix own their storage; moving one moves the borrow; assigning to one
+   * copies the values into the borrowed storage, which requires the same shape.
+  */
+  static Matrix borrow(T* storage, size_t rows, size_t columns) {
+   Matrix m(0, 0);
+   m.rows_ = rows;
+   m.columns_ = columns;
+   m.stride_ = columns;
+   m.borrowed_ = storage;
+   return m;
+  }
+
+  // A matrix over the storage of a view, with its stride: the operations writing it write the view
+  static Matrix borrow(nn::MatrixView<T> view) {
+   Matrix m = borrow(view.data(), view.rows(), view.columns());
+   m.stride_ = view.stride();
+   return m;
+  }
+
+  bool is_borrowed() const { return borrowed_ != nullptr; }
+
+  // Whether the view reads any of the storage of this matrix, e.g. a result fed back as an input
+  bool shares_storage(nn::MatrixView<const T> view) const {
+   if (rows_ * columns_ == 0 || view.empty()) {
+    return false;
+   }
+   const std::less<const T*> before;
+   const T* view_end = view.data() + (view.rows() - 1) * view.stride() + view.columns();
+   return before(view.data(), data() + rows_ * stride_) && before(data(), view_end);
+  }
+
+  // Exchanges shapes and storage, borrowed or not
+  void swap(Matrix& other) noexcept {
+   std::swap(rows_, other.rows_);
+   std::swap(columns_, other.columns_);
+   std::swap(stride_, other.stride_);
+   std::swap(padded_, other.padded_);
+   data_.swap(other.data_);
+   std::swap(borrowed_, other.borrowed_);
+  }
+
+  Matrix(const Matrix& other)
+   : rows_(other.rows_), columns_(other.columns_), stride_(other.padded_ ? other.stride_ : other.columns_),
+     padded_(other.padded_), data_(other.rows_ * stride_) {
+   if (!data_.empty()) {
+    NN_PROFILE_ALLOCATION(data_.size() * sizeof(T));
+   }
+   copy_values(other, *this);
+  }
+
+  // Evaluates an elementwise expression, e.g. Matrix<float> c = a + b * 2.0f
+  template<typename E>
+  Matrix(const nn::expr::Expression<E>& expression)
+   : Matrix(expression.self().rows(), expression.self().columns()) {
+   evaluate(expression.self());
+  }
+
+  /*
+   * The expression may read this matrix, as in a = a + b. One of another shape that does is
+   * evaluated into new storage (of the same layout) first, since resizing would move what it reads.
+   */
+  template<typename E>
+  Matrix& operator=(const nn::expr::Expression<E>& expression) {
+   const E& e = expression.self();
+   if (e.rows() != rows_ || e.columns() != columns_) {
+    if (borrowed_) {
+     throw std::invalid_argument(std::string(__func__) + ": borrowed storage cannot change shape");
+    }
+    if (e.reads(data(), data() + rows_ * stride_)) {
+     Matrix result = padded_ ? padded(e.rows(), e.columns()) : Matrix(e.rows(), e.columns());
+     result.evaluate(e);
+     swap(result);
+     return *this;
+    }
+   }
+   resize(e.rows(), e.columns());
+   evaluate(e);
+   return *this;
+  }
+
+  // Copies the values; the layout (contiguous or padded) stays the one of this matrix
+  Matrix& operator=(const Matrix& other) {
+   if (this == &other) {
+    return *this;
+   }
+   if (borrowed_) {
+    assign_borrowed(other);
+   } else {
+    resize(other.rows_, other.columns_);
+    copy_values(other, *this);
+   }
+   return *this;
+  }
+
+  // Copies the values of a view, like operator= does those of a matrix
+  void assign(nn::MatrixView<const T> values) {
+   if (borrowed_) {
+    if (values.rows() != rows_ || values.columns() != columns_) {
+     throw std::invalid_argument(std::string(__func__) + ": borrowed storage cannot change shape");
+    }
+   } else {
+    resize(values.rows(), values.columns());
+   }
+   copy_values(values, *this);
+  }
+
+  Matrix(Matrix&& other) noexcept
+   : rows_(other.rows_), columns_(other.columns_), stride_(other.stride_), padded_(other.padded_),
+     data_(std::move(other.data_)), borrowed_(other.borrowed_) {
+   other.borrowed_ = nullptr;
+  }
+
+  /*
+   * Moving into borrowed storage copies the values, and throws std::invalid_argument unless the
+   * shapes match, so this cannot be noexcept. Containers still move matrices when they grow: that
+   * takes the move constructor, which is.
+   */
+  Matrix& operator=(Matrix&& other) {
+   if (this == &other) {
+    return *this;
+   }
+   if (borrowed_) {
+    assign_borrowed(other);
+   } else {
+    rows_ = other.rows_;
+    columns_ = other.columns_;
+    stride_ = other.stride_;
+    padded_ = other.padded_;
+    data_ = std::move(other.data_);
+    borrowed_ = other.borrowed_;
+    other.borrowed_ = nullptr;
+   }
+   return *this;
+  }
 
   // Access element at (i,j)
   T& at(size_t i, size_t j) {
    if (i >= rows_ || j >= columns_) {
     throw std::out_of_range("matrix indices out of range");
    }
-   return data_[i * columns_ + j];
+   return data()[i * stride_ + j];
   }
 
   const T& at(size_t i, size_t j) const {
    if (i >= rows_ || j >= columns_) {
     throw std::out_of_range("matrix indices out of range");
    }
-   return data_[i * columns_ + j];
+   return data()[i * stride_ + j];
   }
 
   // Get dimensions
   size_t rows() const { return rows_; }
   size_t columns() const { return columns_; }
 
+  // Distance between the starts of two consecutive rows, columns() unless padded()
+  size_t stride() const { return stride_; }
+  // Whether the elements are the first rows() * columns() of data(), with no padding between rows
+  bool is_contiguous() const { return stride_ == columns_ || rows_ <= 1; }
+
+  // Raw row-major storage, for the kernels: row i starts at data() + i * stride()
+  T* data() { return borrowed_ ? borrowed_ : data_.data(); }
+  const T* data() const { return borrowed_ ? borrowed_ : data_.data(); }
+
+  // Views of the whole matrix (see matrix_view.hpp), valid until it is resized
+  nn::MatrixView<T> view() { return nn::MatrixView<T>(data(), rows_, columns_, stride_); }
+  nn::MatrixView<const T> view() const { return nn::MatrixView<const T>(data(), rows_, columns_, stride_); }
+  operator nn::MatrixView<const T>() const { return view(); }
+
   // Matrix operations
-  Matrix<T> add(const Matrix<T>& A) const {
+  Matrix<T> add(nn::MatrixView<const T> A) const {
    if (A.rows() != rows_ || A.columns() != columns_) {
     throw std::invalid_argument(std::string(__func__) + ": matrices are not the same size");
    }
 
    Matrix<T> result(rows_, columns_);
-
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     result.at(i, j) = A.at(i,j) + at(i,j);
-    }
-   }
+   add_into(A, result);
 
    return result;
   }
 
-  Matrix<T> subtract(const Matrix<T>& A) const {
+  /*
+   * The *_into variants write into result instead of returning a new matrix. result is resized
+   * to the shape of the output, which only allocates when its storage has to grow, and it may
+   * be one of the operands for the elementwise operations. The operands are read through views,
+   * so a block of a larger matrix (see matrix_view.hpp) is used in place.
+   */
+  void add_into(nn::MatrixView<const T> A, Matrix<T>& result) const {
    if (A.rows() != rows_ || A.columns() != columns_) {
     throw std::invalid_argument(std::string(__func__) + ": matrices are not the same size");
    }
 
-   Matrix<T> result(rows_, columns_);
+   NN_PROFILE_SCOPE("Matrix::add", "matrix", static_cast<double>(rows_ * columns_), 3.0 * sizeof(T) * rows_ * columns_);
+   result.resize(rows_, columns_);
+   elementwise(A, *this, result, [](T a, T b) { return a + b; });
+  }
 
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     result.at(i, j) = at(i,j) - A.at(i,j);
-    }
+  Matrix<T> subtract(nn::MatrixView<const T> A) const {
+   if (A.rows() != rows_ || A.columns() != columns_) {
+    throw std::invalid_argument(std::string(__func__) + ": matrices are not the same size");
    }
 
+   Matrix<T> result(rows_, columns_);
+   subtract_into(A, result);
+
    return result;
   }
 
-  Matrix<T>& subtract_inplace(const Matrix<T>& A) {
+  void subtract_into(nn::MatrixView<const T> A, Matrix<T>& result) const {
    if (A.rows() != rows_ || A.columns() != columns_) {
     throw std::invalid_argument(std::string(__func__) + ": matrices are not the same size");
    }
 
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     unsafe_at(i, j) -= A.at(i, j);
-    }
+   NN_PROFILE_SCOPE("Matrix::subtract", "matrix", static_cast<double>(rows_ * columns_), 3.0 * sizeof(T) * rows_ * columns_);
+   result.resize(rows_, columns_);
+   elementwise(*this, A, result, [](T b, T a) { return b - a; });
+  }
+
+  Matrix<T>& subtract_inplace(nn::MatrixView<const T> A) {
+   if (A.rows() != rows_ || A.columns() != columns_) {
+    throw std::invalid_argument(std::string(__func__) + ": matrices are not the same size");
    }
 
+   NN_PROFILE_SCOPE("Matrix::subtract_inplace", "matrix", static_cast<double>(rows_ * columns_), 3.0 * sizeof(T) * rows_ * columns_);
+   elementwise(*this, A, *this, [](T r, T a) { return r - a; });
+
    return *this;
   }
 
-  Matrix<T> operator-(const Matrix<T>& A) const { return subtract(A); }
-  Matrix<T>& operator-=(const Matrix<T>& A) { return subtract_inplace(A); }
+  /*
+   * The elementwise operators build expressions (see matrix_expression.hpp), evaluated when they
+   * are assigned to a Matrix; the named methods (add, subtract, ...) compute right away.
+   */
+  template<typename R, typename = std::enable_if_t<nn::expr::is_operand<R>::value>>
+  auto operator-(const R& A) const { return nn::expr::make_binary<nn::expr::Subtract>(*this, A); }
+
+  Matrix<T>& operator-=(nn::MatrixView<const T> A) { return subtract_inplace(A); }
+
+  template<typename E>
+  Matrix<T>& operator-=(const nn::expr::Expression<E>& expression) {
+   const E& e = expression.self();
+   check_same_shape(e, "subtract_inplace");
+   update(e, [](T r, T x) { return r - x; });
+   return *this;
+  }
 
-  Matrix<T>& add_inplace(const Matrix<T>& A) {
+  Matrix<T>& add_inplace(nn::MatrixView<const T> A) {
    if (A.rows() != rows_ || A.columns() != columns_) {
     throw std::invalid_argument(std::string(__func__) + ": matrices are not the same size");
    }
 
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     unsafe_at(i, j) += A.at(i, j);
-    }
-   }
+   NN_PROFILE_SCOPE("Matrix::add_inplace", "matrix", static_cast<double>(rows_ * columns_), 3.0 * sizeof(T) * rows_ * columns_);
+   elementwise(*this, A, *this, [](T r, T a) { return r + a; });
 
    return *this;
   }
 
-  Matrix<T> operator+(const Matrix<T>& A) const { return add(A); }
-  Matrix<T>& operator+=(const Matrix<T>& A) { return add_inplace(A); }
+  template<typename R, typename = std::enable_if_t<nn::expr::is_operand<R>::value>>
+  auto operator+(const R& A) const { return nn::expr::make_binary<nn::expr::Add>(*this, A); }
+
+  Matrix<T>& operator+=(nn::MatrixView<const T> A) { return add_inplace(A); }
+
+  template<typename E>
+  Matrix<T>& operator+=(const nn::expr::Expression<E>& expression) {
+   const E& e = expression.self();
+   check_same_shape(e, "add_inplace");
+   update(e, [](T r, T x) { return r + x; });
+   return *this;
+  }
 
-  Matrix<T> hadamard(const Matrix<T>& other) const {
+  Matrix<T> hadamard(nn::MatrixView<const T> other) const {
    if (rows_ != other.rows() || columns_ != other.columns()) {
     throw std::invalid_argument(std::string(__func__) + ": matrices must have the same dimensions for Hadamard product");
    }
 
    Matrix<T> result(rows_, columns_);
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     result.at(i, j) = at(i, j) * other.at(i, j);
-    }
-   }
+   hadamard_into(other, result);
 
    return result;
   }
 
-  Matrix<T> mul(const Matrix<T>& A) const {
+  void hadamard_into(nn::MatrixView<const T> other, Matrix<T>& result) const {
+   if (rows_ != other.rows() || columns_ != other.columns()) {
+    throw std::invalid_argument(std::string(__func__) + ": matrices must have the same dimensions for Hadamard product");
+   }
+
+   NN_PROFILE_SCOPE("Matrix::hadamard", "matrix", static_cast<double>(rows_ * columns_), 3.0 * sizeof(T) * rows_ * columns_);
+   result.resize(rows_, columns_);
+   elementwise(*this, other, result, [](T a, T b) { return a * b; });
+  }
+
+  Matrix<T> mul(nn::MatrixView<const T> A) const {
    if (A.rows() != columns_) {
     throw std::invalid_argument(std::string(__func__) + ": matrices cannot be multiplied");
    }
 
    Matrix<T> result(rows_, A.columns());
-   
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < A.columns(); j++) {
-     T sum = 0;
-     for (size_t k = 0; k < columns_; k++) {
-      sum += at(i, k) * A.at(k, j);
-     }
-     result.at(i,j) = sum;
-    }
-   }
+   mul_into(A, result);
 
    return result;
   }
 
-  Matrix<T> scalar_mul(const T scalar) const {
-   Matrix<T> result(rows_, columns_);
+  /*
+   * result = this * A, reusing the storage of result (it only allocates when it has to grow).
+   * The optional epilogue (bias add, activation) runs on each tile of result as it is finished.
+  */
+  void mul_into(nn::MatrixView<const T> A, Matrix<T>& result,
+    const nn::kernels::Epilogue<T>& epilogue = nn::kernels::Epilogue<T>()) const {
+   if (A.rows() != columns_) {
+    throw std::invalid_argument(std::string(__func__) + ": matrices cannot be multiplied");
+   }
+   if (result.data() != nullptr && (result.data() == data() || result.data() == A.data())) {
+    throw std::invalid_argument(std::string(__func__) + ": result cannot alias an operand");
+   }
 
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     result.at(i,j) = at(i,j) * scalar;
-    }
+   NN_PROFILE_SCOPE("Matrix::mul", "matrix", 2.0 * rows_ * A.columns() * columns_,
+     static_cast<double>(sizeof(T)) * (rows_ * columns_ + A.rows() * A.columns() + rows_ * A.columns()));
+   result.resize(rows_, A.columns());
+
+   // packed, cache-blocked kernel (see gemm.hpp)
+   nn::kernels::gemm(nn::kernels::Transpose::NO, nn::kernels::Transpose::NO, rows_, A.columns(), columns_,
+     static_cast<T>(1), data(), stride_,
+     A.data(), A.stride(),
+     static_cast<T>(0), result.data(), result.stride(), epilogue);
+  }
+
+  /*
+   * result = alpha * op(this) * op(A) + beta * result, op() transposing its operand when asked
+   * to. The transposed operands are read in place, no transposed copy is made.
+   * With beta == 0 result is resized, otherwise it must already have the shape of the product.
+  */
+  void mul_into(nn::MatrixView<const T> A, Matrix<T>& result, nn::kernels::Transpose trans_this,
+    nn::kernels::Transpose trans_A, const T alpha = 1, const T beta = 0) const {
+   const bool ta = trans_this == nn::kernels::Transpose::YES;
+   const bool tb = trans_A == nn::kernels::Transpose::YES;
+   const size_t M = ta ? columns_ : rows_;
+   const size_t K = ta ? rows_ : columns_;
+   const size_t N = tb ? A.rows() : A.columns();
+
+   if ((tb ? A.columns() : A.rows()) != K) {
+    throw std::invalid_argument(std::string(__func__) + ": matrices cannot be multiplied");
    }
+   if (result.data() != nullptr && (result.data() == data() || result.data() == A.data())) {
+    throw std::invalid_argument(std::string(__func__) + ": result cannot alias an operand");
+   }
+   NN_PROFILE_SCOPE("Matrix::mul", "matrix", 2.0 * M * N * K,
+     static_cast<double>(sizeof(T)) * (M * K + K * N + (beta == static_cast<T>(0) ? 1 : 2) * M * N));
+   if (beta == static_cast<T>(0)) {
+    result.resize(M, N);
+   } else if (result.rows() != M || result.columns() != N) {
+    throw std::invalid_argument(std::string(__func__) + ": result does not match the product shape");
+   }
+
+   nn::kernels::gemm(trans_this, trans_A, M, N, K,
+     alpha, data(), stride_,
+     A.data(), A.stride(),
+     beta, result.data(), result.stride());
+  }
+
+  Matrix<T> scalar_mul(const T scalar) const {
+   Matrix<T> result(rows_, columns_);
+   scalar_mul_into(scalar, result);
 
    return result;
   }
 
+  void scalar_mul_into(const T scalar, Matrix<T>& result) const {
+   NN_PROFILE_SCOPE("Matrix::scalar_mul", "matrix", static_cast<double>(rows_ * columns_), 2.0 * sizeof(T) * rows_ * columns_);
+   result.resize(rows_, columns_);
+   elementwise(*this, result, [scalar](T a) { return a * scalar; });
+  }
+
   Matrix<T>& scalar_mul_inplace(const T scalar) {
-   for (size_t i = 0; i < rows_; i++) {
-    for (size_t j = 0; j < columns_; j++) {
-     unsafe_at(i, j) *= scalar;
-    }
-   }
+   NN_PROFILE_SCOPE("Matrix::scalar_mul_inplace", "matrix", static_cast<double>(rows_ * columns_), 2.0 * sizeof(T) * rows_ * columns_);
+   elementwise(*this, *this, [scalar](T r) { return r * scalar; });
 
    return *this;
   }
    
+  // Matrix product, computed right away
   Matrix<T> operator*(const Matrix<T>& A) const { return mul(A); }
-  Matrix<T> operator*(const T scalar) const { return scalar_mul(scalar); }
+  auto operator*(const T scalar) const { return nn::expr::make_scale(*this, scalar); }
   Matrix<T>& operator*=(const T scalar) { return scalar_mul_inplace(scalar); }
 
   Matrix transpose() const {
    Matrix<T> result(columns_, rows_);
+   transpose_into(result);
+
+   return result;
+  }
 
+  void transpose_into(Matrix<T>& result) const {
+   if (&result == this) {
+    throw std::invalid_argument(std::string(__func__) + ": result cannot alias the matrix");
+   }
+
+   NN_PROFILE_SCOPE("Matrix::transpose", "matrix", 0.0, 2.0 * sizeof(T) * rows_ * columns_);
+   result.resize(columns_, rows_);
    for (size_t i = 0; i < rows_; i++) {
     for (size_t j = 0; j < columns_; j++) {
-     result.at(j,i) = at(i,j);
+     result.unsafe_at(j, i) = unsafe_at(i, j);
     }
    }
-
-   return result;
   }
 
   // Utils
@@ -210,14 +614,88 @@ class Matrix {
   }
 
   void zeros() {
-   data_.assign(rows_ * columns_, 0.0);
+   if (is_contiguous()) {
+    std::fill(data(), data() + rows_ * columns_, static_cast<T>(0));
+    return;
+   }
+   for (size_t i = 0; i < rows_; i++) {
+    std::fill(data() + i * stride_, data() + i * stride_ + columns_, static_cast<T>(0));
+   }
   }
 
+  // Borrowed storage can only be reshaped to the same number of elements, a borrowed view not at all
   void resize(size_t rows, size_t cols) {
+   if (borrowed_) {
+    if (rows == rows_ && cols == columns_) {
+     return;
+    }
+    if (rows * cols != rows_ * columns_) {
+     throw std::invalid_argument(std::string(__func__) + ": borrowed storage cannot grow or shrink");
+    }
+    if (!is_contiguous()) {
+     throw std::invalid_argument(std::string(__func__) + ": a borrowed view cannot be reshaped");
+    }
+    rows_ = rows;
+    columns_ = cols;
+    stride_ = cols;
+    return;
+   }
+   const size_t stride = padded_ ? padded_stride(cols) : cols;
+   if (rows * stride > data_.capacity()) {
+    NN_PROFILE_ALLOCATION(rows * stride * sizeof(T));
+   }
+   if (padded_ && stride != stride_) {
+    // the padding of the new rows must be zero
+    data_.assign(rows * stride, static_cast<T>(0));
+   } else {
+    data_.resize(rows * stride);
+   }
    rows_ = rows;
    columns_ = cols;
-   data_.resize(rows * cols);
+   stride_ = stride;
   }
 };
 
+template<typename T>
+auto operator*(const typename Matrix<T>::value_type scalar, const Matrix<T>& A) { return A * scalar; }
+
+namespace nn {
+ namespace expr {
+  template<typename T>
+  struct Operand<Matrix<T>> {
+   using type = Leaf<T>;
+   static Leaf<T> get(const Matrix<T>& m) { return Leaf<T>(m.data(), m.rows(), m.columns(), m.stride()); }
+  };
+
+  template<typename T>
+  struct is_operand<Matrix<T>> : std::true_type {};
+
+  template<typename T>
+  struct Operand<MatrixView<T>> {
+   using type = Leaf<std::remove_const_t<T>>;
+   static type get(MatrixView<T> v) { return type(v.data(), v.rows(), v.columns(), v.stride()); }
+  };
+
+  template<typename T>
+  struct is_operand<MatrixView<T>> : std::true_type {};
+
+  // Product of an evaluated expression with a matrix, e.g. (a + b) * c
+  template<typename E, typename T>
+  Matrix<T> operator*(const Expression<E>& left, const Matrix<T>& right) { return Matrix<T>(left).mul(right); }
+ }
+
+ // Elementwise expressions with a view on the left, e.g. Matrix<float> c = a.view().column_range(0, 8) + b
+ template<typename T, typename R, typename = std::enable_if_t<expr::is_operand<R>::value>>
+ auto operator+(MatrixView<T> left, const R& right) { return expr::make_binary<expr::Add>(left, right); }
+
+ template<typename T, typename R, typename = std::enable_if_t<expr::is_operand<R>::value>>
+ auto operator-(MatrixView<T> left, const R& right) { return expr::make_binary<expr::Subtract>(left, right); }
+
+ template<typename T>
+ auto operator*(MatrixView<T> left, typename MatrixView<T>::value_type scalar) { return expr::make_scale(left, scalar); }
+
+ template<typename T>
+ auto operator*(typename MatrixView<T>::value_type scalar, MatrixView<T> right) { return expr::make_scale(right, scalar); }
+}
+
 #endif
@@ -0,0 +1,202 @@
+ /*
+  * Elementwise Matrix expressions
+  *
+  * The elementwise operators of Matrix (a + b, a - b, a * scalar, scalar * a) and nn::hadamard()
+  * do not compute anything: they return a small expression object naming the operation and its
+  * operands. A whole chain, e.g. (a - b) * 0.5f + nn::hadamard(c, d), is evaluated when it is
+  * assigned to a Matrix (or added to, subtracted from one): a single pass over the elements,
+  * split over the thread pool like the other elementwise loops, without a temporary per
+  * operation.
+  *
+  * Shapes are checked when the expression is built, so a mismatch still throws at the operator.
+  * Expressions refer to their Matrix operands instead of copying them: assign them to a Matrix
+  * within the statement that builds them, rather than keeping them in an auto variable that
+  * could outlive an operand.
+  * The result may be one of the operands (a = a + b), every element only reads its own index.
+ * An expression of another shape that reads the result (a = a.view().column_range(0, 2) * 2.0f)
+ * is evaluated into new storage first: resizing the result would move what it reads.
+ *
+ * e(i, k) is element k of row i. Padded operands (Matrix::padded()) are walked row by row; when
+ * every operand is contiguous the pass walks the storage as a single row, e(0, k) for
+ * k < rows * columns.
+ */
+
+#ifndef MATRIX_EXPRESSION_H
+#define MATRIX_EXPRESSION_H
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace nn {
+ namespace expr {
+
+  // Base of every expression node E (CRTP)
+  template<typename E>
+  struct Expression {
+   const E& self() const { return static_cast<const E&>(*this); }
+
+   // Element (i, j), computed on the spot
+   auto at(size_t i, size_t j) const {
+    if (i >= self().rows() || j >= self().columns()) {
+     throw std::out_of_range("matrix indices out of range");
+    }
+    return self()(i, j);
+   }
+  };
+
+  // The storage of a Matrix operand
+  template<typename T>
+  class Leaf : public Expression<Leaf<T>> {
+   public:
+    using value_type = T;
+    static constexpr size_t kOperations = 0;  // arithmetic operations per element
+    static constexpr size_t kReads = 1;       // values read per element
+
+    Leaf(const T* data, size_t rows, size_t columns, size_t stride)
+     : data_(data), rows_(rows), columns_(columns), stride_(stride) {}
+
+    size_t rows() const { return rows_; }
+    size_t columns() const { return columns_; }
+    bool contiguous() const { return stride_ == columns_ || rows_ <= 1; }
+    T operator()(size_t i, size_t k) const { return data_[i * stride_ + k]; }
+
+    // Whether any element read lies in [begin, end)
+    bool reads(const T* begin, const T* end) const {
+     if (rows_ == 0 || columns_ == 0) {
+      return false;
+     }
+     const std::less<const T*> before;
+     return before(data_, end) && before(begin, data_ + (rows_ - 1) * stride_ + columns_);
+    }
+
+   private:
+    const T* data_;
+    size_t rows_;
+    size_t columns_;
+    size_t stride_;
+  };
+
+  struct Add {
+   static constexpr const char* name = "add";
+   template<typename T> static T apply(T a, T b) { return a + b; }
+  };
+
+  struct Subtract {
+   static constexpr const char* name = "subtract";
+   template<typename T> static T apply(T a, T b) { return a - b; }
+  };
+
+  struct Hadamard {
+   static constexpr const char* name = "hadamard";
+   template<typename T> static T apply(T a, T b) { return a * b; }
+  };
+
+  template<typename Op, typename L, typename R>
+  class Binary : public Expression<Binary<Op, L, R>> {
+   static_assert(std::is_same<typename L::value_type, typename R::value_type>::value,
+     "operands must have the same element type");
+
+   public:
+    using value_type = typename L::value_type;
+    static constexpr size_t kOperations = L::kOperations + R::kOperations + 1;
+    static constexpr size_t kReads = L::kReads + R::kReads;
+
+    Binary(const L& left, const R& right) : left_(left), right_(right) {
+     if (left.rows() != right.rows() || left.columns() != right.columns()) {
+      throw std::invalid_argument(std::string(Op::name) + ": matrices are not the same size");
+     }
+    }
+
+    size_t rows() const { return left_.rows(); }
+    size_t columns() const { return left_.columns(); }
+    bool contiguous() const { return left_.contiguous() && right_.contiguous(); }
+    value_type operator()(size_t i, size_t k) const { return Op::apply(left_(i, k), right_(i, k)); }
+    bool reads(const value_type* begin, const value_type* end) const {
+     return left_.reads(begin, end) || right_.reads(begin, end);
+    }
+
+   private:
+    L left_;
+    R right_;
+  };
+
+  template<typename E>
+  class Scale : public Expression<Scale<E>> {
+   public:
+    using value_type = typename E::value_type;
+    static constexpr size_t kOperations = E::kOperations + 1;
+    static constexpr size_t kReads = E::kReads;
+
+    Scale(const E& expression, value_type scalar) : expression_(expression), scalar_(scalar) {}
+
+    size_t rows() const { return expression_.rows(); }
+    size_t columns() const { return expression_.columns(); }
+    bool contiguous() const { return expression_.contiguous(); }
+    value_type operator()(size_t i, size_t k) const { return expression_(i, k) * scalar_; }
+    bool reads(const value_type* begin, const value_type* end) const { return expression_.reads(begin, end); }
+
+   private:
+    E expression_;
+    value_type scalar_;
+  };
+
+  /*
+   * Operand<X>::get(x) is the node an operand takes in an expression: expressions are held by
+   * value (they are a few pointers and sizes), matrices become a Leaf over their storage
+   * (specialized in matrix.hpp).
+   */
+  template<typename X>
+  struct Operand {
+   using type = X;
+   static const X& get(const X& x) { return x; }
+  };
+
+  template<typename X>
+  using operand_t = typename Operand<X>::type;
+
+  template<typename X>
+  struct is_expression : std::is_base_of<Expression<X>, X> {};
+
+  // Matrix or expression, set for Matrix in matrix.hpp
+  template<typename X>
+  struct is_operand : is_expression<X> {};
+
+  template<typename Op, typename L, typename R>
+  Binary<Op, operand_t<L>, operand_t<R>> make_binary(const L& left, const R& right) {
+   return Binary<Op, operand_t<L>, operand_t<R>>(Operand<L>::get(left), Operand<R>::get(right));
+  }
+
+  template<typename X>
+  Scale<operand_t<X>> make_scale(const X& x, typename operand_t<X>::value_type scalar) {
+   return Scale<operand_t<X>>(Operand<X>::get(x), scalar);
+  }
+
+  /*
+   * Operators with an expression on at least one side, found by argument-dependent lookup.
+   * Matrix op Matrix and Matrix op expression are members of Matrix.
+   */
+  template<typename E, typename R, typename = std::enable_if_t<is_operand<R>::value>>
+  auto operator+(const Expression<E>& left, const R& right) { return make_binary<Add>(left.self(), right); }
+
+  template<typename E, typename R, typename = std::enable_if_t<is_operand<R>::value>>
+  auto operator-(const Expression<E>& left, const R& right) { return make_binary<Subtract>(left.self(), right); }
+
+  template<typename E>
+  auto operator*(const Expression<E>& left, typename E::value_type scalar) { return make_scale(left.self(), scalar); }
+
+  template<typename E>
+  auto operator*(typename E::value_type scalar, const Expression<E>& right) { return make_scale(right.self(), scalar); }
+ }
+
+ // Lazy elementwise product of two matrices or expressions
+ template<typename L, typename R,
+   typename = std::enable_if_t<expr::is_operand<L>::value && expr::is_operand<R>::value>>
+ auto hadamard(const L& left, const R& right) {
+  return expr::make_binary<expr::Hadamard>(left, right);
+ }
+}
+
+#endif
@@ -0,0 +1,85 @@
+ /*
+  * Matrix views
+  *
+  * MatrixView<T> is a rows x columns window over storage it does not own: a pointer, the shape
+  * and the stride between two rows (MatrixView<const T> for read-only access). Selecting a
+  * block, a range of rows or a range of columns makes another view of the same storage, so a
+  * mini-batch of a (features x samples) buffer is column_range(first, count), with no copy.
+  *
+  * A Matrix converts to a read-only view of itself, and view() gives a writable one. Views are
+  * accepted by the Matrix operations (add_into(view, result), mul_into, ...), the elementwise
+  * expressions (see matrix_expression.hpp) and Layer::forward/backward/infer; a Matrix borrowing
+  * a writable view (Matrix::borrow) writes into it. Like borrowed storage, the viewed storage must
+  * outlive the view.
+ */
+
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace nn {
+
+ template<typename T>
+ class MatrixView {
+  public:
+   using value_type = std::remove_const_t<T>;
+
+   // An empty view
+   MatrixView() = default;
+
+   MatrixView(T* data, size_t rows, size_t columns) : MatrixView(data, rows, columns, columns) {}
+
+   MatrixView(T* data, size_t rows, size_t columns, size_t stride)
+    : data_(data), rows_(rows), columns_(columns), stride_(stride) {
+    if (stride < columns && rows > 1) {
+     throw std::invalid_argument("MatrixView: the stride is shorter than a row");
+    }
+   }
+
+   // A writable view is also a read-only one
+   template<typename U, typename = std::enable_if_t<std::is_same<const U, T>::value && !std::is_same<U, T>::value>>
+   MatrixView(const MatrixView<U>& other)
+    : data_(other.data()), rows_(other.rows()), columns_(other.columns()), stride_(other.stride()) {}
+
+   T* data() const { return data_; }
+   size_t rows() const { return rows_; }
+   size_t columns() const { return columns_; }
+   size_t stride() const { return stride_; }
+   bool empty() const { return rows_ == 0 || columns_ == 0; }
+   // Whether the elements are the first rows() * columns() after data()
+   bool is_contiguous() const { return stride_ == columns_ || rows_ <= 1; }
+
+   T& at(size_t i, size_t j) const {
+    if (i >= rows_ || j >= columns_) {
+     throw std::out_of_range("matrix indices out of range");
+    }
+    return data_[i * stride_ + j];
+   }
+
+   // Element (i, j), unchecked
+   T& operator()(size_t i, size_t j) const { return data_[i * stride_ + j]; }
+
+   // The rows x columns block starting at (row, column)
+   MatrixView block(size_t row, size_t column, size_t rows, size_t columns) const {
+    if (row + rows > rows_ || column + columns > columns_) {
+     throw std::out_of_range(std::string(__func__) + ": block out of range of the view");
+    }
+    return MatrixView(data_ + row * stride_ + column, rows, columns, stride_);
+   }
+
+   MatrixView row_range(size_t first, size_t count) const { return block(first, 0, count, columns_); }
+   MatrixView column_range(size_t first, size_t count) const { return block(0, first, rows_, count); }
+
+  private:
+   T* data_ = nullptr;
+   size_t rows_ = 0;
+   size_t columns_ = 0;
+   size_t stride_ = 0;
+ };
+}
+
+#endif
@@ -4,8 +4,20 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include "batch_loader.hpp"
+#include "data_parallel.hpp"
+#include "dataset.hpp"
 #include "layer.hpp"
+#include "loss.hpp"
+#include "optimizer.hpp"
+#include "parameters.hpp"
+#include "profiler.hpp"
 
 namespace nn {
 
@@ -27,6 +39,41 @@ namespace nn {
    std::vector<LayerBase<T>*> layers_;
    Verbosity verbosity_ = Verbosity::MINIMAL;
 
+   // Network-wide optimizer and the arena holding every layer's parameters (see set_optimizer)
+   Optimizer<T>* optimizer_ = nullptr;
+   std::shared_ptr<ParameterArena<T>> parameters_;
+
+   // Replicas of the layers for data-parallel training steps, null when off (see set_replicas)
+   std::unique_ptr<DataParallel<T>> data_parallel_;
+   Synchronization synchronization_ = Synchronization::ALL_REDUCE;
+   Matrix<T> parallel_output_ = Matrix<T>(0, 0);
+
+   // Layer outputs of predict(), used alternately and reused between calls
+   Matrix<T> inference_buffers_[2] = {Matrix<T>(0, 0), Matrix<T>(0, 0)};
+
+   // Loss of training, mean squared error unless set_loss() was called
+   MeanSquaredError<T> default_loss_;
+   Loss<T>* loss_ = nullptr;
+   T last_loss_ = 0;
+
+   // Training buffers reused between steps: loss gradient and the stacked mini-batch
+   Matrix<T> output_gradient_ = Matrix<T>(0, 0);
+   Batch<T> batch_;
+
+   // Forward pass through all layers, the result is the last layer's output
+   const Matrix<T>& forward_layers(const Matrix<T>& input) {
+    if (layers_.empty()) {
+     throw std::runtime_error("network has no layers");
+    }
+
+    const Matrix<T>* current = &input;
+    for (auto& layer : layers_) {
+     current = &layer->forward(*current);
+    }
+
+    return *current;
+   }
+
   public:
    Network() = default;
    ~Network() = default; // user responsible for layer cleanup
@@ -37,75 +84,335 @@ namespace nn {
 
    // Add (an existing) layer to the network
    void add(LayerBase<T>* layer) {
+    if (optimizer_) {
+     throw std::invalid_argument(std::string(__func__) + ": layers must be added before the network optimizer is set");
+    }
     layers_.push_back(layer);
    }
 
+   const std::vector<LayerBase<T>*>& layers() const { return layers_; }
+
+   /*
+    * One optimizer for all layers, instead of one per layer. The first call moves the weights,
+    * biases and gradients of every layer into a single aligned ParameterArena (see parameters.hpp);
+    * after each backward pass the optimizer then makes one sweep over all the weights and one over
+    * all the biases. The layers must not have optimizers of their own, and no layer can be added
+    * afterwards. A later call replaces the optimizer, which starts from its own (empty) state.
+    */
+   void set_optimizer(Optimizer<T>* optimizer) {
+    if (!optimizer) {
+     throw std::invalid_argument(std::string(__func__) + ": optimizer must not be null");
+    }
+    if (layers_.empty()) {
+     throw std::invalid_argument(std::string(__func__) + ": network has no layers");
+    }
+
+    if (!parameters_) {
+     std::vector<std::pair<size_t, size_t>> shapes;
+     for (const auto& layer : layers_) {
+      if (layer->optimizer()) {
+       throw std::invalid_argument(std::string(__func__) + ": a layer already has its own optimizer");
+      }
+      shapes.emplace_back(layer->output_size(), layer->input_size());
+     }
+     parameters_ = std::make_shared<ParameterArena<T>>(shapes);
+     for (size_t i = 0; i < layers_.size(); ++i) {
+      layers_[i]->bind_parameters(parameters_, i);
+     }
+    }
+    optimizer_ = optimizer;
+   }
+
+   Optimizer<T>* optimizer() const { return optimizer_; }
+
+   /*
+    * Data-parallel training over the library thread pool (see data_parallel.hpp): each training
+    * step splits its batch over num_replicas copies of the layers, which share the parameters of
+    * the network, and sums their gradients before the single optimizer step. The result is the
+    * one of a serial step on the whole batch, up to rounding. Worth it when the layers are too
+    * small for their products to be split over the threads, e.g. with num_replicas =
+    * nn::num_threads(). Needs the network optimizer (set_optimizer), 0 or 1 goes back to serial
+    * steps. forward(), predict() and backward() keep using the layers themselves.
+    *
+    * With Synchronization::HOGWILD, train() instead runs the replicas asynchronously: each one
+    * trains on its own batches and applies its SGD steps to the shared parameters without locks.
+    * This needs an SGD network optimizer (momentum is kept per replica); train_step() still takes
+    * synchronous steps.
+    */
+   void set_replicas(size_t num_replicas, Synchronization synchronization = Synchronization::ALL_REDUCE) {
+    if (num_replicas <= 1) {
+     data_parallel_.reset();
+     return;
+    }
+    if (!parameters_) {
+     throw std::invalid_argument(std::string(__func__) + ": data-parallel training needs the network optimizer (set_optimizer)");
+    }
+    if (synchronization == Synchronization::HOGWILD) {
+     hogwild_optimizer();
+    }
+    data_parallel_ = std::make_unique<DataParallel<T>>(layers_, parameters_, num_replicas);
+    synchronization_ = synchronization;
+   }
+
+   size_t replicas() const { return data_parallel_ ? data_parallel_->size() : 1; }
+
+   bool hogwild() const { return data_parallel_ && synchronization_ == Synchronization::HOGWILD; }
+
+   // The arena once set_optimizer() was called, null before
+   const ParameterArena<T>* parameters() const { return parameters_.get(); }
+
    // Forward pass through all layers
    Matrix<T> forward(const Matrix<T>& input) {
+    return forward_layers(input);
+   }
+
+   /*
+    * Inference only forward pass: layers don't cache anything for backward and the intermediate
+    * outputs live in two buffers owned by the network, so after the first call with a given batch
+    * size no memory is allocated. The returned matrix is overwritten by the next predict() call;
+    * it can be passed back in, as in predict(predict(x)).
+    */
+   const Matrix<T>& predict(const Matrix<T>& input) {
     if (layers_.empty()) {
      throw std::runtime_error("network has no layers");
     }
 
-    Matrix<T> current_output = input;
-
-    for (auto& layer : layers_) {
-     current_output = layer->forward(current_output);
+    // an input in the first buffer makes the first layer write the other one
+    const size_t first = &input == &inference_buffers_[0] ? 1 : 0;
+    const Matrix<T>* current = &input;
+    for (size_t i = 0; i < layers_.size(); ++i) {
+     Matrix<T>& output = inference_buffers_[(first + i) % 2];
+     layers_[i]->infer(*current, output);
+     current = &output;
     }
 
-    return current_output;
+    return *current;
    }
 
-   // Backward pass through all layers
+   /*
+    * The loss the network trains on (see loss.hpp), e.g. SoftmaxCrossEntropy on the logits of an
+    * Identity output layer. Null goes back to the default, mean squared error. The loss must
+    * outlive its use by the network.
+    */
+   void set_loss(Loss<T>* loss) { loss_ = loss; }
+
+   Loss<T>& loss() { return loss_ ? *loss_ : default_loss_; }
+
+   // Loss of the last backward pass, averaged over its samples
+   T last_loss() const { return last_loss_; }
+
+   // Backward pass through all layers, from the loss of output against the target columns
    void backward(const Matrix<T>& target, const Matrix<T>& output) {
     if (layers_.empty()) {
      throw std::runtime_error("network has no layers");
     }
 
-    // Calculate initial error gradient based on the loss function
-    Matrix<T> gradient = output - target; // for MSE loss
+    // loss and its gradient with respect to the output, in one pass
+    last_loss_ = loss().evaluate(output, target, output_gradient_);
+    backpropagate();
+   }
+
+   // Same with the class index of each sample (labels has output.columns() entries)
+   void backward(const uint32_t* labels, const Matrix<T>& output) {
+    if (layers_.empty()) {
+     throw std::runtime_error("network has no layers");
+    }
 
-    // Backprpagate through layers in reverse order
+    last_loss_ = loss().evaluate(output, labels, output_gradient_);
+    backpropagate();
+   }
+
+  private:
+   // Backpropagate output_gradient_ through the layers in reverse order
+   void backpropagate() {
+    const Matrix<T>* gradient = &output_gradient_;
     for (int i = layers_.size() - 1; i >= 0; --i) {
-     gradient = layers_[i]->backward(gradient);
+     gradient = &layers_[i]->backward(*gradient);
+    }
+
+    if (optimizer_) {
+     update_parameters();
     }
    }
 
-   Matrix<T> train_step(const Matrix<T>& input, const Matrix<T>& target) {
-    Matrix<T> output = forward(input);
+  public:
+
+   /*
+    * One forward and backward pass. Layers and network keep their intermediates in reused
+    * workspaces, so once they are sized for the batch a step does not allocate.
+    * The returned output is owned by the last layer and overwritten by the next step.
+    */
+   const Matrix<T>& train_step(const Matrix<T>& input, const Matrix<T>& target) {
+    if (data_parallel_) {
+     last_loss_ = data_parallel_->step(input, &target, nullptr, loss(), parallel_output_);
+     update_parameters();
+     return parallel_output_;
+    }
+    const Matrix<T>& output = forward_layers(input);
     backward(target, output);
     return output;
    }
 
+   // Same with the class index of each sample (input column) instead of target columns
+   const Matrix<T>& train_step(const Matrix<T>& input, const std::vector<uint32_t>& labels) {
+    if (labels.size() != input.columns()) {
+     throw std::invalid_argument("number of labels must match the batch size");
+    }
+    if (data_parallel_) {
+     last_loss_ = data_parallel_->step(input, nullptr, labels.data(), loss(), parallel_output_);
+     update_parameters();
+     return parallel_output_;
+    }
+    const Matrix<T>& output = forward_layers(input);
+    backward(labels.data(), output);
+    return output;
+   }
+
    void train(const std::vector<Matrix<T>>& inputs,
      const std::vector<Matrix<T>>& targets,
      size_t epochs, size_t batch_size = 1) {
-    /*
-     * As one can tell, this training loop is aimed for a classification task.
-     */
-
     if (inputs.size() != targets.size()) {
      throw std::invalid_argument("number of inputs must match number of targets");
     }
 
+    train_batches(inputs.size(), epochs, batch_size, [&](size_t first, size_t count, Batch<T>& batch) -> const Batch<T>& {
+     stack_columns(inputs, first, count, batch.inputs);
+     stack_columns(targets, first, count, batch.targets);
+     batch.labels.clear();
+     return batch;
+    });
+   }
+
+   /*
+    * Same loop over a contiguous data set, each batch is gathered straight from its storage.
+    * A class index data set trains on the labels, without building one-hot targets.
+    */
+   void train(const Dataset<T>& data, size_t epochs, size_t batch_size = 1) {
+    train_batches(data.size(), epochs, batch_size, [&](size_t first, size_t count, Batch<T>& batch) -> const Batch<T>& {
+     if (data.kind() == Targets::CLASS_INDICES) {
+      data.gather(first, count, batch.inputs, batch.labels);
+     } else {
+      data.gather(first, count, batch.inputs, batch.targets);
+      batch.labels.clear();
+     }
+     return batch;
+    });
+   }
+
+   /*
+    * Same loop with the batches prepared ahead by a loader thread (in the loader's order, shuffled
+    * or not). Epochs continue where the previous call to train() left the loader.
+    * Hogwild! replicas take the batches in turn and copy them, as the loader hands out one at a time.
+    */
+   void train(BatchLoader<T>& loader, size_t epochs) {
+    if (hogwild()) {
+     std::mutex mutex;
+     train_batches(loader.size(), epochs, loader.batch_size(), [&](size_t, size_t, Batch<T>& batch) -> const Batch<T>& {
+      std::lock_guard<std::mutex> lock(mutex);
+      const Batch<T>& next = loader.next();
+      batch.inputs = next.inputs;
+      batch.targets = next.targets;
+      batch.labels = next.labels;
+      return batch;
+     });
+     return;
+    }
+    train_batches(loader.size(), epochs, loader.batch_size(), [&](size_t, size_t, Batch<T>&) -> const Batch<T>& {
+     return loader.next();
+    });
+   }
+
+   // Public for testing
+   // The training loss (MSE by default), averaged over the samples (columns) of the batch
+   T calculate_loss(const Matrix<T>& output, const Matrix<T>& target) {
+    return loss().loss(output, target);
+   }
+
+   // Public for testing
+   bool is_prediction_correct(const Matrix<T>& output, const Matrix<T>& target) {
+    return predicted_class(output, 0) == predicted_class(target, 0);
+   }
+
+   // Number of samples (columns) whose highest output matches the target class
+   size_t count_correct_predictions(const Matrix<T>& output, const Matrix<T>& target) {
+    size_t correct = 0;
+    for (size_t j = 0; j < output.columns(); ++j) {
+     if (predicted_class(output, j) == predicted_class(target, j)) {
+      correct++;
+     }
+    }
+    return correct;
+   }
+
+   size_t count_correct_predictions(const Matrix<T>& output, const std::vector<uint32_t>& labels) {
+    size_t correct = 0;
+    for (size_t j = 0; j < output.columns(); ++j) {
+     if (predicted_class(output, j) == labels[j]) {
+      correct++;
+     }
+    }
+    return correct;
+   }
+
+  private:
+   // One optimizer step over the whole arena: all weights in one pass, all biases in another
+   void update_parameters() {
+    Matrix<T> weights = parameters_->weight_block();
+    Matrix<T> bias = parameters_->bias_block();
+    optimizer_->update(weights, bias, parameters_->weight_gradient_block(), parameters_->bias_gradient_block());
+    for (auto& layer : layers_) {
+     layer->parameters_updated();
+    }
+   }
+
+   // The network optimizer as the SGD the Hogwild! replicas step with
+   const SGD<T>& hogwild_optimizer() const {
+    const auto* sgd = dynamic_cast<const SGD<T>*>(optimizer_);
+    if (!sgd) {
+     throw std::invalid_argument("Hogwild! training needs an SGD network optimizer");
+    }
+    return *sgd;
+   }
+
+   /*
+    * As one can tell, this training loop is aimed for a classification task.
+    * Each mini-batch is stacked column-wise into a single (features x batch_size) matrix by
+    * load_batch(first, count, batch), which returns the batch to train on (batch, or one of its
+    * own), so every layer runs one matrix-matrix product and one optimizer step per batch.
+    */
+   template<typename LoadBatch>
+   void train_batches(size_t num_samples, size_t epochs, size_t batch_size, LoadBatch load_batch) {
+    if (batch_size == 0) {
+     throw std::invalid_argument("batch size must be positive");
+    }
+
+    if (num_samples == 0) {
+     return;
+    }
+
+    if (hogwild()) {
+     train_hogwild(num_samples, epochs, batch_size, load_batch);
+     return;
+    }
+
     for (size_t epoch = 0; epoch < epochs; ++epoch) {
      T total_loss = 0;
      size_t correct_predictions = 0;
+     NN_PROFILE_BEGIN_EPOCH();
 
      // Training loop with batch support
-     for (size_t i = 0; i < inputs.size(); i += batch_size) {
-      size_t current_batch_size = std::min(batch_size, inputs.size() - i);
+     for (size_t i = 0; i < num_samples; i += batch_size) {
+      size_t current_batch_size = std::min(batch_size, num_samples - i);
 
-      // Process one batch
-      for (size_t j = 0; j < current_batch_size; ++j) {
-       Matrix<T> output = train_step(inputs[i+j], targets[i+j]);
+      const Batch<T>& batch = load_batch(i, current_batch_size, batch_);
 
-       T sample_loss = calculate_loss(output, targets[i+j]);
-       total_loss += sample_loss;
+      // Process one batch, on the labels when the batch has them
+      const bool labeled = batch.labels.size() == current_batch_size;
+      const Matrix<T>& output = labeled ? train_step(batch.inputs, batch.labels) : train_step(batch.inputs, batch.targets);
 
-       if (is_prediction_correct(output, targets[i+j])) {
-        correct_predictions++;
-       }
-      }
+      total_loss += last_loss_ * current_batch_size;
+      correct_predictions += labeled ? count_correct_predictions(output, batch.labels)
+       : count_correct_predictions(output, batch.targets);
 
       if (verbosity_ == Verbosity::DETAILED && (i/batch_size) % 10 == 0) {
        std::cout << "Epoch " << epoch+1 << ", Batch " << i/batch_size
@@ -113,51 +420,105 @@ namespace nn {
       }
      }
 
-     if (verbosity_ >= Verbosity::MINIMAL) {
-      T avg_loss = total_loss / inputs.size();
-      float accuracy = static_cast<float>(correct_predictions) / inputs.size() * 100;
+     NN_PROFILE_END_EPOCH();
+     print_epoch(epoch, epochs, total_loss, correct_predictions, num_samples);
+    }
+   }
 
-      std::cout << "Epoch " << epoch+1 << "/" << epochs
-       << ", Loss: " << avg_loss
-       << ", Accuracy: " << accuracy << "%" << std::endl;
+   /*
+    * The same epochs with the Hogwild! replicas, each one loading and training on the batches it
+    * takes (see DataParallel::hogwild). Loss and accuracy are summed per replica, then per epoch.
+    */
+   template<typename LoadBatch>
+   void train_hogwild(size_t num_samples, size_t epochs, size_t batch_size, LoadBatch load_batch) {
+    const SGD<T>& sgd = hogwild_optimizer();
+    const std::vector<T> settings = sgd.settings();  // learning rate, momentum
+    const size_t num_batches = (num_samples + batch_size - 1) / batch_size;
+    std::vector<T> losses(data_parallel_->size());
+    std::vector<size_t> correct(data_parallel_->size());
+
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+     std::fill(losses.begin(), losses.end(), static_cast<T>(0));
+     std::fill(correct.begin(), correct.end(), size_t{0});
+     NN_PROFILE_BEGIN_EPOCH();
+     data_parallel_->hogwild(num_batches,
+      [&](size_t b, Batch<T>& batch) -> const Batch<T>& {
+       return load_batch(b * batch_size, std::min(batch_size, num_samples - b * batch_size), batch);
+      },
+      [&](size_t r, const Batch<T>& batch, const Matrix<T>& output, T loss) {
+       const bool labeled = batch.labels.size() == output.columns();
+       losses[r] += loss * output.columns();
+       correct[r] += labeled ? count_correct_predictions(output, batch.labels)
+        : count_correct_predictions(output, batch.targets);
+      },
+      loss(), settings[0], settings[1]);
+
+     // narrow weight copies of the layers themselves, for predict()
+     for (auto& layer : layers_) {
+      layer->parameters_updated();
      }
+
+     T total_loss = 0;
+     size_t correct_predictions = 0;
+     for (size_t r = 0; r < losses.size(); r++) {
+      total_loss += losses[r];
+      correct_predictions += correct[r];
+     }
+     last_loss_ = total_loss / num_samples;
+     NN_PROFILE_END_EPOCH();
+     print_epoch(epoch, epochs, total_loss, correct_predictions, num_samples);
     }
    }
 
-   // Public for testing
-   T calculate_loss(const Matrix<T>& output, const Matrix<T>& target) {
-    // MSE
-    T sum_squared_error = 0;
-    for (size_t i = 0; i < output.rows(); ++i) {
-     T error = output.at(i, 0) - target.at(i, 0);
-     sum_squared_error += error * error;
+   void print_epoch(size_t epoch, size_t epochs, T total_loss, size_t correct_predictions, size_t num_samples) const {
+    if (verbosity_ >= Verbosity::MINIMAL) {
+     T avg_loss = total_loss / num_samples;
+     float accuracy = static_cast<float>(correct_predictions) / num_samples * 100;
+
+     std::cout << "Epoch " << epoch+1 << "/" << epochs
+      << ", Loss: " << avg_loss
+      << ", Accuracy: " << accuracy << "%" << std::endl;
+    }
+#ifdef NN_PROFILE
+    // where the time of the epoch went (see profiler.hpp)
+    const profile::Profiler& profiler = profile::profiler();
+    if (verbosity_ == Verbosity::DETAILED && profiler.enabled() && !profiler.epochs().empty()) {
+     profile::Profiler::print_summary(std::cout, profiler.epochs().back());
     }
-    return sum_squared_error / output.rows();
+#endif
    }
 
-   // Public for testing
-   bool is_prediction_correct(const Matrix<T>& output, const Matrix<T>& target) {
-    size_t predicted_class = 0;
-    T max_value = output.at(0, 0);
+   // Row of the highest value in the given column
+   static size_t predicted_class(const Matrix<T>& m, size_t column) {
+    size_t predicted = 0;
+    T max_value = m.at(0, column);
 
-    for (size_t i = 1; i < output.rows(); ++i) {
-     if (output.at(i, 0) > max_value) { // check if highest probability matches target
-      max_value = output.at(i, 0);
-      predicted_class = i;
+    for (size_t i = 1; i < m.rows(); ++i) {
+     if (m.at(i, column) > max_value) {
+      max_value = m.at(i, column);
+      predicted = i;
      }
     }
 
-    size_t target_class = 0;
-    T target_max = target.at(0, 0);
+    return predicted;
+   }
 
-    for (size_t i = 1; i < target.rows(); ++i) {
-     if (target.at(i, 0) > target_max) {
-      target_max = target.at(i, 0);
-      target_class = i;
+   // Place samples[first, first + count) side by side in batch, one per column
+   static void stack_columns(const std::vector<Matrix<T>>& samples, size_t first, size_t count, Matrix<T>& batch) {
+    const size_t rows = samples[first].rows();
+    batch.resize(rows, count);
+
+    for (size_t j = 0; j < count; ++j) {
+     const Matrix<T>& sample = samples[first + j];
+     if (sample.rows() != rows || sample.columns() != 1) {
+      throw std::invalid_argument("samples must be column vectors of the same size");
+     }
+     const T* src = sample.data();
+     T* dst = batch.data();
+     for (size_t i = 0; i < rows; ++i) {
+      dst[i * batch.stride() + j] = src[i * sample.stride()];
      }
     }
-
-    return predicted_class == target_class;
    }
  };
 }
@@ -1,7 +1,13 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "matrix.hpp"
+#include "optimizer_kernels.hpp"
+#include "profiler.hpp"
 
 namespace nn {
 
@@ -21,8 +27,52 @@ namespace nn {
    T learning_rate() const { return learning_rate_; }
    void set_learning_rate(T lr) { learning_rate_ = lr; }
 
+   /*
+    * Checkpointing (see checkpoint.hpp): the algorithm's name, its scalar settings with the
+    * learning rate first, and its state buffers, which are empty matrices before the first update.
+    * The buffers of the weights come first, then as many of the bias, each of the shape of its
+    * parameters. Restoring state resizes the buffers to the stored shapes.
+    */
+   virtual const char* name() const { return "custom"; }
+
+   virtual std::vector<T> settings() const { return {learning_rate_}; }
+
+   virtual void restore_settings(const std::vector<T>& settings) {
+    if (settings.empty()) {
+     throw std::invalid_argument(std::string(__func__) + ": missing learning rate");
+    }
+    learning_rate_ = settings[0];
+   }
+
+   virtual std::vector<Matrix<T>*> state() { return {}; }
+
   protected:
    T learning_rate_;
+
+   // Number of parameters of an update, for the profile (see profiler.hpp)
+   static double parameter_count(const Matrix<T>& weights, const Matrix<T>& bias) {
+    return static_cast<double>(weights.rows() * weights.columns() + bias.rows() * bias.columns());
+   }
+
+   /*
+    * The kernels walk the parameters, their gradients and the state buffers as flat arrays of the
+    * same length: each must have the shape of the parameters. The state is sized by the first
+    * update, so an optimizer shared by layers of different shapes fails here instead of running
+    * past its buffers (give each layer its own, or use Network::set_optimizer).
+    */
+   static void check_shape(const Matrix<T>& m, const Matrix<T>& parameters, const char* what) {
+    if (m.rows() != parameters.rows() || m.columns() != parameters.columns()) {
+     throw std::invalid_argument(std::string("update: ") + what + " is " + std::to_string(m.rows()) + "x"
+       + std::to_string(m.columns()) + ", the parameters " + std::to_string(parameters.rows()) + "x"
+       + std::to_string(parameters.columns()));
+    }
+   }
+
+   static void check_gradients(const Matrix<T>& weights, const Matrix<T>& bias,
+     const Matrix<T>& weight_gradients, const Matrix<T>& bias_gradients) {
+    check_shape(weight_gradients, weights, "weight gradient");
+    check_shape(bias_gradients, bias, "bias gradient");
+   }
  };
 
  template<typename T>
@@ -38,42 +88,218 @@ namespace nn {
      Matrix<T>& bias,
      const Matrix<T>& weight_gradients,
      const Matrix<T>& bias_gradients) override {
+    // w, gradient and velocity read, w and velocity written
+    NN_PROFILE_SCOPE("SGD::update", "optimizer", 4.0 * this->parameter_count(weights, bias),
+      5.0 * sizeof(T) * this->parameter_count(weights, bias));
 
     // init velocities in the first update
     if (weight_velocity_.rows() == 0) {
      weight_velocity_ = Matrix<T>(weights.rows(), weights.columns());
      bias_velocity_ = Matrix<T>(bias.rows(), bias.columns());
     }
+    this->check_gradients(weights, bias, weight_gradients, bias_gradients);
+    this->check_shape(weight_velocity_, weights, "weight velocity");
+    this->check_shape(bias_velocity_, bias, "bias velocity");
 
-    // update with momentum
-    for (size_t i = 0; i < weights.rows(); i++) {
-     for (size_t j = 0; j < weights.columns(); j++) {
-      // v = momentum * v - learning_rate * gradient
-      weight_velocity_.at(i, j) = 
-       momentum_ * weight_velocity_.at(i, j) - 
-       this->learning_rate_ * weight_gradients.at(i, j);
-
-      // w = w + v
-      weights.at(i, j) += weight_velocity_.at(i, j);
-     }
-    }
+    // v = momentum * v - learning_rate * gradient, w = w + v, in one pass (see optimizer_kernels.hpp)
+    kernels::sgd_update(weights.data(), weight_gradients.data(), weight_velocity_.data(),
+      weights.rows() * weights.columns(), this->learning_rate_, momentum_);
+    kernels::sgd_update(bias.data(), bias_gradients.data(), bias_velocity_.data(),
+      bias.rows() * bias.columns(), this->learning_rate_, momentum_);
+   }
 
-    // update biases
-    for (size_t i = 0; i < bias.rows(); i++) {
-     bias_velocity_.at(i, 0) = 
-      momentum_ * bias_velocity_.at(i, 0) - 
-      this->learning_rate_ * bias_gradients.at(i, 0);
+   const char* name() const override { return "sgd"; }
 
-     bias.at(i, 0) += bias_velocity_.at(i, 0);
+   std::vector<T> settings() const override { return {this->learning_rate_, momentum_}; }
+
+   void restore_settings(const std::vector<T>& settings) override {
+    if (settings.size() != 2) {
+     throw std::invalid_argument(std::string(__func__) + ": expected learning rate and momentum");
     }
+    this->learning_rate_ = settings[0];
+    momentum_ = settings[1];
    }
 
+   std::vector<Matrix<T>*> state() override { return {&weight_velocity_, &bias_velocity_}; }
+
   private:
    T momentum_;
    Matrix<T> weight_velocity_; // for momentum
    Matrix<T> bias_velocity_;
 
  };
+
+ /*
+  * Adam (Kingma & Ba): per-parameter step sizes from running averages of the gradient (m) and of
+  * its square (v), with bias correction for the zero initialized averages.
+  * The step count is part of the settings, so a restored checkpoint continues the schedule.
+  */
+ template<typename T>
+ class Adam: public Optimizer<T> {
+  public:
+   explicit Adam(T learning_rate = 0.001, T beta1 = 0.9, T beta2 = 0.999, T eps = 1e-8)
+    : Optimizer<T>(learning_rate), beta1_(beta1), beta2_(beta2), eps_(eps) {}
+
+   void update(Matrix<T>& weights,
+     Matrix<T>& bias,
+     const Matrix<T>& weight_gradients,
+     const Matrix<T>& bias_gradients) override {
+    NN_PROFILE_SCOPE("Adam::update", "optimizer", 12.0 * this->parameter_count(weights, bias),
+      7.0 * sizeof(T) * this->parameter_count(weights, bias));
+    if (weight_m_.rows() == 0) {
+     weight_m_ = Matrix<T>(weights.rows(), weights.columns());
+     weight_v_ = Matrix<T>(weights.rows(), weights.columns());
+     bias_m_ = Matrix<T>(bias.rows(), bias.columns());
+     bias_v_ = Matrix<T>(bias.rows(), bias.columns());
+    }
+    this->check_gradients(weights, bias, weight_gradients, bias_gradients);
+    this->check_shape(weight_m_, weights, "weight first moment");
+    this->check_shape(weight_v_, weights, "weight second moment");
+    this->check_shape(bias_m_, bias, "bias first moment");
+    this->check_shape(bias_v_, bias, "bias second moment");
+
+    step_++;
+    kernels::AdamStep<T> step = adam_step();
+    kernels::adam_update(weights.data(), weight_gradients.data(), weight_m_.data(), weight_v_.data(),
+      weights.rows() * weights.columns(), step);
+    step.decay = 1;  // no weight decay on the bias
+    kernels::adam_update(bias.data(), bias_gradients.data(), bias_m_.data(), bias_v_.data(),
+      bias.rows() * bias.columns(), step);
+   }
+
+   size_t step() const { return step_; }
+
+   const char* name() const override { return "adam"; }
+
+   std::vector<T> settings() const override {
+    return {this->learning_rate_, beta1_, beta2_, eps_, static_cast<T>(step_)};
+   }
+
+   void restore_settings(const std::vector<T>& settings) override {
+    if (settings.size() != 5) {
+     throw std::invalid_argument(std::string(__func__) + ": expected learning rate, betas, epsilon and step");
+    }
+    this->learning_rate_ = settings[0];
+    beta1_ = settings[1];
+    beta2_ = settings[2];
+    eps_ = settings[3];
+    step_ = static_cast<size_t>(settings[4]);
+   }
+
+   std::vector<Matrix<T>*> state() override { return {&weight_m_, &weight_v_, &bias_m_, &bias_v_}; }
+
+  protected:
+   T beta1_;
+   T beta2_;
+   T eps_;
+   size_t step_ = 0;
+
+   // Multiplier of the weights before the step, 1 - lr * weight decay for AdamW
+   virtual T weight_decay_factor() const { return 1; }
+
+  private:
+   Matrix<T> weight_m_ = Matrix<T>(0, 0);  // first moments, resized on first update
+   Matrix<T> weight_v_ = Matrix<T>(0, 0);  // second moments
+   Matrix<T> bias_m_ = Matrix<T>(0, 0);
+   Matrix<T> bias_v_ = Matrix<T>(0, 0);
+
+   kernels::AdamStep<T> adam_step() const {
+    const T t = static_cast<T>(step_);
+    kernels::AdamStep<T> step;
+    step.step_size = this->learning_rate_ / (1 - std::pow(beta1_, t));
+    step.beta1 = beta1_;
+    step.beta2 = beta2_;
+    step.correction = 1 / std::sqrt(1 - std::pow(beta2_, t));
+    step.eps = eps_;
+    step.decay = weight_decay_factor();
+    return step;
+   }
+ };
+
+ /*
+  * AdamW (Loshchilov & Hutter): Adam with the weight decay decoupled from the gradient, the
+  * weights shrink by lr * weight_decay each step, independently of the adaptive step size.
+  * The bias is not decayed.
+  */
+ template<typename T>
+ class AdamW: public Adam<T> {
+  public:
+   explicit AdamW(T learning_rate = 0.001, T weight_decay = 0.01, T beta1 = 0.9, T beta2 = 0.999, T eps = 1e-8)
+    : Adam<T>(learning_rate, beta1, beta2, eps), weight_decay_(weight_decay) {}
+
+   const char* name() const override { return "adamw"; }
+
+   std::vector<T> settings() const override {
+    std::vector<T> values = Adam<T>::settings();
+    values.push_back(weight_decay_);
+    return values;
+   }
+
+   void restore_settings(const std::vector<T>& settings) override {
+    if (settings.size() != 6) {
+     throw std::invalid_argument(std::string(__func__) + ": expected learning rate, betas, epsilon, step and weight decay");
+    }
+    Adam<T>::restore_settings(std::vector<T>(settings.begin(), settings.end() - 1));
+    weight_decay_ = settings[5];
+   }
+
+  protected:
+   T weight_decay_factor() const override { return 1 - this->learning_rate_ * weight_decay_; }
+
+  private:
+   T weight_decay_;
+ };
+
+ /*
+  * RMSProp: the step of each parameter is divided by a running root mean square of its gradients.
+  */
+ template<typename T>
+ class RMSProp: public Optimizer<T> {
+  public:
+   explicit RMSProp(T learning_rate = 0.001, T rho = 0.9, T eps = 1e-8)
+    : Optimizer<T>(learning_rate), rho_(rho), eps_(eps) {}
+
+   void update(Matrix<T>& weights,
+     Matrix<T>& bias,
+     const Matrix<T>& weight_gradients,
+     const Matrix<T>& bias_gradients) override {
+    NN_PROFILE_SCOPE("RMSProp::update", "optimizer", 9.0 * this->parameter_count(weights, bias),
+      5.0 * sizeof(T) * this->parameter_count(weights, bias));
+    if (weight_square_.rows() == 0) {
+     weight_square_ = Matrix<T>(weights.rows(), weights.columns());
+     bias_square_ = Matrix<T>(bias.rows(), bias.columns());
+    }
+    this->check_gradients(weights, bias, weight_gradients, bias_gradients);
+    this->check_shape(weight_square_, weights, "weight mean square");
+    this->check_shape(bias_square_, bias, "bias mean square");
+
+    kernels::rmsprop_update(weights.data(), weight_gradients.data(), weight_square_.data(),
+      weights.rows() * weights.columns(), this->learning_rate_, rho_, eps_);
+    kernels::rmsprop_update(bias.data(), bias_gradients.data(), bias_square_.data(),
+      bias.rows() * bias.columns(), this->learning_rate_, rho_, eps_);
+   }
+
+   const char* name() const override { return "rmsprop"; }
+
+   std::vector<T> settings() const override { return {this->learning_rate_, rho_, eps_}; }
+
+   void restore_settings(const std::vector<T>& settings) override {
+    if (settings.size() != 3) {
+     throw std::invalid_argument(std::string(__func__) + ": expected learning rate, rho and epsilon");
+    }
+    this->learning_rate_ = settings[0];
+    rho_ = settings[1];
+    eps_ = settings[2];
+   }
+
+   std::vector<Matrix<T>*> state() override { return {&weight_square_, &bias_square_}; }
+
+  private:
+   T rho_;
+   T eps_;
+   Matrix<T> weight_square_ = Matrix<T>(0, 0);  // running mean of the squared gradients
+   Matrix<T> bias_square_ = Matrix<T>(0, 0);
+ };
 }
 
 #endif
@@ -0,0 +1,206 @@
+ /*
+  * Fused optimizer kernels
+  *
+  * One pass over contiguous parameter, gradient and state buffers per update: every element is
+  * loaded once, updated in registers and stored once, with no temporaries. For n elements:
+  *
+  * sgd:     v = momentum * v - lr * g;  w += v
+  * adam:    m = beta1 * m + (1 - beta1) * g;  v = beta2 * v + (1 - beta2) * g^2
+  *          w = decay * w - step_size * m / (sqrt(v) * correction + eps)
+  *          (the bias corrections are folded by the caller into step_size = lr / (1 - beta1^t) and
+  *          correction = 1 / sqrt(1 - beta2^t); decay = 1 - lr * weight_decay for AdamW, else 1)
+  * rmsprop: v = rho * v + (1 - rho) * g^2;  w -= lr * g / (sqrt(v) + eps)
+  *
+  * Float buffers run on AVX2/AVX-512 (true division and square root, no approximations), the
+  * tail and other types use the same formulas in scalar code. Large buffers are split over the
+  * library thread pool.
+ */
+
+#ifndef OPTIMIZER_KERNELS_H
+#define OPTIMIZER_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+namespace nn {
+ namespace kernels {
+
+  template<typename T>
+  struct AdamStep {
+   T step_size;   // lr / (1 - beta1^t)
+   T beta1;
+   T beta2;
+   T correction;  // 1 / sqrt(1 - beta2^t)
+   T eps;
+   T decay;       // 1 - lr * weight_decay (AdamW), 1 for Adam
+  };
+
+  namespace detail {
+   // Elements per task when an update is split over the thread pool
+   constexpr size_t kOptimizerGrain = 1 << 15;
+
+   template<typename T>
+   void sgd_scalar(T* w, const T* g, T* v, size_t n, T lr, T momentum) {
+    for (size_t i = 0; i < n; i++) {
+     v[i] = momentum * v[i] - lr * g[i];
+     w[i] += v[i];
+    }
+   }
+
+   template<typename T>
+   void adam_scalar(T* w, const T* g, T* m, T* v, size_t n, const AdamStep<T>& s) {
+    const T one = static_cast<T>(1);
+    for (size_t i = 0; i < n; i++) {
+     m[i] = s.beta1 * m[i] + (one - s.beta1) * g[i];
+     v[i] = s.beta2 * v[i] + (one - s.beta2) * g[i] * g[i];
+     w[i] = s.decay * w[i] - s.step_size * m[i] / (std::sqrt(v[i]) * s.correction + s.eps);
+    }
+   }
+
+   template<typename T>
+   void rmsprop_scalar(T* w, const T* g, T* v, size_t n, T lr, T rho, T eps) {
+    const T one = static_cast<T>(1);
+    for (size_t i = 0; i < n; i++) {
+     v[i] = rho * v[i] + (one - rho) * g[i] * g[i];
+     w[i] -= lr * g[i] / (std::sqrt(v[i]) + eps);
+    }
+   }
+
+#if NN_X86_DISPATCH
+   // V is one of the float Vec* structs of simd.hpp, stamped out per target like the other kernels
+#define NN_DEFINE_VECTOR_OPTIMIZERS(ns, target)                                               \
+   namespace ns {                                                                             \
+    template<typename V>                                                                      \
+    target void sgd(float* w, const float* g, float* v, size_t n, float lr, float momentum) { \
+     const auto neg_lr = V::broadcast(-lr);                                                   \
+     const auto mom = V::broadcast(momentum);                                                 \
+     size_t i = 0;                                                                            \
+     for (; i + V::width <= n; i += V::width) {                                               \
+      const auto vi = V::fmadd(mom, V::load(v + i), V::mul(neg_lr, V::load(g + i)));          \
+      V::store(v + i, vi);                                                                    \
+      V::store(w + i, V::add(V::load(w + i), vi));                                            \
+     }                                                                                        \
+     sgd_scalar(w + i, g + i, v + i, n - i, lr, momentum);                                    \
+    }                                                                                         \
+                                                                                              \
+    template<typename V>                                                                      \
+    target void adam(float* w, const float* g, float* m, float* v, size_t n,                  \
+      const AdamStep<float>& s) {                                                             \
+     const auto beta1 = V::broadcast(s.beta1);                                                \
+     const auto beta2 = V::broadcast(s.beta2);                                                \
+     const auto rest1 = V::broadcast(1.0f - s.beta1);                                         \
+     const auto rest2 = V::broadcast(1.0f - s.beta2);                                         \
+     const auto step = V::broadcast(s.step_size);                                             \
+     const auto correction = V::broadcast(s.correction);                                      \
+     const auto eps = V::broadcast(s.eps);                                                    \
+     const auto decay = V::broadcast(s.decay);                                                \
+     size_t i = 0;                                                                            \
+     for (; i + V::width <= n; i += V::width) {                                               \
+      const auto gi = V::load(g + i);                                                         \
+      const auto mi = V::fmadd(beta1, V::load(m + i), V::mul(rest1, gi));                     \
+      const auto vi = V::fmadd(beta2, V::load(v + i), V::mul(V::mul(rest2, gi), gi));         \
+      const auto denominator = V::fmadd(V::sqrt(vi), correction, eps);                        \
+      V::store(m + i, mi);                                                                    \
+      V::store(v + i, vi);                                                                    \
+      V::store(w + i, V::sub(V::mul(decay, V::load(w + i)), V::div(V::mul(step, mi), denominator))); \
+     }                                                                                        \
+     adam_scalar(w + i, g + i, m + i, v + i, n - i, s);                                       \
+    }                                                                                         \
+                                                                                              \
+    template<typename V>                                                                      \
+    target void rmsprop(float* w, const float* g, float* v, size_t n,                         \
+      float lr, float rho, float eps) {                                                       \
+     const auto rate = V::broadcast(lr);                                                      \
+     const auto decay = V::broadcast(rho);                                                    \
+     const auto rest = V::broadcast(1.0f - rho);                                              \
+     const auto epsilon = V::broadcast(eps);                                                  \
+     size_t i = 0;                                                                            \
+     for (; i + V::width <= n; i += V::width) {                                               \
+      const auto gi = V::load(g + i);                                                         \
+      const auto vi = V::fmadd(decay, V::load(v + i), V::mul(V::mul(rest, gi), gi));         \
+      V::store(v + i, vi);                                                                    \
+      const auto delta = V::div(V::mul(rate, gi), V::add(V::sqrt(vi), epsilon));              \
+      V::store(w + i, V::sub(V::load(w + i), delta));                                         \
+     }                                                                                        \
+     rmsprop_scalar(w + i, g + i, v + i, n - i, lr, rho, eps);                                \
+    }                                                                                         \
+   }
+
+   NN_DEFINE_VECTOR_OPTIMIZERS(avx2, NN_TARGET_AVX2)
+   NN_DEFINE_VECTOR_OPTIMIZERS(avx512, NN_TARGET_AVX512)
+#undef NN_DEFINE_VECTOR_OPTIMIZERS
+#endif
+  }
+
+  template<typename T>
+  void sgd_update(T* w, const T* g, T* v, size_t n, T lr, T momentum) {
+   nn::parallel_for(0, n, detail::kOptimizerGrain, [=](size_t lo, size_t hi) {
+#if NN_X86_DISPATCH
+    if constexpr (std::is_same<T, float>::value) {
+     switch (simd::active_isa()) {
+      case simd::Isa::AVX512:
+       detail::avx512::sgd<simd::VecAvx512Float>(w + lo, g + lo, v + lo, hi - lo, lr, momentum);
+       return;
+      case simd::Isa::AVX2:
+       detail::avx2::sgd<simd::VecAvx2Float>(w + lo, g + lo, v + lo, hi - lo, lr, momentum);
+       return;
+      case simd::Isa::SCALAR:
+      default:
+       break;
+     }
+    }
+#endif
+    detail::sgd_scalar(w + lo, g + lo, v + lo, hi - lo, lr, momentum);
+   });
+  }
+
+  template<typename T>
+  void adam_update(T* w, const T* g, T* m, T* v, size_t n, const AdamStep<T>& step) {
+   nn::parallel_for(0, n, detail::kOptimizerGrain, [=, &step](size_t lo, size_t hi) {
+#if NN_X86_DISPATCH
+    if constexpr (std::is_same<T, float>::value) {
+     switch (simd::active_isa()) {
+      case simd::Isa::AVX512:
+       detail::avx512::adam<simd::VecAvx512Float>(w + lo, g + lo, m + lo, v + lo, hi - lo, step);
+       return;
+      case simd::Isa::AVX2:
+       detail::avx2::adam<simd::VecAvx2Float>(w + lo, g + lo, m + lo, v + lo, hi - lo, step);
+       return;
+      case simd::Isa::SCALAR:
+      default:
+       break;
+     }
+    }
+#endif
+    detail::adam_scalar(w + lo, g + lo, m + lo, v + lo, hi - lo, step);
+   });
+  }
+
+  template<typename T>
+  void rmsprop_update(T* w, const T* g, T* v, size_t n, T lr, T rho, T eps) {
+   nn::parallel_for(0, n, detail::kOptimizerGrain, [=](size_t lo, size_t hi) {
+#if NN_X86_DISPATCH
+    if constexpr (std::is_same<T, float>::value) {
+     switch (simd::active_isa()) {
+      case simd::Isa::AVX512:
+       detail::avx512::rmsprop<simd::VecAvx512Float>(w + lo, g + lo, v + lo, hi - lo, lr, rho, eps);
+       return;
+      case simd::Isa::AVX2:
+       detail::avx2::rmsprop<simd::VecAvx2Float>(w + lo, g + lo, v + lo, hi - lo, lr, rho, eps);
+       return;
+      case simd::Isa::SCALAR:
+      default:
+       break;
+     }
+    }
+#endif
+    detail::rmsprop_scalar(w + lo, g + lo, v + lo, hi - lo, lr, rho, eps);
+   });
+  }
+ }
+}
+
+#endif
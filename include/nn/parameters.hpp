@@ -0,0 +1,130 @@
+ /*
+  * Parameter arena
+  *
+  * The weights and biases of every layer of a network in one contiguous buffer, and their
+  * gradients in a second buffer with the same layout:
+  *
+  *   [ weights of layer 0 | weights of layer 1 | ... | bias of layer 0 | bias of layer 1 | ... ]
+  *
+  * Every matrix starts on a kAlignment byte boundary, the padding between them stays zero (its
+  * gradient is zero too, so no optimizer moves it). Weights come first so that an optimizer can
+  * sweep all of them in one pass and all the biases in a second one, which keeps the biases out
+  * of the weight decay of AdamW.
+  *
+  * Layers bind to a slot with LayerBase::bind_parameters(): their weight, bias and gradient
+  * matrices then borrow the arena's storage, and hold a reference to the arena so it lives as long
+  * as any of them.
+  *
+  * sharing_values() makes an arena of the same layout that reads the values of another one and
+  * has gradients of its own, for the replicas of data-parallel training (see data_parallel.hpp).
+ */
+
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "matrix.hpp"
+
+namespace nn {
+
+ template<typename T>
+ class ParameterArena {
+  public:
+   static constexpr size_t kAlignment = 64;
+
+   // One slot per (output_size, input_size) pair: weights of that shape and an output_size bias
+   explicit ParameterArena(const std::vector<std::pair<size_t, size_t>>& shapes) : shapes_(shapes) {
+    lay_out();
+    values_storage_.resize(size_);
+    values_ = values_storage_.data();
+   }
+
+   // An arena with the values of source (kept alive by the result) and zeroed gradients of its own
+   static std::shared_ptr<ParameterArena> sharing_values(std::shared_ptr<ParameterArena> source) {
+    return std::shared_ptr<ParameterArena>(new ParameterArena(std::move(source)));
+   }
+
+   ParameterArena(const ParameterArena&) = delete;
+   ParameterArena& operator=(const ParameterArena&) = delete;
+
+   size_t num_slots() const { return shapes_.size(); }
+   size_t size() const { return size_; }                // elements, padding included
+   size_t num_weights() const { return num_weights_; }  // elements of the weight region
+
+   T* values() { return values_; }
+   const T* values() const { return values_; }
+   T* gradients() { return gradients_; }
+   const T* gradients() const { return gradients_; }
+
+   // Matrices borrowing the storage of slot i
+   Matrix<T> weights(size_t i) { return Matrix<T>::borrow(values_ + weight_offset(i), rows(i), columns(i)); }
+   Matrix<T> bias(size_t i) { return Matrix<T>::borrow(values_ + bias_offset(i), rows(i), 1); }
+   Matrix<T> weight_gradients(size_t i) { return Matrix<T>::borrow(gradients_ + weight_offset(i), rows(i), columns(i)); }
+   Matrix<T> bias_gradients(size_t i) { return Matrix<T>::borrow(gradients_ + bias_offset(i), rows(i), 1); }
+
+   // The whole weight and bias regions as single rows, for one optimizer sweep over each
+   Matrix<T> weight_block() { return Matrix<T>::borrow(values_, 1, num_weights_); }
+   Matrix<T> bias_block() { return Matrix<T>::borrow(values_ + num_weights_, 1, size_ - num_weights_); }
+   Matrix<T> weight_gradient_block() { return Matrix<T>::borrow(gradients_, 1, num_weights_); }
+   Matrix<T> bias_gradient_block() { return Matrix<T>::borrow(gradients_ + num_weights_, 1, size_ - num_weights_); }
+
+  private:
+   explicit ParameterArena(std::shared_ptr<ParameterArena> source)
+    : shapes_(source->shapes_), values_owner_(std::move(source)) {
+    lay_out();
+    values_ = values_owner_->values_;
+   }
+
+   static constexpr size_t kStep = kAlignment / sizeof(T) > 0 ? kAlignment / sizeof(T) : 1;
+
+   std::vector<std::pair<size_t, size_t>> shapes_;
+   std::vector<size_t> weight_offsets_;
+   std::vector<size_t> bias_offsets_;
+   size_t num_weights_ = 0;
+   size_t size_ = 0;
+
+   std::vector<T, AlignedAllocator<T, kAlignment>> values_storage_;
+   std::vector<T, AlignedAllocator<T, kAlignment>> gradients_storage_;
+   std::shared_ptr<ParameterArena> values_owner_;  // set when the values are another arena's
+   T* values_ = nullptr;
+   T* gradients_ = nullptr;
+
+   // Offsets of every slot and the gradient storage
+   void lay_out() {
+    size_t offset = 0;
+    for (const auto& shape : shapes_) {
+     weight_offsets_.push_back(offset);
+     offset = padded(offset + shape.first * shape.second);
+    }
+    num_weights_ = offset;
+    for (const auto& shape : shapes_) {
+     bias_offsets_.push_back(offset);
+     offset = padded(offset + shape.first);
+    }
+    size_ = offset;
+
+    gradients_storage_.resize(size_);
+    gradients_ = gradients_storage_.data();
+   }
+
+   static size_t padded(size_t elements) { return (elements + kStep - 1) / kStep * kStep; }
+
+   void check_slot(size_t i) const {
+    if (i >= shapes_.size()) {
+     throw std::out_of_range("parameter slot index out of range");
+    }
+   }
+   size_t weight_offset(size_t i) const { check_slot(i); return weight_offsets_[i]; }
+   size_t bias_offset(size_t i) const { check_slot(i); return bias_offsets_[i]; }
+   size_t rows(size_t i) const { return shapes_[i].first; }
+   size_t columns(size_t i) const { return shapes_[i].second; }
+ };
+}
+
+#endif
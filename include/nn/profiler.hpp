@@ -0,0 +1,309 @@
+ /*
+  * Profiling instrumentation
+  *
+  * Opt-in and compiled out by default: the NN_PROFILE_* macros below expand to nothing unless
+  * NN_PROFILE is defined (cmake -DNN_ENABLE_PROFILING=ON defines it for the whole build; it must be
+  * the same in every translation unit). Compiled in, every instrumented region records
+  * - its wall time, as one complete event of a trace,
+  * - the floating point operations and the bytes its kernels move, estimated from the shapes
+  *   (every operand read or written once, so the bytes are a lower bound of the memory traffic),
+  * - the Matrix storage allocations made on its thread while it ran.
+  *
+  * The instrumented regions are Layer forward, backward and infer (one row per layer shape), the
+  * Matrix operations, the optimizer updates and the data-parallel gradient reduction.
+  * Network::train closes an epoch summary after every epoch, which it prints with
+  * Verbosity::DETAILED; write_chrome_trace() writes the events in the Chrome trace event format,
+  * for chrome://tracing or https://ui.perfetto.dev.
+  *
+  * Events are recorded under a lock, on any thread; the summary is accumulated as they come and
+  * the trace keeps the first max_events() of them, so recording allocates as the trace grows
+  * (a profiled build does not keep the allocation-free training steps). Names are compared by
+  * address, so they must be string literals or label() results.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nn {
+ namespace profile {
+
+  struct Event {
+   const char* name;
+   const char* category;
+   uint64_t start_ns;     // since the profiler was created
+   uint64_t duration_ns;
+   uint32_t thread;       // small index, in order of first use
+   double flops;
+   double bytes;
+   size_t allocations;
+   size_t allocated_bytes;
+  };
+
+  // One row of an epoch summary: the events of one name added up
+  struct Totals {
+   const char* name;
+   const char* category;
+   size_t calls = 0;
+   uint64_t duration_ns = 0;
+   double flops = 0;
+   double bytes = 0;
+   size_t allocations = 0;
+   size_t allocated_bytes = 0;
+  };
+
+  struct EpochSummary {
+   size_t epoch;           // counted from 0 over the life of the profiler
+   uint64_t duration_ns;
+   std::vector<Totals> rows;  // by decreasing time
+  };
+
+  // Matrix storage allocations of the calling thread, counted by Matrix through NN_PROFILE_ALLOCATION
+  struct AllocationCount {
+   size_t count = 0;
+   size_t bytes = 0;
+  };
+
+  inline AllocationCount& thread_allocations() {
+   static thread_local AllocationCount allocations;
+   return allocations;
+  }
+
+  inline uint32_t thread_index() {
+   static std::atomic<uint32_t> next{0};
+   static thread_local const uint32_t index = next.fetch_add(1);
+   return index;
+  }
+
+  class Profiler {
+   public:
+    using clock_type = std::chrono::steady_clock;
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // Recording can be paused, e.g. to profile a single epoch
+    void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+    size_t max_events() const { return max_events_; }
+    void set_max_events(size_t max_events) {
+     std::lock_guard<std::mutex> lock(mutex_);
+     max_events_ = max_events;
+    }
+
+    uint64_t now() const {
+     return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - origin_).count();
+    }
+
+    void record(const Event& event) {
+     std::lock_guard<std::mutex> lock(mutex_);
+     if (events_.size() < max_events_) {
+      events_.push_back(event);
+     }
+     auto found = current_index_.find(event.name);
+     if (found == current_index_.end()) {
+      found = current_index_.emplace(event.name, current_.size()).first;
+      Totals totals;
+      totals.name = event.name;
+      totals.category = event.category;
+      current_.push_back(totals);
+     }
+     Totals& totals = current_[found->second];
+     totals.calls++;
+     totals.duration_ns += event.duration_ns;
+     totals.flops += event.flops;
+     totals.bytes += event.bytes;
+     totals.allocations += event.allocations;
+     totals.allocated_bytes += event.allocated_bytes;
+    }
+
+    // Starts accumulating a new epoch summary, dropping what was recorded since the last epoch
+    void begin_epoch() {
+     if (!enabled()) {
+      return;
+     }
+     std::lock_guard<std::mutex> lock(mutex_);
+     current_.clear();
+     current_index_.clear();
+     epoch_start_ = now();
+    }
+
+    // Closes the epoch summary, which also becomes an event of the trace
+    void end_epoch() {
+     if (!enabled()) {
+      return;
+     }
+     const uint64_t end = now();
+     std::lock_guard<std::mutex> lock(mutex_);
+     EpochSummary summary{epochs_.size(), end - epoch_start_, std::move(current_)};
+     std::sort(summary.rows.begin(), summary.rows.end(),
+       [](const Totals& a, const Totals& b) { return a.duration_ns > b.duration_ns; });
+     current_.clear();
+     current_index_.clear();
+     if (events_.size() < max_events_) {
+      events_.push_back({"epoch", "network", epoch_start_, end - epoch_start_, thread_index(), 0, 0, 0, 0});
+     }
+     epochs_.push_back(std::move(summary));
+    }
+
+    // Not synchronized with recording threads: read once they are done
+    const std::vector<EpochSummary>& epochs() const { return epochs_; }
+    const std::vector<Event>& events() const { return events_; }
+
+    void clear() {
+     std::lock_guard<std::mutex> lock(mutex_);
+     events_.clear();
+     epochs_.clear();
+     current_.clear();
+     current_index_.clear();
+    }
+
+    /*
+     * A stable name for a row built at run time, e.g. "Layer 784x128 forward". Equal strings give
+     * the same pointer, so the rows of layers with the same shape are added up.
+     */
+    const char* label(const std::string& name) {
+     std::lock_guard<std::mutex> lock(mutex_);
+     return labels_.insert(name).first->c_str();
+    }
+
+    /*
+     * The events as a Chrome trace ({"traceEvents": [...]}), one complete ("X") event each, in
+     * microseconds, with flops, bytes and allocations as arguments.
+     */
+    void write_chrome_trace(std::ostream& out) const {
+     const std::ios::fmtflags flags = out.flags();
+     const std::streamsize precision = out.precision();
+     out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+     const char* separator = "\n";
+     for (const Event& event : events_) {
+      out << separator << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+       << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+       << std::fixed << std::setprecision(3)
+       << ",\"ts\":" << event.start_ns / 1e3 << ",\"dur\":" << event.duration_ns / 1e3
+       << std::setprecision(0)
+       << ",\"args\":{\"flops\":" << event.flops << ",\"bytes\":" << event.bytes
+       << ",\"allocations\":" << event.allocations << ",\"allocated_bytes\":" << event.allocated_bytes << "}}";
+      separator = ",\n";
+     }
+     out << "\n]}\n";
+     out.flags(flags);
+     out.precision(precision);
+    }
+
+    void write_chrome_trace(const std::string& filename) const {
+     std::ofstream file(filename, std::ios::trunc);
+     if (!file) {
+      throw std::runtime_error("cannot create file: " + filename);
+     }
+     write_chrome_trace(file);
+     if (!file) {
+      throw std::runtime_error("cannot write file: " + filename);
+     }
+    }
+
+    // One line per row: calls, time and share of the epoch, GFLOP/s, GB/s and allocations
+    static void print_summary(std::ostream& out, const EpochSummary& summary) {
+     const std::ios::fmtflags flags = out.flags();
+     const std::streamsize precision = out.precision();
+     out << std::left << std::setw(28) << "region" << std::right << std::setw(9) << "calls"
+      << std::setw(12) << "time ms" << std::setw(8) << "%" << std::setw(10) << "GFLOP/s"
+      << std::setw(10) << "GB/s" << std::setw(8) << "allocs" << std::endl;
+     for (const Totals& row : summary.rows) {
+      const double seconds = row.duration_ns / 1e9;
+      out << std::left << std::setw(28) << row.name << std::right << std::setw(9) << row.calls
+       << std::fixed << std::setprecision(3) << std::setw(12) << row.duration_ns / 1e6
+       << std::setprecision(1) << std::setw(8) << 100.0 * row.duration_ns / std::max<uint64_t>(1, summary.duration_ns)
+       << std::setprecision(2) << std::setw(10) << (seconds > 0 ? row.flops / seconds / 1e9 : 0.0)
+       << std::setw(10) << (seconds > 0 ? row.bytes / seconds / 1e9 : 0.0)
+       << std::setw(8) << row.allocations << std::endl;
+     }
+     out.flags(flags);
+     out.precision(precision);
+    }
+
+   private:
+    std::atomic<bool> enabled_{true};
+    const clock_type::time_point origin_ = clock_type::now();
+    std::mutex mutex_;
+    size_t max_events_ = 1 << 20;
+    std::vector<Event> events_;
+    std::vector<EpochSummary> epochs_;
+    std::vector<Totals> current_;
+    std::unordered_map<const char*, size_t> current_index_;
+    uint64_t epoch_start_ = 0;
+    std::set<std::string> labels_;
+  };
+
+  // The library-wide profiler
+  inline Profiler& profiler() {
+   static Profiler instance;
+   return instance;
+  }
+
+  // Records the region from construction to destruction, when the profiler is enabled
+  class Scope {
+   public:
+    Scope(const char* name, const char* category, double flops = 0, double bytes = 0)
+     : active_(profiler().enabled()) {
+     if (active_) {
+      const AllocationCount& allocations = thread_allocations();
+      event_ = {name, category, profiler().now(), 0, thread_index(), flops, bytes, allocations.count, allocations.bytes};
+     }
+    }
+
+    ~Scope() {
+     if (active_) {
+      const AllocationCount& allocations = thread_allocations();
+      event_.duration_ns = profiler().now() - event_.start_ns;
+      event_.allocations = allocations.count - event_.allocations;
+      event_.allocated_bytes = allocations.bytes - event_.allocated_bytes;
+      profiler().record(event_);
+     }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    bool active_;
+    Event event_{};
+  };
+
+  inline void count_allocation(size_t bytes) {
+   AllocationCount& allocations = thread_allocations();
+   allocations.count++;
+   allocations.bytes += bytes;
+  }
+ }
+}
+
+#define NN_PROFILE_CONCAT_(a, b) a##b
+#define NN_PROFILE_CONCAT(a, b) NN_PROFILE_CONCAT_(a, b)
+
+#ifdef NN_PROFILE
+// NN_PROFILE_SCOPE(name, category[, flops[, bytes]]) profiles the rest of the enclosing block
+#define NN_PROFILE_SCOPE(...) ::nn::profile::Scope NN_PROFILE_CONCAT(nn_profile_scope_, __LINE__)(__VA_ARGS__)
+#define NN_PROFILE_ALLOCATION(bytes) ::nn::profile::count_allocation(bytes)
+#define NN_PROFILE_BEGIN_EPOCH() ::nn::profile::profiler().begin_epoch()
+#define NN_PROFILE_END_EPOCH() ::nn::profile::profiler().end_epoch()
+#else
+// Compiled out: the arguments are not evaluated
+#define NN_PROFILE_SCOPE(...) ((void)0)
+#define NN_PROFILE_ALLOCATION(bytes) ((void)0)
+#define NN_PROFILE_BEGIN_EPOCH() ((void)0)
+#define NN_PROFILE_END_EPOCH() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,481 @@
+ /*
+  * Post-training int8 quantization
+  *
+  * Inference with int8 weights and int32 accumulation, built from a trained float network.
+  *
+  * Weights are quantized symmetrically per output neuron (row of W): w ~= s_w[o] * q[o][k] with
+  * s_w[o] = max_k |W[o][k]| / 127 and q in [-127, 127]. The inputs of a layer are quantized with
+  * one scale per layer, s_x = max |x| / 127, where max |x| is calibrated by running the float
+  * network on a sample of the training set. Inputs beyond the calibrated range saturate.
+  *
+  * A layer then computes, for every output o and sample j,
+  *   y[o][j] = activation(s_w[o] * s_x * sum_k q[o][k] * q_x[k][j] + bias[o])
+  * where the sum is an exact int32 dot product (|sum| <= 127^2 * input_size) and the bias,
+  * rescaling and activation stay in float. The float output is quantized again by the next layer.
+  *
+  * Quantized inputs are stored as unsigned bytes q_x + 128, the operand type of VNNI (vpdpbusd
+  * multiplies unsigned by signed bytes); the offset's contribution, 128 * sum_k q[o][k], is a
+  * per-output constant subtracted from the int32 sums. Weight rows and samples are padded with
+  * zeros to a multiple of 64 bytes, so the kernels (VNNI, or AVX-512BW/AVX2 widening the bytes to
+  * 16 bits for vpmaddwd) need no tail loop. Each pass of the kernel covers 4 outputs x 2 samples.
+ */
+
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "activation.hpp"
+#include "layer.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+namespace nn {
+
+ namespace kernels {
+  // Quantized rows are padded to a multiple of this many bytes
+  constexpr size_t kInt8RowAlignment = 64;
+
+  namespace detail {
+   inline void gemm_s8u8_scalar(const int8_t* w, size_t ldw, size_t rows, const uint8_t* x, size_t ldx,
+     size_t samples, size_t n, int32_t* y, size_t ldy) {
+    for (size_t j = 0; j < samples; j++) {
+     for (size_t r = 0; r < rows; r++) {
+      int32_t sum = 0;
+      for (size_t k = 0; k < n; k++) {
+       sum += static_cast<int32_t>(w[r * ldw + k]) * static_cast<int32_t>(x[j * ldx + k]);
+      }
+      y[j * ldy + r] = sum;
+     }
+    }
+   }
+
+#if NN_X86_DISPATCH
+   /*
+    * One step of k per instruction set: load_w/load_x bring step bytes of a weight row and of a
+    * sample into the form dot() multiplies, dot() adds their products into 32-bit lanes.
+    * AVX2 and AVX-512BW widen both to 16 bits and use vpmaddwd, VNNI multiplies the bytes directly.
+   */
+   struct Int8Avx2 {
+    using reg = __m256i;
+    static constexpr size_t step = 16;
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg zero() { return _mm256_setzero_si256(); }
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg load_w(const int8_t* p) {
+     return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg load_x(const uint8_t* p) {
+     return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg dot(reg acc, reg w, reg x) {
+     return _mm256_add_epi32(acc, _mm256_madd_epi16(w, x));
+    }
+    NN_TARGET_AVX2 static NN_ALWAYS_INLINE int32_t reduce(reg x) {
+     __m128i r = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+     r = _mm_add_epi32(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2)));
+     r = _mm_add_epi32(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 3, 0, 1)));
+     return _mm_cvtsi128_si32(r);
+    }
+   };
+
+   struct Int8Avx512Bw {
+    using reg = __m512i;
+    static constexpr size_t step = 32;
+    NN_TARGET_AVX512BW static NN_ALWAYS_INLINE reg zero() { return _mm512_setzero_si512(); }
+    NN_TARGET_AVX512BW static NN_ALWAYS_INLINE reg load_w(const int8_t* p) {
+     return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    NN_TARGET_AVX512BW static NN_ALWAYS_INLINE reg load_x(const uint8_t* p) {
+     return _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    NN_TARGET_AVX512BW static NN_ALWAYS_INLINE reg dot(reg acc, reg w, reg x) {
+     return _mm512_add_epi32(acc, _mm512_madd_epi16(w, x));
+    }
+    NN_TARGET_AVX512BW static NN_ALWAYS_INLINE int32_t reduce(reg x) { return _mm512_reduce_add_epi32(x); }
+   };
+
+   struct Int8Avx512Vnni {
+    using reg = __m512i;
+    static constexpr size_t step = 64;
+    NN_TARGET_AVX512VNNI static NN_ALWAYS_INLINE reg zero() { return _mm512_setzero_si512(); }
+    NN_TARGET_AVX512VNNI static NN_ALWAYS_INLINE reg load_w(const int8_t* p) { return _mm512_loadu_si512(p); }
+    NN_TARGET_AVX512VNNI static NN_ALWAYS_INLINE reg load_x(const uint8_t* p) { return _mm512_loadu_si512(p); }
+    NN_TARGET_AVX512VNNI static NN_ALWAYS_INLINE reg dot(reg acc, reg w, reg x) { return _mm512_dpbusd_epi32(acc, x, w); }
+    NN_TARGET_AVX512VNNI static NN_ALWAYS_INLINE int32_t reduce(reg x) { return _mm512_reduce_add_epi32(x); }
+   };
+
+   /*
+    * R weight rows x S samples per pass, so every loaded slice of a row serves S samples and
+    * every slice of a sample R rows. Stamped out per target like the activation kernels.
+   */
+#define NN_DEFINE_INT8_KERNEL(ns, target)                                                       \
+   namespace ns {                                                                               \
+    template<typename K, size_t R, size_t S>                                                    \
+    target NN_ALWAYS_INLINE void block(const int8_t* w, size_t ldw, const uint8_t* x,          \
+      size_t ldx, size_t n, int32_t* y, size_t ldy) {                                           \
+     typename K::reg acc[R][S];                                                                 \
+     for (size_t r = 0; r < R; r++) {                                                           \
+      for (size_t s = 0; s < S; s++) {                                                          \
+       acc[r][s] = K::zero();                                                                   \
+      }                                                                                         \
+     }                                                                                          \
+     for (size_t k = 0; k < n; k += K::step) {                                                  \
+      typename K::reg xs[S];                                                                    \
+      for (size_t s = 0; s < S; s++) {                                                          \
+       xs[s] = K::load_x(x + s * ldx + k);                                                      \
+      }                                                                                         \
+      for (size_t r = 0; r < R; r++) {                                                          \
+       const typename K::reg wr = K::load_w(w + r * ldw + k);                                   \
+       for (size_t s = 0; s < S; s++) {                                                         \
+        acc[r][s] = K::dot(acc[r][s], wr, xs[s]);                                               \
+       }                                                                                        \
+      }                                                                                         \
+     }                                                                                          \
+     for (size_t r = 0; r < R; r++) {                                                           \
+      for (size_t s = 0; s < S; s++) {                                                          \
+       y[s * ldy + r] = K::reduce(acc[r][s]);                                                   \
+      }                                                                                         \
+     }                                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template<typename K, size_t S>                                                              \
+    target NN_ALWAYS_INLINE void rows_of(const int8_t* w, size_t ldw, size_t rows,              \
+      const uint8_t* x, size_t ldx, size_t n, int32_t* y, size_t ldy) {                         \
+     size_t r = 0;                                                                              \
+     for (; r + 4 <= rows; r += 4) {                                                            \
+      block<K, 4, S>(w + r * ldw, ldw, x, ldx, n, y + r, ldy);                                  \
+     }                                                                                          \
+     for (; r < rows; r++) {                                                                    \
+      block<K, 1, S>(w + r * ldw, ldw, x, ldx, n, y + r, ldy);                                  \
+     }                                                                                          \
+    }                                                                                           \
+                                                                                                \
+    template<typename K>                                                                        \
+    target void gemm_s8u8(const int8_t* w, size_t ldw, size_t rows, const uint8_t* x,           \
+      size_t ldx, size_t samples, size_t n, int32_t* y, size_t ldy) {                           \
+     size_t j = 0;                                                                              \
+     for (; j + 2 <= samples; j += 2) {                                                         \
+      rows_of<K, 2>(w, ldw, rows, x + j * ldx, ldx, n, y + j * ldy, ldy);                       \
+     }                                                                                          \
+     for (; j < samples; j++) {                                                                 \
+      rows_of<K, 1>(w, ldw, rows, x + j * ldx, ldx, n, y + j * ldy, ldy);                       \
+     }                                                                                          \
+    }                                                                                           \
+   }
+
+   NN_DEFINE_INT8_KERNEL(avx2, NN_TARGET_AVX2)
+   NN_DEFINE_INT8_KERNEL(avx512bw, NN_TARGET_AVX512BW)
+   NN_DEFINE_INT8_KERNEL(avx512vnni, NN_TARGET_AVX512VNNI)
+#undef NN_DEFINE_INT8_KERNEL
+#endif
+  }
+
+  /*
+   * y[j * ldy + r] = sum_k w[r * ldw + k] * x[j * ldx + k] for rows r and samples j, accumulated
+   * exactly in int32: signed weights against unsigned inputs, the operand types of VNNI.
+   * n must be a multiple of kInt8RowAlignment (pad rows and samples with zeros).
+  */
+  inline void gemm_s8u8(const int8_t* w, size_t ldw, size_t rows, const uint8_t* x, size_t ldx,
+    size_t samples, size_t n, int32_t* y, size_t ldy) {
+   if (n % kInt8RowAlignment != 0) {
+    throw std::invalid_argument(std::string(__func__) + ": row length must be padded to the row alignment");
+   }
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     if (simd::has_avx512vnni()) {
+      detail::avx512vnni::gemm_s8u8<detail::Int8Avx512Vnni>(w, ldw, rows, x, ldx, samples, n, y, ldy);
+     } else if (simd::has_avx512bw()) {
+      detail::avx512bw::gemm_s8u8<detail::Int8Avx512Bw>(w, ldw, rows, x, ldx, samples, n, y, ldy);
+     } else {
+      detail::avx2::gemm_s8u8<detail::Int8Avx2>(w, ldw, rows, x, ldx, samples, n, y, ldy);
+     }
+     return;
+    case simd::Isa::AVX2:
+     detail::avx2::gemm_s8u8<detail::Int8Avx2>(w, ldw, rows, x, ldx, samples, n, y, ldy);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     detail::gemm_s8u8_scalar(w, ldw, rows, x, ldx, samples, n, y, ldy);
+     return;
+   }
+  }
+
+  namespace detail {
+#if NN_X86_DISPATCH
+   NN_TARGET_AVX512
+   inline void quantize_u8_avx512(const float* x, uint8_t* y, size_t n, float inverse_scale) {
+    const __m512 s = _mm512_set1_ps(inverse_scale);
+    const __m512 lo = _mm512_set1_ps(-127.0f);
+    const __m512 hi = _mm512_set1_ps(127.0f);
+    const __m512i offset = _mm512_set1_epi32(128);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+     const __m512 v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(x + i), s), lo), hi);
+     const __m512i q = _mm512_add_epi32(_mm512_cvtps_epi32(v), offset);
+     _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), _mm512_cvtepi32_epi8(q));
+    }
+    for (; i < n; i++) {
+     y[i] = static_cast<uint8_t>(std::nearbyint(std::min(127.0f, std::max(-127.0f, x[i] * inverse_scale))) + 128);
+    }
+   }
+
+   NN_TARGET_AVX2
+   inline void quantize_u8_avx2(const float* x, uint8_t* y, size_t n, float inverse_scale) {
+    const __m256 s = _mm256_set1_ps(inverse_scale);
+    const __m256 lo = _mm256_set1_ps(-127.0f);
+    const __m256 hi = _mm256_set1_ps(127.0f);
+    const __m256i offset = _mm256_set1_epi32(128);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+     const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), s), lo), hi);
+     const __m256i q = _mm256_add_epi32(_mm256_cvtps_epi32(v), offset);
+     const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+     _mm_storel_epi64(reinterpret_cast<__m128i*>(y + i), _mm_packus_epi16(words, words));
+    }
+    for (; i < n; i++) {
+     y[i] = static_cast<uint8_t>(std::nearbyint(std::min(127.0f, std::max(-127.0f, x[i] * inverse_scale))) + 128);
+    }
+   }
+#endif
+  }
+
+  // y[i] = clamp(round(x[i] * inverse_scale), -127, 127) + 128, rounding to nearest even
+  inline void quantize_u8(const float* x, uint8_t* y, size_t n, float inverse_scale) {
+   switch (simd::active_isa()) {
+#if NN_X86_DISPATCH
+    case simd::Isa::AVX512:
+     detail::quantize_u8_avx512(x, y, n, inverse_scale);
+     return;
+    case simd::Isa::AVX2:
+     detail::quantize_u8_avx2(x, y, n, inverse_scale);
+     return;
+#endif
+    case simd::Isa::SCALAR:
+    default:
+     for (size_t i = 0; i < n; i++) {
+      y[i] = static_cast<uint8_t>(std::nearbyint(std::min(127.0f, std::max(-127.0f, x[i] * inverse_scale))) + 128);
+     }
+     return;
+   }
+  }
+ }
+
+ /*
+  * A fully connected layer with int8 weights, converted from a trained float layer.
+  * input_scale is the step of the input quantization, max |input| / 127 from calibration.
+ */
+ class QuantizedLayer {
+  public:
+   QuantizedLayer(const LayerBase<float>& layer, float input_scale)
+    : input_size_(layer.input_size()),
+      output_size_(layer.output_size()),
+      row_size_((layer.input_size() + kernels::kInt8RowAlignment - 1) / kernels::kInt8RowAlignment
+       * kernels::kInt8RowAlignment),
+      input_scale_(input_scale),
+      activate_(activations::forward_function<float>(layer.activation())),
+      weights_(output_size_ * row_size_, 0),
+      offsets_(output_size_),
+      weight_scales_(output_size_),
+      output_scales_(output_size_),
+      bias_(layer.bias().data(), layer.bias().data() + output_size_) {
+    if (!(input_scale > 0.0f) || !std::isfinite(input_scale)) {
+     throw std::invalid_argument(std::string(__func__) + ": input scale must be positive");
+    }
+
+    const float* w = layer.weights().data();
+    for (size_t o = 0; o < output_size_; o++) {
+     float max_abs = 0.0f;
+     for (size_t k = 0; k < input_size_; k++) {
+      max_abs = std::max(max_abs, std::abs(w[o * input_size_ + k]));
+     }
+     const float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+     int32_t row_sum = 0;
+     for (size_t k = 0; k < input_size_; k++) {
+      const int8_t q = static_cast<int8_t>(std::lround(w[o * input_size_ + k] / scale));
+      weights_[o * row_size_ + k] = q;
+      row_sum += q;
+     }
+     offsets_[o] = kInputOffset * row_sum;
+     weight_scales_[o] = scale;
+     output_scales_[o] = scale * input_scale_;
+    }
+   }
+
+   size_t input_size() const { return input_size_; }
+   size_t output_size() const { return output_size_; }
+   float input_scale() const { return input_scale_; }
+   const std::vector<float>& weight_scales() const { return weight_scales_; }
+
+   // Quantized weight of output o and input k
+   int8_t weight(size_t o, size_t k) const { return weights_[o * row_size_ + k]; }
+
+   // Bytes of the parameters used by inference: int8 weights (padded rows), scales and bias
+   size_t memory_bytes() const {
+    return weights_.size() * sizeof(int8_t) + offsets_.size() * sizeof(int32_t)
+     + (weight_scales_.size() + output_scales_.size() + bias_.size()) * sizeof(float);
+   }
+
+   /*
+    * output (output_size x N) from input (input_size x N), one sample per column. The quantized
+    * input and the accumulators live in workspaces reused between calls.
+    */
+   void infer(const Matrix<float>& input, Matrix<float>& output) {
+    if (input.columns() == 0 || input.rows() != input_size_) {
+     throw std::invalid_argument("input dimensions do not match layer input size");
+    }
+
+    if (output.shares_storage(input)) {
+     throw std::invalid_argument(std::string(__func__) + ": output cannot alias the input");
+    }
+
+    const size_t batch = input.columns();
+    quantized_input_.resize(batch * row_size_);
+    accumulators_.resize(batch * output_size_);
+    output.resize(output_size_, batch);
+
+    /*
+     * Each sample becomes one contiguous row of q + 128, the offset is taken back out of the sums
+     * with offsets_. A batch is quantized in storage order first, then transposed 16 samples at a
+     * time. The padding of the rows only ever meets zero weights.
+     */
+    const float inverse_scale = 1.0f / input_scale_;
+    uint8_t* xq = quantized_input_.data();
+    if (batch == 1 && input.is_contiguous()) {
+     kernels::quantize_u8(input.data(), xq, input_size_, inverse_scale);
+    } else {
+     staging_.resize(input_size_ * batch);
+     if (input.is_contiguous()) {
+      kernels::quantize_u8(input.data(), staging_.data(), staging_.size(), inverse_scale);
+     } else {
+      for (size_t k = 0; k < input_size_; k++) {
+       kernels::quantize_u8(input.data() + k * input.stride(), staging_.data() + k * batch, batch, inverse_scale);
+      }
+     }
+     const uint8_t* staged = staging_.data();
+     for (size_t j0 = 0; j0 < batch; j0 += kTransposeBlock) {
+      const size_t j1 = std::min(batch, j0 + kTransposeBlock);
+      for (size_t k = 0; k < input_size_; k++) {
+       for (size_t j = j0; j < j1; j++) {
+        xq[j * row_size_ + k] = staged[k * batch + j];
+       }
+      }
+     }
+    }
+
+    const int8_t* w = weights_.data();
+    int32_t* acc = accumulators_.data();
+    const size_t rows = output_size_;
+    const size_t n = row_size_;
+    nn::parallel_for(0, batch, 2, [=](size_t lo, size_t hi) {
+     kernels::gemm_s8u8(w, n, rows, xq + lo * n, n, hi - lo, n, acc + lo * rows, rows);
+    });
+
+    float* y = output.data();
+    const size_t ldy = output.stride();
+    for (size_t o = 0; o < output_size_; o++) {
+     for (size_t j = 0; j < batch; j++) {
+      y[o * ldy + j] = static_cast<float>(acc[j * output_size_ + o] - offsets_[o]) * output_scales_[o] + bias_[o];
+     }
+    }
+    // row by row into a padded output, whose padding stays zero
+    if (output.is_contiguous()) {
+     activate_(y, y, output_size_ * batch);
+    } else {
+     for (size_t o = 0; o < output_size_; o++) {
+      activate_(y + o * ldy, y + o * ldy, batch);
+     }
+    }
+   }
+
+  private:
+   size_t input_size_;
+   size_t output_size_;
+   size_t row_size_;  // input_size rounded up to kInt8RowAlignment
+   float input_scale_;
+   void (*activate_)(const float*, float*, size_t);
+
+   // inputs are stored as unsigned bytes q + kInputOffset, the operand type of VNNI
+   static constexpr int32_t kInputOffset = 128;
+
+   std::vector<int8_t> weights_;       // output_size x row_size, row-major
+   std::vector<int32_t> offsets_;      // kInputOffset * sum_k q[o][k], removed from every sum
+   std::vector<float> weight_scales_;  // s_w per output
+   std::vector<float> output_scales_;  // s_w * s_x per output
+   std::vector<float> bias_;
+
+   static constexpr size_t kTransposeBlock = 16;
+
+   std::vector<uint8_t> staging_;          // quantized input in storage order (input_size x N)
+   std::vector<uint8_t> quantized_input_;  // N x row_size
+   std::vector<int32_t> accumulators_;
+ };
+
+ /*
+  * Every layer of a trained float network quantized, with the input scales calibrated by a float
+  * forward pass over calibration (features x samples, e.g. a few hundred training samples).
+  * Like Network::predict, the returned matrix is overwritten by the next call.
+ */
+ class QuantizedNetwork {
+  public:
+   QuantizedNetwork(const Network<float>& network, const Matrix<float>& calibration) {
+    const std::vector<LayerBase<float>*>& layers = network.layers();
+    if (layers.empty()) {
+     throw std::runtime_error("network has no layers");
+    }
+
+    Matrix<float> buffers[2] = {Matrix<float>(0, 0), Matrix<float>(0, 0)};
+    const Matrix<float>* current = &calibration;
+    for (size_t i = 0; i < layers.size(); i++) {
+     float max_abs = 0.0f;
+     for (size_t r = 0; r < current->rows(); r++) {
+      const float* x = current->data() + r * current->stride();
+      for (size_t k = 0; k < current->columns(); k++) {
+       max_abs = std::max(max_abs, std::abs(x[k]));
+      }
+     }
+     layers_.emplace_back(*layers[i], max_abs > 0.0f ? max_abs / 127.0f : 1.0f);
+
+     Matrix<float>& output = buffers[i % 2];
+     layers[i]->infer(*current, output);
+     current = &output;
+    }
+   }
+
+   size_t input_size() const { return layers_.front().input_size(); }
+   size_t output_size() const { return layers_.back().output_size(); }
+   const std::vector<QuantizedLayer>& layers() const { return layers_; }
+
+   size_t memory_bytes() const {
+    size_t bytes = 0;
+    for (const QuantizedLayer& layer : layers_) {
+     bytes += layer.memory_bytes();
+    }
+    return bytes;
+   }
+
+   const Matrix<float>& predict(const Matrix<float>& input) {
+    // the previous result can be passed back in: the first layer then writes the other buffer
+    const size_t first = &input == &buffers_[0] ? 1 : 0;
+    const Matrix<float>* current = &input;
+    for (size_t i = 0; i < layers_.size(); i++) {
+     Matrix<float>& output = buffers_[(first + i) % 2];
+     layers_[i].infer(*current, output);
+     current = &output;
+    }
+    return *current;
+   }
+
+  private:
+   std::vector<QuantizedLayer> layers_;
+   Matrix<float> buffers_[2] = {Matrix<float>(0, 0), Matrix<float>(0, 0)};
+ };
+}
+
+#endif
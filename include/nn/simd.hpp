@@ -0,0 +1,244 @@
+ /*
+  * SIMD support
+  *
+  * The library is header-only and built without any -march flags, so wide kernels are compiled
+  * per function with GCC/Clang target attributes and selected at runtime from the CPU features.
+  *
+  * Isa::SCALAR: portable C++ (whatever the baseline compiler flags allow, e.g. SSE2 on x86-64)
+  * Isa::AVX2:   AVX2 + FMA + F16C (256-bit; every AVX2 CPU has the half precision conversions)
+  * Isa::AVX512: AVX-512F (512-bit)
+  *
+  * Kernels needing an extension on top of a tier (the int8 kernels use AVX-512BW and VNNI) check
+  * for it separately and otherwise run the next lower tier.
+  *
+  * set_isa() caps the selected instruction set, which is handy to test or benchmark the fallbacks.
+  *
+  * The Vec* structs wrap the intrinsics of one register type behind a common set of static
+  * functions, so a kernel body can be written once as a template over the vector type.
+  * The float wrappers also carry the elementwise math used by the activation kernels.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NN_X86_DISPATCH 1
+#define NN_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define NN_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#define NN_TARGET_AVX512BW __attribute__((target("avx512f,avx512bw,avx2,fma,f16c")))
+#define NN_TARGET_AVX512VNNI __attribute__((target("avx512f,avx512bw,avx512vnni,avx2,fma,f16c")))
+#else
+#define NN_X86_DISPATCH 0
+#define NN_TARGET_AVX2
+#define NN_TARGET_AVX512
+#define NN_TARGET_AVX512BW
+#define NN_TARGET_AVX512VNNI
+#endif
+
+#if NN_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include <cstddef>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NN_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define NN_ALWAYS_INLINE inline
+#endif
+
+namespace nn {
+ namespace simd {
+
+  enum class Isa {
+   SCALAR,
+   AVX2,
+   AVX512
+  };
+
+  inline Isa detect_isa() {
+#if NN_X86_DISPATCH
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c")) {
+    return Isa::AVX2;
+   }
+#endif
+   return Isa::SCALAR;
+  }
+
+  // AVX-512 byte/word instructions, used by the int8 kernels on top of Isa::AVX512
+  inline bool has_avx512bw() {
+#if NN_X86_DISPATCH
+   static const bool supported = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512bw") != 0;
+   }();
+   return supported;
+#else
+   return false;
+#endif
+  }
+
+  // AVX-512 VNNI (vpdpbusd: four 8-bit products summed into each 32-bit lane)
+  inline bool has_avx512vnni() {
+#if NN_X86_DISPATCH
+   static const bool supported = [] {
+    __builtin_cpu_init();
+    return has_avx512bw() && __builtin_cpu_supports("avx512vnni") != 0;
+   }();
+   return supported;
+#else
+   return false;
+#endif
+  }
+
+  inline Isa& selected_isa() {
+   static Isa isa = detect_isa();
+   return isa;
+  }
+
+  inline Isa active_isa() { return selected_isa(); }
+
+  // Select a lower instruction set than detected (requests above the CPU's support are clamped)
+  inline void set_isa(Isa isa) {
+   Isa supported = detect_isa();
+   selected_isa() = static_cast<int>(isa) < static_cast<int>(supported) ? isa : supported;
+  }
+
+  inline const char* isa_name(Isa isa) {
+   switch (isa) {
+    case Isa::AVX512: return "avx512";
+    case Isa::AVX2: return "avx2";
+    case Isa::SCALAR:
+    default: return "scalar";
+   }
+  }
+
+#if NN_X86_DISPATCH
+  struct VecAvx2Float {
+   using scalar = float;
+   using reg = __m256;
+   using mask = __m256;
+   static constexpr size_t width = 8;
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg zero() { return _mm256_setzero_ps(); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg load(const float* p) { return _mm256_loadu_ps(p); }
+   // p aligned to the vector width
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg load_aligned(const float* p) { return _mm256_load_ps(p); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg broadcast(float x) { return _mm256_set1_ps(x); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg mul(reg x, reg y) { return _mm256_mul_ps(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg add(reg x, reg y) { return _mm256_add_ps(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg fmadd(reg x, reg y, reg z) { return _mm256_fmadd_ps(x, y, z); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg sub(reg x, reg y) { return _mm256_sub_ps(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg div(reg x, reg y) { return _mm256_div_ps(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg sqrt(reg x) { return _mm256_sqrt_ps(x); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg min(reg x, reg y) { return _mm256_min_ps(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg max(reg x, reg y) { return _mm256_max_ps(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg abs(reg x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+   // magnitude of x, sign of y
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg copysign(reg x, reg y) {
+    const reg sign = _mm256_set1_ps(-0.0f);
+    return _mm256_or_ps(_mm256_andnot_ps(sign, x), _mm256_and_ps(sign, y));
+   }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg round(reg x) {
+    return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+   }
+   // 2^n for integral n in [-126, 127], built directly in the exponent field
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg pow2(reg n) {
+    const __m256i biased = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(biased, 23));
+   }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE mask greater(reg x, reg y) { return _mm256_cmp_ps(x, y, _CMP_GT_OQ); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE mask less(reg x, reg y) { return _mm256_cmp_ps(x, y, _CMP_LT_OQ); }
+   // m ? x : y, per lane
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg select(mask m, reg x, reg y) { return _mm256_blendv_ps(y, x, m); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE float reduce(reg x) {
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+    r = _mm_add_ss(r, _mm_movehdup_ps(r));
+    return _mm_cvtss_f32(r);
+   }
+  };
+
+  struct VecAvx2Double {
+   using scalar = double;
+   using reg = __m256d;
+   static constexpr size_t width = 4;
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg zero() { return _mm256_setzero_pd(); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg load(const double* p) { return _mm256_loadu_pd(p); }
+   // p aligned to the vector width
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg load_aligned(const double* p) { return _mm256_load_pd(p); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg broadcast(double x) { return _mm256_set1_pd(x); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg mul(reg x, reg y) { return _mm256_mul_pd(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE reg fmadd(reg x, reg y, reg z) { return _mm256_fmadd_pd(x, y, z); }
+   NN_TARGET_AVX2 static NN_ALWAYS_INLINE double reduce(reg x) {
+    __m128d r = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+    r = _mm_add_sd(r, _mm_unpackhi_pd(r, r));
+    return _mm_cvtsd_f64(r);
+   }
+  };
+
+  struct VecAvx512Float {
+   using scalar = float;
+   using reg = __m512;
+   using mask = __mmask16;
+   static constexpr size_t width = 16;
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg zero() { return _mm512_setzero_ps(); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg load(const float* p) { return _mm512_loadu_ps(p); }
+   // p aligned to the vector width
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg load_aligned(const float* p) { return _mm512_load_ps(p); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg broadcast(float x) { return _mm512_set1_ps(x); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg mul(reg x, reg y) { return _mm512_mul_ps(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg add(reg x, reg y) { return _mm512_add_ps(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg fmadd(reg x, reg y, reg z) { return _mm512_fmadd_ps(x, y, z); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg sub(reg x, reg y) { return _mm512_sub_ps(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg div(reg x, reg y) { return _mm512_div_ps(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg sqrt(reg x) { return _mm512_sqrt_ps(x); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg min(reg x, reg y) { return _mm512_min_ps(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg max(reg x, reg y) { return _mm512_max_ps(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg abs(reg x) { return _mm512_abs_ps(x); }
+   // magnitude of x, sign of y (AVX-512F has no float bitwise ops, they go through the integer unit)
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg copysign(reg x, reg y) {
+    const __m512i sign = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(_mm512_abs_ps(x)),
+      _mm512_and_si512(_mm512_castps_si512(y), sign)));
+   }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg round(reg x) {
+    return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+   }
+   // 2^n for integral n in [-126, 127], built directly in the exponent field
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg pow2(reg n) {
+    const __m512i biased = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(biased, 23));
+   }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE mask greater(reg x, reg y) { return _mm512_cmp_ps_mask(x, y, _CMP_GT_OQ); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE mask less(reg x, reg y) { return _mm512_cmp_ps_mask(x, y, _CMP_LT_OQ); }
+   // m ? x : y, per lane
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg select(mask m, reg x, reg y) { return _mm512_mask_blend_ps(m, y, x); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE float reduce(reg x) { return _mm512_reduce_add_ps(x); }
+  };
+
+  struct VecAvx512Double {
+   using scalar = double;
+   using reg = __m512d;
+   static constexpr size_t width = 8;
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg zero() { return _mm512_setzero_pd(); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg load(const double* p) { return _mm512_loadu_pd(p); }
+   // p aligned to the vector width
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg load_aligned(const double* p) { return _mm512_load_pd(p); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg broadcast(double x) { return _mm512_set1_pd(x); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg mul(reg x, reg y) { return _mm512_mul_pd(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg add(reg x, reg y) { return _mm512_add_pd(x, y); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE reg fmadd(reg x, reg y, reg z) { return _mm512_fmadd_pd(x, y, z); }
+   NN_TARGET_AVX512 static NN_ALWAYS_INLINE double reduce(reg x) { return _mm512_reduce_add_pd(x); }
+  };
+#endif
+ }
+}
+
+#endif
@@ -0,0 +1,227 @@
+ /*
+  * Fixed-shape inference network
+  *
+  * For a topology known at compile time, e.g.
+  *   using Mnist = nn::StaticNetwork<float,
+  *     nn::StaticLayer<784, 128, nn::activations::ReLU>,
+  *     nn::StaticLayer<128, 64, nn::activations::ReLU>,
+  *     nn::StaticLayer<64, 10, nn::activations::Sigmoid>>;
+  * every size is a constant, the parameters and outputs live in std::array members aligned to 64
+  * bytes inside the network object, and the layers are chained by a fold over the layer list
+  * instead of virtual calls, so a prediction neither allocates nor checks a shape.
+  *
+  * It computes one sample at a time. Each layer keeps its weights transposed (input-major), so
+  * y = W x + b is a sum of Inputs columns scaled by x[k]: the loop over the outputs has a
+  * constant trip count and no reduction, which the compiler unrolls and vectorizes as it is,
+  * and each output is still summed in input order. Like the other kernels, that loop is compiled
+  * once per instruction set (simd.hpp) and picked at run time.
+  *
+  * The parameters come from a trained Network with the same topology and activations. The
+  * object holds all of them (about 440 KB for the mnist topology), so allocate it on the heap,
+  * e.g. with std::make_unique.
+ */
+
+#ifndef STATIC_NETWORK_H
+#define STATIC_NETWORK_H
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include "activation.hpp"
+#include "layer.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+#include "simd.hpp"
+
+namespace nn {
+
+ namespace kernels {
+  namespace detail {
+   // y = W x + b with W stored transposed (weights[k * Outputs + o]), y must not alias x
+   template<typename T, size_t Inputs, size_t Outputs>
+   NN_ALWAYS_INLINE void static_affine_body(const T* weights, const T* bias, const T* x, T* y) {
+    alignas(64) T sum[Outputs];
+    for (size_t o = 0; o < Outputs; o++) {
+     sum[o] = bias[o];
+    }
+    for (size_t k = 0; k < Inputs; k++) {
+     const T xk = x[k];
+     const T* w = weights + k * Outputs;
+     for (size_t o = 0; o < Outputs; o++) {
+      sum[o] += w[o] * xk;
+     }
+    }
+    for (size_t o = 0; o < Outputs; o++) {
+     y[o] = sum[o];
+    }
+   }
+
+   // The same body, vectorized by the compiler for each instruction set
+   template<typename T, size_t Inputs, size_t Outputs>
+   struct StaticAffine {
+    static void scalar(const T* weights, const T* bias, const T* x, T* y) {
+     static_affine_body<T, Inputs, Outputs>(weights, bias, x, y);
+    }
+#if NN_X86_DISPATCH
+    NN_TARGET_AVX2 static void avx2(const T* weights, const T* bias, const T* x, T* y) {
+     static_affine_body<T, Inputs, Outputs>(weights, bias, x, y);
+    }
+    NN_TARGET_AVX512 static void avx512(const T* weights, const T* bias, const T* x, T* y) {
+     static_affine_body<T, Inputs, Outputs>(weights, bias, x, y);
+    }
+#endif
+   };
+  }
+
+  template<typename T, size_t Inputs, size_t Outputs>
+  inline void static_affine(const T* weights, const T* bias, const T* x, T* y) {
+#if NN_X86_DISPATCH
+   switch (simd::active_isa()) {
+    case simd::Isa::AVX512:
+     detail::StaticAffine<T, Inputs, Outputs>::avx512(weights, bias, x, y);
+     return;
+    case simd::Isa::AVX2:
+     detail::StaticAffine<T, Inputs, Outputs>::avx2(weights, bias, x, y);
+     return;
+    case simd::Isa::SCALAR:
+    default:
+     break;
+   }
+#endif
+   detail::StaticAffine<T, Inputs, Outputs>::scalar(weights, bias, x, y);
+  }
+ }
+
+ // Shape and activation of one layer of a StaticNetwork
+ template<size_t Inputs, size_t Outputs, template<typename> class Activation>
+ struct StaticLayer {
+  static_assert(Inputs > 0 && Outputs > 0, "a layer needs inputs and outputs");
+  static constexpr size_t input_size = Inputs;
+  static constexpr size_t output_size = Outputs;
+  template<typename T> using activation = Activation<T>;
+ };
+
+ namespace detail {
+  template<typename T, typename Shape>
+  struct StaticLayerState {
+   static constexpr size_t kInputs = Shape::input_size;
+   static constexpr size_t kOutputs = Shape::output_size;
+
+   alignas(64) std::array<T, kInputs * kOutputs> weights{};  // W transposed: weights[k * kOutputs + o] = W[o][k]
+   alignas(64) std::array<T, kOutputs> bias{};
+   alignas(64) std::array<T, kOutputs> output{};
+
+   void forward(const T* input) {
+    kernels::static_affine<T, kInputs, kOutputs>(weights.data(), bias.data(), input, output.data());
+    Shape::template activation<T>::forward(output.data(), output.data(), kOutputs);
+   }
+
+   void load(const LayerBase<T>& layer, size_t index) {
+    if (layer.input_size() != kInputs || layer.output_size() != kOutputs
+      || layer.activation() != Shape::template activation<T>::kind) {
+     throw std::invalid_argument("load: layer " + std::to_string(index) + " does not match the static topology");
+    }
+    const T* w = layer.weights().data();
+    for (size_t o = 0; o < kOutputs; o++) {
+     for (size_t k = 0; k < kInputs; k++) {
+      weights[k * kOutputs + o] = w[o * kInputs + k];
+     }
+    }
+    const T* b = layer.bias().data();
+    std::copy(b, b + kOutputs, bias.begin());
+   }
+  };
+
+  template<typename First, typename Second, typename... Rest>
+  constexpr bool layers_chain() {
+   if constexpr (sizeof...(Rest) == 0) {
+    return First::output_size == Second::input_size;
+   } else {
+    return First::output_size == Second::input_size && layers_chain<Second, Rest...>();
+   }
+  }
+
+  template<typename... Layers>
+  constexpr bool layers_chain_all() {
+   if constexpr (sizeof...(Layers) < 2) {
+    return true;
+   } else {
+    return layers_chain<Layers...>();
+   }
+  }
+ }
+
+ template<typename T, typename... Layers>
+ class StaticNetwork {
+  static_assert(sizeof...(Layers) > 0, "a network needs at least one layer");
+  static_assert(detail::layers_chain_all<Layers...>(), "each layer must take the outputs of the previous one");
+
+  using First = std::tuple_element_t<0, std::tuple<Layers...>>;
+  using Last = std::tuple_element_t<sizeof...(Layers) - 1, std::tuple<Layers...>>;
+
+  public:
+   static constexpr size_t num_layers = sizeof...(Layers);
+   static constexpr size_t input_size = First::input_size;
+   static constexpr size_t output_size = Last::output_size;
+
+   using Input = std::array<T, input_size>;
+   using Output = std::array<T, output_size>;
+
+   // All parameters zero
+   StaticNetwork() = default;
+
+   explicit StaticNetwork(const Network<T>& network) { load(network); }
+
+   // Copies the parameters of a network with the same topology and activations
+   void load(const Network<T>& network) {
+    const std::vector<LayerBase<T>*>& layers = network.layers();
+    if (layers.size() != num_layers) {
+     throw std::invalid_argument(std::string(__func__) + ": the network has " + std::to_string(layers.size())
+       + " layers, the static topology " + std::to_string(num_layers));
+    }
+    load_layers(layers, std::index_sequence_for<Layers...>());
+   }
+
+   // The returned output belongs to the network and is overwritten by the next call
+   const Output& predict(const T* input) {
+    return forward(input, std::index_sequence_for<Layers...>());
+   }
+
+   const Output& predict(const Input& input) { return predict(input.data()); }
+
+   // A single sample, as a (input_size x 1) column; a padded column is gathered first
+   const Output& predict(const Matrix<T>& input) {
+    if (input.rows() != input_size || input.columns() != 1) {
+     throw std::invalid_argument(std::string(__func__) + ": expected one sample of " + std::to_string(input_size) + " inputs");
+    }
+    if (input.is_contiguous()) {
+     return predict(input.data());
+    }
+    for (size_t k = 0; k < input_size; k++) {
+     gathered_input_[k] = input.data()[k * input.stride()];
+    }
+    return predict(gathered_input_);
+   }
+
+  private:
+   std::tuple<detail::StaticLayerState<T, Layers>...> layers_;
+   Input gathered_input_{};
+
+   template<size_t... I>
+   const Output& forward(const T* input, std::index_sequence<I...>) {
+    const T* current = input;
+    ((std::get<I>(layers_).forward(current), current = std::get<I>(layers_).output.data()), ...);
+    return std::get<num_layers - 1>(layers_).output;
+   }
+
+   template<size_t... I>
+   void load_layers(const std::vector<LayerBase<T>*>& layers, std::index_sequence<I...>) {
+    (std::get<I>(layers_).load(*layers[I], I), ...);
+   }
+ };
+}
+
+#endif
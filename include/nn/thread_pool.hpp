@@ -0,0 +1,239 @@
+ /*
+  * Thread pool
+  *
+  * A fixed set of worker threads, created once and reused by every parallel kernel in the library
+  * (GEMM, elementwise Matrix ops, the activation loops of the layers).
+  *
+  * run(num_tasks, f) calls f(task) for every task index in [0, num_tasks) and returns when all of
+  * them are done. The calling thread works on tasks too, so a pool of N threads owns N - 1 workers.
+  * Dispatching a job does not allocate: the callable is passed by address to the workers.
+  *
+  * Calls made from inside a task, or while another thread is already using the pool, simply run
+  * serially on the calling thread, so nested parallel regions cannot deadlock.
+  *
+  * The library-wide pool is sized from the NN_NUM_THREADS environment variable, or the number of
+  * hardware threads, and can be resized with nn::set_num_threads().
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nn {
+
+ class ThreadPool {
+  public:
+   explicit ThreadPool(size_t num_threads) {
+    const size_t workers = num_threads > 1 ? num_threads - 1 : 0;
+    workers_.reserve(workers);
+    for (size_t i = 0; i < workers; i++) {
+     workers_.emplace_back([this] { worker_loop(); });
+    }
+   }
+
+   ~ThreadPool() {
+    {
+     std::lock_guard<std::mutex> lock(mutex_);
+     stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+     worker.join();
+    }
+   }
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   // Threads taking part in a job, the caller included
+   size_t size() const { return workers_.size() + 1; }
+
+   template<typename F>
+   void run(size_t num_tasks, const F& f) {
+    if (num_tasks == 0) {
+     return;
+    }
+
+    // (checked before locking: the thread running a job already owns dispatch_mutex_)
+    const bool serial = num_tasks == 1 || workers_.empty() || in_parallel_region();
+    std::unique_lock<std::mutex> dispatch(dispatch_mutex_, std::defer_lock);
+    if (serial || !dispatch.try_lock()) {
+     for (size_t task = 0; task < num_tasks; task++) {
+      f(task);
+     }
+     return;
+    }
+
+    {
+     std::lock_guard<std::mutex> lock(mutex_);
+     invoke_ = [](const void* callable, size_t task) { (*static_cast<const F*>(callable))(task); };
+     callable_ = &f;
+     num_tasks_ = num_tasks;
+     next_task_.store(0, std::memory_order_relaxed);
+     checked_in_ = 0;
+     error_ = nullptr;
+     generation_++;
+    }
+    wake_.notify_all();
+
+    execute_tasks();
+
+    {
+     std::unique_lock<std::mutex> lock(mutex_);
+     done_.wait(lock, [this] { return checked_in_ == workers_.size(); });
+    }
+
+    if (error_) {
+     std::rethrow_exception(error_);
+    }
+   }
+
+   // Split [begin, end) into at most size() contiguous chunks of at least grain items, f(lo, hi) per chunk
+   template<typename F>
+   void parallel_for(size_t begin, size_t end, size_t grain, const F& f) {
+    if (end <= begin) {
+     return;
+    }
+
+    const size_t n = end - begin;
+    const size_t chunks = std::min(size(), std::max<size_t>(1, n / std::max<size_t>(1, grain)));
+    if (chunks <= 1) {
+     f(begin, end);
+     return;
+    }
+
+    const size_t chunk = (n + chunks - 1) / chunks;
+    run(chunks, [&](size_t task) {
+     const size_t lo = begin + task * chunk;
+     const size_t hi = std::min(end, lo + chunk);
+     if (lo < hi) {
+      f(lo, hi);
+     }
+    });
+   }
+
+   static bool& in_parallel_region() {
+    thread_local bool inside = false;
+    return inside;
+   }
+
+  private:
+   std::vector<std::thread> workers_;
+
+   std::mutex dispatch_mutex_;  // one job at a time
+   std::mutex mutex_;
+   std::condition_variable wake_;
+   std::condition_variable done_;
+   bool stop_ = false;
+   size_t generation_ = 0;
+   size_t checked_in_ = 0;
+
+   void (*invoke_)(const void*, size_t) = nullptr;
+   const void* callable_ = nullptr;
+   size_t num_tasks_ = 0;
+   std::atomic<size_t> next_task_{0};
+   std::exception_ptr error_;
+
+   void execute_tasks() {
+    bool& inside = in_parallel_region();
+    inside = true;
+    for (size_t task = next_task_.fetch_add(1); task < num_tasks_; task = next_task_.fetch_add(1)) {
+     try {
+      invoke_(callable_, task);
+     } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+       error_ = std::current_exception();
+      }
+     }
+    }
+    inside = false;
+   }
+
+   void worker_loop() {
+    size_t seen = 0;
+    for (;;) {
+     {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+       return;
+      }
+      seen = generation_;
+     }
+
+     execute_tasks();
+
+     // every worker checks in, so the job fields are never rewritten under a late worker
+     std::lock_guard<std::mutex> lock(mutex_);
+     if (++checked_in_ == workers_.size()) {
+      done_.notify_one();
+     }
+    }
+   }
+ };
+
+ namespace detail {
+  inline size_t default_num_threads() {
+   if (const char* env = std::getenv("NN_NUM_THREADS")) {
+    const long n = std::strtol(env, nullptr, 10);
+    if (n > 0) {
+     return static_cast<size_t>(n);
+    }
+   }
+   const unsigned hardware = std::thread::hardware_concurrency();
+   return hardware > 0 ? hardware : 1;
+  }
+
+  inline std::unique_ptr<ThreadPool>& global_pool() {
+   static std::unique_ptr<ThreadPool> pool;
+   return pool;
+  }
+ }
+
+ // The library-wide pool, created on first use
+ inline ThreadPool& thread_pool() {
+  auto& pool = detail::global_pool();
+  static std::once_flag created;
+  std::call_once(created, [&pool] {
+   if (!pool) {
+    pool.reset(new ThreadPool(detail::default_num_threads()));
+   }
+  });
+  return *pool;
+ }
+
+ inline size_t num_threads() { return thread_pool().size(); }
+
+ // Resize the library-wide pool; must not be called while a parallel operation is running
+ inline void set_num_threads(size_t n) {
+  auto& pool = detail::global_pool();
+  if (!pool || pool->size() != std::max<size_t>(1, n)) {
+   pool.reset();
+   pool.reset(new ThreadPool(std::max<size_t>(1, n)));
+  }
+ }
+
+ template<typename F>
+ void parallel_for(size_t begin, size_t end, size_t grain, const F& f) {
+  if (end <= begin) {
+   return;
+  }
+  if (end - begin < 2 * grain) {
+   f(begin, end);
+   return;
+  }
+  thread_pool().parallel_for(begin, end, grain, f);
+ }
+}
+
+#endif
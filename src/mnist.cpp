@@ -21,47 +21,52 @@ int main() {
     network.add(layer2);
     network.add(layer3);
     
-    auto* optimizer1 = new nn::SGD<float>(0.01, 0.9);  // learning_rate=0.01, momentum=0.9
-    auto* optimizer2 = new nn::SGD<float>(0.01, 0.9);  // learning_rate=0.01, momentum=0.9 
-    auto* optimizer3 = new nn::SGD<float>(0.01, 0.9);  // learning_rate=0.01, momentum=0.9 
-    
-    layer1->set_optimizer(optimizer1);
-    layer2->set_optimizer(optimizer2);
-    layer3->set_optimizer(optimizer3);
+    // One update per batch with the gradients averaged over the batch, hence the larger step.
+    // A single optimizer updates the parameters of all layers, kept in one buffer by the network
+    auto* optimizer = new nn::SGD<float>(0.1, 0.9);  // learning_rate=0.1, momentum=0.9
+    network.set_optimizer(optimizer);
     
     try {
         std::cout << "Loading MNIST dataset..." << std::endl;
         
         std::string data_path = "./data/";  // adjust path if needed
-        std::vector<Matrix<float> > training_images = mnist::load_images(data_path + "train-images.idx3-ubyte", 1000);
-        std::vector<Matrix<float> > training_labels = mnist::load_labels(data_path + "train-labels.idx1-ubyte", 1000);
-        
-        std::vector<Matrix<float> > test_images = mnist::load_images(data_path + "t10k-images.idx3-ubyte", 100);
-        std::vector<Matrix<float> > test_labels = mnist::load_labels(data_path + "t10k-labels.idx1-ubyte", 100);
+        nn::Dataset<float> training_set = mnist::load_dataset(
+            data_path + "train-images.idx3-ubyte", data_path + "train-labels.idx1-ubyte", 1000);
+        nn::Dataset<float> test_set = mnist::load_dataset(
+            data_path + "t10k-images.idx3-ubyte", data_path + "t10k-labels.idx1-ubyte", 100);
         
-        std::cout << "Loaded " << training_images.size() << " training images and " 
-                  << test_images.size() << " test images." << std::endl;
+        std::cout << "Loaded " << training_set.size() << " training images and " 
+                  << test_set.size() << " test images." << std::endl;
         
         // Train
         network.set_verbosity(nn::Verbosity::DETAILED);
         std::cout << "\nTraining network...\n" << std::endl;
-        network.train(training_images, training_labels, 10, 32);  // 10 epochs, batch size 32
+        // Batches of 32 are shuffled and gathered on a loader thread while the previous one trains
+        nn::BatchLoader<float> loader(training_set, 32, true, 42);
+        network.train(loader, 10);  // 10 epochs
+#ifdef NN_PROFILE
+        nn::profile::profiler().write_chrome_trace("mnist_trace.json");
+        std::cout << "Trace of the training written to mnist_trace.json" << std::endl;
+#endif
         
         std::cout << "\nEvaluating on test set...\n" << std::endl;
         size_t correct = 0;
-        for (size_t i = 0; i < test_images.size(); ++i) {
-            Matrix<float> prediction = network.forward(test_images[i]);
-            if (network.is_prediction_correct(prediction, test_labels[i])) {
+        Matrix<float> image(0, 0);
+        Matrix<float> label(0, 0);
+        for (size_t i = 0; i < test_set.size(); ++i) {
+            test_set.gather(i, 1, image, label);
+            const Matrix<float>& prediction = network.predict(image);
+            if (network.is_prediction_correct(prediction, label)) {
                 correct++;
             }
             
             // Visualize some predictions
             if (i < 10) {
-             mnist::visualize_prediction(test_images[i], prediction, test_labels[i]);
+             mnist::visualize_prediction(image, prediction, label);
             }
         }
         
-        std::cout << "Test accuracy: " << (float)correct / test_images.size() * 100 << "%" << std::endl;
+        std::cout << "Test accuracy: " << (float)correct / test_set.size() * 100 << "%" << std::endl;
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -72,9 +77,7 @@ int main() {
     delete layer1;
     delete layer2;
     delete layer3;
-    delete optimizer1;
-    delete optimizer2;
-    delete optimizer3;
+    delete optimizer;
     
     return 0;
 }
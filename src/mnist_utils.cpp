@@ -4,117 +4,98 @@
 #include <iomanip>
 #include <algorithm>
 #include <cstring>
+#include "nn/dataset.hpp"
+#include "nn/idx.hpp"
 #include "nn/matrix.hpp"
 
 namespace mnist {
- // read MNIST file format (big endian)
- uint32_t read_big_endian_int(std::ifstream& file) {
-  /*
-   * reads a 32-bit integer from a file in big-endian format
-   * first, it reads 4 bytes from the file into a buffer
-   * then it combines these bytes to form a 32-bit integer:
-   *   - buf[0] contains the most significant byte (shifted left by 24 bits)
-   *   - buf[1] is the second byte (shifted left by 16 bits)
-   *   - buf[2] is the third byte (shifted left by 8 bits)
-   *   - buf[3] is the least significant byte (used as is)
-   * third, the bytes are combined using bitwise OR
-   */
-
-  uint8_t buf[4];
-  file.read(reinterpret_cast<char*>(buf), 4);
-  return (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 | (uint32_t)buf[2] << 8 | (uint32_t)buf[3];
- }
- 
+ /*
+  * MNIST files are IDX files (see nn/idx.hpp):
+  *   - images: magic number 0x803, dimensions (number of images, rows (28), columns (28))
+  *   - labels: magic number 0x801, dimension (number of labels)
+  * The file is mapped once and the pixels are converted straight into the image matrices.
+ */
  std::vector<Matrix<float> > load_images(const std::string& filename, size_t max_images = -1) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file.is_open()) {
-   throw std::runtime_error("cannot open file: " + filename);
-  }
-  
-  /*
-   * MNIST image file format has a 16-byte header:
-   *   - 4 bytes: magic number (0x803)
-   *   - 4 bytes: number of images
-   *   - 4 bytes: number of rows (28)
-   *   - 4 bytes: number of columns (28)
-   *   - followed by rows*cols bytes for each image
-   */
-
-  uint32_t magic = read_big_endian_int(file); // magic number (0x803 for images) - first 4 bytes
-  if (magic != 0x803) {
+  nn::IdxFile file(filename);
+  if (file.magic() != 0x803) {
    throw std::runtime_error("invalid MNIST image file format");
   }
 
-  uint32_t num_images = read_big_endian_int(file); // second 4 bytes
-  uint32_t rows = read_big_endian_int(file); // third 4 bytes
-  uint32_t cols = read_big_endian_int(file); // fourth 4 bytes
-    
-  if (max_images != -1 && max_images < num_images) {
-   num_images = max_images;
-  }
+  const size_t num_images = std::min(file.count(), max_images);
+  const size_t pixels = file.sample_size();
 
   std::vector<Matrix<float> > images;
   images.reserve(num_images);
 
-  for (uint32_t i = 0; i < num_images; ++i) {
-   std::vector<float> pixels(rows * cols);
-        
-   for (uint32_t j = 0; j < rows * cols; ++j) {
-    uint8_t pixel;
-    file.read(reinterpret_cast<char*>(&pixel), 1);
-    pixels[j] = static_cast<float>(pixel) / 255.0f; // normalize pixel values to [0, 1]
-   }
-        
-   // Flatten image into vector
-   Matrix<float> image(rows * cols, 1, pixels);
-   images.push_back(image);
+  for (size_t i = 0; i < num_images; ++i) {
+   // Flatten image into vector, pixel values normalized to [0, 1]
+   Matrix<float> image(pixels, 1);
+   file.to_float(i, 1, image.data());
+   images.push_back(std::move(image));
   }
 
   return images;
  }
 
  std::vector<Matrix<float> > load_labels(const std::string& filename, size_t max_labels = -1) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file.is_open()) {
-   throw std::runtime_error("cannot open file: " + filename);
-  }
-
-  /*
-   * MNIST label file format has an 8-byte header:
-   *   - 4 bytes: magic number (0x801)
-   *   - 4 bytes: number of labels
-   *   - followed by 1 byte for each label
-   */
-
-  uint32_t magic = read_big_endian_int(file);
-  if (magic != 0x801) { // magic number (0x801 for labels) - first 4 bytes
+  nn::IdxFile file(filename);
+  if (file.magic() != 0x801) {
    throw std::runtime_error("invalid MNIST label file format");
   }
 
-  uint32_t num_labels = read_big_endian_int(file); // second 4 bytes
-    
-  if (max_labels != -1 && max_labels < num_labels) {
-   num_labels = max_labels;
-  }
+  const size_t num_labels = std::min(file.count(), max_labels);
 
   std::vector<Matrix<float> > labels;
   labels.reserve(num_labels);
- 
-  for (uint32_t i = 0; i < num_labels; ++i) {
-   uint8_t label;
-   file.read(reinterpret_cast<char*>(&label), 1);
-        
+
+  for (size_t i = 0; i < num_labels; ++i) {
+   const uint8_t label = file.data()[i];
+   if (label >= 10) {
+    throw std::runtime_error("invalid MNIST label: " + std::to_string(label));
+   }
+
    // Convert to one-hot encoding
-   std::vector<float> one_hot(10, 0.0f);
-   one_hot[label] = 1.0f;
-        
-   Matrix<float> label_matrix(10, 1, one_hot);
-   labels.push_back(label_matrix);
+   Matrix<float> label_matrix(10, 1);
+   label_matrix.at(label, 0) = 1.0f;
+   labels.push_back(std::move(label_matrix));
   }
- 
+
   return labels;
  }
 
+ /*
+  * Images and labels as one contiguous data set: the pixels are converted in a single pass into
+  * the feature block and the labels stay class indices.
+ */
+ nn::Dataset<float> load_dataset(const std::string& images_filename, const std::string& labels_filename,
+   size_t max_samples = -1) {
+  nn::IdxFile images(images_filename);
+  if (images.magic() != 0x803) {
+   throw std::runtime_error("invalid MNIST image file format");
+  }
+  nn::IdxFile labels(labels_filename);
+  if (labels.magic() != 0x801) {
+   throw std::runtime_error("invalid MNIST label file format");
+  }
+  if (images.count() != labels.count()) {
+   throw std::runtime_error("MNIST image and label files do not match");
+  }
+
+  const size_t num_samples = std::min(images.count(), max_samples);
+  nn::Dataset<float> dataset(num_samples, images.sample_size(), 10);
+
+  images.to_float(0, num_samples, dataset.features());
+  for (size_t i = 0; i < num_samples; ++i) {
+   const uint8_t label = labels.data()[i];
+   if (label >= 10) {
+    throw std::runtime_error("invalid MNIST label: " + std::to_string(label));
+   }
+   dataset.set_label(i, label);
+  }
+
+  return dataset;
+ }
+
  void visualize_prediction(const Matrix<float>& image, const Matrix<float>& prediction, const Matrix<float>& target) {
   // Determine the actual digit (from target one-hot)
   int actual_digit = 0;
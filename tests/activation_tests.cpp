@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
 #include "nn/activation.hpp"
 
 class ReLUTest : public ::testing::Test {
@@ -168,3 +170,133 @@ TEST_F(LeakyReLUTest, BackwardPass) {
     // Test zero input
     EXPECT_FLOAT_EQ(nn::activations::LeakyReLU<float>::backward(0.0f, 0.01f), 0.01f);
 }
+
+class BatchedActivationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        detected = nn::simd::detect_isa();
+        // dense sweep of the interesting range, plus saturated values; 1001 is not a multiple of any vector width
+        for (int i = 0; i < 1001; i++) {
+            inputs.push_back(-10.0f + 20.0f * i / 1000.0f);
+        }
+        inputs.insert(inputs.end(), {-100.0f, -50.0f, -0.3f, 1e-6f, -1e-6f, 0.0f, 50.0f, 100.0f});
+    }
+    void TearDown() override { nn::simd::set_isa(detected); }
+
+    // Run a batched pass under every instruction set and compare with a double precision reference
+    template<typename F, typename Ref>
+    void expect_matches(F batched, Ref reference, double tolerance) {
+        for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+            nn::simd::set_isa(isa);
+            std::vector<float> outputs(inputs.size());
+            batched(inputs.data(), outputs.data(), inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++) {
+                ASSERT_NEAR(outputs[i], reference(static_cast<double>(inputs[i])), tolerance)
+                    << "x=" << inputs[i] << " isa=" << nn::simd::isa_name(nn::simd::active_isa());
+            }
+        }
+    }
+
+    nn::simd::Isa detected = nn::simd::Isa::SCALAR;
+    std::vector<float> inputs;
+};
+
+TEST_F(BatchedActivationTest, ReLU) {
+    using A = nn::activations::ReLU<float>;
+    expect_matches([](const float* x, float* y, size_t n) { A::forward(x, y, n); },
+        [](double x) { return x > 0 ? x : 0.0; }, 0.0);
+    expect_matches([](const float* x, float* y, size_t n) { A::backward(x, y, n); },
+        [](double x) { return x > 0 ? 1.0 : 0.0; }, 0.0);
+}
+
+TEST_F(BatchedActivationTest, LeakyReLU) {
+    using A = nn::activations::LeakyReLU<float>;
+    expect_matches([](const float* x, float* y, size_t n) { A::forward(x, y, n, 0.1f); },
+        [](double x) { return x > 0 ? x : static_cast<double>(static_cast<float>(x) * 0.1f); }, 0.0);
+    expect_matches([](const float* x, float* y, size_t n) { A::backward(x, y, n, 0.1f); },
+        [](double x) { return x > 0 ? 1.0 : static_cast<double>(0.1f); }, 0.0);
+}
+
+TEST_F(BatchedActivationTest, Identity) {
+    using A = nn::activations::Identity<float>;
+    EXPECT_EQ(A::forward(-3.5f), -3.5f);
+    EXPECT_EQ(A::backward(-3.5f), 1.0f);
+    expect_matches([](const float* x, float* y, size_t n) { A::forward(x, y, n); },
+        [](double x) { return x; }, 0.0);
+    expect_matches([](const float* x, float* y, size_t n) { A::backward(x, y, n); },
+        [](double) { return 1.0; }, 0.0);
+    expect_matches([](const float* x, float* y, size_t n) { A::backward(x, x, y, n); },
+        [](double x) { return x; }, 0.0);
+}
+
+TEST_F(BatchedActivationTest, Sigmoid) {
+    using A = nn::activations::Sigmoid<float>;
+    // documented bound of the vector kernels: 1e-7 absolute
+    expect_matches([](const float* x, float* y, size_t n) { A::forward(x, y, n); },
+        [](double x) { return 1.0 / (1.0 + std::exp(-x)); }, 1e-7);
+    expect_matches([](const float* x, float* y, size_t n) { A::backward(x, y, n); },
+        [](double x) { double s = 1.0 / (1.0 + std::exp(-x)); return s * (1.0 - s); }, 1e-7);
+}
+
+TEST_F(BatchedActivationTest, Tanh) {
+    using A = nn::activations::Tanh<float>;
+    expect_matches([](const float* x, float* y, size_t n) { A::forward(x, y, n); },
+        [](double x) { return std::tanh(x); }, 1e-7);
+    expect_matches([](const float* x, float* y, size_t n) { A::backward(x, y, n); },
+        [](double x) { double t = std::tanh(x); return 1.0 - t * t; }, 2e-7);
+
+    // odd function, also for the vector kernels
+    std::vector<float> positive(inputs.size()), negative(inputs.size()), outputs(inputs.size()), mirrored(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        positive[i] = std::fabs(inputs[i]);
+        negative[i] = -positive[i];
+    }
+    A::forward(positive.data(), outputs.data(), positive.size());
+    A::forward(negative.data(), mirrored.data(), negative.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        EXPECT_EQ(outputs[i], -mirrored[i]);
+    }
+}
+
+TEST_F(BatchedActivationTest, InPlaceAndDouble) {
+    // x and y may be the same buffer
+    std::vector<float> values = inputs;
+    nn::activations::Sigmoid<float>::forward(values.data(), values.data(), values.size());
+    std::vector<float> expected(inputs.size());
+    nn::activations::Sigmoid<float>::forward(inputs.data(), expected.data(), inputs.size());
+    EXPECT_EQ(values, expected);
+
+    // double buffers use the exact per-element functions
+    std::vector<double> x(inputs.begin(), inputs.end());
+    std::vector<double> y(x.size());
+    nn::activations::Tanh<double>::forward(x.data(), y.data(), x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+        EXPECT_EQ(y[i], nn::activations::Tanh<double>::forward(x[i]));
+    }
+}
+
+TEST_F(BatchedActivationTest, FusedGradientMatchesSeparatePasses) {
+    std::vector<float> gradient(inputs.size());
+    for (size_t i = 0; i < gradient.size(); i++) {
+        gradient[i] = 0.5f - static_cast<float>(i % 7) / 7.0f;
+    }
+
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        std::vector<float> derivative(inputs.size()), fused(inputs.size());
+
+        nn::activations::Sigmoid<float>::backward(inputs.data(), derivative.data(), inputs.size());
+        nn::activations::Sigmoid<float>::backward(inputs.data(), gradient.data(), fused.data(), inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            EXPECT_EQ(fused[i], gradient[i] * derivative[i]);
+        }
+
+        nn::activations::LeakyReLU<float>::backward(inputs.data(), derivative.data(), inputs.size(), 0.2f);
+        // in place over the gradient
+        fused = gradient;
+        nn::activations::LeakyReLU<float>::backward(inputs.data(), fused.data(), fused.data(), inputs.size(), 0.2f);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            EXPECT_EQ(fused[i], gradient[i] * derivative[i]);
+        }
+    }
+}
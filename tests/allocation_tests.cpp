@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+
+/*
+ * Heap allocation counts of the hot paths.
+ * The global operator new of this test binary, plain and aligned, is replaced by a counting one.
+ */
+
+namespace {
+std::atomic<size_t> allocation_count{0};
+
+void* counted_malloc(std::size_t size) {
+    allocation_count++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* counted_aligned_alloc(std::size_t size, std::align_val_t alignment) {
+    allocation_count++;
+    const std::size_t a = static_cast<std::size_t>(alignment);
+    if (void* p = std::aligned_alloc(a, size ? (size + a - 1) / a * a : a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+}
+
+// Every form is replaced, each new with its delete, so that GCC sees malloc paired with free
+void* operator new(std::size_t size) { return counted_malloc(size); }
+void* operator new[](std::size_t size) { return counted_malloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// Matrix storage comes from the aligned forms (see aligned_allocator.hpp)
+void* operator new(std::size_t size, std::align_val_t alignment) { return counted_aligned_alloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return counted_aligned_alloc(size, alignment); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+template<typename F>
+size_t count_allocations(F&& f) {
+    size_t before = allocation_count.load();
+    f();
+    return allocation_count.load() - before;
+}
+
+}
+
+class AllocationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        layer1 = new nn::Layer<float, nn::activations::ReLU>(784, 128);
+        layer2 = new nn::Layer<float, nn::activations::ReLU>(128, 64);
+        layer3 = new nn::Layer<float, nn::activations::Sigmoid>(64, 10);
+        network.add(layer1);
+        network.add(layer2);
+        network.add(layer3);
+    }
+
+    void TearDown() override {
+        delete layer1;
+        delete layer2;
+        delete layer3;
+    }
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU>* layer1 = nullptr;
+    nn::Layer<float, nn::activations::ReLU>* layer2 = nullptr;
+    nn::Layer<float, nn::activations::Sigmoid>* layer3 = nullptr;
+};
+
+TEST_F(AllocationTest, PredictDoesNotAllocate) {
+    Matrix<float> input(784, 1);
+
+    // the first call sizes the buffers
+    network.predict(input);
+
+    EXPECT_EQ(count_allocations([&] { network.predict(input); }), 0);
+
+    // forward, for comparison, copies into the layer caches and returns new matrices
+    EXPECT_GT(count_allocations([&] { network.forward(input); }), 0);
+}
+
+TEST_F(AllocationTest, PredictDoesNotAllocateForSmallerBatches) {
+    Matrix<float> batch(784, 32);
+    Matrix<float> single(784, 1);
+
+    network.predict(batch);
+
+    EXPECT_EQ(count_allocations([&] {
+        network.predict(single);
+        network.predict(batch);
+    }), 0);
+}
+
+TEST_F(AllocationTest, TrainStepDoesNotAllocate) {
+    nn::SGD<float> optimizer1(0.01f, 0.9f);
+    nn::SGD<float> optimizer2(0.01f, 0.9f);
+    nn::SGD<float> optimizer3(0.01f, 0.9f);
+    layer1->set_optimizer(&optimizer1);
+    layer2->set_optimizer(&optimizer2);
+    layer3->set_optimizer(&optimizer3);
+
+    Matrix<float> batch(784, 32);
+    Matrix<float> batch_target(10, 32);
+    Matrix<float> single(784, 1);
+    Matrix<float> single_target(10, 1);
+
+    // the first step sizes the workspaces, the optimizer velocities and the packing buffers
+    network.train_step(batch, batch_target);
+
+    EXPECT_EQ(count_allocations([&] { network.train_step(batch, batch_target); }), 0);
+    EXPECT_EQ(count_allocations([&] { network.train_step(single, single_target); }), 0);
+}
+
+TEST_F(AllocationTest, TrainEpochDoesNotAllocate) {
+    nn::SGD<float> optimizer1(0.01f);
+    nn::SGD<float> optimizer2(0.01f);
+    nn::SGD<float> optimizer3(0.01f);
+    layer1->set_optimizer(&optimizer1);
+    layer2->set_optimizer(&optimizer2);
+    layer3->set_optimizer(&optimizer3);
+
+    std::vector<Matrix<float>> inputs(100, Matrix<float>(784, 1));
+    std::vector<Matrix<float>> targets(100, Matrix<float>(10, 1));
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    network.train(inputs, targets, 1, 16);
+
+    EXPECT_EQ(count_allocations([&] { network.train(inputs, targets, 2, 16); }), 0);
+}
+
+TEST_F(AllocationTest, TrainOnDatasetDoesNotAllocate) {
+    nn::SGD<float> optimizer1(0.01f);
+    nn::SGD<float> optimizer2(0.01f);
+    nn::SGD<float> optimizer3(0.01f);
+    layer1->set_optimizer(&optimizer1);
+    layer2->set_optimizer(&optimizer2);
+    layer3->set_optimizer(&optimizer3);
+
+    nn::Dataset<float> data(100, 784, 10);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    network.train(data, 1, 16);
+
+    EXPECT_EQ(count_allocations([&] { network.train(data, 2, 16); }), 0);
+}
+
+TEST_F(AllocationTest, TrainWithBatchLoaderDoesNotAllocate) {
+    nn::SGD<float> optimizer1(0.01f);
+    nn::SGD<float> optimizer2(0.01f);
+    nn::SGD<float> optimizer3(0.01f);
+    layer1->set_optimizer(&optimizer1);
+    layer2->set_optimizer(&optimizer2);
+    layer3->set_optimizer(&optimizer3);
+
+    nn::Dataset<float> data(100, 784, 10);
+    nn::BatchLoader<float> loader(data, 16, true, 3);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    // every slot of the ring has held a full batch after the first epoch
+    network.train(loader, 1);
+
+    EXPECT_EQ(count_allocations([&] { network.train(loader, 2); }), 0);
+}
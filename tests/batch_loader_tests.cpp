@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "nn/batch_loader.hpp"
+
+class BatchLoaderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // feature 0 of sample i is i, class i % 3
+        for (size_t i = 0; i < 23; i++) {
+            data.sample(i)[0] = static_cast<float>(i);
+            data.sample(i)[1] = -static_cast<float>(i);
+            data.set_label(i, static_cast<uint32_t>(i % 3));
+        }
+    }
+    void TearDown() override {}
+
+    // Sample order of one epoch as seen through the loader
+    static std::vector<size_t> epoch_order(nn::BatchLoader<float>& loader, size_t epoch) {
+        std::vector<size_t> order;
+        for (size_t b = 0; b < loader.batches_per_epoch(); b++) {
+            const nn::Batch<float>& batch = loader.next();
+            EXPECT_EQ(batch.epoch, epoch);
+            EXPECT_EQ(batch.first, b * loader.batch_size());
+            EXPECT_EQ(batch.inputs.columns(), batch.count);
+            // class indices: the labels alone, no one-hot targets
+            EXPECT_EQ(batch.targets.rows(), 0u);
+            EXPECT_EQ(batch.labels.size(), batch.count);
+            for (size_t j = 0; j < batch.count; j++) {
+                const size_t i = static_cast<size_t>(batch.inputs.at(0, j));
+                EXPECT_EQ(batch.inputs.at(1, j), -static_cast<float>(i));
+                EXPECT_EQ(batch.labels.at(j), i % 3);
+                order.push_back(i);
+            }
+        }
+        return order;
+    }
+
+    nn::Dataset<float> data = nn::Dataset<float>(23, 2, 3);
+};
+
+TEST_F(BatchLoaderTest, UnshuffledEpochsKeepDatasetOrder) {
+    nn::BatchLoader<float> loader(data, 5);
+    EXPECT_EQ(loader.batches_per_epoch(), 5);
+
+    std::vector<size_t> expected(23);
+    for (size_t i = 0; i < 23; i++) {
+        expected[i] = i;
+    }
+    for (size_t epoch = 0; epoch < 3; epoch++) {
+        EXPECT_EQ(epoch_order(loader, epoch), expected);
+    }
+}
+
+TEST_F(BatchLoaderTest, ShuffleIsDeterministicPerSeedAndEpoch) {
+    nn::BatchLoader<float> loader(data, 4, true, 7);
+    nn::BatchLoader<float> same_seed(data, 6, true, 7, 3);
+    nn::BatchLoader<float> other_seed(data, 4, true, 8);
+
+    const std::vector<size_t> first = epoch_order(loader, 0);
+    const std::vector<size_t> second = epoch_order(loader, 1);
+
+    std::vector<size_t> sorted = first;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < 23; i++) {
+        EXPECT_EQ(sorted[i], i);
+    }
+    EXPECT_NE(first, second);
+
+    // The order depends on the seed and the epoch only, not on the batch size or ring depth
+    EXPECT_EQ(epoch_order(same_seed, 0), first);
+    EXPECT_EQ(epoch_order(same_seed, 1), second);
+    EXPECT_NE(epoch_order(other_seed, 0), first);
+}
+
+TEST_F(BatchLoaderTest, DenseTargetsComeWithoutLabels) {
+    nn::Dataset<float> dense(5, 1, 2, nn::Targets::DENSE);
+    for (size_t i = 0; i < 5; i++) {
+        dense.sample(i)[0] = static_cast<float>(i);
+        dense.target(i)[0] = static_cast<float>(i);
+        dense.target(i)[1] = 2.0f * i;
+    }
+
+    nn::BatchLoader<float> loader(dense, 5);
+    const nn::Batch<float>& batch = loader.next();
+    EXPECT_TRUE(batch.labels.empty());
+    ASSERT_EQ(batch.targets.rows(), 2u);
+    ASSERT_EQ(batch.targets.columns(), 5u);
+    for (size_t j = 0; j < 5; j++) {
+        EXPECT_EQ(batch.targets.at(0, j), static_cast<float>(j));
+        EXPECT_EQ(batch.targets.at(1, j), 2.0f * j);
+    }
+}
+
+TEST_F(BatchLoaderTest, PreparesNextBatchInBackground) {
+    std::atomic<size_t> filled{0};
+    nn::BatchLoader<float> loader(10, 2,
+        [&](const size_t* indices, size_t count, Matrix<float>& inputs, Matrix<float>& targets) {
+            inputs.resize(1, count);
+            targets.resize(1, count);
+            for (size_t j = 0; j < count; j++) {
+                inputs.at(0, j) = static_cast<float>(indices[j]);
+            }
+            filled++;
+        }, false, 0, 3);
+
+    const nn::Batch<float>& batch = loader.next();
+    EXPECT_EQ(batch.inputs.at(0, 1), 1.0f);
+
+    // While the first batch is held, the loader fills the other two slots and then waits
+    for (int i = 0; i < 1000 && filled.load() < 3; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(filled.load(), 3);
+
+    EXPECT_EQ(loader.next().inputs.at(0, 0), 2.0f);
+    EXPECT_EQ(loader.next().inputs.at(0, 0), 4.0f);
+}
+
+TEST_F(BatchLoaderTest, SourceErrorsReachTheTrainingThread) {
+    nn::BatchLoader<float> loader(10, 4,
+        [](const size_t* indices, size_t count, Matrix<float>& inputs, Matrix<float>& targets) {
+            if (indices[0] >= 4) {
+                throw std::runtime_error("cannot decode sample");
+            }
+            inputs.resize(1, count);
+            targets.resize(1, count);
+        });
+
+    EXPECT_NO_THROW(loader.next());
+    EXPECT_THROW(loader.next(), std::runtime_error);
+
+    EXPECT_THROW(nn::BatchLoader<float>(data, 0), std::invalid_argument);
+    EXPECT_THROW(nn::BatchLoader<float>(data, 4, false, 0, 0), std::invalid_argument);
+}
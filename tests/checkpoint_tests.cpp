@@ -0,0 +1,289 @@
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "nn/checkpoint.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+
+class CheckpointTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() / "nn_checkpoint_test.nnckpt").string();
+
+        network.add(&hidden);
+        network.add(&output);
+        hidden.set_optimizer(&hidden_optimizer);
+        output.set_optimizer(&output_optimizer);
+        network.set_verbosity(nn::Verbosity::SILENT);
+
+        for (size_t i = 0; i < 8; i++) {
+            inputs.emplace_back(4, 1, std::vector<float>{0.1f * i, 0.5f - 0.05f * i, (i % 2) * 0.3f, 0.2f});
+            targets.emplace_back(3, 1, std::vector<float>{i % 3 == 0 ? 1.0f : 0.0f, i % 3 == 1 ? 1.0f : 0.0f, i % 3 == 2 ? 1.0f : 0.0f});
+        }
+    }
+    void TearDown() override { std::filesystem::remove(path); }
+
+    static void expect_equal(const Matrix<float>& a, const Matrix<float>& b) {
+        ASSERT_EQ(a.rows(), b.rows());
+        ASSERT_EQ(a.columns(), b.columns());
+        for (size_t i = 0; i < a.rows(); i++) {
+            for (size_t j = 0; j < a.columns(); j++) {
+                EXPECT_EQ(a.at(i, j), b.at(i, j));
+            }
+        }
+    }
+
+    std::string path;
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::Tanh> hidden = nn::Layer<float, nn::activations::Tanh>(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> output = nn::Layer<float, nn::activations::Sigmoid>(6, 3);
+    nn::SGD<float> hidden_optimizer = nn::SGD<float>(0.1f, 0.9f);
+    nn::SGD<float> output_optimizer = nn::SGD<float>(0.1f, 0.9f);
+    std::vector<Matrix<float>> inputs;
+    std::vector<Matrix<float>> targets;
+};
+
+TEST_F(CheckpointTest, RoundTripRestoresParametersAndOptimizerState) {
+    network.train(inputs, targets, 3, 4);
+    nn::save_checkpoint(network, path);
+
+    nn::Network<float> restored;
+    nn::Layer<float, nn::activations::Tanh> restored_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> restored_output(6, 3);
+    nn::SGD<float> restored_hidden_optimizer(0.5f);
+    nn::SGD<float> restored_output_optimizer(0.5f);
+    restored_hidden.set_optimizer(&restored_hidden_optimizer);
+    restored_output.set_optimizer(&restored_output_optimizer);
+    restored.add(&restored_hidden);
+    restored.add(&restored_output);
+    restored.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::load_checkpoint(restored, path);
+    expect_equal(restored_hidden.weights(), hidden.weights());
+    expect_equal(restored_output.bias(), output.bias());
+    EXPECT_EQ(restored_hidden_optimizer.settings(), hidden_optimizer.settings());
+
+    // with the velocities restored, training continues exactly as it would have
+    network.train(inputs, targets, 1, 4);
+    restored.train(inputs, targets, 1, 4);
+    expect_equal(restored_hidden.weights(), hidden.weights());
+    expect_equal(restored_output.weights(), output.weights());
+    expect_equal(restored_output.bias(), output.bias());
+}
+
+TEST_F(CheckpointTest, RoundTripContinuesAdamWSchedule) {
+    // moments and step count are restored, so the bias corrections pick up where they were
+    nn::AdamW<float> adam_hidden(0.01f), adam_output(0.01f);
+    hidden.set_optimizer(&adam_hidden);
+    output.set_optimizer(&adam_output);
+    network.train(inputs, targets, 2, 4);
+    nn::save_checkpoint(network, path);
+
+    nn::Network<float> restored;
+    nn::Layer<float, nn::activations::Tanh> restored_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> restored_output(6, 3);
+    nn::AdamW<float> restored_adam_hidden, restored_adam_output;
+    restored_hidden.set_optimizer(&restored_adam_hidden);
+    restored_output.set_optimizer(&restored_adam_output);
+    restored.add(&restored_hidden);
+    restored.add(&restored_output);
+    restored.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::load_checkpoint(restored, path);
+    EXPECT_EQ(restored_adam_hidden.step(), 4u);
+    EXPECT_EQ(restored_adam_output.settings(), adam_output.settings());
+
+    network.train(inputs, targets, 1, 4);
+    restored.train(inputs, targets, 1, 4);
+    expect_equal(restored_hidden.weights(), hidden.weights());
+    expect_equal(restored_output.weights(), output.weights());
+    expect_equal(restored_output.bias(), output.bias());
+}
+
+TEST_F(CheckpointTest, RoundTripRestoresNetworkOptimizer) {
+    // one optimizer for the whole network, its state covers the parameter arena
+    nn::Network<float> shared;
+    nn::Layer<float, nn::activations::Tanh> shared_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> shared_output(6, 3);
+    nn::Adam<float> adam(0.01f);
+    shared.add(&shared_hidden);
+    shared.add(&shared_output);
+    shared.set_optimizer(&adam);
+    shared.set_verbosity(nn::Verbosity::SILENT);
+    shared.train(inputs, targets, 2, 4);
+    nn::save_checkpoint(shared, path);
+
+    nn::Network<float> restored;
+    nn::Layer<float, nn::activations::Tanh> restored_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> restored_output(6, 3);
+    nn::Adam<float> restored_adam;
+    restored.add(&restored_hidden);
+    restored.add(&restored_output);
+    restored.set_optimizer(&restored_adam);
+    restored.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::load_checkpoint(restored, path);
+    EXPECT_EQ(restored_adam.step(), 4u);
+    expect_equal(*restored_adam.state()[1], *adam.state()[1]);
+
+    shared.train(inputs, targets, 1, 4);
+    restored.train(inputs, targets, 1, 4);
+    expect_equal(restored_hidden.weights(), shared_hidden.weights());
+    expect_equal(restored_output.bias(), shared_output.bias());
+
+    // another network optimizer does not match
+    nn::SGD<float> sgd(0.1f);
+    nn::Network<float> other;
+    nn::Layer<float, nn::activations::Tanh> other_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> other_output(6, 3);
+    other.add(&other_hidden);
+    other.add(&other_output);
+    other.set_optimizer(&sgd);
+    EXPECT_THROW(nn::load_checkpoint(other, path), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, RejectsOptimizerStateOfOtherShapes) {
+    // the stored (rows, columns) of array index of the array table, rewritten in place
+    auto reshape_array = [&](size_t index, uint64_t rows, uint64_t columns) {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        const size_t record = sizeof(nn::checkpoint::Header) + 2 * sizeof(nn::checkpoint::LayerRecord)
+            + index * sizeof(nn::checkpoint::ArrayRecord);
+        file.seekp(static_cast<std::streamoff>(record + offsetof(nn::checkpoint::ArrayRecord, rows)));
+        file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+        file.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+    };
+
+    // per layer: weights, bias, settings, then the weight velocity of the hidden layer
+    network.train(inputs, targets, 1, 4);
+    nn::save_checkpoint(network, path);
+    reshape_array(3, 4, 6);
+
+    nn::Network<float> restored;
+    nn::Layer<float, nn::activations::Tanh> restored_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> restored_output(6, 3);
+    nn::SGD<float> hidden_sgd(0.1f, 0.9f), output_sgd(0.1f, 0.9f);
+    restored_hidden.set_optimizer(&hidden_sgd);
+    restored_output.set_optimizer(&output_sgd);
+    restored.add(&restored_hidden);
+    restored.add(&restored_output);
+    const Matrix<float> weights = restored_hidden.weights();
+    EXPECT_THROW(nn::load_checkpoint(restored, path), std::runtime_error);
+    expect_equal(restored_hidden.weights(), weights);  // nothing was loaded
+
+    // network optimizer: the arrays of both layers, the settings, then the state of the weight region
+    nn::Network<float> shared;
+    nn::Layer<float, nn::activations::Tanh> shared_hidden(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> shared_output(6, 3);
+    nn::SGD<float> shared_sgd(0.1f, 0.9f);
+    shared.add(&shared_hidden);
+    shared.add(&shared_output);
+    shared.set_optimizer(&shared_sgd);
+    shared.set_verbosity(nn::Verbosity::SILENT);
+    shared.train(inputs, targets, 1, 4);
+    nn::save_checkpoint(shared, path);
+    const uint64_t num_weights = shared.parameters()->num_weights();
+    EXPECT_NO_THROW(nn::load_checkpoint(shared, path));
+    reshape_array(5, num_weights, 1);
+    EXPECT_THROW(nn::load_checkpoint(shared, path), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, MappedModelPredictsFromAlignedMapping) {
+    network.train(inputs, targets, 2, 4);
+    nn::save_checkpoint(network, path);
+
+    nn::MappedModel<float> model(path);
+    EXPECT_EQ(model.input_size(), 4);
+    EXPECT_EQ(model.output_size(), 3);
+    for (size_t i = 0; i < model.checkpoint().num_layers(); i++) {
+        for (size_t j = 0; j < model.checkpoint().layer(i).num_arrays; j++) {
+            const float* data = model.checkpoint().data(model.checkpoint().array(i, j));
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % nn::checkpoint::kAlignment, 0u);
+        }
+    }
+    // the first layer's weights are used where they are mapped
+    EXPECT_EQ(model.checkpoint().data(model.checkpoint().array(0, 0))[5], hidden.weights().at(1, 1));
+
+    Matrix<float> batch(4, 8);
+    for (size_t j = 0; j < 8; j++) {
+        for (size_t i = 0; i < 4; i++) {
+            batch.at(i, j) = inputs[j].at(i, 0);
+        }
+    }
+    const Matrix<float> expected = network.predict(batch);
+    expect_equal(model.predict(batch), expected);
+
+    // the products read a padded input with its stride
+    Matrix<float> padded = Matrix<float>::padded(4, 8);
+    padded = batch;
+    ASSERT_FALSE(padded.is_contiguous());
+    expect_equal(model.predict(padded), expected);
+    EXPECT_THROW(model.predict(Matrix<float>(3, 1)), std::invalid_argument);
+}
+
+TEST_F(CheckpointTest, MappedModelTakesItsOwnResult) {
+    // one layer: the result lives in the buffer the first layer writes
+    nn::Network<float> square;
+    nn::Layer<float, nn::activations::Tanh> layer(4, 4);
+    square.add(&layer);
+    nn::save_checkpoint(square, path);
+
+    nn::MappedModel<float> model(path);
+    const Matrix<float> input(4, 1, {0.1f, -0.2f, 0.3f, 0.9f});
+    const Matrix<float> once(model.predict(input).view());
+    const Matrix<float> expected(model.predict(once).view());
+    expect_equal(model.predict(model.predict(input)), expected);
+}
+
+TEST_F(CheckpointTest, RejectsMismatchedNetworksAndCorruptFiles) {
+    nn::save_checkpoint(network, path);
+
+    // other activation
+    nn::Network<float> other_activation;
+    nn::Layer<float, nn::activations::ReLU> relu(4, 6);
+    nn::Layer<float, nn::activations::Sigmoid> sigmoid(6, 3);
+    other_activation.add(&relu);
+    other_activation.add(&sigmoid);
+    EXPECT_THROW(nn::load_checkpoint(other_activation, path), std::runtime_error);
+
+    // other sizes
+    nn::Network<float> other_sizes;
+    nn::Layer<float, nn::activations::Tanh> wide(4, 7);
+    nn::Layer<float, nn::activations::Sigmoid> narrow(7, 3);
+    other_sizes.add(&wide);
+    other_sizes.add(&narrow);
+    EXPECT_THROW(nn::load_checkpoint(other_sizes, path), std::runtime_error);
+
+    // other scalar type
+    EXPECT_THROW(nn::MappedModel<double> model(path), std::runtime_error);
+
+    // truncated and corrupted files
+    std::vector<char> bytes(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    auto rewrite = [&](const std::vector<char>& content) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    };
+
+    rewrite(std::vector<char>(bytes.begin(), bytes.end() - 4));
+    EXPECT_THROW(nn::MappedModel<float> model(path), std::runtime_error);
+
+    std::vector<char> bad_magic = bytes;
+    bad_magic[0] = 'X';
+    rewrite(bad_magic);
+    EXPECT_THROW(nn::MappedModel<float> model(path), std::runtime_error);
+
+    std::vector<char> bad_offset = bytes;
+    const size_t first_array = sizeof(nn::checkpoint::Header) + 2 * sizeof(nn::checkpoint::LayerRecord);
+    bad_offset[first_array] = 1;  // no longer aligned
+    rewrite(bad_offset);
+    EXPECT_THROW(nn::MappedModel<float> model(path), std::runtime_error);
+
+    rewrite(bytes);
+    EXPECT_NO_THROW(nn::MappedModel<float> model(path));
+}
@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#include "nn/batch_loader.hpp"
+#include "nn/data_parallel.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/loss.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+#include "nn/half.hpp"
+
+class DataParallelTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        nn::set_num_threads(4);
+        // 23 samples of 5 features, 3 classes
+        std::mt19937 gen(9);
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        for (size_t i = 0; i < 23; i++) {
+            for (size_t f = 0; f < 5; f++) {
+                data.sample(i)[f] = dist(gen);
+            }
+            data.set_label(i, static_cast<uint32_t>(i % 3));
+        }
+    }
+    void TearDown() override { nn::set_num_threads(1); }
+
+    // Two networks with the same weights: 5-7-3, Tanh then Sigmoid
+    struct Pair {
+        nn::Layer<double, nn::activations::Tanh> hidden{5, 7};
+        nn::Layer<double, nn::activations::Sigmoid> output{7, 3};
+        nn::Layer<double, nn::activations::Tanh> hidden_copy{5, 7};
+        nn::Layer<double, nn::activations::Sigmoid> output_copy{7, 3};
+        nn::Adam<double> optimizer{0.01};
+        nn::Adam<double> optimizer_copy{0.01};
+        nn::Network<double> serial;
+        nn::Network<double> parallel;
+
+        Pair() {
+            hidden_copy.set_weights(hidden.weights());
+            output_copy.set_weights(output.weights());
+            serial.add(&hidden);
+            serial.add(&output);
+            parallel.add(&hidden_copy);
+            parallel.add(&output_copy);
+            serial.set_optimizer(&optimizer);
+            parallel.set_optimizer(&optimizer_copy);
+            serial.set_verbosity(nn::Verbosity::SILENT);
+            parallel.set_verbosity(nn::Verbosity::SILENT);
+        }
+
+        void expect_same_parameters() {
+            for (size_t i = 0; i < 7; i++) {
+                for (size_t j = 0; j < 5; j++) {
+                    EXPECT_NEAR(hidden_copy.weights().at(i, j), hidden.weights().at(i, j), 1e-12);
+                }
+            }
+            for (size_t i = 0; i < 3; i++) {
+                EXPECT_NEAR(output_copy.bias().at(i, 0), output.bias().at(i, 0), 1e-12);
+            }
+        }
+    };
+
+    nn::Dataset<double> data = nn::Dataset<double>(23, 5, 3);
+};
+
+TEST_F(DataParallelTest, MatchesSerialTraining) {
+    Pair pair;
+    pair.parallel.set_replicas(3);
+    EXPECT_EQ(pair.parallel.replicas(), 3u);
+    EXPECT_EQ(pair.serial.replicas(), 1u);
+
+    // batches of 10 and a last one of 3: uneven shards, and as many shards as samples
+    pair.serial.train(data, 4, 10);
+    pair.parallel.train(data, 4, 10);
+    pair.expect_same_parameters();
+    EXPECT_NEAR(pair.parallel.last_loss(), pair.serial.last_loss(), 1e-12);
+
+    // the network output of a step is put back together from the shards
+    Matrix<double> inputs(0, 0), targets(0, 0);
+    data.gather(size_t{0}, size_t{8}, inputs, targets);
+    const Matrix<double> expected = pair.serial.train_step(inputs, targets);
+    const Matrix<double>& output = pair.parallel.train_step(inputs, targets);
+    ASSERT_EQ(output.columns(), 8u);
+    for (size_t c = 0; c < 3; c++) {
+        for (size_t j = 0; j < 8; j++) {
+            EXPECT_NEAR(output.at(c, j), expected.at(c, j), 1e-12);
+        }
+    }
+}
+
+TEST_F(DataParallelTest, ShardsPaddedBatches) {
+    Pair pair;
+    pair.parallel.set_replicas(3);
+
+    // 7 columns of doubles: the padded rows hold 8
+    Matrix<double> inputs(0, 0), targets(0, 0);
+    data.gather(size_t{0}, size_t{7}, inputs, targets);
+    Matrix<double> padded_inputs = Matrix<double>::padded(5, 7);
+    Matrix<double> padded_targets = Matrix<double>::padded(3, 7);
+    padded_inputs = inputs;
+    padded_targets = targets;
+    ASSERT_FALSE(padded_inputs.is_contiguous());
+
+    const Matrix<double> expected = pair.serial.train_step(inputs, targets);
+    const Matrix<double>& output = pair.parallel.train_step(padded_inputs, padded_targets);
+    for (size_t c = 0; c < 3; c++) {
+        for (size_t j = 0; j < 7; j++) {
+            EXPECT_NEAR(output.at(c, j), expected.at(c, j), 1e-12);
+        }
+    }
+    pair.expect_same_parameters();
+}
+
+TEST_F(DataParallelTest, LabelsAndCrossEntropy) {
+    Pair pair;
+    nn::SoftmaxCrossEntropy<double> loss, loss_copy;
+    pair.serial.set_loss(&loss);
+    pair.parallel.set_loss(&loss_copy);
+    pair.parallel.set_replicas(4);
+
+    // batch 2: fewer samples than replicas
+    pair.serial.train(data, 2, 2);
+    pair.parallel.train(data, 2, 2);
+    pair.expect_same_parameters();
+
+    Matrix<double> inputs(0, 0);
+    std::vector<uint32_t> labels;
+    data.gather(size_t{0}, size_t{6}, inputs, labels);
+    labels[4] = 3;
+    EXPECT_THROW(pair.parallel.train_step(inputs, labels), std::out_of_range);
+}
+
+TEST_F(DataParallelTest, MixedPrecisionReplicasFollowTheWeights) {
+    nn::Layer<float, nn::activations::ReLU, nn::bfloat16> hidden(5, 7), hidden_copy(5, 7);
+    nn::Layer<float, nn::activations::Sigmoid> output(7, 3), output_copy(7, 3);
+    hidden_copy.set_weights(hidden.weights());
+    output_copy.set_weights(output.weights());
+    nn::SGD<float> optimizer(0.5f), optimizer_copy(0.5f);
+    nn::Network<float> serial, parallel;
+    serial.add(&hidden);
+    serial.add(&output);
+    parallel.add(&hidden_copy);
+    parallel.add(&output_copy);
+    serial.set_optimizer(&optimizer);
+    parallel.set_optimizer(&optimizer_copy);
+    parallel.set_replicas(2);
+
+    Matrix<float> inputs(5, 12), targets(3, 12);
+    for (size_t j = 0; j < 12; j++) {
+        for (size_t f = 0; f < 5; f++) {
+            inputs.at(f, j) = static_cast<float>(data.sample(j)[f]);
+        }
+        targets.at(j % 3, j) = 1.0f;
+    }
+    for (int step = 0; step < 5; step++) {
+        serial.train_step(inputs, targets);
+        parallel.train_step(inputs, targets);
+    }
+    for (size_t i = 0; i < 7; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            EXPECT_NEAR(hidden_copy.weights().at(i, j), hidden.weights().at(i, j), 1e-5);
+        }
+    }
+}
+
+TEST_F(DataParallelTest, NeedsTheNetworkOptimizer) {
+    nn::Layer<double, nn::activations::Tanh> layer(5, 3);
+    nn::Network<double> network;
+    network.add(&layer);
+    EXPECT_THROW(network.set_replicas(2), std::invalid_argument);
+    EXPECT_NO_THROW(network.set_replicas(1));
+
+    nn::SGD<double> optimizer(0.1);
+    network.set_optimizer(&optimizer);
+    network.set_replicas(2);
+    EXPECT_EQ(network.replicas(), 2u);
+    network.set_replicas(0);
+    EXPECT_EQ(network.replicas(), 1u);
+
+    // a replica is an independent copy of the layer
+    std::unique_ptr<nn::LayerBase<double>> copy = layer.clone();
+    EXPECT_NE(copy->weights().data(), layer.weights().data());
+    EXPECT_EQ(copy->weights().at(2, 4), layer.weights().at(2, 4));
+    EXPECT_EQ(copy->optimizer(), nullptr);
+}
+
+TEST_F(DataParallelTest, HogwildLearnsWithoutLocks) {
+    // 3 well separated clusters, trained sample by sample
+    std::mt19937 gen(4);
+    std::normal_distribution<double> noise(0.0, 0.2);
+    nn::Dataset<double> clusters(120, 5, 3);
+    for (size_t i = 0; i < 120; i++) {
+        for (size_t f = 0; f < 5; f++) {
+            clusters.sample(i)[f] = (f == i % 3 ? 2.0 : 0.0) + noise(gen);
+        }
+        clusters.set_label(i, static_cast<uint32_t>(i % 3));
+    }
+
+    Pair pair;
+    nn::SGD<double> sgd(0.05, 0.5);
+    pair.parallel.set_optimizer(&sgd);
+    pair.parallel.set_replicas(3, nn::Synchronization::HOGWILD);
+    EXPECT_TRUE(pair.parallel.hogwild());
+    EXPECT_FALSE(pair.serial.hogwild());
+
+    pair.parallel.train(clusters, 1, 1);
+    const double first_epoch = pair.parallel.last_loss();
+    pair.parallel.train(clusters, 10, 1);
+    EXPECT_LT(pair.parallel.last_loss(), first_epoch / 2);
+
+    Matrix<double> inputs(0, 0);
+    std::vector<uint32_t> labels;
+    clusters.gather(size_t{0}, size_t{120}, inputs, labels);
+    EXPECT_GE(pair.parallel.count_correct_predictions(pair.parallel.predict(inputs), labels), 114u);
+
+    // batches of a loader are taken in turn: two epochs leave it at the start of the third
+    nn::BatchLoader<double> loader(clusters, 7, true, 3);
+    pair.parallel.train(loader, 2);
+    EXPECT_EQ(loader.next().epoch, 2u);
+}
+
+TEST_F(DataParallelTest, HogwildNeedsSgd) {
+    Pair pair;
+    EXPECT_THROW(pair.parallel.set_replicas(2, nn::Synchronization::HOGWILD), std::invalid_argument);
+
+    nn::SGD<double> sgd(0.1);
+    pair.parallel.set_optimizer(&sgd);
+    pair.parallel.set_replicas(2, nn::Synchronization::HOGWILD);
+    pair.parallel.set_optimizer(&pair.optimizer_copy);
+    EXPECT_THROW(pair.parallel.train(data, 1, 4), std::invalid_argument);
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "nn/dataset.hpp"
+
+class DatasetTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // 40 samples of 3 features, feature f of sample i is 10 * i + f, class i % 4
+        for (size_t i = 0; i < 40; i++) {
+            for (size_t f = 0; f < 3; f++) {
+                data.sample(i)[f] = static_cast<float>(10 * i + f);
+            }
+            data.set_label(i, static_cast<uint32_t>(i % 4));
+        }
+    }
+    void TearDown() override {}
+
+    nn::Dataset<float> data = nn::Dataset<float>(40, 3, 4);
+};
+
+TEST_F(DatasetTest, StoresSamplesContiguously) {
+    EXPECT_EQ(data.size(), 40);
+    EXPECT_EQ(data.num_features(), 3);
+    EXPECT_EQ(data.num_targets(), 4);
+    EXPECT_EQ(data.kind(), nn::Targets::CLASS_INDICES);
+
+    EXPECT_EQ(data.sample(0), data.features());
+    EXPECT_EQ(data.sample(7), data.features() + 21);
+    EXPECT_EQ(data.features()[7 * 3 + 2], 72.0f);
+    EXPECT_EQ(data.label(6), 2u);
+
+    EXPECT_THROW(data.sample(40), std::out_of_range);
+    EXPECT_THROW(data.set_label(0, 4), std::out_of_range);
+    EXPECT_THROW(data.target(0), std::logic_error);
+}
+
+TEST_F(DatasetTest, GathersConsecutiveBatch) {
+    Matrix<float> inputs(0, 0);
+    Matrix<float> targets(0, 0);
+    // 19 samples: more than one gather block, and not a multiple of it
+    data.gather(5, 19, inputs, targets);
+
+    ASSERT_EQ(inputs.rows(), 3);
+    ASSERT_EQ(inputs.columns(), 19);
+    ASSERT_EQ(targets.rows(), 4);
+    ASSERT_EQ(targets.columns(), 19);
+    for (size_t j = 0; j < 19; j++) {
+        for (size_t f = 0; f < 3; f++) {
+            EXPECT_EQ(inputs.at(f, j), static_cast<float>(10 * (5 + j) + f));
+        }
+        for (size_t c = 0; c < 4; c++) {
+            EXPECT_EQ(targets.at(c, j), c == (5 + j) % 4 ? 1.0f : 0.0f);
+        }
+    }
+
+    EXPECT_THROW(data.gather(30, 11, inputs, targets), std::out_of_range);
+
+    // the same batch with class indices instead of one-hot columns
+    std::vector<uint32_t> labels;
+    Matrix<float> same_inputs(0, 0);
+    data.gather(5, 19, same_inputs, labels);
+    ASSERT_EQ(labels.size(), 19u);
+    for (size_t j = 0; j < 19; j++) {
+        EXPECT_EQ(labels[j], (5 + j) % 4);
+        EXPECT_EQ(same_inputs.at(2, j), inputs.at(2, j));
+    }
+}
+
+TEST_F(DatasetTest, GathersIndexedBatch) {
+    const std::vector<size_t> order = {39, 0, 17, 17, 2};
+    Matrix<float> inputs(0, 0);
+    Matrix<float> targets(0, 0);
+    data.gather(order.data(), order.size(), inputs, targets);
+
+    ASSERT_EQ(inputs.columns(), order.size());
+    for (size_t j = 0; j < order.size(); j++) {
+        for (size_t f = 0; f < 3; f++) {
+            EXPECT_EQ(inputs.at(f, j), static_cast<float>(10 * order[j] + f));
+        }
+        EXPECT_EQ(targets.at(order[j] % 4, j), 1.0f);
+    }
+
+    const std::vector<size_t> bad = {1, 40};
+    EXPECT_THROW(data.gather(bad.data(), bad.size(), inputs, targets), std::out_of_range);
+}
+
+TEST_F(DatasetTest, DenseTargetsFromSampleVectors) {
+    std::vector<Matrix<float>> inputs = {Matrix<float>(2, 1, {1, 2}), Matrix<float>(2, 1, {3, 4})};
+    std::vector<Matrix<float>> targets = {Matrix<float>(1, 1, {0.5f}), Matrix<float>(1, 1, {-0.5f})};
+    nn::Dataset<float> dense(inputs, targets);
+
+    EXPECT_EQ(dense.kind(), nn::Targets::DENSE);
+    EXPECT_EQ(dense.size(), 2);
+    EXPECT_EQ(dense.target(1)[0], -0.5f);
+    EXPECT_THROW(dense.label(0), std::logic_error);
+
+    Matrix<float> batch_inputs(0, 0);
+    Matrix<float> batch_targets(0, 0);
+    dense.gather(size_t{0}, 2, batch_inputs, batch_targets);
+    EXPECT_EQ(batch_inputs.at(0, 1), 3.0f);
+    EXPECT_EQ(batch_inputs.at(1, 0), 2.0f);
+    EXPECT_EQ(batch_targets.at(0, 0), 0.5f);
+    std::vector<uint32_t> labels;
+    EXPECT_THROW(dense.gather(size_t{0}, 2, batch_inputs, labels), std::logic_error);
+
+    // padded sample columns are read with their stride
+    std::vector<Matrix<float>> padded_inputs = {Matrix<float>::padded(2, 1), Matrix<float>::padded(2, 1)};
+    padded_inputs[0] = inputs[0];
+    padded_inputs[1] = inputs[1];
+    const nn::Dataset<float> from_padded(padded_inputs, targets);
+    EXPECT_EQ(from_padded.sample(1)[0], 3.0f);
+    EXPECT_EQ(from_padded.sample(1)[1], 4.0f);
+
+    std::vector<Matrix<float>> mismatched = {Matrix<float>(3, 1)};
+    EXPECT_THROW(nn::Dataset<float>(mismatched, targets), std::invalid_argument);
+}
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include "nn/half.hpp"
+#include "nn/gemm.hpp"
+#include "nn/layer.hpp"
+#include "nn/network.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+
+class HalfTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override { nn::simd::set_isa(nn::simd::detect_isa()); }
+
+    static uint32_t bits(float x) {
+        uint32_t b;
+        std::memcpy(&b, &x, sizeof(b));
+        return b;
+    }
+
+    // Floats hitting every rounding case: ties, overflow, subnormals, specials, plus random values
+    static std::vector<float> conversion_inputs() {
+        std::vector<float> x = {0.0f, -0.0f, 1.0f, -1.0f, 1.00390625f, 1.01171875f, 65504.0f, 65519.0f,
+            65520.0f, -70000.0f, 6.1035156e-05f, 6.0e-05f, 5.9604645e-08f, 2.9802322e-08f, 4.0e-08f, 1.0e-10f,
+            3.3895314e+38f, std::numeric_limits<float>::max(), std::numeric_limits<float>::infinity(),
+            -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+            std::numeric_limits<float>::denorm_min()};
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<uint32_t> any_bits;
+        std::uniform_real_distribution<float> moderate(-4.0f, 4.0f);
+        while (x.size() < 1001) {
+            uint32_t b = any_bits(gen);
+            float f;
+            std::memcpy(&f, &b, sizeof(f));
+            x.push_back(f);
+            x.push_back(moderate(gen));
+        }
+        return x;
+    }
+
+    static Matrix<float> random_matrix(size_t rows, size_t columns, unsigned seed) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        Matrix<float> m(rows, columns);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < columns; j++) {
+                m.at(i, j) = dist(gen);
+            }
+        }
+        return m;
+    }
+};
+
+TEST_F(HalfTest, ScalarConversionRoundsToNearestEven) {
+    EXPECT_EQ(nn::bfloat16(1.0f).bits, 0x3f80);
+    EXPECT_EQ(nn::bfloat16(1.00390625f).bits, 0x3f80);  // halfway, stays even
+    EXPECT_EQ(nn::bfloat16(1.01171875f).bits, 0x3f82);  // halfway, rounds up to even
+    EXPECT_EQ(nn::bfloat16(-0.0f).bits, 0x8000);
+    EXPECT_EQ(nn::bfloat16(std::numeric_limits<float>::infinity()).bits, 0x7f80);
+    EXPECT_EQ(nn::bfloat16(std::numeric_limits<float>::max()).bits, 0x7f80);
+    EXPECT_TRUE(std::isnan(static_cast<float>(nn::bfloat16(std::numeric_limits<float>::quiet_NaN()))));
+    EXPECT_EQ(static_cast<float>(nn::bfloat16::from_bits(0x4049)), 3.140625f);
+
+    EXPECT_EQ(nn::float16(1.0f).bits, 0x3c00);
+    EXPECT_EQ(nn::float16(65504.0f).bits, 0x7bff);
+    EXPECT_EQ(nn::float16(65519.0f).bits, 0x7bff);
+    EXPECT_EQ(nn::float16(65520.0f).bits, 0x7c00);      // halfway to the next binade: infinity
+    EXPECT_EQ(nn::float16(5.9604645e-08f).bits, 0x0001);  // smallest subnormal
+    EXPECT_EQ(nn::float16(2.9802322e-08f).bits, 0x0000);  // half of it, ties to even
+    EXPECT_EQ(nn::float16(-6.1035156e-05f).bits, 0x8400);
+    EXPECT_TRUE(std::isnan(static_cast<float>(nn::float16(std::numeric_limits<float>::quiet_NaN()))));
+    EXPECT_EQ(static_cast<float>(nn::float16::from_bits(0x0001)), 5.9604645e-08f);
+    EXPECT_EQ(static_cast<float>(nn::float16::from_bits(0xfc00)), -std::numeric_limits<float>::infinity());
+
+    // every finite 16-bit value survives the round trip through float
+    for (uint32_t b = 0; b < 0x10000; b++) {
+        const auto h = nn::float16::from_bits(static_cast<uint16_t>(b));
+        if (!std::isnan(static_cast<float>(h))) {
+            EXPECT_EQ(nn::float16(static_cast<float>(h)).bits, b);
+        }
+        const auto bf = nn::bfloat16::from_bits(static_cast<uint16_t>(b));
+        if (!std::isnan(static_cast<float>(bf))) {
+            EXPECT_EQ(nn::bfloat16(static_cast<float>(bf)).bits, b);
+        }
+    }
+}
+
+TEST_F(HalfTest, ArrayConversionMatchesScalarOnEveryIsa) {
+    std::vector<nn::bfloat16> all_bf16(0x10000);
+    std::vector<nn::float16> all_fp16(0x10000);
+    for (uint32_t b = 0; b < 0x10000; b++) {
+        all_bf16[b] = nn::bfloat16::from_bits(static_cast<uint16_t>(b));
+        all_fp16[b] = nn::float16::from_bits(static_cast<uint16_t>(b));
+    }
+    const std::vector<float> x = conversion_inputs();
+
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        const char* name = nn::simd::isa_name(nn::simd::active_isa());
+
+        std::vector<float> wide(0x10000);
+        nn::kernels::to_float(all_bf16.data(), wide.data(), wide.size());
+        for (uint32_t b = 0; b < 0x10000; b++) {
+            ASSERT_EQ(bits(wide[b]), bits(static_cast<float>(all_bf16[b]))) << name << " bf16 " << b;
+        }
+        nn::kernels::to_float(all_fp16.data(), wide.data(), wide.size());
+        for (uint32_t b = 0; b < 0x10000; b++) {
+            ASSERT_EQ(bits(wide[b]), bits(static_cast<float>(all_fp16[b]))) << name << " fp16 " << b;
+        }
+
+        std::vector<nn::bfloat16> narrow_bf16(x.size());
+        std::vector<nn::float16> narrow_fp16(x.size());
+        nn::kernels::from_float(x.data(), narrow_bf16.data(), x.size());
+        nn::kernels::from_float(x.data(), narrow_fp16.data(), x.size());
+        for (size_t i = 0; i < x.size(); i++) {
+            ASSERT_EQ(narrow_bf16[i].bits, nn::bfloat16(x[i]).bits) << name << " " << x[i];
+            ASSERT_EQ(narrow_fp16[i].bits, nn::float16(x[i]).bits) << name << " " << x[i];
+        }
+    }
+}
+
+TEST_F(HalfTest, GemmWidensNarrowOperands) {
+    using nn::kernels::Transpose;
+    // matrix-vector (both orientations, more rows than one widening chunk), tiny and blocked products
+    const size_t shapes[][3] = {{300, 1, 70}, {70, 1, 300}, {5, 3, 4}, {67, 45, 131}};
+
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        for (const auto& shape : shapes) {
+            const size_t M = shape[0], N = shape[1], K = shape[2];
+            for (bool ta : {false, true}) {
+                for (bool tb : {false, true}) {
+                    // op(A) is M x K, op(B) is K x N, stored transposed when asked to
+                    Matrix<float> a = random_matrix(ta ? K : M, ta ? M : K, 1);
+                    Matrix<float> b = random_matrix(tb ? N : K, tb ? K : N, 2);
+                    std::vector<nn::bfloat16> a16(a.rows() * a.columns());
+                    std::vector<nn::float16> b16(b.rows() * b.columns());
+                    nn::kernels::from_float(a.data(), a16.data(), a16.size());
+                    nn::kernels::from_float(b.data(), b16.data(), b16.size());
+                    // the float reference multiplies the same (rounded) values
+                    nn::kernels::to_float(a16.data(), a.data(), a16.size());
+                    nn::kernels::to_float(b16.data(), b.data(), b16.size());
+
+                    const Transpose trans_a = ta ? Transpose::YES : Transpose::NO;
+                    const Transpose trans_b = tb ? Transpose::YES : Transpose::NO;
+                    std::vector<float> expected(M * N, 0.5f), mixed(M * N, 0.5f), narrow_a(M * N, 0.5f);
+                    nn::kernels::gemm(trans_a, trans_b, M, N, K, 0.5f, a.data(), a.columns(),
+                        b.data(), b.columns(), 2.0f, expected.data(), N);
+                    nn::kernels::gemm(trans_a, trans_b, M, N, K, 0.5f, a16.data(), a.columns(),
+                        b16.data(), b.columns(), 2.0f, mixed.data(), N);
+                    nn::kernels::gemm(trans_a, trans_b, M, N, K, 0.5f, a16.data(), a.columns(),
+                        b.data(), b.columns(), 2.0f, narrow_a.data(), N);
+                    for (size_t i = 0; i < M * N; i++) {
+                        ASSERT_NEAR(mixed[i], expected[i], 1e-4f) << M << "x" << N << "x" << K << " " << ta << tb;
+                        ASSERT_NEAR(narrow_a[i], expected[i], 1e-4f) << M << "x" << N << "x" << K << " " << ta << tb;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_F(HalfTest, MixedPrecisionLayerKeepsFloatMasterWeights) {
+    nn::Layer<float, nn::activations::Sigmoid> reference(40, 6);
+    nn::Layer<float, nn::activations::Sigmoid, nn::bfloat16> layer(40, 6);
+    layer.set_weights(reference.weights());
+    layer.set_bias(reference.bias());
+
+    Matrix<float> input = random_matrix(40, 8, 4);
+    const Matrix<float>& expected = reference.forward(input);
+    const Matrix<float>& output = layer.forward(input);
+    Matrix<float> inferred(0, 0);
+    layer.infer(input, inferred);
+    for (size_t i = 0; i < 6; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            EXPECT_NEAR(output.at(i, j), expected.at(i, j), 0.02f);
+            EXPECT_FLOAT_EQ(inferred.at(i, j), output.at(i, j));
+        }
+    }
+
+    // steps far below the bfloat16 resolution still accumulate in the master copy
+    nn::SGD<float> optimizer(1e-4f);
+    layer.set_optimizer(&optimizer);
+    const Matrix<float> before = layer.weights();
+    Matrix<float> gradient = random_matrix(6, 8, 5);
+    for (int step = 0; step < 3; step++) {
+        layer.forward(input);
+        layer.backward(gradient);
+    }
+    size_t changed = 0;
+    for (size_t i = 0; i < 6; i++) {
+        for (size_t k = 0; k < 40; k++) {
+            changed += layer.weights().at(i, k) != before.at(i, k);
+        }
+    }
+    EXPECT_GT(changed, 200u);
+}
+
+TEST_F(HalfTest, MixedPrecisionNetworkLearns) {
+    // 3 gaussian blobs in 16 dimensions
+    const size_t classes = 3, features = 16, samples = 600;
+    std::mt19937 gen(11);
+    std::normal_distribution<float> noise(0.0f, 0.4f);
+    Matrix<float> centers = random_matrix(classes, features, 12);
+    std::vector<Matrix<float>> inputs, targets;
+    for (size_t s = 0; s < samples; s++) {
+        const size_t c = s % classes;
+        Matrix<float> x(features, 1), t(classes, 1);
+        for (size_t f = 0; f < features; f++) {
+            x.at(f, 0) = centers.at(c, f) + noise(gen);
+        }
+        t.at(c, 0) = 1.0f;
+        inputs.push_back(x);
+        targets.push_back(t);
+    }
+
+    nn::Layer<float, nn::activations::ReLU, nn::float16> hidden(features, 32, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::Sigmoid, nn::bfloat16> output(32, classes);
+    nn::SGD<float> optimizer1(0.1f, 0.9f), optimizer2(0.1f, 0.9f);
+    hidden.set_optimizer(&optimizer1);
+    output.set_optimizer(&optimizer2);
+    nn::Network<float> network;
+    network.set_verbosity(nn::Verbosity::SILENT);
+    network.add(&hidden);
+    network.add(&output);
+
+    network.train(inputs, targets, 10, 16);
+
+    size_t correct = 0;
+    for (size_t s = 0; s < samples; s++) {
+        correct += network.is_prediction_correct(network.predict(inputs[s]), targets[s]);
+    }
+    EXPECT_GE(correct, samples * 95 / 100);
+}
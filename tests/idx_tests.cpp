@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "nn/idx.hpp"
+
+class IdxTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() / "nn_idx_test.idx").string();
+    }
+    void TearDown() override { std::filesystem::remove(path); }
+
+    void write(const std::vector<uint8_t>& bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    // IDX image file with count samples of rows x cols bytes, pixel k of the file is k % 251
+    std::vector<uint8_t> images(uint32_t count, uint8_t rows, uint8_t cols) {
+        std::vector<uint8_t> bytes = {0, 0, 8, 3, 0, 0, static_cast<uint8_t>(count >> 8), static_cast<uint8_t>(count),
+            0, 0, 0, rows, 0, 0, 0, cols};
+        for (size_t k = 0; k < size_t(count) * rows * cols; k++) {
+            bytes.push_back(static_cast<uint8_t>(k % 251));
+        }
+        return bytes;
+    }
+
+    std::string path;
+};
+
+TEST_F(IdxTest, ParsesHeaderAndExposesSamples) {
+    write(images(300, 5, 7));
+    nn::IdxFile file(path);
+
+    EXPECT_EQ(file.magic(), 0x803u);
+    ASSERT_EQ(file.dims().size(), 3);
+    EXPECT_EQ(file.dims()[1], 5);
+    EXPECT_EQ(file.dims()[2], 7);
+    EXPECT_EQ(file.count(), 300);
+    EXPECT_EQ(file.sample_size(), 35);
+
+    // samples are views into one contiguous buffer
+    EXPECT_EQ(file.sample(0), file.data());
+    EXPECT_EQ(file.sample(10), file.data() + 10 * 35);
+    EXPECT_EQ(file.sample(10)[3], (10 * 35 + 3) % 251);
+    EXPECT_THROW(file.sample(300), std::out_of_range);
+}
+
+TEST_F(IdxTest, ConvertsToFloatOnEveryIsa) {
+    write(images(300, 5, 7));
+    nn::IdxFile file(path);
+    const nn::simd::Isa detected = nn::simd::detect_isa();
+
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        // 3 samples: 105 values, not a multiple of any vector width
+        std::vector<float> out(3 * 35, -1.0f);
+        file.to_float(17, 3, out.data());
+        for (size_t k = 0; k < out.size(); k++) {
+            EXPECT_EQ(out[k], static_cast<float>((17 * 35 + k) % 251) * (1.0f / 255.0f));
+        }
+
+        std::vector<float> all(file.count() * file.sample_size());
+        file.to_float(0, file.count(), all.data(), 1.0f);
+        for (size_t k = 0; k < all.size(); k++) {
+            ASSERT_EQ(all[k], static_cast<float>(k % 251));
+        }
+    }
+    nn::simd::set_isa(detected);
+
+    std::vector<float> out(35);
+    EXPECT_THROW(file.to_float(299, 2, out.data()), std::out_of_range);
+}
+
+TEST_F(IdxTest, RejectsInvalidFiles) {
+    EXPECT_THROW(nn::IdxFile(path + ".missing"), std::runtime_error);
+
+    // bad leading bytes
+    write({1, 0, 8, 1, 0, 0, 0, 1, 5});
+    EXPECT_THROW(nn::IdxFile file(path), std::runtime_error);
+
+    // unsupported element type (0x0D = float)
+    write({0, 0, 0x0D, 1, 0, 0, 0, 1, 0, 0, 0, 0});
+    EXPECT_THROW(nn::IdxFile file(path), std::runtime_error);
+
+    // truncated header and truncated data
+    write({0, 0, 8, 3, 0, 0, 0, 1});
+    EXPECT_THROW(nn::IdxFile file(path), std::runtime_error);
+    std::vector<uint8_t> truncated = images(4, 2, 2);
+    truncated.pop_back();
+    write(truncated);
+    EXPECT_THROW(nn::IdxFile file(path), std::runtime_error);
+
+    // four dimensions of 65536 multiply to 2^64, which wraps to no elements at all
+    write({0, 0, 8, 4, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0});
+    EXPECT_THROW(nn::IdxFile file(path), std::runtime_error);
+
+    // labels: one dimension
+    write({0, 0, 8, 1, 0, 0, 0, 3, 7, 1, 9});
+    nn::IdxFile labels(path);
+    EXPECT_EQ(labels.magic(), 0x801u);
+    EXPECT_EQ(labels.count(), 3);
+    EXPECT_EQ(labels.sample_size(), 1);
+    EXPECT_EQ(labels.sample(2)[0], 9);
+}
@@ -16,6 +16,16 @@ TEST_F(LayerTest, ConstructorTest) {
     EXPECT_EQ(layer.bias().columns(), 1);
 }
 
+TEST_F(LayerTest, SetParametersRejectsOtherShapes) {
+    nn::Layer<float, nn::activations::ReLU> layer(5, 3);
+    EXPECT_THROW(layer.set_weights(Matrix<float>(5, 3)), std::invalid_argument);
+    EXPECT_THROW(layer.set_weights(Matrix<float>(3, 4)), std::invalid_argument);
+    EXPECT_THROW(layer.set_bias(Matrix<float>(3, 2)), std::invalid_argument);
+    EXPECT_THROW(layer.set_bias(Matrix<float>(1, 3)), std::invalid_argument);
+    EXPECT_NO_THROW(layer.set_weights(Matrix<float>(3, 5)));
+    EXPECT_NO_THROW(layer.set_bias(Matrix<float>(3, 1)));
+}
+
 TEST_F(LayerTest, ForwardPass) {
     // Create a 2 input, 2 output, ReLU layer
     nn::Layer<float, nn::activations::ReLU> layer(2, 2);
@@ -144,3 +154,198 @@ TEST_F(LayerTest, OptimizerIntegrationTest) {
     
     delete optimizer;
 }
+
+TEST_F(LayerTest, BatchForwardPass) {
+    nn::Layer<float, nn::activations::ReLU> layer(2, 2);
+
+    std::vector<float> w_values = {0.5f, 0.8f, 0.1f, 0.2f};
+    std::vector<float> b_values = {0.1f, 0.2f};
+    layer.set_weights(Matrix<float>(2, 2, w_values));
+    layer.set_bias(Matrix<float>(2, 1, b_values));
+
+    // Two samples, one per column: [0.5, 1.0] and [-2.0, 0.0]
+    std::vector<float> input_values = {0.5f, -2.0f,
+                                       1.0f,  0.0f};
+    Matrix<float> input(2, 2, input_values);
+
+    Matrix<float> output = layer.forward(input);
+
+    ASSERT_EQ(output.rows(), 2);
+    ASSERT_EQ(output.columns(), 2);
+
+    // First column as in ForwardPass, bias broadcast to the second one:
+    // ReLU(0.5x-2.0 + 0.8x0.0 + 0.1) = ReLU(-0.9) = 0
+    // ReLU(0.1x-2.0 + 0.2x0.0 + 0.2) = ReLU(0.0) = 0
+    EXPECT_NEAR(output.at(0, 0), 1.15f, 0.001f);
+    EXPECT_NEAR(output.at(1, 0), 0.45f, 0.001f);
+    EXPECT_NEAR(output.at(0, 1), 0.0f, 0.001f);
+    EXPECT_NEAR(output.at(1, 1), 0.0f, 0.001f);
+}
+
+TEST_F(LayerTest, BatchBackwardAveragesGradients) {
+    nn::Layer<float, nn::activations::ReLU> layer(2, 2);
+
+    std::vector<float> w_values = {0.5f, 0.8f, 0.1f, 0.2f};
+    std::vector<float> b_values = {0.1f, 0.2f};
+    layer.set_weights(Matrix<float>(2, 2, w_values));
+    layer.set_bias(Matrix<float>(2, 1, b_values));
+
+    nn::SGD<float> optimizer(0.1f);
+    layer.set_optimizer(&optimizer);
+
+    // Same sample twice plus its gradient doubled: the averaged step matches a single sample step
+    std::vector<float> input_values = {0.5f, 0.5f,
+                                       1.0f, 1.0f};
+    std::vector<float> grad_values = {1.0f, 1.0f,
+                                      1.0f, 1.0f};
+    Matrix<float> input(2, 2, input_values);
+    Matrix<float> gradient(2, 2, grad_values);
+
+    layer.forward(input);
+    Matrix<float> input_gradient = layer.backward(gradient);
+
+    // Input gradients stay per sample (see BackwardPass)
+    ASSERT_EQ(input_gradient.columns(), 2);
+    EXPECT_NEAR(input_gradient.at(0, 0), 0.6f, 0.001f);
+    EXPECT_NEAR(input_gradient.at(1, 0), 1.0f, 0.001f);
+    EXPECT_NEAR(input_gradient.at(0, 1), 0.6f, 0.001f);
+    EXPECT_NEAR(input_gradient.at(1, 1), 1.0f, 0.001f);
+
+    // One optimizer step with the averaged gradients (see OptimizerIntegrationTest)
+    EXPECT_NEAR(layer.weights().at(0, 0), 0.45f, 0.001f);
+    EXPECT_NEAR(layer.weights().at(0, 1), 0.7f, 0.001f);
+    EXPECT_NEAR(layer.weights().at(1, 0), 0.05f, 0.001f);
+    EXPECT_NEAR(layer.weights().at(1, 1), 0.1f, 0.001f);
+    EXPECT_NEAR(layer.bias().at(0, 0), 0.0f, 0.001f);
+    EXPECT_NEAR(layer.bias().at(1, 0), 0.1f, 0.001f);
+}
+
+TEST_F(LayerTest, InferMatchesForward) {
+    nn::Layer<float, nn::activations::Sigmoid> layer(3, 2);
+
+    std::vector<float> input_values = {0.5f, -1.0f,
+                                       1.0f, 0.25f,
+                                       -0.3f, 2.0f};
+    Matrix<float> input(3, 2, input_values);
+
+    Matrix<float> expected = layer.forward(input);
+
+    // Output buffer of the wrong size gets resized
+    Matrix<float> output(1, 1);
+    layer.infer(input, output);
+
+    ASSERT_EQ(output.rows(), 2);
+    ASSERT_EQ(output.columns(), 2);
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            EXPECT_FLOAT_EQ(output.at(i, j), expected.at(i, j));
+        }
+    }
+
+    EXPECT_THROW(layer.infer(Matrix<float>(2, 1), output), std::invalid_argument);
+}
+
+TEST_F(LayerTest, PaddedInputsAndGradients) {
+    nn::Layer<float, nn::activations::Tanh> layer(3, 2);
+    Matrix<float> input(3, 5), gradient(2, 5);
+    for (size_t k = 0; k < 15; k++) input.data()[k] = 0.1f * k - 0.7f;
+    for (size_t k = 0; k < 10; k++) gradient.data()[k] = 0.05f * k - 0.2f;
+
+    const Matrix<float> expected = layer.forward(input);
+    const Matrix<float> expected_gradient = layer.backward(gradient);
+
+    // rows padded to 16 floats
+    Matrix<float> padded_input = Matrix<float>::padded(3, 5), padded_gradient = Matrix<float>::padded(2, 5);
+    padded_input = input;
+    padded_gradient = gradient;
+    const Matrix<float> output = layer.forward(padded_input);
+    const Matrix<float> input_gradient = layer.backward(padded_gradient);
+    Matrix<float> inferred = Matrix<float>::padded(2, 5);
+    layer.infer(padded_input, inferred);
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            EXPECT_FLOAT_EQ(output.at(i, j), expected.at(i, j));
+            EXPECT_FLOAT_EQ(inferred.at(i, j), expected.at(i, j));
+        }
+    }
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            EXPECT_FLOAT_EQ(input_gradient.at(i, j), expected_gradient.at(i, j));
+        }
+    }
+}
+
+TEST_F(LayerTest, InferDoesNotChangeBackwardState) {
+    nn::Layer<float, nn::activations::ReLU> layer(2, 2);
+
+    std::vector<float> w_values = {0.5f, 0.8f, 0.1f, 0.2f};
+    std::vector<float> b_values = {0.1f, 0.2f};
+    layer.set_weights(Matrix<float>(2, 2, w_values));
+    layer.set_bias(Matrix<float>(2, 1, b_values));
+
+    std::vector<float> input_values = {0.5f, 1.0f};
+    layer.forward(Matrix<float>(2, 1, input_values));
+
+    // An inference call in between must not replace the cached input of the forward call
+    std::vector<float> other_values = {-5.0f, -5.0f, 3.0f, 3.0f};
+    Matrix<float> output(2, 2);
+    layer.infer(Matrix<float>(2, 2, other_values), output);
+
+    std::vector<float> grad_values = {1.0f, 1.0f};
+    Matrix<float> input_gradient = layer.backward(Matrix<float>(2, 1, grad_values));
+
+    // Same values as in BackwardPass
+    EXPECT_NEAR(input_gradient.at(0, 0), 0.6f, 0.001f);
+    EXPECT_NEAR(input_gradient.at(1, 0), 1.0f, 0.001f);
+}
+
+TEST_F(LayerTest, ForwardAndBackwardOverViews) {
+    nn::Layer<float, nn::activations::ReLU> layer(4, 3);
+    // 4 features x 20 samples, a batch is a column range
+    Matrix<float> samples(4, 20);
+    for (size_t k = 0; k < 80; k++) samples.data()[k] = 0.05f * static_cast<float>(k % 13) - 0.3f;
+    Matrix<float> gradient(3, 6);
+    for (size_t k = 0; k < 18; k++) gradient.data()[k] = 0.1f * static_cast<float>(k % 5) - 0.2f;
+
+    const nn::MatrixView<const float> batch = samples.view().column_range(7, 6);
+    const Matrix<float> copy(batch);
+    const Matrix<float> expected = layer.forward(copy);
+    const Matrix<float> expected_gradient = layer.backward(gradient);
+
+    const Matrix<float> output = layer.forward(batch);
+    const Matrix<float> input_gradient = layer.backward(gradient.view());
+    Matrix<float> inferred(0, 0);
+    layer.infer(batch, inferred);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 6; j++) {
+            EXPECT_FLOAT_EQ(output.at(i, j), expected.at(i, j));
+            EXPECT_FLOAT_EQ(inferred.at(i, j), expected.at(i, j));
+        }
+    }
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 6; j++) {
+            EXPECT_FLOAT_EQ(input_gradient.at(i, j), expected_gradient.at(i, j));
+        }
+    }
+
+    // a view of the wrong shape
+    EXPECT_THROW(layer.forward(samples.view().block(0, 0, 3, 6)), std::invalid_argument);
+}
+
+TEST_F(LayerTest, SharedOptimizerRejectsOtherShapes) {
+    // the optimizer state is sized by the first layer it updates
+    nn::Layer<float, nn::activations::ReLU> first(128, 64);
+    nn::Layer<float, nn::activations::ReLU> second(64, 10);
+    nn::SGD<float> sgd(0.1f, 0.9f);
+    nn::Adam<float> adam(0.01f);
+    nn::RMSProp<float> rmsprop(0.01f);
+
+    for (nn::Optimizer<float>* optimizer : std::initializer_list<nn::Optimizer<float>*>{&sgd, &adam, &rmsprop}) {
+        first.set_optimizer(optimizer);
+        second.set_optimizer(optimizer);
+        first.forward(Matrix<float>(128, 2, std::vector<float>(256, 0.5f)));
+        EXPECT_NO_THROW(first.backward(Matrix<float>(64, 2, std::vector<float>(128, 0.1f))));
+        second.forward(Matrix<float>(64, 2, std::vector<float>(128, 0.5f)));
+        EXPECT_THROW(second.backward(Matrix<float>(10, 2, std::vector<float>(20, 0.1f))), std::invalid_argument);
+    }
+}
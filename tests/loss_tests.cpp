@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "nn/loss.hpp"
+#include "nn/loss_kernels.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+#include "nn/simd.hpp"
+
+class LossTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // 10 classes, 37 samples: not a multiple of any vector width
+        std::mt19937 gen(5);
+        std::uniform_real_distribution<float> dist(-4.0f, 4.0f);
+        logits = Matrix<float>(10, 37);
+        for (size_t k = 0; k < 10 * 37; k++) {
+            logits.data()[k] = dist(gen);
+        }
+        for (size_t j = 0; j < 37; j++) {
+            labels.push_back(static_cast<uint32_t>((3 * j) % 10));
+        }
+        one_hot = Matrix<float>(10, 37);
+        for (size_t j = 0; j < 37; j++) {
+            one_hot.at(labels[j], j) = 1.0f;
+        }
+    }
+    void TearDown() override { nn::simd::set_isa(nn::simd::detect_isa()); }
+
+    // Double precision softmax and log-sum-exp of column j
+    static std::vector<double> reference_softmax(const Matrix<float>& x, size_t j, double& lse) {
+        double m = x.at(0, j);
+        for (size_t c = 1; c < x.rows(); c++) m = std::max(m, static_cast<double>(x.at(c, j)));
+        double s = 0.0;
+        for (size_t c = 0; c < x.rows(); c++) s += std::exp(x.at(c, j) - m);
+        lse = m + std::log(s);
+        std::vector<double> y(x.rows());
+        for (size_t c = 0; c < x.rows(); c++) y[c] = std::exp(x.at(c, j) - lse);
+        return y;
+    }
+
+    Matrix<float> logits = Matrix<float>(0, 0);
+    Matrix<float> one_hot = Matrix<float>(0, 0);
+    std::vector<uint32_t> labels;
+};
+
+TEST_F(LossTest, SoftmaxMatchesReferenceOnEveryIsa) {
+    // large logits would overflow a plain exp
+    logits.at(2, 5) = 500.0f;
+    logits.at(7, 6) = -500.0f;
+    logits.at(0, 36) = 88.0f;
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        Matrix<float> y(10, 37);
+        std::vector<float> lse(37);
+        nn::kernels::softmax_columns(logits.data(), y.data(), lse.data(), 10, 37);
+        for (size_t j = 0; j < 37; j++) {
+            double expected_lse = 0.0;
+            const std::vector<double> expected = reference_softmax(logits, j, expected_lse);
+            double sum = 0.0;
+            for (size_t c = 0; c < 10; c++) {
+                ASSERT_TRUE(std::isfinite(y.at(c, j)));
+                ASSERT_NEAR(y.at(c, j), expected[c], 1e-5) << "isa=" << nn::simd::isa_name(nn::simd::active_isa());
+                sum += y.at(c, j);
+            }
+            EXPECT_NEAR(sum, 1.0, 1e-5);
+            EXPECT_NEAR(lse[j], expected_lse, 1e-4 * std::max(1.0, std::fabs(expected_lse)));
+        }
+    }
+}
+
+TEST_F(LossTest, CrossEntropyGradientIsSoftmaxMinusOneHot) {
+    nn::SoftmaxCrossEntropy<float> loss;
+    Matrix<float> gradient(0, 0);
+    const float value = loss.evaluate(logits, labels.data(), gradient);
+
+    double expected_loss = 0.0;
+    for (size_t j = 0; j < 37; j++) {
+        double lse = 0.0;
+        const std::vector<double> y = reference_softmax(logits, j, lse);
+        expected_loss += lse - logits.at(labels[j], j);
+        for (size_t c = 0; c < 10; c++) {
+            EXPECT_NEAR(gradient.at(c, j), y[c] - (c == labels[j] ? 1.0 : 0.0), 1e-5);
+        }
+    }
+    EXPECT_NEAR(value, expected_loss / 37, 1e-4);
+
+    // one-hot target columns give the same loss and gradient as the labels
+    Matrix<float> dense_gradient(0, 0);
+    EXPECT_NEAR(loss.evaluate(logits, one_hot, dense_gradient), value, 1e-5);
+    for (size_t k = 0; k < 10 * 37; k++) {
+        EXPECT_NEAR(dense_gradient.data()[k], gradient.data()[k], 1e-6);
+    }
+    EXPECT_NEAR(loss.loss(logits, one_hot), value, 1e-5);
+
+    std::vector<uint32_t> bad = labels;
+    bad[3] = 10;
+    EXPECT_THROW(loss.evaluate(logits, bad.data(), gradient), std::out_of_range);
+    EXPECT_THROW(loss.evaluate(logits, Matrix<float>(10, 36), gradient), std::invalid_argument);
+    EXPECT_THROW(loss.evaluate(logits, one_hot, logits), std::invalid_argument);
+}
+
+TEST_F(LossTest, MeanSquaredErrorMatchesNetworkLoss) {
+    nn::MeanSquaredError<float> loss;
+    Matrix<float> output(10, 37);
+    for (size_t k = 0; k < 10 * 37; k++) {
+        output.data()[k] = 1.0f / (1.0f + std::exp(-logits.data()[k]));
+    }
+
+    Matrix<float> gradient(0, 0), label_gradient(0, 0);
+    const float value = loss.evaluate(output, one_hot, gradient);
+    EXPECT_FLOAT_EQ(loss.evaluate(output, labels.data(), label_gradient), value);
+    for (size_t k = 0; k < 10 * 37; k++) {
+        EXPECT_FLOAT_EQ(gradient.data()[k], output.data()[k] - one_hot.data()[k]);
+        EXPECT_EQ(label_gradient.data()[k], gradient.data()[k]);
+    }
+
+    nn::Network<float> network;
+    EXPECT_STREQ(network.loss().name(), "mse");
+    EXPECT_FLOAT_EQ(network.calculate_loss(output, one_hot), value);
+}
+
+TEST_F(LossTest, NetworkTrainsOnLabelsWithCrossEntropy) {
+    // 3 separable classes in 2 dimensions, logits from an Identity output layer
+    std::mt19937 gen(11);
+    std::normal_distribution<double> noise(0.0, 0.3);
+    const double centers[3][2] = {{0.0, 2.0}, {-2.0, -1.0}, {2.0, -1.0}};
+    nn::Dataset<double> data(90, 2, 3);
+    for (size_t i = 0; i < 90; i++) {
+        data.sample(i)[0] = centers[i % 3][0] + noise(gen);
+        data.sample(i)[1] = centers[i % 3][1] + noise(gen);
+        data.set_label(i, static_cast<uint32_t>(i % 3));
+    }
+
+    nn::Layer<double, nn::activations::Tanh> hidden(2, 8);
+    nn::Layer<double, nn::activations::Identity> output(8, 3);
+    nn::SGD<double> optimizer(0.1);
+    nn::SoftmaxCrossEntropy<double> loss;
+    nn::Network<double> network;
+    network.add(&hidden);
+    network.add(&output);
+    network.set_optimizer(&optimizer);
+    network.set_loss(&loss);
+    network.set_verbosity(nn::Verbosity::SILENT);
+    EXPECT_STREQ(network.loss().name(), "softmax_cross_entropy");
+
+    Matrix<double> inputs(0, 0);
+    std::vector<uint32_t> batch_labels;
+    data.gather(size_t{0}, size_t{90}, inputs, batch_labels);
+    network.train_step(inputs, batch_labels);
+    const double initial = network.last_loss();
+
+    network.train(data, 30, 10);
+    network.train_step(inputs, batch_labels);
+    EXPECT_LT(network.last_loss(), initial / 4);
+    EXPECT_EQ(network.count_correct_predictions(network.predict(inputs), batch_labels), 90u);
+
+    Matrix<double> probabilities(0, 0);
+    nn::SoftmaxCrossEntropy<double>::probabilities(network.predict(inputs), probabilities);
+    EXPECT_GT(probabilities.at(1, 1), 0.9);
+
+    EXPECT_THROW(network.train_step(inputs, std::vector<uint32_t>(89)), std::invalid_argument);
+}
+
+TEST_F(LossTest, RejectsPaddedOperands) {
+    // the losses walk their operands as one array
+    Matrix<float> padded = Matrix<float>::padded(10, 37);
+    padded = logits;
+    ASSERT_FALSE(padded.is_contiguous());
+    Matrix<float> gradient(0, 0);
+    Matrix<float> padded_gradient = Matrix<float>::padded(0, 0);
+
+    nn::MeanSquaredError<float> mse;
+    nn::SoftmaxCrossEntropy<float> cross_entropy;
+    for (nn::Loss<float>* loss : std::vector<nn::Loss<float>*>{&mse, &cross_entropy}) {
+        EXPECT_THROW(loss->evaluate(padded, labels.data(), gradient), std::invalid_argument) << loss->name();
+        EXPECT_THROW(loss->evaluate(padded, one_hot, gradient), std::invalid_argument) << loss->name();
+        EXPECT_THROW(loss->evaluate(logits, labels.data(), padded_gradient), std::invalid_argument) << loss->name();
+        EXPECT_THROW(loss->evaluate(logits, one_hot, padded_gradient), std::invalid_argument) << loss->name();
+    }
+    EXPECT_THROW(nn::SoftmaxCrossEntropy<float>::probabilities(padded, gradient), std::invalid_argument);
+}
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <cstdint>
+#include <random>
+#include <type_traits>
 #include "nn/matrix.hpp"
 
 class MatrixTest : public ::testing::Test {
@@ -104,3 +107,489 @@ TEST_F(MatrixTest, HadamardProductDimensionMismatch) {
 
     EXPECT_THROW(m1.hadamard(m2), std::invalid_argument);
 }
+
+namespace {
+
+template<typename T>
+Matrix<T> reference_mul(const Matrix<T>& A, const Matrix<T>& B) {
+    Matrix<T> result(A.rows(), B.columns());
+    for (size_t i = 0; i < A.rows(); i++) {
+        for (size_t j = 0; j < B.columns(); j++) {
+            T sum = 0;
+            for (size_t k = 0; k < A.columns(); k++) {
+                sum += A.at(i, k) * B.at(k, j);
+            }
+            result.at(i, j) = sum;
+        }
+    }
+    return result;
+}
+
+template<typename T>
+Matrix<T> random_matrix(size_t rows, size_t columns, std::mt19937& gen) {
+    std::uniform_real_distribution<T> dist(-1, 1);
+    std::vector<T> values(rows * columns);
+    for (auto& v : values) {
+        v = dist(gen);
+    }
+    return Matrix<T>(rows, columns, values);
+}
+
+template<typename T>
+void expect_blocked_mul_matches_reference(T tolerance) {
+    // Sizes that are not multiples of the register tile or the cache blocks
+    const size_t shapes[][3] = {
+        {1, 1, 1}, {3, 5, 7}, {17, 1, 33}, {128, 1, 784}, {37, 29, 300},
+        {128, 32, 784}, {100, 70, 513}, {7, 300, 9}
+    };
+
+    std::mt19937 gen(1234);
+    for (const auto& shape : shapes) {
+        Matrix<T> A = random_matrix<T>(shape[0], shape[2], gen);
+        Matrix<T> B = random_matrix<T>(shape[2], shape[1], gen);
+
+        Matrix<T> expected = reference_mul(A, B);
+        Matrix<T> result = A * B;
+
+        ASSERT_EQ(result.rows(), shape[0]);
+        ASSERT_EQ(result.columns(), shape[1]);
+        for (size_t i = 0; i < result.rows(); i++) {
+            for (size_t j = 0; j < result.columns(); j++) {
+                ASSERT_NEAR(result.at(i, j), expected.at(i, j), tolerance)
+                    << "M=" << shape[0] << " N=" << shape[1] << " K=" << shape[2];
+            }
+        }
+    }
+}
+
+template<typename T>
+void expect_transposed_mul_matches_reference(T tolerance) {
+    using nn::kernels::Transpose;
+    const size_t shapes[][3] = {
+        {1, 1, 1}, {3, 5, 7}, {17, 1, 33}, {128, 1, 784}, {784, 1, 128},
+        {37, 29, 300}, {128, 32, 784}, {784, 128, 32}, {7, 300, 9}
+    };
+    const T alpha = static_cast<T>(0.5);
+    const T beta = static_cast<T>(-2);
+
+    std::mt19937 gen(4321);
+    for (const auto& shape : shapes) {
+        for (auto trans_a : {Transpose::NO, Transpose::YES}) {
+            for (auto trans_b : {Transpose::NO, Transpose::YES}) {
+                Matrix<T> A = random_matrix<T>(shape[0], shape[2], gen);
+                Matrix<T> B = random_matrix<T>(shape[2], shape[1], gen);
+                Matrix<T> C = random_matrix<T>(shape[0], shape[1], gen);
+                const Matrix<T> stored_a = trans_a == Transpose::YES ? A.transpose() : A;
+                const Matrix<T> stored_b = trans_b == Transpose::YES ? B.transpose() : B;
+
+                Matrix<T> product = reference_mul(A, B);
+                Matrix<T> result(0, 0);
+                stored_a.mul_into(stored_b, result, trans_a, trans_b);
+                Matrix<T> accumulated = C;
+                stored_a.mul_into(stored_b, accumulated, trans_a, trans_b, alpha, beta);
+
+                ASSERT_EQ(result.rows(), shape[0]);
+                ASSERT_EQ(result.columns(), shape[1]);
+                for (size_t i = 0; i < result.rows(); i++) {
+                    for (size_t j = 0; j < result.columns(); j++) {
+                        const T expected = product.at(i, j);
+                        ASSERT_NEAR(result.at(i, j), expected, tolerance)
+                            << "M=" << shape[0] << " N=" << shape[1] << " K=" << shape[2]
+                            << " transA=" << (trans_a == Transpose::YES) << " transB=" << (trans_b == Transpose::YES);
+                        ASSERT_NEAR(accumulated.at(i, j), alpha * expected + beta * C.at(i, j), tolerance)
+                            << "M=" << shape[0] << " N=" << shape[1] << " K=" << shape[2]
+                            << " transA=" << (trans_a == Transpose::YES) << " transB=" << (trans_b == Transpose::YES);
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
+
+TEST_F(MatrixTest, BlockedMultiplicationMatchesReference) {
+    const nn::simd::Isa detected = nn::simd::detect_isa();
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        expect_blocked_mul_matches_reference<float>(1e-3f);
+        expect_blocked_mul_matches_reference<double>(1e-10);
+    }
+    nn::simd::set_isa(detected);
+}
+
+TEST_F(MatrixTest, TransposedMultiplicationMatchesReference) {
+    const nn::simd::Isa detected = nn::simd::detect_isa();
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        expect_transposed_mul_matches_reference<float>(1e-3f);
+        expect_transposed_mul_matches_reference<double>(1e-10);
+    }
+    nn::simd::set_isa(detected);
+}
+
+TEST_F(MatrixTest, TransposedMultiplicationChecksShapes) {
+    using nn::kernels::Transpose;
+    Matrix<float> A(3, 4);
+    Matrix<float> B(3, 5);
+    Matrix<float> C(0, 0);
+    EXPECT_NO_THROW(A.mul_into(B, C, Transpose::YES, Transpose::NO));
+    EXPECT_EQ(C.rows(), 4);
+    EXPECT_EQ(C.columns(), 5);
+    EXPECT_THROW(A.mul_into(B, C, Transpose::NO, Transpose::NO), std::invalid_argument);
+    Matrix<float> wrong_shape(5, 4);
+    EXPECT_THROW(A.mul_into(B, wrong_shape, Transpose::YES, Transpose::NO, 1.0f, 1.0f), std::invalid_argument);
+    Matrix<float> D(4, 5);
+    EXPECT_NO_THROW(A.mul_into(B, D, Transpose::YES, Transpose::NO, 1.0f, 1.0f));
+    EXPECT_THROW(A.mul_into(A, A, Transpose::YES, Transpose::NO), std::invalid_argument);
+}
+
+TEST_F(MatrixTest, EpilogueAddsBiasAndActivates) {
+    // shapes hitting the GEMV, small, blocked (with edge tiles) and parallel paths
+    const size_t shapes[][3] = {{1, 1, 1}, {128, 1, 784}, {3, 5, 7}, {37, 29, 300}, {128, 32, 784}, {300, 200, 64}};
+    const nn::simd::Isa detected = nn::simd::detect_isa();
+    std::mt19937 gen(99);
+
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        for (const auto& shape : shapes) {
+            Matrix<double> A = random_matrix<double>(shape[0], shape[2], gen);
+            Matrix<double> B = random_matrix<double>(shape[2], shape[1], gen);
+            Matrix<double> bias = random_matrix<double>(shape[0], 1, gen);
+            Matrix<double> expected = reference_mul(A, B);
+
+            nn::kernels::Epilogue<double> epilogue;
+            epilogue.bias = bias.data();
+            epilogue.activate = [](const double* x, double* y, size_t n) {
+                for (size_t i = 0; i < n; i++) y[i] = x[i] > 0 ? x[i] : 0.5 * x[i];
+            };
+            Matrix<double> z(0, 0);
+            Matrix<double> out(shape[0], shape[1]);
+            epilogue.out = out.data();
+            epilogue.ldo = out.columns();
+            A.mul_into(B, z, epilogue);
+
+            for (size_t i = 0; i < shape[0]; i++) {
+                for (size_t j = 0; j < shape[1]; j++) {
+                    const double pre = expected.at(i, j) + bias.at(i, 0);
+                    ASSERT_NEAR(z.at(i, j), pre, 1e-10) << "M=" << shape[0] << " N=" << shape[1] << " K=" << shape[2];
+                    ASSERT_NEAR(out.at(i, j), pre > 0 ? pre : 0.5 * pre, 1e-10)
+                        << "M=" << shape[0] << " N=" << shape[1] << " K=" << shape[2];
+                }
+            }
+
+            // in place: the activation overwrites the product
+            epilogue.out = z.data();
+            A.mul_into(B, z, epilogue);
+            for (size_t i = 0; i < shape[0]; i++) {
+                for (size_t j = 0; j < shape[1]; j++) {
+                    ASSERT_NEAR(z.at(i, j), out.at(i, j), 1e-10);
+                }
+            }
+        }
+    }
+    nn::simd::set_isa(detected);
+}
+
+TEST_F(MatrixTest, BorrowedStorage) {
+    // a growing vector moves its matrices (std::move_if_noexcept takes the move constructor)
+    static_assert(std::is_nothrow_move_constructible<Matrix<float>>::value, "");
+    std::vector<Matrix<float>> matrices;
+    matrices.emplace_back(4, 4);
+    const float* first = matrices[0].data();
+    for (size_t k = 0; k < 16; k++) {
+        matrices.emplace_back(4, 4);
+    }
+    EXPECT_EQ(matrices[0].data(), first);
+
+    std::vector<float> storage = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+    Matrix<float> view = Matrix<float>::borrow(storage.data(), 2, 3);
+    EXPECT_TRUE(view.is_borrowed());
+    EXPECT_EQ(view.data(), storage.data());
+    EXPECT_EQ(view.at(1, 2), 6.0f);
+
+    // assignment writes through, copies own their storage
+    view = Matrix<float>(2, 3, {6.0, 5.0, 4.0, 3.0, 2.0, 1.0});
+    EXPECT_EQ(storage[0], 6.0f);
+    Matrix<float> copy = view;
+    EXPECT_FALSE(copy.is_borrowed());
+    copy.at(0, 0) = 0.0f;
+    EXPECT_EQ(storage[0], 6.0f);
+
+    // the shape can change, the size cannot
+    view.resize(3, 2);
+    EXPECT_EQ(view.at(2, 1), 1.0f);
+    EXPECT_THROW(view.resize(4, 2), std::invalid_argument);
+    EXPECT_THROW(view = Matrix<float>(1, 1), std::invalid_argument);
+
+    // results of the *_into operations can live in borrowed storage
+    Matrix<float> a(3, 2, {1.0, 1.0, 1.0, 1.0, 1.0, 1.0});
+    a.add_into(copy.transpose(), view);
+    EXPECT_EQ(storage[0], 1.0f);
+    EXPECT_EQ(storage[5], 2.0f);
+}
+
+TEST_F(MatrixTest, ExpressionChainsMatchTheNamedOperations) {
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix<double> a(37, 29), b(37, 29), c(37, 29), d(37, 29);
+    for (Matrix<double>* m : {&a, &b, &c, &d}) {
+        for (size_t k = 0; k < 37 * 29; k++) m->data()[k] = dist(gen);
+    }
+
+    // one pass, no temporary per operation
+    Matrix<double> fused = (a - b) * 0.5 + nn::hadamard(c, d) - 2.0 * a;
+    Matrix<double> expected = a.subtract(b).scalar_mul(0.5).add(c.hadamard(d)).subtract(a.scalar_mul(2.0));
+    ASSERT_EQ(fused.rows(), 37u);
+    ASSERT_EQ(fused.columns(), 29u);
+    for (size_t i = 0; i < 37; i++) {
+        for (size_t j = 0; j < 29; j++) {
+            EXPECT_DOUBLE_EQ(fused.at(i, j), expected.at(i, j));
+        }
+    }
+
+    // elements of an expression can be read without evaluating it
+    EXPECT_DOUBLE_EQ((a + b).at(3, 4), a.at(3, 4) + b.at(3, 4));
+    EXPECT_THROW((a + b).at(37, 0), std::out_of_range);
+
+    // a product with an expression evaluates it first
+    Matrix<double> e(29, 3);
+    e.at(2, 1) = 1.0;
+    Matrix<double> product = (a + b) * e;
+    EXPECT_DOUBLE_EQ(product.at(5, 1), a.at(5, 2) + b.at(5, 2));
+}
+
+TEST_F(MatrixTest, ExpressionsAssignAndAccumulate) {
+    Matrix<float> a(2, 2, {1.0, 2.0, 3.0, 4.0});
+    Matrix<float> b(2, 2, {1.0, 1.0, 1.0, 1.0});
+
+    // the result may be an operand
+    a = a + b * 3.0f;
+    EXPECT_EQ(a.at(1, 1), 7.0f);
+    a += nn::hadamard(a, b) - b;
+    EXPECT_EQ(a.at(0, 0), 7.0f);
+    a -= b * 2.0f;
+    EXPECT_EQ(a.at(0, 1), 7.0f);
+
+    // assignment reshapes an owning matrix, not a borrowed one
+    Matrix<float> c(0, 0);
+    c = a - b;
+    EXPECT_EQ(c.rows(), 2u);
+    EXPECT_EQ(c.at(1, 0), 8.0f);
+    std::vector<float> storage(4);
+    Matrix<float> view = Matrix<float>::borrow(storage.data(), 2, 2);
+    view = a + b;
+    EXPECT_EQ(storage[3], 12.0f);
+    Matrix<float> wide = Matrix<float>::borrow(storage.data(), 1, 4);
+    EXPECT_THROW(wide = a + b, std::invalid_argument);
+
+    // shapes are checked as the expression is built
+    Matrix<float> other(2, 3);
+    EXPECT_THROW(a + other, std::invalid_argument);
+    EXPECT_THROW(a - other, std::invalid_argument);
+    EXPECT_THROW(nn::hadamard(a + b, other), std::invalid_argument);
+    EXPECT_THROW(a += other * 2.0f, std::invalid_argument);
+}
+
+TEST_F(MatrixTest, ExpressionsReadingTheResultMayChangeItsShape) {
+    // 20 columns are padded to 32, 8 to 16: resizing in place would zero what the expression reads
+    Matrix<float> padded = Matrix<float>::padded(3, 20);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t k = 0; k < 20; k++) {
+            padded.at(i, k) = static_cast<float>(i * 20 + k);
+        }
+    }
+    padded = padded.view().column_range(4, 8) * 2.0f;
+    ASSERT_EQ(padded.columns(), 8u);
+    EXPECT_EQ(padded.stride(), 16u);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t k = 0; k < 8; k++) {
+            EXPECT_EQ(padded.at(i, k), 2.0f * (i * 20 + 4 + k));
+        }
+    }
+
+    Matrix<float> a(2, 4, {1, 2, 3, 4, 5, 6, 7, 8});
+    a = a.view().column_range(1, 2) + a.view().column_range(2, 2);
+    ASSERT_EQ(a.columns(), 2u);
+    EXPECT_EQ(a.at(0, 0), 5.0f);
+    EXPECT_EQ(a.at(0, 1), 7.0f);
+    EXPECT_EQ(a.at(1, 0), 13.0f);
+    EXPECT_EQ(a.at(1, 1), 15.0f);
+}
+
+TEST_F(MatrixTest, StorageIsAligned) {
+    for (size_t n : {1, 3, 17, 784}) {
+        Matrix<float> m(n, 3);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(m.data()) % Matrix<float>::kAlignment, 0u) << n;
+        EXPECT_EQ(m.stride(), 3u);
+        EXPECT_TRUE(m.is_contiguous());
+    }
+
+    // every row of a padded matrix starts on a cache line
+    Matrix<float> p = Matrix<float>::padded(5, 784);
+    EXPECT_EQ(p.stride(), 784u);
+    Matrix<double> q = Matrix<double>::padded(5, 10);
+    EXPECT_EQ(q.stride(), 16u);
+    EXPECT_FALSE(q.is_contiguous());
+    for (size_t i = 0; i < 5; i++) {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(&q.at(i, 0)) % Matrix<double>::kAlignment, 0u);
+    }
+    EXPECT_TRUE(Matrix<double>::padded(1, 10).is_contiguous());
+}
+
+TEST_F(MatrixTest, PaddedMatricesComputeLikeContiguousOnes) {
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Matrix<float> a(13, 21), b(13, 21), c(21, 7);
+    for (Matrix<float>* m : {&a, &b, &c}) {
+        for (size_t k = 0; k < m->rows() * m->columns(); k++) m->data()[k] = dist(gen);
+    }
+    Matrix<float> pa = Matrix<float>::padded(13, 21), pb = Matrix<float>::padded(13, 21), pc = Matrix<float>::padded(21, 7);
+    pa = a;
+    pb = b;
+    pc = c;
+    // assignment keeps the layout of the destination
+    ASSERT_EQ(pa.stride(), 32u);
+    ASSERT_EQ(pc.stride(), 16u);
+
+    auto expect_equal = [](const Matrix<float>& x, const Matrix<float>& y) {
+        ASSERT_EQ(x.rows(), y.rows());
+        ASSERT_EQ(x.columns(), y.columns());
+        for (size_t i = 0; i < x.rows(); i++) {
+            for (size_t j = 0; j < x.columns(); j++) {
+                EXPECT_FLOAT_EQ(x.at(i, j), y.at(i, j)) << i << ", " << j;
+            }
+        }
+    };
+    expect_equal(pa.add(b), a.add(b));
+    expect_equal(pa.subtract(pb), a.subtract(b));
+    expect_equal(pa.hadamard(pb), a.hadamard(b));
+    expect_equal(pa.scalar_mul(3.0f), a.scalar_mul(3.0f));
+    expect_equal(pa.transpose(), a.transpose());
+    expect_equal(pa * pc, a * c);
+    expect_equal(a * pc, a * c);
+    Matrix<float> fused = (pa - b) * 0.5f + nn::hadamard(pa, pb);
+    expect_equal(fused, (a - b) * 0.5f + nn::hadamard(a, b));
+
+    // in place, into a padded result, and a copy that stays padded
+    Matrix<float> sum = Matrix<float>::padded(0, 0);
+    pa.add_into(pb, sum);
+    EXPECT_EQ(sum.stride(), 32u);
+    expect_equal(sum, a + b);
+    pa += pb;
+    pa -= b * 2.0f;
+    a += b;
+    a -= b * 2.0f;
+    expect_equal(pa, a);
+    Matrix<float> copy = pa;
+    EXPECT_EQ(copy.stride(), 32u);
+    expect_equal(copy, a);
+    Matrix<float> product(0, 0);
+    pa.mul_into(pc, product, nn::kernels::Transpose::NO, nn::kernels::Transpose::NO, 2.0f);
+    expect_equal(product, a.mul(c).scalar_mul(2.0f));
+
+    // the padding stays zero through resizing
+    pa.resize(4, 9);
+    EXPECT_EQ(pa.stride(), 16u);
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 9; j < 16; j++) {
+            EXPECT_EQ(pa.data()[i * 16 + j], 0.0f);
+        }
+    }
+}
+
+TEST_F(MatrixTest, ViewsSelectWithoutCopying) {
+    // 4 x 6, m(i, j) = 10 * i + j
+    Matrix<float> m(4, 6);
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 6; j++) m.at(i, j) = 10.0f * i + j;
+    }
+
+    nn::MatrixView<const float> block = m.view().block(1, 2, 2, 3);
+    EXPECT_EQ(block.data(), &m.at(1, 2));
+    EXPECT_EQ(block.rows(), 2u);
+    EXPECT_EQ(block.columns(), 3u);
+    EXPECT_EQ(block.stride(), 6u);
+    EXPECT_FALSE(block.is_contiguous());
+    EXPECT_EQ(block.at(1, 2), 24.0f);
+    EXPECT_THROW(block.at(2, 0), std::out_of_range);
+    EXPECT_THROW(block.block(1, 1, 2, 1), std::out_of_range);
+    EXPECT_EQ(m.view().row_range(2, 2).at(0, 0), 20.0f);
+    EXPECT_TRUE(m.view().row_range(2, 2).is_contiguous());
+    EXPECT_EQ(m.view().column_range(4, 2).at(3, 1), 35.0f);
+    EXPECT_THROW(nn::MatrixView<float>(m.data(), 2, 7, 6), std::invalid_argument);
+
+    // a contiguous copy
+    Matrix<float> copy(block);
+    EXPECT_EQ(copy.stride(), 3u);
+    EXPECT_EQ(copy.at(0, 0), 12.0f);
+    EXPECT_EQ(copy.at(1, 2), 24.0f);
+
+    // writing through a view, and a borrowed view that only touches its block
+    m.view().at(0, 0) = -1.0f;
+    EXPECT_EQ(m.at(0, 0), -1.0f);
+    Matrix<float> window = Matrix<float>::borrow(m.view().block(1, 1, 2, 2));
+    window.zeros();
+    EXPECT_EQ(m.at(1, 0), 10.0f);
+    EXPECT_EQ(m.at(1, 1), 0.0f);
+    EXPECT_EQ(m.at(2, 2), 0.0f);
+    EXPECT_EQ(m.at(2, 3), 23.0f);
+    window.assign(Matrix<float>(2, 2, {1.0, 2.0, 3.0, 4.0}));
+    EXPECT_EQ(m.at(2, 2), 4.0f);
+    EXPECT_THROW(window.resize(1, 4), std::invalid_argument);
+    Matrix<float> owned = window;
+    EXPECT_FALSE(owned.is_borrowed());
+    EXPECT_EQ(owned.stride(), 2u);
+    EXPECT_EQ(owned.at(1, 0), 3.0f);
+}
+
+TEST_F(MatrixTest, OperationsAcceptViews) {
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    // a (8 x 40) buffer of which the batches are column ranges
+    Matrix<double> buffer(8, 40), weights(5, 8), other(8, 10);
+    for (Matrix<double>* m : {&buffer, &weights, &other}) {
+        for (size_t k = 0; k < m->rows() * m->columns(); k++) m->data()[k] = dist(gen);
+    }
+    nn::MatrixView<const double> batch = buffer.view().column_range(10, 10);
+    const Matrix<double> copy(batch);
+
+    auto expect_equal = [](const Matrix<double>& x, const Matrix<double>& y) {
+        ASSERT_EQ(x.rows(), y.rows());
+        ASSERT_EQ(x.columns(), y.columns());
+        for (size_t i = 0; i < x.rows(); i++) {
+            for (size_t j = 0; j < x.columns(); j++) {
+                EXPECT_DOUBLE_EQ(x.at(i, j), y.at(i, j)) << i << ", " << j;
+            }
+        }
+    };
+    expect_equal(weights * copy, weights.mul(batch));
+    Matrix<double> product(0, 0);
+    weights.mul_into(batch, product);
+    expect_equal(product, weights * copy);
+    Matrix<double> gram(0, 0);
+    copy.mul_into(batch, gram, nn::kernels::Transpose::NO, nn::kernels::Transpose::YES);
+    expect_equal(gram, copy * copy.transpose());
+
+    Matrix<double> sum(0, 0);
+    other.add_into(batch, sum);
+    expect_equal(sum, other + copy);
+    other.hadamard_into(batch, sum);
+    expect_equal(sum, nn::hadamard(other, copy));
+    expect_equal(other.subtract(batch), other - copy);
+
+    // expressions over views, on either side
+    Matrix<double> fused = batch * 2.0 - other + nn::hadamard(batch, other);
+    expect_equal(fused, copy * 2.0 - other + nn::hadamard(copy, other));
+    Matrix<double> accumulated = other;
+    accumulated += batch;
+    accumulated -= 0.5 * batch;
+    expect_equal(accumulated, other + copy - copy * 0.5);
+    EXPECT_THROW(other + buffer.view().column_range(0, 9), std::invalid_argument);
+
+    // results written into a view of the buffer
+    Matrix<double> target = Matrix<double>::borrow(buffer.view().column_range(30, 10));
+    target = other + copy;
+    expect_equal(Matrix<double>(buffer.view().column_range(30, 10)), other + copy);
+    EXPECT_THROW(target = buffer + buffer, std::invalid_argument);
+}
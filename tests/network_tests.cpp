@@ -182,3 +182,199 @@ TEST_F(NetworkTest, PredictionCorrectnessTest) {
     
     EXPECT_FALSE(network.is_prediction_correct(out2, tgt2));
 }
+
+TEST_F(NetworkTest, BatchForwardMatchesPerSampleForward) {
+    nn::Network<float> network;
+
+    auto* layer1 = new nn::Layer<float, nn::activations::ReLU>(3, 4);
+    auto* layer2 = new nn::Layer<float, nn::activations::Sigmoid>(4, 2);
+    network.add(layer1);
+    network.add(layer2);
+
+    std::vector<float> sample1 = {0.1f, -0.4f, 0.9f};
+    std::vector<float> sample2 = {1.0f, 0.5f, -0.3f};
+    std::vector<float> batch_values = {0.1f, 1.0f,
+                                       -0.4f, 0.5f,
+                                       0.9f, -0.3f};
+
+    Matrix<float> out1 = network.forward(Matrix<float>(3, 1, sample1));
+    Matrix<float> out2 = network.forward(Matrix<float>(3, 1, sample2));
+    Matrix<float> batch_out = network.forward(Matrix<float>(3, 2, batch_values));
+
+    ASSERT_EQ(batch_out.rows(), 2);
+    ASSERT_EQ(batch_out.columns(), 2);
+    for (size_t i = 0; i < 2; ++i) {
+        EXPECT_NEAR(batch_out.at(i, 0), out1.at(i, 0), 1e-6);
+        EXPECT_NEAR(batch_out.at(i, 1), out2.at(i, 0), 1e-6);
+    }
+
+    delete layer1;
+    delete layer2;
+}
+
+TEST_F(NetworkTest, BatchLossAndAccuracy) {
+    nn::Network<float> network;
+
+    // Two samples per column: the first is classified correctly, the second is not
+    std::vector<float> output_values = {0.1f, 0.1f,
+                                        0.7f, 0.2f,
+                                        0.2f, 0.7f};
+    std::vector<float> target_values = {0.0f, 0.0f,
+                                        1.0f, 1.0f,
+                                        0.0f, 0.0f};
+    Matrix<float> output(3, 2, output_values);
+    Matrix<float> target(3, 2, target_values);
+
+    // Per sample MSE: 0.0467 and (0.01 + 0.64 + 0.49) / 3 = 0.38, averaged over the batch
+    EXPECT_NEAR(network.calculate_loss(output, target), (0.0467f + 0.38f) / 2, 0.001);
+    EXPECT_EQ(network.count_correct_predictions(output, target), 1);
+}
+
+TEST_F(NetworkTest, PredictMatchesForward) {
+    nn::Network<float> network;
+
+    auto* layer1 = new nn::Layer<float, nn::activations::ReLU>(4, 8);
+    auto* layer2 = new nn::Layer<float, nn::activations::Tanh>(8, 5);
+    auto* layer3 = new nn::Layer<float, nn::activations::Sigmoid>(5, 3);
+    network.add(layer1);
+    network.add(layer2);
+    network.add(layer3);
+
+    std::vector<float> input_values = {0.1f, -0.2f, 0.3f, 0.9f};
+    Matrix<float> input(4, 1, input_values);
+
+    Matrix<float> expected = network.forward(input);
+
+    // Repeated calls reuse the same buffers and give the same result
+    for (int i = 0; i < 3; i++) {
+        const Matrix<float>& output = network.predict(input);
+        ASSERT_EQ(output.rows(), 3);
+        ASSERT_EQ(output.columns(), 1);
+        for (size_t r = 0; r < 3; r++) {
+            EXPECT_FLOAT_EQ(output.at(r, 0), expected.at(r, 0));
+        }
+    }
+
+    delete layer1;
+    delete layer2;
+    delete layer3;
+}
+
+TEST_F(NetworkTest, PredictTakesItsOwnResult) {
+    // three layers: the result lives in the buffer the first layer writes
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::Tanh> layer1(3, 4);
+    nn::Layer<float, nn::activations::Tanh> layer2(4, 5);
+    nn::Layer<float, nn::activations::Tanh> layer3(5, 3);
+    network.add(&layer1);
+    network.add(&layer2);
+    network.add(&layer3);
+
+    const Matrix<float> input(3, 2, {0.1f, -0.2f, 0.3f, 0.9f, -0.5f, 0.4f});
+    const Matrix<float> once = network.predict(input);
+    const Matrix<float> expected = network.predict(once);
+    const Matrix<float>& twice = network.predict(network.predict(input));
+    for (size_t r = 0; r < 3; r++) {
+        for (size_t j = 0; j < 2; j++) {
+            EXPECT_FLOAT_EQ(twice.at(r, j), expected.at(r, j));
+        }
+    }
+
+    // a layer cannot write the storage it reads
+    Matrix<float> square(3, 3);
+    nn::Layer<float, nn::activations::Tanh> layer(3, 3);
+    EXPECT_THROW(layer.infer(square, square), std::invalid_argument);
+    EXPECT_THROW(layer.infer(square.view().column_range(1, 2), square), std::invalid_argument);
+}
+
+TEST_F(NetworkTest, TrainOnDatasetMatchesTrainOnVectors) {
+    // Two identical networks, one trained from per-sample matrices, one from a contiguous data set
+    nn::Network<double> network_vectors;
+    nn::Network<double> network_dataset;
+    nn::Layer<double, nn::activations::Tanh> layer_a(3, 5);
+    nn::Layer<double, nn::activations::Sigmoid> layer_b(5, 2);
+    nn::Layer<double, nn::activations::Tanh> copy_a(3, 5);
+    nn::Layer<double, nn::activations::Sigmoid> copy_b(5, 2);
+    copy_a.set_weights(layer_a.weights());
+    copy_a.set_bias(layer_a.bias());
+    copy_b.set_weights(layer_b.weights());
+    copy_b.set_bias(layer_b.bias());
+
+    nn::SGD<double> opt_a(0.1), opt_b(0.1), opt_copy_a(0.1), opt_copy_b(0.1);
+    layer_a.set_optimizer(&opt_a);
+    layer_b.set_optimizer(&opt_b);
+    copy_a.set_optimizer(&opt_copy_a);
+    copy_b.set_optimizer(&opt_copy_b);
+    network_vectors.add(&layer_a);
+    network_vectors.add(&layer_b);
+    network_dataset.add(&copy_a);
+    network_dataset.add(&copy_b);
+    network_vectors.set_verbosity(nn::Verbosity::SILENT);
+    network_dataset.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::Dataset<double> data(11, 3, 2);
+    std::vector<Matrix<double>> inputs;
+    std::vector<Matrix<double>> targets;
+    for (size_t i = 0; i < 11; i++) {
+        std::vector<double> features = {0.1 * i, -0.2 * i + 0.5, (i % 3) * 0.3};
+        std::copy(features.begin(), features.end(), data.sample(i));
+        data.set_label(i, i % 2);
+        inputs.emplace_back(3, 1, features);
+        targets.emplace_back(2, 1, std::vector<double>{i % 2 == 0 ? 1.0 : 0.0, i % 2 == 1 ? 1.0 : 0.0});
+        if (i % 2 == 1) {
+            // padded samples are stacked with their stride
+            Matrix<double> padded = Matrix<double>::padded(3, 1);
+            padded = inputs.back();
+            inputs.back().swap(padded);
+        }
+    }
+
+    network_vectors.train(inputs, targets, 3, 4);
+    network_dataset.train(data, 3, 4);
+
+    for (size_t i = 0; i < 5; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_DOUBLE_EQ(copy_a.weights().at(i, j), layer_a.weights().at(i, j));
+        }
+    }
+    for (size_t i = 0; i < 2; i++) {
+        EXPECT_DOUBLE_EQ(copy_b.bias().at(i, 0), layer_b.bias().at(i, 0));
+    }
+}
+
+TEST_F(NetworkTest, TrainWithBatchLoaderMatchesDataset) {
+    // An unshuffled loader hands out the same batches as the synchronous loop
+    nn::Network<double> network_sync;
+    nn::Network<double> network_async;
+    nn::Layer<double, nn::activations::Tanh> layer_sync(2, 3);
+    nn::Layer<double, nn::activations::Tanh> layer_async(2, 3);
+    layer_async.set_weights(layer_sync.weights());
+    layer_async.set_bias(layer_sync.bias());
+
+    nn::SGD<double> opt_sync(0.1, 0.9), opt_async(0.1, 0.9);
+    layer_sync.set_optimizer(&opt_sync);
+    layer_async.set_optimizer(&opt_async);
+    network_sync.add(&layer_sync);
+    network_async.add(&layer_async);
+    network_sync.set_verbosity(nn::Verbosity::SILENT);
+    network_async.set_verbosity(nn::Verbosity::SILENT);
+
+    nn::Dataset<double> data(13, 2, 3);
+    for (size_t i = 0; i < 13; i++) {
+        data.sample(i)[0] = 0.1 * i;
+        data.sample(i)[1] = 1.0 - 0.05 * i;
+        data.set_label(i, i % 3);
+    }
+
+    nn::BatchLoader<double> loader(data, 4);
+    network_sync.train(data, 2, 4);
+    network_async.train(loader, 1);
+    network_async.train(loader, 1);  // continues with the next epoch
+
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 2; j++) {
+            EXPECT_DOUBLE_EQ(layer_async.weights().at(i, j), layer_sync.weights().at(i, j));
+        }
+        EXPECT_DOUBLE_EQ(layer_async.bias().at(i, 0), layer_sync.bias().at(i, 0));
+    }
+}
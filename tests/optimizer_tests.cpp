@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
 #include "nn/optimizer.hpp"
 
 class OptimizerTest : public ::testing::Test {
@@ -165,3 +167,128 @@ TEST_F(OptimizerTest, SGDWithMomentum) {
     
     delete optimizer;
 }
+
+namespace {
+
+// Double precision reference of the adaptive updates, one element at a time
+struct ReferenceAdam {
+    double lr, beta1, beta2, eps, weight_decay;
+    double m = 0, v = 0;
+    int t = 0;
+
+    double step(double w, double g, bool decay) {
+        t++;
+        m = beta1 * m + (1 - beta1) * g;
+        v = beta2 * v + (1 - beta2) * g * g;
+        const double m_hat = m / (1 - std::pow(beta1, t));
+        const double v_hat = v / (1 - std::pow(beta2, t));
+        if (decay) {
+            w *= 1 - lr * weight_decay;
+        }
+        return w - lr * m_hat / (std::sqrt(v_hat) + eps);
+    }
+};
+
+Matrix<float> ramp(size_t rows, size_t columns, float start, float step) {
+    Matrix<float> m(rows, columns);
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < columns; j++) {
+            m.at(i, j) = start + step * static_cast<float>(i * columns + j);
+        }
+    }
+    return m;
+}
+
+}
+
+TEST_F(OptimizerTest, AdamAndAdamWMatchReference) {
+    // 7 x 5 = 35 weights: full vectors and a scalar tail on every instruction set
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        for (bool decoupled : {false, true}) {
+            Matrix<float> weights = ramp(7, 5, -1.0f, 0.06f);
+            Matrix<float> bias = ramp(7, 1, 0.5f, -0.1f);
+            std::unique_ptr<nn::Adam<float>> optimizer = decoupled
+                ? std::make_unique<nn::AdamW<float>>(0.01f, 0.1f)
+                : std::make_unique<nn::Adam<float>>(0.01f);
+
+            std::vector<ReferenceAdam> w_ref(35, {0.01, 0.9, 0.999, 1e-8, decoupled ? 0.1 : 0.0});
+            std::vector<ReferenceAdam> b_ref(7, {0.01, 0.9, 0.999, 1e-8, 0.0});
+            std::vector<double> w_expected(weights.data(), weights.data() + 35);
+            std::vector<double> b_expected(bias.data(), bias.data() + 7);
+
+            for (int step = 0; step < 5; step++) {
+                // gradients change sign and magnitude between steps
+                Matrix<float> w_grad = ramp(7, 5, step % 2 ? 0.3f : -0.2f, 0.01f * (step + 1));
+                Matrix<float> b_grad = ramp(7, 1, 0.05f * step, -0.02f);
+                optimizer->update(weights, bias, w_grad, b_grad);
+                for (size_t k = 0; k < 35; k++) {
+                    w_expected[k] = w_ref[k].step(w_expected[k], w_grad.data()[k], decoupled);
+                }
+                for (size_t k = 0; k < 7; k++) {
+                    b_expected[k] = b_ref[k].step(b_expected[k], b_grad.data()[k], false);
+                }
+            }
+
+            EXPECT_EQ(optimizer->step(), 5u);
+            for (size_t k = 0; k < 35; k++) {
+                EXPECT_NEAR(weights.data()[k], w_expected[k], 1e-5) << nn::simd::isa_name(isa) << " " << k;
+            }
+            for (size_t k = 0; k < 7; k++) {
+                EXPECT_NEAR(bias.data()[k], b_expected[k], 1e-5) << nn::simd::isa_name(isa) << " " << k;
+            }
+        }
+    }
+    nn::simd::set_isa(nn::simd::detect_isa());
+}
+
+TEST_F(OptimizerTest, RMSPropMatchesReference) {
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        Matrix<float> weights = ramp(9, 4, 1.0f, -0.05f);
+        Matrix<float> bias = ramp(9, 1, 0.0f, 0.1f);
+        nn::RMSProp<float> optimizer(0.01f, 0.9f, 1e-6f);
+
+        std::vector<double> w(weights.data(), weights.data() + 36), w_square(36, 0.0);
+        for (int step = 0; step < 4; step++) {
+            Matrix<float> w_grad = ramp(9, 4, step % 2 ? 0.5f : -0.1f, 0.02f);
+            Matrix<float> b_grad = ramp(9, 1, 0.1f, 0.0f);
+            optimizer.update(weights, bias, w_grad, b_grad);
+            for (size_t k = 0; k < 36; k++) {
+                const double g = w_grad.data()[k];
+                w_square[k] = 0.9 * w_square[k] + 0.1 * g * g;
+                w[k] -= 0.01 * g / (std::sqrt(w_square[k]) + 1e-6);
+            }
+        }
+        for (size_t k = 0; k < 36; k++) {
+            EXPECT_NEAR(weights.data()[k], w[k], 1e-5) << nn::simd::isa_name(isa) << " " << k;
+        }
+        // constant gradient: every step is lr / sqrt(1 - 0.9^t) * sign, the same for all biases
+        EXPECT_NEAR(bias.at(3, 0) - bias.at(2, 0), 0.1f, 1e-5f);
+    }
+    nn::simd::set_isa(nn::simd::detect_isa());
+}
+
+TEST_F(OptimizerTest, AdaptiveSettingsRoundTrip) {
+    nn::AdamW<float> adamw(0.002f, 0.05f, 0.8f, 0.99f, 1e-7f);
+    Matrix<float> weights(2, 2), bias(2, 1), w_grad = ramp(2, 2, 0.1f, 0.1f), b_grad = ramp(2, 1, 0.1f, 0.1f);
+    adamw.update(weights, bias, w_grad, b_grad);
+    adamw.update(weights, bias, w_grad, b_grad);
+
+    EXPECT_STREQ(adamw.name(), "adamw");
+    const std::vector<float> settings = adamw.settings();
+    ASSERT_EQ(settings.size(), 6u);
+    EXPECT_FLOAT_EQ(settings[4], 2.0f);  // step count
+    EXPECT_EQ(adamw.state().size(), 4u);
+
+    nn::AdamW<float> restored;
+    restored.restore_settings(settings);
+    EXPECT_EQ(restored.settings(), settings);
+    EXPECT_EQ(restored.step(), 2u);
+    EXPECT_THROW(restored.restore_settings({0.1f}), std::invalid_argument);
+
+    nn::RMSProp<float> rmsprop(0.01f, 0.95f);
+    EXPECT_STREQ(rmsprop.name(), "rmsprop");
+    EXPECT_EQ(rmsprop.settings().size(), 3u);
+    EXPECT_EQ(rmsprop.state().size(), 2u);
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "nn/parameters.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+
+class ParametersTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (size_t i = 0; i < 10; i++) {
+            inputs.emplace_back(3, 1, std::vector<double>{0.1 * i, 0.5 - 0.05 * i, (i % 3) * 0.2});
+            targets.emplace_back(2, 1, std::vector<double>{i % 2 == 0 ? 1.0 : 0.0, i % 2 == 1 ? 1.0 : 0.0});
+        }
+    }
+
+    std::vector<Matrix<double>> inputs;
+    std::vector<Matrix<double>> targets;
+};
+
+TEST_F(ParametersTest, ArenaLaysOutAlignedWeightsThenBiases) {
+    nn::ParameterArena<float> arena({{5, 3}, {2, 5}});
+    EXPECT_EQ(arena.num_slots(), 2u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(arena.values()) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(arena.gradients()) % 64, 0u);
+
+    // 15 and 10 weights padded to 16 floats each, then two biases padded the same way
+    EXPECT_EQ(arena.num_weights(), 32u);
+    EXPECT_EQ(arena.size(), 64u);
+    EXPECT_EQ(arena.weights(1).data(), arena.values() + 16);
+    EXPECT_EQ(arena.bias(0).data(), arena.values() + 32);
+    EXPECT_EQ(arena.bias(1).data(), arena.values() + 48);
+    EXPECT_EQ(arena.weight_gradients(1).data(), arena.gradients() + 16);
+    EXPECT_EQ(arena.bias_gradients(1).rows(), 2u);
+    EXPECT_TRUE(arena.weights(0).is_borrowed());
+    EXPECT_THROW(arena.weights(2), std::out_of_range);
+
+    // writes through a borrowed matrix land in the arena
+    Matrix<float> w = arena.weights(1);
+    w.at(1, 4) = 3.0f;
+    EXPECT_EQ(arena.values()[16 + 9], 3.0f);
+    EXPECT_THROW(w.resize(3, 5), std::invalid_argument);
+    EXPECT_THROW(w = Matrix<float>(5, 2), std::invalid_argument);
+}
+
+TEST_F(ParametersTest, BindingKeepsTheLayerParameters) {
+    nn::Layer<double, nn::activations::Tanh> layer(3, 5);
+    const Matrix<double> weights = layer.weights();
+    auto arena = std::make_shared<nn::ParameterArena<double>>(std::vector<std::pair<size_t, size_t>>{{5, 3}});
+    layer.bind_parameters(arena, 0);
+
+    EXPECT_EQ(layer.weights().data(), arena->values());
+    for (size_t i = 0; i < 5; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_EQ(layer.weights().at(i, j), weights.at(i, j));
+        }
+    }
+
+    // the arena outlives our handle while the layer uses it
+    arena.reset();
+    layer.set_bias(Matrix<double>(5, 1, std::vector<double>{1, 2, 3, 4, 5}));
+    EXPECT_EQ(layer.bias().at(4, 0), 5.0);
+}
+
+TEST_F(ParametersTest, SharedOptimizerMatchesOnePerLayer) {
+    // SGD with momentum over the whole arena takes the same steps as one SGD per layer
+    nn::Layer<double, nn::activations::Tanh> layer_a(3, 5);
+    nn::Layer<double, nn::activations::Sigmoid> layer_b(5, 2);
+    nn::Layer<double, nn::activations::Tanh> copy_a(3, 5);
+    nn::Layer<double, nn::activations::Sigmoid> copy_b(5, 2);
+    copy_a.set_weights(layer_a.weights());
+    copy_b.set_weights(layer_b.weights());
+
+    nn::SGD<double> opt_a(0.1, 0.9), opt_b(0.1, 0.9), shared(0.1, 0.9);
+    layer_a.set_optimizer(&opt_a);
+    layer_b.set_optimizer(&opt_b);
+    nn::Network<double> per_layer, arena;
+    per_layer.add(&layer_a);
+    per_layer.add(&layer_b);
+    arena.add(&copy_a);
+    arena.add(&copy_b);
+    arena.set_optimizer(&shared);
+    per_layer.set_verbosity(nn::Verbosity::SILENT);
+    arena.set_verbosity(nn::Verbosity::SILENT);
+    ASSERT_NE(arena.parameters(), nullptr);
+    EXPECT_EQ(per_layer.parameters(), nullptr);
+
+    per_layer.train(inputs, targets, 3, 4);
+    arena.train(inputs, targets, 3, 4);
+
+    for (size_t i = 0; i < 5; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_DOUBLE_EQ(copy_a.weights().at(i, j), layer_a.weights().at(i, j));
+        }
+    }
+    for (size_t i = 0; i < 2; i++) {
+        EXPECT_DOUBLE_EQ(copy_b.bias().at(i, 0), layer_b.bias().at(i, 0));
+    }
+
+    // one velocity buffer per region instead of one per layer
+    EXPECT_EQ(shared.state()[0]->columns(), arena.parameters()->num_weights());
+}
+
+TEST_F(ParametersTest, SharedAdamWDecaysWeightsOnly) {
+    nn::Layer<double, nn::activations::Sigmoid> layer(3, 2);
+    layer.set_weights(Matrix<double>(2, 3, std::vector<double>{1, 1, 1, 1, 1, 1}));
+    layer.set_bias(Matrix<double>(2, 1, std::vector<double>{1, 1}));
+    nn::AdamW<double> optimizer(0.1, 0.5);
+    nn::Network<double> network;
+    network.add(&layer);
+    network.set_optimizer(&optimizer);
+
+    // output == target gives zero gradients, leaving only the decay: 1 - 0.1 * 0.5 on the weights
+    const Matrix<double> output = network.forward(Matrix<double>(3, 1));
+    network.backward(output, output);
+    EXPECT_DOUBLE_EQ(layer.weights().at(1, 2), 0.95);
+    EXPECT_DOUBLE_EQ(layer.bias().at(1, 0), 1.0);
+}
+
+TEST_F(ParametersTest, RejectsMixedOptimizers) {
+    nn::Layer<double, nn::activations::Tanh> layer_a(3, 5);
+    nn::Layer<double, nn::activations::Tanh> layer_b(5, 2);
+    nn::SGD<double> own(0.1), shared(0.1);
+    nn::Network<double> network;
+    EXPECT_THROW(network.set_optimizer(&shared), std::invalid_argument);  // no layers
+    network.add(&layer_a);
+    network.add(&layer_b);
+    EXPECT_THROW(network.set_optimizer(nullptr), std::invalid_argument);
+
+    layer_b.set_optimizer(&own);
+    EXPECT_THROW(network.set_optimizer(&shared), std::invalid_argument);
+    layer_b.set_optimizer(nullptr);
+
+    network.set_optimizer(&shared);
+    EXPECT_THROW(layer_a.set_optimizer(&own), std::invalid_argument);
+    EXPECT_THROW(network.add(&layer_b), std::invalid_argument);
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "nn/profiler.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+
+/*
+ * The instrumentation, compiled in for this test binary (NN_PROFILE, see tests/CMakeLists.txt).
+ */
+
+namespace {
+
+const nn::profile::Totals* find_row(const nn::profile::EpochSummary& summary, const char* name) {
+    for (const auto& row : summary.rows) {
+        if (std::strcmp(row.name, name) == 0) {
+            return &row;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+class ProfilerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        profiler.clear();
+        profiler.set_enabled(true);
+        // 12 samples of 5 features, 3 classes
+        for (size_t i = 0; i < 12; i++) {
+            for (size_t f = 0; f < 5; f++) {
+                data.sample(i)[f] = static_cast<float>((i + f) % 4) / 4.0f;
+            }
+            data.set_label(i, static_cast<uint32_t>(i % 3));
+        }
+    }
+    void TearDown() override {
+        profiler.set_enabled(true);
+        profiler.clear();
+    }
+
+    nn::profile::Profiler& profiler = nn::profile::profiler();
+    nn::Dataset<float> data = nn::Dataset<float>(12, 5, 3);
+};
+
+TEST_F(ProfilerTest, SummarizesEveryEpoch) {
+    nn::Layer<float, nn::activations::ReLU> hidden(5, 7);
+    nn::Layer<float, nn::activations::Sigmoid> output(7, 3);
+    nn::Network<float> network;
+    network.add(&hidden);
+    network.add(&output);
+    nn::SGD<float> optimizer(0.1f, 0.9f);
+    network.set_optimizer(&optimizer);
+    network.set_verbosity(nn::Verbosity::SILENT);
+
+    // 3 batches of 4 per epoch
+    network.train(data, 2, 4);
+    ASSERT_EQ(profiler.epochs().size(), 2u);
+
+    const nn::profile::EpochSummary& summary = profiler.epochs()[1];
+    EXPECT_EQ(summary.epoch, 1u);
+    EXPECT_GT(summary.duration_ns, 0u);
+
+    const nn::profile::Totals* forward = find_row(summary, "Layer 5x7 forward");
+    ASSERT_NE(forward, nullptr);
+    EXPECT_EQ(forward->calls, 3u);
+    EXPECT_STREQ(forward->category, "layer");
+    EXPECT_DOUBLE_EQ(forward->flops, 3 * 2.0 * 7 * 5 * 4);
+    EXPECT_GT(forward->bytes, 0.0);
+    EXPECT_LE(forward->duration_ns, summary.duration_ns);
+
+    const nn::profile::Totals* backward = find_row(summary, "Layer 7x3 backward");
+    ASSERT_NE(backward, nullptr);
+    EXPECT_EQ(backward->calls, 3u);
+    EXPECT_DOUBLE_EQ(backward->flops, 3 * 4.0 * 3 * 7 * 4);
+
+    // one update of the whole arena per batch, padding included
+    const nn::profile::Totals* update = find_row(summary, "SGD::update");
+    ASSERT_NE(update, nullptr);
+    EXPECT_EQ(update->calls, 3u);
+    EXPECT_DOUBLE_EQ(update->flops, 3 * 4.0 * network.parameters()->size());
+
+    // the workspaces were sized in the first epoch
+    for (const auto& row : summary.rows) {
+        EXPECT_EQ(row.allocations, 0u) << row.name;
+    }
+
+    // rows by decreasing time
+    for (size_t k = 1; k < summary.rows.size(); k++) {
+        EXPECT_GE(summary.rows[k - 1].duration_ns, summary.rows[k].duration_ns);
+    }
+}
+
+TEST_F(ProfilerTest, CountsMatrixOperationsAndAllocations) {
+    Matrix<double> a(8, 16), b(16, 4);
+    {
+        NN_PROFILE_SCOPE("outer", "test");
+        Matrix<double> c = a.mul(b);
+        Matrix<double> d = c.add(c);
+        c.add_into(d, d);
+    }
+    profiler.end_epoch();
+    const nn::profile::EpochSummary& summary = profiler.epochs().back();
+
+    const nn::profile::Totals* mul = find_row(summary, "Matrix::mul");
+    ASSERT_NE(mul, nullptr);
+    EXPECT_DOUBLE_EQ(mul->flops, 2.0 * 8 * 4 * 16);
+    EXPECT_DOUBLE_EQ(mul->bytes, sizeof(double) * (8.0 * 16 + 16 * 4 + 8 * 4));
+    // the results of mul and add are allocated before their kernels run
+    EXPECT_EQ(mul->allocations, 0u);
+
+    const nn::profile::Totals* add = find_row(summary, "Matrix::add");
+    ASSERT_NE(add, nullptr);
+    EXPECT_EQ(add->calls, 2u);
+    EXPECT_DOUBLE_EQ(add->flops, 2 * 32.0);
+
+    const nn::profile::Totals* outer = find_row(summary, "outer");
+    ASSERT_NE(outer, nullptr);
+    EXPECT_EQ(outer->allocations, 2u);
+    EXPECT_EQ(outer->allocated_bytes, 2 * 32 * sizeof(double));
+}
+
+TEST_F(ProfilerTest, WritesAChromeTrace) {
+    Matrix<float> a(4, 4);
+    profiler.begin_epoch();
+    a.transpose();
+    profiler.end_epoch();
+
+    std::ostringstream out;
+    out << std::setprecision(2);
+    profiler.write_chrome_trace(out);
+    const std::string trace = out.str();
+    EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(trace.find("\"name\":\"Matrix::transpose\",\"cat\":\"matrix\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(trace.find("\"name\":\"epoch\",\"cat\":\"network\""), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"flops\":0,\"bytes\":128,\"allocations\":0,\"allocated_bytes\":0}"),
+        std::string::npos);
+    EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+    EXPECT_EQ(out.precision(), 2);
+
+    // bounded trace, the summary still counts everything
+    profiler.clear();
+    profiler.set_max_events(1);
+    a.transpose();
+    a.transpose();
+    profiler.end_epoch();
+    EXPECT_EQ(profiler.events().size(), 1u);
+    EXPECT_EQ(profiler.epochs().back().rows[0].calls, 2u);
+    profiler.set_max_events(1 << 20);
+}
+
+TEST_F(ProfilerTest, PausedRecordsNothing) {
+    profiler.set_enabled(false);
+    Matrix<float> a(4, 4);
+    a.add(a);
+    profiler.begin_epoch();
+    profiler.end_epoch();
+    EXPECT_TRUE(profiler.events().empty());
+    EXPECT_TRUE(profiler.epochs().empty());
+
+    // the table of an epoch, as Network prints it with Verbosity::DETAILED
+    profiler.set_enabled(true);
+    profiler.begin_epoch();
+    a.add(a);
+    profiler.end_epoch();
+    std::ostringstream out;
+    nn::profile::Profiler::print_summary(out, profiler.epochs().back());
+    EXPECT_NE(out.str().find("GFLOP/s"), std::string::npos);
+    EXPECT_NE(out.str().find("Matrix::add"), std::string::npos);
+}
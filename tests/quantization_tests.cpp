@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "nn/quantization.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/optimizer.hpp"
+#include "nn/activation.hpp"
+
+class QuantizationTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    static Matrix<float> random_matrix(size_t rows, size_t columns, float lo, float hi, unsigned seed) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> dist(lo, hi);
+        Matrix<float> m(rows, columns);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < columns; j++) {
+                m.at(i, j) = dist(gen);
+            }
+        }
+        return m;
+    }
+};
+
+TEST_F(QuantizationTest, Int8KernelIsExactOnEveryIsa) {
+    // neither count is a multiple of the 4 x 2 blocks; rows and samples have padded strides
+    const size_t rows = 11;
+    const size_t samples = 5;
+    const size_t n = 192;
+    const size_t ldw = n + 64;
+    const size_t ldx = n + 128;
+    const size_t ldy = rows + 3;
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    std::vector<int8_t> w(rows * ldw);
+    std::vector<uint8_t> x(samples * ldx);
+    for (auto& v : w) v = static_cast<int8_t>(dist(gen));
+    for (auto& v : x) v = static_cast<uint8_t>(dist(gen) + 128);
+    // extreme values: the 16-bit pair sums must not saturate
+    std::fill(w.begin(), w.begin() + n, static_cast<int8_t>(-128));
+    std::fill(x.begin(), x.begin() + n, static_cast<uint8_t>(255));
+
+    std::vector<int32_t> expected(samples * ldy, -1);
+    for (size_t j = 0; j < samples; j++) {
+        for (size_t r = 0; r < rows; r++) {
+            int32_t sum = 0;
+            for (size_t k = 0; k < n; k++) {
+                sum += static_cast<int32_t>(w[r * ldw + k]) * x[j * ldx + k];
+            }
+            expected[j * ldy + r] = sum;
+        }
+    }
+    EXPECT_EQ(expected[0], -128 * 255 * 192);
+
+    const nn::simd::Isa detected = nn::simd::detect_isa();
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        std::vector<int32_t> y(samples * ldy, -1);
+        nn::kernels::gemm_s8u8(w.data(), ldw, rows, x.data(), ldx, samples, n, y.data(), ldy);
+        EXPECT_EQ(y, expected) << nn::simd::isa_name(nn::simd::active_isa());
+    }
+    nn::simd::set_isa(detected);
+
+    std::vector<int32_t> y(samples * ldy);
+    EXPECT_THROW(nn::kernels::gemm_s8u8(w.data(), ldw, rows, x.data(), ldx, samples, 100, y.data(), ldy),
+        std::invalid_argument);
+}
+
+TEST_F(QuantizationTest, InputQuantizationMatchesOnEveryIsa) {
+    // 37 values: full vectors plus a tail on every instruction set
+    std::vector<float> x = {0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 1.5f, 2.5f, -2.5f, 126.6f, 127.4f, -127.4f,
+        500.0f, -500.0f, 3.49f, -3.51f};
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<float> dist(-140.0f, 140.0f);
+    while (x.size() < 37) x.push_back(dist(gen));
+
+    std::vector<uint8_t> expected(x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+        const float q = std::nearbyint(std::min(127.0f, std::max(-127.0f, x[i])));
+        expected[i] = static_cast<uint8_t>(static_cast<int>(q) + 128);
+    }
+    EXPECT_EQ(expected[0], 128);
+    EXPECT_EQ(expected[6], 130);   // ties round to even
+    EXPECT_EQ(expected[11], 255);
+    EXPECT_EQ(expected[12], 1);
+
+    const nn::simd::Isa detected = nn::simd::detect_isa();
+    for (auto isa : {nn::simd::Isa::SCALAR, nn::simd::Isa::AVX2, nn::simd::Isa::AVX512}) {
+        nn::simd::set_isa(isa);
+        std::vector<uint8_t> y(x.size());
+        nn::kernels::quantize_u8(x.data(), y.data(), x.size(), 1.0f);
+        EXPECT_EQ(y, expected) << nn::simd::isa_name(nn::simd::active_isa());
+    }
+    nn::simd::set_isa(detected);
+}
+
+TEST_F(QuantizationTest, LayerQuantizesPerOutputChannel) {
+    nn::Layer<float, nn::activations::ReLU> layer(70, 5);
+    Matrix<float> weights = random_matrix(5, 70, -0.5f, 0.5f, 1);
+    for (size_t k = 0; k < 70; k++) {
+        weights.at(3, k) *= 0.01f;  // a channel with much smaller weights keeps its own scale
+    }
+    layer.set_weights(weights);
+    layer.set_bias(random_matrix(5, 1, -0.1f, 0.1f, 2));
+
+    nn::QuantizedLayer quantized(layer, 1.0f / 127.0f);
+    EXPECT_LT(quantized.weight_scales()[3], quantized.weight_scales()[0] * 0.05f);
+    for (size_t o = 0; o < 5; o++) {
+        for (size_t k = 0; k < 70; k++) {
+            EXPECT_NEAR(quantized.weight(o, k) * quantized.weight_scales()[o], weights.at(o, k),
+                quantized.weight_scales()[o] * 0.5f + 1e-7f);
+        }
+    }
+    // rows padded to 128 bytes, the input offset correction, two scales and the bias per output
+    EXPECT_EQ(quantized.memory_bytes(), 5 * 128 + 5 * sizeof(int32_t) + 5 * 3 * sizeof(float));
+
+    // inputs in [-1, 1]: the error of an output is bounded by the rounding of both operands
+    const Matrix<float> input = random_matrix(70, 9, -1.0f, 1.0f, 3);
+    Matrix<float> expected(0, 0);
+    Matrix<float> output(0, 0);
+    layer.infer(input, expected);
+    quantized.infer(input, output);
+    ASSERT_EQ(output.rows(), 5);
+    ASSERT_EQ(output.columns(), 9);
+    for (size_t o = 0; o < 5; o++) {
+        for (size_t j = 0; j < 9; j++) {
+            EXPECT_NEAR(output.at(o, j), expected.at(o, j), 70 * (0.5f * quantized.weight_scales()[o] + 0.5f / 127.0f * 0.5f));
+        }
+    }
+
+    // padded input and output give the same values, the output padding stays zero
+    for (size_t columns : {size_t{1}, size_t{9}}) {
+        Matrix<float> padded_input = Matrix<float>::padded(70, columns);
+        for (size_t k = 0; k < 70; k++) {
+            for (size_t j = 0; j < columns; j++) {
+                padded_input.at(k, j) = input.at(k, j);
+            }
+        }
+        Matrix<float> contiguous_output(0, 0);
+        Matrix<float> padded_output = Matrix<float>::padded(0, 0);
+        quantized.infer(Matrix<float>(padded_input.view()), contiguous_output);
+        quantized.infer(padded_input, padded_output);
+        ASSERT_FALSE(padded_output.is_contiguous());
+        for (size_t o = 0; o < 5; o++) {
+            for (size_t j = 0; j < columns; j++) {
+                EXPECT_EQ(padded_output.at(o, j), contiguous_output.at(o, j));
+            }
+            EXPECT_EQ(padded_output.data()[o * padded_output.stride() + columns], 0.0f);
+        }
+    }
+
+    EXPECT_THROW(quantized.infer(Matrix<float>(69, 1), output), std::invalid_argument);
+    EXPECT_THROW(nn::QuantizedLayer(layer, 0.0f), std::invalid_argument);
+}
+
+TEST_F(QuantizationTest, NetworkTakesItsOwnResult) {
+    // one layer: the result lives in the buffer the first layer writes
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::Tanh> layer(8, 8);
+    network.add(&layer);
+    const Matrix<float> input = random_matrix(8, 3, -1.0f, 1.0f, 4);
+    nn::QuantizedNetwork quantized(network, input);
+
+    const Matrix<float> once = quantized.predict(input);
+    const Matrix<float> expected = quantized.predict(once);
+    const Matrix<float>& twice = quantized.predict(quantized.predict(input));
+    for (size_t o = 0; o < 8; o++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_EQ(twice.at(o, j), expected.at(o, j));
+        }
+    }
+
+    Matrix<float> output = random_matrix(8, 3, -1.0f, 1.0f, 5);
+    nn::QuantizedLayer quantized_layer(layer, 1.0f / 127.0f);
+    EXPECT_THROW(quantized_layer.infer(output, output), std::invalid_argument);
+}
+
+TEST_F(QuantizationTest, NetworkKeepsPredictionsOfTrainedModel) {
+    // four well separated classes in 32 dimensions
+    const size_t samples = 400;
+    std::mt19937 gen(11);
+    std::normal_distribution<float> noise(0.0f, 0.3f);
+    const Matrix<float> prototypes = random_matrix(32, 4, -1.0f, 1.0f, 12);
+    std::vector<Matrix<float>> inputs;
+    std::vector<Matrix<float>> targets;
+    Matrix<float> all(32, samples);
+    for (size_t i = 0; i < samples; i++) {
+        Matrix<float> x(32, 1);
+        for (size_t k = 0; k < 32; k++) {
+            x.at(k, 0) = prototypes.at(k, i % 4) + noise(gen);
+            all.at(k, i) = x.at(k, 0);
+        }
+        Matrix<float> t(4, 1);
+        t.at(i % 4, 0) = 1.0f;
+        inputs.push_back(x);
+        targets.push_back(t);
+    }
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> hidden(32, 16, 0.01f, nn::InitializationType::HE_UNIFORM);
+    nn::Layer<float, nn::activations::Sigmoid> output(16, 4);
+    nn::SGD<float> hidden_optimizer(0.5f, 0.9f);
+    nn::SGD<float> output_optimizer(0.5f, 0.9f);
+    hidden.set_optimizer(&hidden_optimizer);
+    output.set_optimizer(&output_optimizer);
+    network.add(&hidden);
+    network.add(&output);
+    network.set_verbosity(nn::Verbosity::SILENT);
+    network.train(inputs, targets, 20, 16);
+
+    Matrix<float> calibration(32, 100);
+    for (size_t k = 0; k < 32; k++) {
+        for (size_t j = 0; j < 100; j++) {
+            calibration.at(k, j) = all.at(k, j);
+        }
+    }
+    nn::QuantizedNetwork quantized(network, calibration);
+    EXPECT_EQ(quantized.input_size(), 32);
+    EXPECT_EQ(quantized.output_size(), 4);
+
+    // calibrating on a padded copy finds the same input scales
+    Matrix<float> padded_calibration = Matrix<float>::padded(32, 100);
+    padded_calibration = calibration;
+    const nn::QuantizedNetwork padded_quantized(network, padded_calibration);
+    for (size_t i = 0; i < 2; i++) {
+        EXPECT_EQ(padded_quantized.layers()[i].input_scale(), quantized.layers()[i].input_scale());
+    }
+
+    const Matrix<float> expected = network.predict(all);
+    const Matrix<float>& result = quantized.predict(all);
+    size_t agree = 0;
+    for (size_t j = 0; j < samples; j++) {
+        size_t float_class = 0;
+        size_t int8_class = 0;
+        for (size_t c = 1; c < 4; c++) {
+            if (expected.at(c, j) > expected.at(float_class, j)) float_class = c;
+            if (result.at(c, j) > result.at(int8_class, j)) int8_class = c;
+        }
+        agree += float_class == int8_class;
+        for (size_t c = 0; c < 4; c++) {
+            EXPECT_NEAR(result.at(c, j), expected.at(c, j), 0.05f);
+        }
+    }
+    EXPECT_GE(agree, samples * 99 / 100);
+}
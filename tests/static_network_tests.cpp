@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include "nn/static_network.hpp"
+#include "nn/network.hpp"
+#include "nn/layer.hpp"
+#include "nn/activation.hpp"
+
+using MnistNetwork = nn::StaticNetwork<float,
+    nn::StaticLayer<784, 128, nn::activations::ReLU>,
+    nn::StaticLayer<128, 64, nn::activations::ReLU>,
+    nn::StaticLayer<64, 10, nn::activations::Sigmoid>>;
+
+static_assert(MnistNetwork::num_layers == 3, "three layers");
+static_assert(MnistNetwork::input_size == 784 && MnistNetwork::output_size == 10, "sizes are constants");
+
+class StaticNetworkTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        network.add(&layer1);
+        network.add(&layer2);
+        network.add(&layer3);
+
+        std::mt19937 gen(5);
+        std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+        Matrix<float> bias1(128, 1), bias3(10, 1);
+        for (size_t i = 0; i < 128; i++) bias1.at(i, 0) = dist(gen);
+        for (size_t i = 0; i < 10; i++) bias3.at(i, 0) = dist(gen);
+        layer1.set_bias(bias1);
+        layer3.set_bias(bias3);
+    }
+
+    nn::Network<float> network;
+    nn::Layer<float, nn::activations::ReLU> layer1{784, 128};
+    nn::Layer<float, nn::activations::ReLU> layer2{128, 64};
+    nn::Layer<float, nn::activations::Sigmoid> layer3{64, 10};
+};
+
+TEST_F(StaticNetworkTest, MatchesNetworkPredict) {
+    auto model = std::make_unique<MnistNetwork>(network);
+
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+    for (int sample = 0; sample < 5; sample++) {
+        MnistNetwork::Input image;
+        for (auto& p : image) p = pixel(gen);
+        const Matrix<float> input(784, 1, std::vector<float>(image.begin(), image.end()));
+
+        const Matrix<float>& expected = network.predict(input);
+        const MnistNetwork::Output& output = model->predict(image);
+        for (size_t c = 0; c < 10; c++) {
+            EXPECT_NEAR(output[c], expected.at(c, 0), 1e-5f);
+        }
+        EXPECT_EQ(&model->predict(input), &output);
+
+        // a padded column has one element per 16 floats
+        Matrix<float> padded = Matrix<float>::padded(784, 1);
+        padded = input;
+        ASSERT_EQ(padded.stride(), 16u);
+        const MnistNetwork::Output& from_padded = model->predict(padded);
+        for (size_t c = 0; c < 10; c++) {
+            EXPECT_NEAR(from_padded[c], expected.at(c, 0), 1e-5f);
+        }
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(output.data()) % 64, 0u);
+    }
+
+    EXPECT_THROW(model->predict(Matrix<float>(784, 2)), std::invalid_argument);
+}
+
+TEST_F(StaticNetworkTest, LoadChecksTheTopology) {
+    auto model = std::make_unique<MnistNetwork>();
+    nn::Network<float> two_layers;
+    two_layers.add(&layer1);
+    two_layers.add(&layer2);
+    EXPECT_THROW(model->load(two_layers), std::invalid_argument);
+
+    // same sizes, another activation
+    nn::Layer<float, nn::activations::Tanh> tanh_layer(128, 64);
+    nn::Network<float> other;
+    other.add(&layer1);
+    other.add(&tanh_layer);
+    other.add(&layer3);
+    EXPECT_THROW(model->load(other), std::invalid_argument);
+
+    // a network of one layer, zero until loaded
+    nn::StaticNetwork<double, nn::StaticLayer<3, 2, nn::activations::Identity>> linear;
+    EXPECT_EQ(linear.predict({1.0, 2.0, 3.0})[1], 0.0);
+    nn::Layer<double, nn::activations::Identity> layer(3, 2);
+    layer.set_weights(Matrix<double>(2, 3, {1, 0, 0, 0, 2, 1}));
+    layer.set_bias(Matrix<double>(2, 1, {0.5, -1}));
+    nn::Network<double> single;
+    single.add(&layer);
+    linear.load(single);
+    const auto& y = linear.predict({1.0, 2.0, 3.0});
+    EXPECT_DOUBLE_EQ(y[0], 1.5);
+    EXPECT_DOUBLE_EQ(y[1], 6.0);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "nn/thread_pool.hpp"
+#include "nn/matrix.hpp"
+
+class ThreadPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override { nn::set_num_threads(4); }
+    void TearDown() override { nn::set_num_threads(1); }
+};
+
+TEST_F(ThreadPoolTest, NumThreads) {
+    EXPECT_EQ(nn::num_threads(), 4);
+
+    nn::set_num_threads(2);
+    EXPECT_EQ(nn::num_threads(), 2);
+
+    // 0 falls back to running on the calling thread only
+    nn::set_num_threads(0);
+    EXPECT_EQ(nn::num_threads(), 1);
+}
+
+TEST_F(ThreadPoolTest, RunExecutesEveryTaskOnce) {
+    std::vector<std::atomic<int>> hits(100);
+    for (auto& h : hits) {
+        h = 0;
+    }
+
+    // Reuse the same pool for several jobs
+    for (int round = 0; round < 10; round++) {
+        nn::thread_pool().run(hits.size(), [&](size_t task) { hits[task]++; });
+    }
+
+    for (auto& h : hits) {
+        EXPECT_EQ(h.load(), 10);
+    }
+}
+
+TEST_F(ThreadPoolTest, ParallelForCoversRange) {
+    std::vector<int> values(100000, 0);
+
+    nn::parallel_for(0, values.size(), 1000, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            values[i] += 1;
+        }
+    });
+
+    for (int v : values) {
+        ASSERT_EQ(v, 1);
+    }
+}
+
+TEST_F(ThreadPoolTest, NestedRunIsSerial) {
+    std::atomic<int> count{0};
+
+    nn::thread_pool().run(8, [&](size_t) {
+        nn::thread_pool().run(8, [&](size_t) { count++; });
+    });
+
+    EXPECT_EQ(count.load(), 64);
+}
+
+TEST_F(ThreadPoolTest, ExceptionsPropagateToCaller) {
+    EXPECT_THROW(nn::thread_pool().run(16, [](size_t task) {
+        if (task == 7) {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+
+    // The pool stays usable
+    std::atomic<int> count{0};
+    nn::thread_pool().run(16, [&](size_t) { count++; });
+    EXPECT_EQ(count.load(), 16);
+}
+
+TEST_F(ThreadPoolTest, ParallelMatrixOpsMatchSerial) {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    auto random_matrix = [&](size_t rows, size_t columns) {
+        std::vector<float> values(rows * columns);
+        for (auto& v : values) {
+            v = dist(gen);
+        }
+        return Matrix<float>(rows, columns, values);
+    };
+
+    // Shapes of the mnist layers, large enough to be split over the threads
+    Matrix<float> w = random_matrix(128, 784);
+    Matrix<float> x = random_matrix(784, 64);
+    Matrix<float> y = random_matrix(256, 300);
+
+    Matrix<float> product = w * x;
+    Matrix<float> sum = y + y;
+    Matrix<float> hadamard = y.hadamard(y);
+
+    nn::set_num_threads(1);
+    Matrix<float> serial_product = w * x;
+    Matrix<float> serial_hadamard = y.hadamard(y);
+
+    for (size_t i = 0; i < product.rows(); i++) {
+        for (size_t j = 0; j < product.columns(); j++) {
+            ASSERT_FLOAT_EQ(product.at(i, j), serial_product.at(i, j));
+        }
+    }
+    for (size_t i = 0; i < y.rows(); i++) {
+        for (size_t j = 0; j < y.columns(); j++) {
+            ASSERT_FLOAT_EQ(sum.at(i, j), 2 * y.at(i, j));
+            ASSERT_FLOAT_EQ(hadamard.at(i, j), serial_hadamard.at(i, j));
+        }
+    }
+}